@@ -0,0 +1,58 @@
+#include "Bench.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Global operator new/delete replacement so benchmarks can report heap
+// traffic. Each block carries its size in a 16-byte header.
+namespace {
+
+std::atomic<size_t> g_liveBytes{0};
+std::atomic<size_t> g_allocations{0};
+std::atomic<size_t> g_peakBytes{0};
+
+constexpr size_t kHeader = 16;
+
+void* countedAlloc(size_t n) {
+    void* p = std::malloc(n + kHeader);
+    if (!p) throw std::bad_alloc();
+    *static_cast<size_t*>(p) = n;
+    const size_t live = g_liveBytes.fetch_add(n, std::memory_order_relaxed) + n;
+    size_t peak = g_peakBytes.load(std::memory_order_relaxed);
+    while (live > peak && !g_peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return static_cast<char*>(p) + kHeader;
+}
+
+void countedFree(void* p) noexcept {
+    if (!p) return;
+    void* base = static_cast<char*>(p) - kHeader;
+    g_liveBytes.fetch_sub(*static_cast<size_t*>(base), std::memory_order_relaxed);
+    std::free(base);
+}
+
+}
+
+size_t Bench::liveBytes() {
+    return g_liveBytes.load(std::memory_order_relaxed);
+}
+
+size_t Bench::peakBytes() {
+    return g_peakBytes.load(std::memory_order_relaxed);
+}
+
+void Bench::resetPeak() {
+    g_peakBytes.store(g_liveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+size_t Bench::allocationCount() {
+    return g_allocations.load(std::memory_order_relaxed);
+}
+
+void* operator new(size_t n) { return countedAlloc(n); }
+void* operator new[](size_t n) { return countedAlloc(n); }
+void operator delete(void* p) noexcept { countedFree(p); }
+void operator delete[](void* p) noexcept { countedFree(p); }
+void operator delete(void* p, size_t) noexcept { countedFree(p); }
+void operator delete[](void* p, size_t) noexcept { countedFree(p); }
@@ -0,0 +1,113 @@
+#include "Bench.h"
+#include "BeamSearch.h"
+#include "MarkovModel.h"
+#include "MelodyGenerator.h"
+#include "MelodyStream.h"
+#include "RhythmModel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+void runBeamSearchBench(const BenchOptions& opt) {
+    auto melodies = Bench::loadMelodies(opt.dataRoot);
+    auto durations = Bench::loadDurations(opt.dataRoot);
+    if (melodies.empty() || durations.empty()) {
+        std::cout << "  no training sequences under " << opt.dataRoot << "\n";
+        return;
+    }
+    const int order = 2;
+    MarkovModel melody(order);
+    RhythmModel rhythm(order);
+    melody.trainMany(melodies);
+    rhythm.trainMany(durations);
+    melody.freeze(1.0);
+    rhythm.freeze(1.0);
+    MelodyGenerator gen(melody, rhythm, order, 8);
+
+    // C major between G3 and G5.
+    MelodyRequest request;
+    request.startPitch = 60;
+    request.minPitch = 55;
+    request.maxPitch = 79;
+    request.enforceScale = true;
+    request.allowedPitchClasses = { 0, 2, 4, 5, 7, 9, 11 };
+    const PitchMask mask = allowedPitches(request);
+
+    // Repairing moves every out-of-range draw onto the range edges; masking
+    // keeps the learned shape inside the range.
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "  sampling        ns/note   notes on range edges   outside mask\n";
+    const size_t notes = 1000000;
+    std::vector<NoteEvent> out(notes);
+    for (bool constrained : { false, true }) {
+        request.constrained = constrained;
+        std::vector<double> seconds;
+        for (int r = 0; r < opt.repeats; ++r) {
+            MelodyStream stream = gen.stream(request, MelodyGenerator::streamFor(3, 0));
+            auto t0 = Bench::clock::now();
+            stream.next(out.data(), out.size());
+            seconds.push_back(Bench::secondsSince(t0));
+        }
+        size_t edges = 0, outside = 0;
+        for (const auto &n : out) {
+            edges += n.pitch == request.minPitch || n.pitch == request.maxPitch;
+            outside += !mask.test(n.pitch);
+        }
+        const std::string key = constrained ? "sample/masked" : "sample/repaired";
+        Bench::record(Bench::Result{ "beam-search", key, notes, "note", seconds });
+        Bench::metric("beam-search", key + "/on-range-edges", static_cast<double>(edges) / static_cast<double>(notes), "ratio");
+        Bench::metric("beam-search", key + "/outside-mask", static_cast<double>(outside), "note");
+        const double best = Bench::best(seconds);
+        std::cout << "  " << std::left << std::setw(14) << (constrained ? "masked" : "repaired") << std::right
+                  << std::setw(9) << best * 1e9 / static_cast<double>(notes)
+                  << std::setw(22) << 100.0 * static_cast<double>(edges) / static_cast<double>(notes) << "%"
+                  << std::setw(14) << outside << "\n";
+    }
+
+    // Beam search: 64 notes ending on C4, and 8 seconds ending on C4.
+    request.length = 64;
+    request.endPitch = 60;
+    BeamSearch search(melody, rhythm, order, 8);
+    std::vector<NoteEvent> melodyOut;
+    std::cout << "  beam search     width   ms/search   notes/s   log-lik/note   expanded   allocs   arena KiB   constraints\n";
+    for (double target : { 0.0, 8.0 }) {
+        request.targetDuration = target;
+        for (int width : { 1, 2, 4, 8, 16, 32, 64 }) {
+            search.search(request, width, melodyOut);    // warm the arenas
+            std::vector<double> seconds;
+            size_t allocs = 0;
+            bool found = false;
+            for (int r = 0; r < opt.repeats; ++r) {
+                const size_t a0 = Bench::allocationCount();
+                auto t0 = Bench::clock::now();
+                found = search.search(request, width, melodyOut);
+                seconds.push_back(Bench::secondsSince(t0));
+                allocs = Bench::allocationCount() - a0;
+            }
+            const double best = Bench::best(seconds);
+            bool ok = found && !melodyOut.empty() && melodyOut.back().pitch == request.endPitch;
+            for (const auto &n : melodyOut) ok = ok && mask.test(n.pitch);
+            if (target > 0.0) ok = ok && !melodyOut.empty() && std::fabs(melodyOut.back().startTime + melodyOut.back().duration - target) < rhythm.unit();
+            else ok = ok && melodyOut.size() == static_cast<size_t>(request.length);
+            const std::string key = std::string(target > 0.0 ? "beam/8s" : "beam/64notes") + "/width" + std::to_string(width);
+            Bench::record(Bench::Result{ "beam-search", key, melodyOut.size(), "note", seconds });
+            Bench::metric("beam-search", key + "/log-lik-per-note",
+                          melodyOut.empty() ? 0.0 : search.logLikelihood() / static_cast<double>(melodyOut.size()), "nat");
+            Bench::metric("beam-search", key + "/expanded", static_cast<double>(search.expanded()), "node");
+            Bench::metric("beam-search", key + "/allocations", static_cast<double>(allocs), "alloc");
+            Bench::metric("beam-search", key + "/arena-bytes", static_cast<double>(search.arenaBytes()), "byte");
+            Bench::metric("beam-search", key + "/constraints-met", ok ? 1.0 : 0.0, "search");
+            std::cout << "  " << std::left << std::setw(14) << (target > 0.0 ? "8 s, end C4" : "64 notes, end C4") << std::right
+                      << std::setw(7) << width << std::setw(12) << best * 1e3
+                      << std::setw(10) << static_cast<double>(melodyOut.size()) / best
+                      << std::setw(15) << (melodyOut.empty() ? 0.0 : search.logLikelihood() / static_cast<double>(melodyOut.size()))
+                      << std::setw(11) << search.expanded() << std::setw(9) << allocs
+                      << std::setw(12) << static_cast<double>(search.arenaBytes()) / 1024.0
+                      << "   " << (ok ? "met" : "NOT MET") << " (" << melodyOut.size() << " notes)\n";
+        }
+    }
+}
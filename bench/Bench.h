@@ -0,0 +1,107 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct BenchOptions {
+    std::string dataRoot = "../data";
+    int repeats = 5;
+    // Notes in the synthetic corpus of the "pipeline" bench.
+    size_t syntheticNotes = 200000;
+    // With a path, every reported result is also written there as JSON.
+    std::string jsonPath;
+};
+
+namespace Bench {
+
+    using clock = std::chrono::steady_clock;
+
+    inline double secondsSince(clock::time_point t0) {
+        return std::chrono::duration<double>(clock::now() - t0).count();
+    }
+
+    // Sorted list of regular files in `dir` whose extension is one of `exts`.
+    std::vector<std::string> listFiles(const std::string& dir, const std::vector<std::string>& exts);
+
+    // Keeps the optimizer from discarding benchmarked work.
+    void consume(size_t v);
+
+    // Heap accounting from the replaced global operator new/delete.
+    size_t liveBytes();
+    size_t allocationCount();
+    // High-water mark of liveBytes() since the last resetPeak().
+    size_t peakBytes();
+    void resetPeak();
+
+    // Melody sequences from <dataRoot>/melodies, in sorted file order.
+    std::vector<std::vector<int>> loadMelodies(const std::string& dataRoot);
+    // Duration sequences from <dataRoot>/durations, in sorted file order.
+    std::vector<std::vector<double>> loadDurations(const std::string& dataRoot);
+
+    // Seconds taken by each of `repeats` calls of fn().
+    template <class F>
+    std::vector<double> repeat(int repeats, F&& fn) {
+        std::vector<double> seconds;
+        for (int r = 0; r < repeats; ++r) {
+            auto t0 = clock::now();
+            fn();
+            seconds.push_back(secondsSince(t0));
+        }
+        return seconds;
+    }
+
+    // One timed measurement: `items` units of work (notes, draws, files) per
+    // repeat, and the seconds every repeat took.
+    struct Result {
+        std::string bench;
+        std::string name;
+        size_t items = 0;
+        std::string unit;
+        std::vector<double> seconds;
+    };
+    // Prints one line with the best and median repeat, and keeps the result
+    // for the JSON report.
+    void report(const Result& result);
+    // As report(), without the line, for benches that print their own table.
+    void record(const Result& result);
+    // The fastest of `seconds`, which tables and regressions go by.
+    double best(const std::vector<double>& seconds);
+    // A measured number that is not a time (a size, a ratio, a mismatch
+    // count), kept for the JSON report next to the timed results.
+    void metric(const std::string& bench, const std::string& name, double value, const std::string& unit);
+
+    // Melodies and rhythms with the statistics of real ones, reproducible
+    // from `seed`: scale-degree random walks in a random key with repeated
+    // motifs, and durations from a weighted grid. Any number of notes, split
+    // into sequences of about `sequenceLength`.
+    struct SyntheticCorpus {
+        std::vector<std::vector<int>> melodies;
+        std::vector<std::vector<double>> durations;
+        size_t notes = 0;
+    };
+    SyntheticCorpus synthesize(size_t notes, uint64_t seed, size_t sequenceLength = 2000);
+}
+
+void runParserBench(const BenchOptions& opt);
+void runMarkovTableBench(const BenchOptions& opt);
+void runSamplingBench(const BenchOptions& opt);
+void runModelFileBench(const BenchOptions& opt);
+void runCorpusBench(const BenchOptions& opt);
+void runTrainingBench(const BenchOptions& opt);
+void runIncrementalBench(const BenchOptions& opt);
+void runGenerationBench(const BenchOptions& opt);
+void runStreamingBench(const BenchOptions& opt);
+void runMidiStreamBench(const BenchOptions& opt);
+void runMidiWriterBench(const BenchOptions& opt);
+void runMelodyExtractBench(const BenchOptions& opt);
+void runTempoMapBench(const BenchOptions& opt);
+void runRhythmQuantizerBench(const BenchOptions& opt);
+void runJointModelBench(const BenchOptions& opt);
+void runContextTreeBench(const BenchOptions& opt);
+void runCompactModelBench(const BenchOptions& opt);
+void runRngBench(const BenchOptions& opt);
+void runBeamSearchBench(const BenchOptions& opt);
+void runScaleBench(const BenchOptions& opt);
+void runIntervalModelBench(const BenchOptions& opt);
+void runPipelineBench(const BenchOptions& opt);
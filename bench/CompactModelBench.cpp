@@ -0,0 +1,87 @@
+#include "Bench.h"
+#include "CompactModel.h"
+#include "MarkovModel.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+void runCompactModelBench(const BenchOptions& opt) {
+    auto melodies = Bench::loadMelodies(opt.dataRoot);
+    if (melodies.size() < 2) {
+        std::cout << "  need at least two melody sequences under " << opt.dataRoot << "\n";
+        return;
+    }
+    // Every tenth melody, with all its transpositions, is held out, so the
+    // test set shares no material with training.
+    std::vector<std::vector<int>> train, heldOut;
+    for (int shift = -5; shift <= 6; ++shift) {
+        for (size_t m = 0; m < melodies.size(); ++m) {
+            std::vector<int> t(melodies[m]);
+            for (int &p : t) p = std::min(127, std::max(0, p + shift));
+            (m % 10 == 9 ? heldOut : train).push_back(std::move(t));
+        }
+    }
+    std::cout << "  " << train.size() << " training, " << heldOut.size() << " held-out sequences\n";
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "  order   bits   budget %   top-K   min count   min history   histories    entries      KiB"
+                 "   held-out PPL   change   build ms\n";
+
+    for (int order : { 2, 4, 8 }) {
+        MarkovModel model(order);
+        model.trainMany(train);
+        const size_t fullBytes = model.memoryBytes();
+        const double fullPerplexity = CompactModel::perplexity(model, heldOut);
+        const std::string prefix = "order" + std::to_string(order) + "/";
+        Bench::metric("compact-model", prefix + "full/bytes", static_cast<double>(fullBytes), "byte");
+        Bench::metric("compact-model", prefix + "full/held-out-ppl", fullPerplexity, "ppl");
+        std::cout << "  " << std::setw(5) << order << "   full" << std::setw(11) << "-" << std::setw(8) << "-"
+                  << std::setw(12) << "-" << std::setw(14) << "-" << std::setw(12) << model.historyCount()
+                  << std::setw(11) << model.transitionCount() << std::setw(9) << static_cast<double>(fullBytes) / 1024.0
+                  << std::setprecision(3) << std::setw(15) << fullPerplexity << std::setprecision(1)
+                  << std::setw(9) << "-" << std::setw(11) << "-" << "\n";
+
+        struct Case {
+            int bits;
+            double budgetShare;
+            uint32_t topK;
+        };
+        const Case cases[] = {
+            { 16, 0.0, 0 }, { 8, 0.0, 0 }, { 8, 0.0, 8 },
+            { 8, 0.5, 0 }, { 8, 0.25, 0 }, { 8, 0.1, 0 }, { 8, 0.05, 0 }, { 8, 0.02, 0 },
+            { 16, 0.1, 0 }, { 8, 0.1, 8 },
+        };
+        for (const Case &c : cases) {
+            CompactModel::Options options;
+            options.countBits = c.bits;
+            options.topK = c.topK;
+            options.budgetBytes = static_cast<size_t>(c.budgetShare * static_cast<double>(fullBytes));
+            CompactModel compact;
+            auto t0 = Bench::clock::now();
+            const bool fits = compact.build(model, options);
+            const double seconds = Bench::secondsSince(t0);
+            const double ms = seconds * 1e3;
+            const double perplexity = compact.perplexity(heldOut);
+            std::string key = prefix + std::to_string(c.bits) + "bit";
+            if (c.budgetShare > 0.0) key += "/budget" + std::to_string(static_cast<int>(100.0 * c.budgetShare)) + "%";
+            if (c.topK > 0) key += "/top" + std::to_string(c.topK);
+            Bench::record(Bench::Result{ "compact-model", key + "/build", model.transitionCount(), "entry", { seconds } });
+            Bench::metric("compact-model", key + "/bytes", static_cast<double>(compact.memoryBytes()), "byte");
+            Bench::metric("compact-model", key + "/histories", static_cast<double>(compact.historyCount()), "history");
+            Bench::metric("compact-model", key + "/entries", static_cast<double>(compact.entryCount()), "entry");
+            Bench::metric("compact-model", key + "/held-out-ppl", perplexity, "ppl");
+            Bench::metric("compact-model", key + "/over-budget", fits ? 0.0 : 1.0, "model");
+            std::cout << "  " << std::setw(5) << order << std::setw(7) << c.bits;
+            if (c.budgetShare > 0.0) std::cout << std::setw(11) << 100.0 * c.budgetShare;
+            else std::cout << std::setw(11) << "-";
+            std::cout << std::setw(8) << c.topK << std::setw(12) << compact.minCount() << std::setw(14) << compact.minHistoryCount()
+                      << std::setw(12) << compact.historyCount() << std::setw(11) << compact.entryCount()
+                      << std::setw(9) << static_cast<double>(compact.memoryBytes()) / 1024.0
+                      << std::setprecision(3) << std::setw(15) << perplexity << std::setprecision(1)
+                      << std::setw(8) << 100.0 * (perplexity / fullPerplexity - 1.0) << "%"
+                      << std::setw(11) << ms << (fits ? "" : "  (over budget)") << "\n";
+        }
+    }
+}
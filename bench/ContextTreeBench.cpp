@@ -0,0 +1,115 @@
+#include "Bench.h"
+#include "ContextTree.h"
+#include "MarkovModel.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+bool sameRow(NGramTable::Row a, NGramTable::Row b) {
+    if (a.size != b.size) return false;
+    std::vector<NGramTable::Entry> x(a.begin(), a.end()), y(b.begin(), b.end());
+    auto byToken = [](const NGramTable::Entry& l, const NGramTable::Entry& r) { return l.token < r.token; };
+    std::sort(x.begin(), x.end(), byToken);
+    std::sort(y.begin(), y.end(), byToken);
+    for (size_t i = 0; i < x.size(); ++i) {
+        if (x[i].token != y[i].token || x[i].count != y[i].count) return false;
+    }
+    return true;
+}
+
+// Best-of-repeats nanoseconds per lookup over every position of `seqs`,
+// recorded as `name`.
+template <class Model>
+double lookupNs(const std::string& name, const Model& model, const std::vector<std::vector<int>>& seqs, size_t positions, int repeats) {
+    const Bench::Result result{ "context-tree", name, positions, "lookup", Bench::repeat(repeats, [&] {
+        size_t sink = 0;
+        for (const auto &s : seqs) {
+            for (size_t i = 0; i < s.size(); ++i) sink += model.lookup(s.data(), i).size;
+        }
+        Bench::consume(sink);
+    }) };
+    Bench::record(result);
+    return Bench::best(result.seconds) * 1e9 / static_cast<double>(positions);
+}
+
+}
+
+void runContextTreeBench(const BenchOptions& opt) {
+    auto melodies = Bench::loadMelodies(opt.dataRoot);
+    if (melodies.empty()) {
+        std::cout << "  no melody sequences under " << opt.dataRoot << "\n";
+        return;
+    }
+    // Transposed copies give the high orders enough material to keep.
+    std::vector<std::vector<int>> seqs;
+    for (int shift = -5; shift <= 6; ++shift) {
+        for (const auto &m : melodies) {
+            std::vector<int> t(m);
+            for (int &p : t) p = std::min(127, std::max(0, p + shift));
+            seqs.push_back(std::move(t));
+        }
+    }
+    size_t positions = 0;
+    for (const auto &s : seqs) positions += s.size();
+    std::cout << "  " << seqs.size() << " sequences, " << positions << " positions\n";
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "  model          order  min   contexts    entries      KiB   ns/lookup   mean depth\n";
+
+    for (int order : { 2, 4, 8 }) {
+        MarkovModel markov(order);
+        markov.trainMany(seqs);
+        const std::string key = "markov/order" + std::to_string(order);
+        Bench::metric("context-tree", key + "/entries", static_cast<double>(markov.transitionCount()), "entry");
+        Bench::metric("context-tree", key + "/bytes", static_cast<double>(markov.memoryBytes()), "byte");
+        std::cout << "  markov         " << std::setw(5) << order << "    -" << std::setw(11) << "-"
+                  << std::setw(11) << markov.transitionCount()
+                  << std::setw(9) << static_cast<double>(markov.memoryBytes()) / 1024.0
+                  << std::setw(12) << lookupNs(key, markov, seqs, positions, opt.repeats) << std::setw(13) << "-" << "\n";
+    }
+
+    for (int order : { 2, 4, 8, 16, 32 }) {
+        for (uint32_t minCount : { 1u, 2u }) {
+            ContextTree tree(order, minCount);
+            tree.build(seqs);
+            double depth = 0.0;
+            for (const auto &s : seqs) {
+                for (size_t i = 0; i < s.size(); ++i) {
+                    size_t d = 0;
+                    tree.lookup(s.data(), i, &d);
+                    depth += static_cast<double>(d);
+                }
+            }
+            const std::string key = "tree/order" + std::to_string(order) + "/min" + std::to_string(minCount);
+            Bench::metric("context-tree", key + "/contexts", static_cast<double>(tree.nodeCount()), "context");
+            Bench::metric("context-tree", key + "/entries", static_cast<double>(tree.entryCount()), "entry");
+            Bench::metric("context-tree", key + "/bytes", static_cast<double>(tree.memoryBytes()), "byte");
+            Bench::metric("context-tree", key + "/mean-depth", depth / static_cast<double>(positions), "token");
+            std::cout << "  context tree   " << std::setw(5) << order << std::setw(5) << minCount
+                      << std::setw(11) << tree.nodeCount() << std::setw(11) << tree.entryCount()
+                      << std::setw(9) << static_cast<double>(tree.memoryBytes()) / 1024.0
+                      << std::setw(12) << lookupNs(key, tree, seqs, positions, opt.repeats)
+                      << std::setw(13) << depth / static_cast<double>(positions) << "\n";
+        }
+    }
+
+    // Unpruned, the tree must answer exactly as MarkovModel's backoff does.
+    for (int order : { 2, 4, 8 }) {
+        MarkovModel markov(order);
+        markov.trainMany(seqs);
+        ContextTree tree(order, 1);
+        tree.build(seqs);
+        size_t mismatches = 0;
+        for (const auto &s : seqs) {
+            for (size_t i = 0; i < s.size(); ++i) {
+                if (!sameRow(markov.lookup(s.data(), i), tree.lookup(s.data(), i))) ++mismatches;
+            }
+        }
+        std::cout << "  order " << order << " rows differing from MarkovModel: " << mismatches << "\n";
+        Bench::metric("context-tree", "tree/order" + std::to_string(order) + "/rows-differing", static_cast<double>(mismatches), "row");
+    }
+}
@@ -0,0 +1,100 @@
+#include "Bench.h"
+#include "CorpusFile.h"
+#include "MarkovModel.h"
+#include "MidiParser.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+uintmax_t folderBytes(const std::string& dir) {
+    uintmax_t total = 0;
+    for (const auto &f : Bench::listFiles(dir, { ".txt" })) total += std::filesystem::file_size(f);
+    return total;
+}
+
+}
+
+void runCorpusBench(const BenchOptions& opt) {
+    auto midiPaths = Bench::listFiles(opt.dataRoot + "/raw_midis", { ".mid", ".midi" });
+    if (midiPaths.empty()) {
+        std::cout << "  no MIDI files under " << opt.dataRoot << "/raw_midis\n";
+        return;
+    }
+    Parser parser;
+    std::vector<CorpusFile::Sequence> sequences;
+    for (const auto &p : midiPaths) {
+        sequences.push_back(CorpusFile::fromNotes(std::filesystem::path(p).stem().string(), parser.parseMidiFile(p)));
+    }
+    const std::string path = (std::filesystem::temp_directory_path() / "musicgen_bench_corpus.bin").string();
+    if (!CorpusFile::write(path, sequences)) return;
+
+    std::vector<double> text, mapped, mappedNoVerify;
+    size_t textNotes = 0;
+    size_t mismatches = 0;
+    for (int r = 0; r < opt.repeats; ++r) {
+        auto t0 = Bench::clock::now();
+        auto melodies = Bench::loadMelodies(opt.dataRoot);
+        auto durations = Bench::loadDurations(opt.dataRoot);
+        text.push_back(Bench::secondsSince(t0));
+        textNotes = 0;
+        for (const auto &s : melodies) textNotes += s.size();
+        Bench::consume(durations.size());
+
+        CorpusFile corpus;
+        t0 = Bench::clock::now();
+        bool ok = corpus.open(path, true);
+        auto pitches = corpus.allPitches();
+        auto durs = corpus.allDurations();
+        mapped.push_back(Bench::secondsSince(t0));
+        Bench::consume(pitches.size() + durs.size());
+
+        CorpusFile fast;
+        t0 = Bench::clock::now();
+        ok = fast.open(path, false) && ok;
+        Bench::consume(fast.allPitches().size() + fast.allDurations().size());
+        mappedNoVerify.push_back(Bench::secondsSince(t0));
+
+        if (r == 0) {
+            // The mapped corpus must hold exactly what was written, and train
+            // the same melody table as the exported text.
+            if (!ok || corpus.size() != sequences.size()) ++mismatches;
+            for (size_t i = 0; ok && i < corpus.size(); ++i) {
+                if (corpus.name(i) != sequences[i].name ||
+                    !std::equal(pitches[i].begin(), pitches[i].end(), sequences[i].pitches.begin(), sequences[i].pitches.end()) ||
+                    !std::equal(durs[i].begin(), durs[i].end(), sequences[i].durations.begin(), sequences[i].durations.end())) {
+                    ++mismatches;
+                }
+            }
+            MarkovModel fromText(2), fromCorpus(2);
+            fromText.trainMany(melodies);
+            fromCorpus.trainMany(pitches);
+            if (fromText.transitionCount() != fromCorpus.transitionCount() ||
+                fromText.observationCount() != fromCorpus.observationCount()) {
+                ++mismatches;
+            }
+        }
+    }
+
+    const uintmax_t textBytes = folderBytes(opt.dataRoot + "/melodies") + folderBytes(opt.dataRoot + "/durations");
+    const uintmax_t binBytes = std::filesystem::file_size(path);
+    std::remove(path.c_str());
+    Bench::record(Bench::Result{ "corpus", "text-parse", textNotes, "note", text });
+    Bench::record(Bench::Result{ "corpus", "map-verified", textNotes, "note", mapped });
+    Bench::record(Bench::Result{ "corpus", "map-unverified", textNotes, "note", mappedNoVerify });
+    Bench::metric("corpus", "text-bytes", static_cast<double>(textBytes), "byte");
+    Bench::metric("corpus", "corpus-bytes", static_cast<double>(binBytes), "byte");
+    Bench::metric("corpus", "mismatches", static_cast<double>(mismatches), "sequence");
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "  sequences: " << sequences.size() << ", notes: " << textNotes << ", mismatches: " << mismatches << "\n";
+    std::cout << "  on disk: text " << textBytes << " bytes, corpus " << binBytes << " bytes\n";
+    std::cout << "  text parse (melodies + durations): " << std::setw(9) << Bench::best(text) * 1e3 << " ms\n";
+    std::cout << "  corpus map + checksum + spans:     " << std::setw(9) << Bench::best(mapped) * 1e3 << " ms\n";
+    std::cout << "  corpus map + spans (no checksum):  " << std::setw(9) << Bench::best(mappedNoVerify) * 1e3 << " ms\n";
+}
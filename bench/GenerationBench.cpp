@@ -0,0 +1,92 @@
+#include "Bench.h"
+#include "MarkovModel.h"
+#include "MelodyGenerator.h"
+#include "RhythmModel.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+bool sameMelodies(const std::vector<std::vector<NoteEvent>>& a, const std::vector<std::vector<NoteEvent>>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (!std::equal(a[i].begin(), a[i].end(), b[i].begin(), b[i].end(), [](const NoteEvent &x, const NoteEvent &y) {
+                return x.pitch == y.pitch && x.startTime == y.startTime && x.duration == y.duration;
+            })) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+void runGenerationBench(const BenchOptions& opt) {
+    auto melodies = Bench::loadMelodies(opt.dataRoot);
+    auto durations = Bench::loadDurations(opt.dataRoot);
+    if (melodies.empty() || durations.empty()) {
+        std::cout << "  no training sequences under " << opt.dataRoot << "\n";
+        return;
+    }
+    const int order = 2;
+    MarkovModel melody(order);
+    RhythmModel rhythm(order);
+    melody.trainMany(melodies);
+    rhythm.trainMany(durations);
+    melody.freeze(1.0);
+    rhythm.freeze(1.0);
+    MelodyGenerator gen(melody, rhythm, order, 8);
+
+    // A candidate pool: mixed lengths and ranges, one temperature off the frozen one.
+    std::vector<MelodyRequest> requests(4000);
+    for (size_t i = 0; i < requests.size(); ++i) {
+        MelodyRequest &r = requests[i];
+        r.length = 64 + static_cast<int>(i % 4) * 32;
+        r.startPitch = 55 + static_cast<int>(i % 12);
+        r.minPitch = 48;
+        r.maxPitch = 84;
+        r.melodyTemp = (i % 8 == 7) ? 0.8 : 1.0;
+    }
+    size_t notes = 0;
+    for (const auto &r : requests) notes += static_cast<size_t>(r.length);
+    std::cout << "  " << requests.size() << " requests, " << notes << " notes per batch\n";
+
+    std::vector<size_t> threadCounts;
+    const size_t hw = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t t = 1; t < hw; t *= 2) threadCounts.push_back(t);
+    threadCounts.push_back(hw);
+    if (hw < 4) threadCounts.push_back(4);
+
+    const uint64_t seed = 2024;
+    std::vector<std::vector<NoteEvent>> reference;
+    double bestSingle = 0.0;
+    std::cout << std::fixed << std::setprecision(0);
+    std::cout << "  threads   melodies/s   notes/s     speedup   same as 1 thread\n";
+    for (size_t threads : threadCounts) {
+        ThreadPool pool(threads);
+        std::vector<std::vector<NoteEvent>> out;
+        const Bench::Result batch{ "generation", "batch/threads" + std::to_string(threads), notes, "note",
+                                   Bench::repeat(opt.repeats, [&] { out = gen.generateBatch(requests, seed, pool); }) };
+        Bench::record(batch);
+        const double best = Bench::best(batch.seconds);
+        Bench::metric("generation", batch.name + "/differs-from-1-thread", sameMelodies(reference.empty() ? out : reference, out) ? 0.0 : 1.0, "batch");
+        if (reference.empty()) {
+            reference = out;
+            bestSingle = best;
+        }
+        std::cout << "  " << std::setw(7) << threads << "  " << std::setw(11) << requests.size() / best
+                  << "  " << std::setw(10) << notes / best << "  " << std::setprecision(2) << std::setw(7) << bestSingle / best
+                  << std::setprecision(0) << "   " << (sameMelodies(reference, out) ? "yes" : "NO") << "\n";
+    }
+
+    ThreadPool pool(1);
+    auto reseeded = gen.generateBatch(requests, seed + 1, pool);
+    std::cout << "  different seed gives different batch: " << (sameMelodies(reference, reseeded) ? "NO" : "yes") << "\n";
+    Bench::metric("generation", "reseeded-batch-identical", sameMelodies(reference, reseeded) ? 1.0 : 0.0, "batch");
+}
@@ -0,0 +1,95 @@
+#include "Bench.h"
+#include "CorpusFile.h"
+#include "MarkovModel.h"
+#include "ModelFile.h"
+#include "RhythmModel.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+void runIncrementalBench(const BenchOptions& opt) {
+    auto base = Bench::loadMelodies(opt.dataRoot);
+    if (base.empty()) {
+        std::cout << "  no melody sequences under " << opt.dataRoot << "/melodies\n";
+        return;
+    }
+    // Every key, four times over, as in the training bench.
+    std::vector<std::vector<int>> corpus;
+    for (int c = 0; c < 4; ++c) {
+        for (int shift = -6; shift < 6; ++shift) {
+            for (const auto &s : base) {
+                std::vector<int> t(s);
+                for (int &p : t) p = std::min(127, std::max(0, p + shift));
+                corpus.push_back(std::move(t));
+            }
+        }
+    }
+    const int order = 2;
+    std::cout << "  corpus: " << corpus.size() << " sequences, order " << order << "\n";
+
+    const Bench::Result full{ "incremental", "full-retrain", corpus.size(), "sequence", Bench::repeat(opt.repeats, [&] {
+        MarkovModel m(order);
+        m.trainMany(corpus);
+    }) };
+    Bench::record(full);
+    const double bestFull = Bench::best(full.seconds);
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "  full retrain: " << bestFull * 1e3 << " ms\n";
+    std::cout << "  changed files   update ms   vs retrain   (untrain + train + compact; counts only)\n";
+
+    MarkovModel model(order);
+    model.trainMany(corpus);
+    for (size_t changed : { 1, 8, 64 }) {
+        // Swap `changed` sequences out and back in: a no-op on the counts,
+        // with the cost of a real update.
+        const Bench::Result update{ "incremental", "update/" + std::to_string(changed), changed, "sequence", Bench::repeat(opt.repeats, [&] {
+            for (size_t i = 0; i < changed; ++i) model.untrain(corpus[i]);
+            for (size_t i = 0; i < changed; ++i) model.train(corpus[i]);
+            model.compact();
+        }) };
+        Bench::record(update);
+        const double best = Bench::best(update.seconds);
+        std::cout << "  " << std::setw(13) << changed << "  " << std::setw(10) << best * 1e3
+                  << "  " << std::setw(10) << bestFull / best << "x\n";
+    }
+
+    // What main() writes after every update, however few files changed: the
+    // corpus and the model are rewritten whole, so this part is not
+    // incremental and grows with the corpus.
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    const fs::path dir = fs::temp_directory_path(ec) / "musicgen-incremental-bench";
+    fs::create_directories(dir, ec);
+    if (ec) {
+        std::cout << "  cannot create " << dir.string() << ": " << ec.message() << "\n";
+        return;
+    }
+    std::vector<CorpusFile::Sequence> sequences;
+    std::vector<std::vector<double>> durations;
+    for (size_t i = 0; i < corpus.size(); ++i) {
+        CorpusFile::Sequence seq;
+        seq.name = "seq" + std::to_string(i);
+        for (int p : corpus[i]) seq.pitches.push_back(static_cast<uint8_t>(p));
+        seq.durations.assign(corpus[i].size(), 0.5);
+        durations.push_back(seq.durations);
+        sequences.push_back(std::move(seq));
+    }
+    RhythmModel rhythm(order);
+    rhythm.trainMany(durations);
+    const std::string corpusPath = (dir / "corpus.bin").string();
+    const std::string modelPath = (dir / "model.bin").string();
+    const Bench::Result rewrite{ "incremental", "rewrite-files", corpus.size(), "sequence", Bench::repeat(opt.repeats, [&] {
+        CorpusFile::write(corpusPath, sequences);
+        ModelFile::save(modelPath, model, rhythm);
+    }) };
+    Bench::record(rewrite);
+    Bench::metric("incremental", "rewrite-files/bytes", static_cast<double>(fs::file_size(corpusPath, ec) + fs::file_size(modelPath, ec)), "byte");
+    std::cout << "  file rewrite per update: " << Bench::best(rewrite.seconds) * 1e3
+              << " ms, any number of changed files (corpus.bin + model.bin written whole, not incremental)\n";
+    fs::remove_all(dir, ec);
+}
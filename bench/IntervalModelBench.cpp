@@ -0,0 +1,156 @@
+#include "Bench.h"
+#include "IntervalModel.h"
+#include "MarkovModel.h"
+#include "MelodyGenerator.h"
+#include "MelodyStream.h"
+#include "RhythmModel.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Every melody in all 12 keys, folded into 0..127 by octaves as
+// NoteStore::transpose does.
+std::vector<std::vector<int>> allKeys(const std::vector<std::vector<int>>& melodies) {
+    std::vector<std::vector<int>> out;
+    for (int shift = -6; shift < 6; ++shift) {
+        for (const auto &m : melodies) {
+            std::vector<int> seq(m);
+            for (int &p : seq) {
+                p += shift;
+                while (p > 127) p -= 12;
+                while (p < 0) p += 12;
+            }
+            out.push_back(std::move(seq));
+        }
+    }
+    return out;
+}
+
+}
+
+void runIntervalModelBench(const BenchOptions& opt) {
+    auto melodies = Bench::loadMelodies(opt.dataRoot);
+    auto durations = Bench::loadDurations(opt.dataRoot);
+    if (melodies.size() < 2 || durations.empty()) {
+        std::cout << "  need at least two melody sequences under " << opt.dataRoot << "\n";
+        return;
+    }
+
+    // Table size: the corpus as recorded, and the corpus in all 12 keys.
+    // Absolute tables grow with every new key; interval tables do not.
+    const auto transposed = allKeys(melodies);
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "  corpus      order   model      vocab   histories   entries   table KiB   train ms\n";
+    for (int keys : { 1, 12 }) {
+        const auto &corpus = keys == 1 ? melodies : transposed;
+        for (int order : { 1, 2, 3 }) {
+            for (bool intervals : { false, true }) {
+                MarkovModel absolute(order);
+                IntervalModel relative(order);
+                std::vector<double> seconds;
+                for (int r = 0; r < opt.repeats; ++r) {
+                    absolute = MarkovModel(order);
+                    relative = IntervalModel(order);
+                    auto t0 = Bench::clock::now();
+                    if (intervals) relative.trainMany(corpus);
+                    else absolute.trainMany(corpus);
+                    seconds.push_back(Bench::secondsSince(t0));
+                }
+                size_t trained = 0;
+                for (const auto &m : corpus) trained += m.size();
+                const std::string key = std::string("train/") + (keys == 1 ? "as-recorded" : "12-keys") + "/" +
+                                        (intervals ? "interval" : "absolute") + "/order" + std::to_string(order);
+                Bench::record(Bench::Result{ "interval-model", key, trained, "note", seconds });
+                Bench::metric("interval-model", key + "/vocabulary",
+                              static_cast<double>(intervals ? relative.vocabularySize() : absolute.vocabularySize()), "symbol");
+                Bench::metric("interval-model", key + "/histories",
+                              static_cast<double>(intervals ? relative.historyCount() : absolute.historyCount()), "history");
+                Bench::metric("interval-model", key + "/entries",
+                              static_cast<double>(intervals ? relative.transitionCount() : absolute.transitionCount()), "entry");
+                Bench::metric("interval-model", key + "/table-bytes",
+                              static_cast<double>(intervals ? relative.memoryBytes() : absolute.memoryBytes()), "byte");
+                const double best = Bench::best(seconds);
+                std::cout << "  " << std::left << std::setw(12) << (keys == 1 ? "as recorded" : "12 keys") << std::right
+                          << std::setw(5) << order << "   " << std::left << std::setw(9) << (intervals ? "interval" : "absolute") << std::right
+                          << std::setw(7) << (intervals ? relative.vocabularySize() : absolute.vocabularySize())
+                          << std::setw(12) << (intervals ? relative.historyCount() : absolute.historyCount())
+                          << std::setw(10) << (intervals ? relative.transitionCount() : absolute.transitionCount())
+                          << std::setw(12) << static_cast<double>(intervals ? relative.memoryBytes() : absolute.memoryBytes()) / 1024.0
+                          << std::setw(11) << best * 1e3 << "\n";
+            }
+        }
+    }
+
+    // Data efficiency: leave one melody out, train on the rest, and count the
+    // held-out transitions whose full history was seen followed by the same
+    // next step. The same positions are scored for both models.
+    std::cout << "  held-out coverage   order   absolute   interval\n";
+    for (int order : { 1, 2, 3 }) {
+        double absoluteSum = 0.0, intervalSum = 0.0;
+        for (size_t out = 0; out < melodies.size(); ++out) {
+            std::vector<std::vector<int>> train, test{ melodies[out] };
+            for (size_t i = 0; i < melodies.size(); ++i) {
+                if (i != out) train.push_back(melodies[i]);
+            }
+            MarkovModel absolute(order);
+            IntervalModel relative(order);
+            absolute.trainMany(train);
+            relative.trainMany(train);
+            absoluteSum += IntervalModel::coverage(absolute, test);
+            intervalSum += relative.coverage(test);
+        }
+        const double n = static_cast<double>(melodies.size());
+        Bench::metric("interval-model", "coverage/absolute/order" + std::to_string(order), absoluteSum / n, "ratio");
+        Bench::metric("interval-model", "coverage/interval/order" + std::to_string(order), intervalSum / n, "ratio");
+        std::cout << "  " << std::setw(25) << order << std::setw(10) << 100.0 * absoluteSum / n << "%"
+                  << std::setw(10) << 100.0 * intervalSum / n << "%\n";
+    }
+
+    // Generation cost: the interval path converts order() + 1 pitches to steps
+    // per note on top of the same frozen draw.
+    const int order = 2;
+    MarkovModel melody(order);
+    RhythmModel rhythm(order);
+    IntervalModel intervals(order);
+    melody.trainMany(melodies);
+    rhythm.trainMany(durations);
+    intervals.trainMany(melodies);
+    melody.freeze(1.0);
+    rhythm.freeze(1.0);
+    intervals.freeze(1.0);
+    MelodyRequest request;
+    request.minPitch = 48;
+    request.maxPitch = 84;
+    const size_t notes = 1000000;
+    std::vector<NoteEvent> out(notes);
+    std::cout << "  generation          model      ns/note   distinct pitches\n";
+    for (bool constrained : { false, true }) {
+        request.constrained = constrained;
+        for (bool useIntervals : { false, true }) {
+            MelodyGenerator gen(melody, rhythm, order, 8);
+            if (useIntervals) gen.setMelodyIntervals(&intervals);
+            std::vector<double> seconds;
+            for (int r = 0; r < opt.repeats; ++r) {
+                MelodyStream stream = gen.stream(request, MelodyGenerator::streamFor(11, 0));
+                auto t0 = Bench::clock::now();
+                stream.next(out.data(), out.size());
+                seconds.push_back(Bench::secondsSince(t0));
+            }
+            bool used[128] = {};
+            for (const auto &n : out) used[n.pitch] = true;
+            const std::string key = std::string("generate/") + (constrained ? "masked" : "repaired") + "/" +
+                                    (useIntervals ? "interval" : "absolute");
+            Bench::record(Bench::Result{ "interval-model", key, notes, "note", seconds });
+            Bench::metric("interval-model", key + "/distinct-pitches", static_cast<double>(std::count(used, used + 128, true)), "pitch");
+            const double best = Bench::best(seconds);
+            std::cout << "  " << std::left << std::setw(18) << (constrained ? "masked" : "repaired") << std::setw(9)
+                      << (useIntervals ? "interval" : "absolute") << std::right << std::setw(10)
+                      << best * 1e9 / static_cast<double>(notes) << std::setw(19) << std::count(used, used + 128, true) << "\n";
+        }
+    }
+}
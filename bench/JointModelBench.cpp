@@ -0,0 +1,114 @@
+#include "Bench.h"
+#include "JointModel.h"
+#include "MarkovModel.h"
+#include "MelodyGenerator.h"
+#include "MelodyStream.h"
+#include "RhythmModel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Mutual information in bits between a note's pitch and its duration token:
+// how much the rhythm says about the melody.
+struct PairCounts {
+    std::vector<double> joint = std::vector<double>(128 * RhythmQuantizer::kTokenCount, 0.0);
+    double total = 0.0;
+
+    void add(int pitch, int durationToken) {
+        if (pitch < 0 || pitch > 127) return;
+        joint[JointModel::pack(pitch, durationToken)] += 1.0;
+        total += 1.0;
+    }
+    double mutualInformation() const {
+        std::vector<double> p(128, 0.0), d(RhythmQuantizer::kTokenCount, 0.0);
+        for (size_t i = 0; i < joint.size(); ++i) {
+            p[JointModel::pitchOf(static_cast<int>(i))] += joint[i];
+            d[JointModel::durationTokenOf(static_cast<int>(i))] += joint[i];
+        }
+        double mi = 0.0;
+        for (size_t i = 0; i < joint.size(); ++i) {
+            if (joint[i] == 0.0) continue;
+            const double pj = joint[i] / total;
+            const double pp = p[JointModel::pitchOf(static_cast<int>(i))] / total;
+            const double pd = d[JointModel::durationTokenOf(static_cast<int>(i))] / total;
+            mi += pj * std::log2(pj / (pp * pd));
+        }
+        return mi;
+    }
+};
+
+}
+
+void runJointModelBench(const BenchOptions& opt) {
+    auto melodies = Bench::loadMelodies(opt.dataRoot);
+    auto durations = Bench::loadDurations(opt.dataRoot);
+    if (melodies.empty() || melodies.size() != durations.size()) {
+        std::cout << "  need paired melody and duration sequences under " << opt.dataRoot << "\n";
+        return;
+    }
+    const size_t notes = 1000000;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "  order   path        table KiB   entries   Mnotes/s   joint draws   pitch/duration MI (bits)\n";
+    for (int order : { 1, 2, 3 }) {
+        MarkovModel melody(order);
+        RhythmModel rhythm(order);
+        melody.trainMany(melodies);
+        rhythm.trainMany(durations);
+        JointModel joint(order);
+        joint.trainMany(melodies, durations, rhythm.quantizer());
+        melody.freeze(1.0);
+        rhythm.freeze(1.0);
+        joint.freeze(1.0);
+
+        PairCounts corpus;
+        for (size_t s = 0; s < melodies.size(); ++s) {
+            for (size_t i = 0; i < std::min(melodies[s].size(), durations[s].size()); ++i) {
+                if (durations[s][i] > 0.0) corpus.add(melodies[s][i], rhythm.durationToToken(durations[s][i]));
+            }
+        }
+
+        Bench::metric("joint-model", "corpus/order" + std::to_string(order) + "/pitch-duration-mi", corpus.mutualInformation(), "bit");
+        MelodyRequest request;
+        request.minPitch = 0;
+        request.maxPitch = 127;
+        for (bool useJoint : { false, true }) {
+            MelodyGenerator gen(melody, rhythm, order, order);
+            if (useJoint) gen.setJointModel(&joint);
+            std::vector<NoteEvent> out(notes);
+            std::vector<double> seconds;
+            uint64_t jointDraws = 0;
+            for (int r = 0; r < opt.repeats; ++r) {
+                MelodyStream stream = gen.stream(request, MelodyGenerator::streamFor(5, 0));
+                auto t0 = Bench::clock::now();
+                stream.next(out.data(), out.size());
+                seconds.push_back(Bench::secondsSince(t0));
+                jointDraws = stream.jointDraws();
+            }
+            const std::string key = std::string(useJoint ? "joint" : "factored") + "/order" + std::to_string(order);
+            Bench::record(Bench::Result{ "joint-model", key, notes, "note", seconds });
+            const double best = Bench::best(seconds);
+            PairCounts generated;
+            for (const auto &n : out) generated.add(n.pitch, rhythm.durationToToken(n.duration));
+
+            // The joint path still needs the separate models for its backoff.
+            const size_t bytes = melody.memoryBytes() + rhythm.memoryBytes() + (useJoint ? joint.memoryBytes() : 0);
+            const size_t entries = melody.transitionCount() + rhythm.transitionCount() + (useJoint ? joint.transitionCount() : 0);
+            Bench::metric("joint-model", key + "/table-bytes", static_cast<double>(bytes), "byte");
+            Bench::metric("joint-model", key + "/entries", static_cast<double>(entries), "entry");
+            Bench::metric("joint-model", key + "/joint-draw-share", static_cast<double>(jointDraws) / static_cast<double>(notes), "ratio");
+            Bench::metric("joint-model", key + "/pitch-duration-mi", generated.mutualInformation(), "bit");
+            std::cout << "  " << std::setw(5) << order << "   " << std::left << std::setw(10) << (useJoint ? "joint" : "factored")
+                      << std::right << std::setw(11) << static_cast<double>(bytes) / 1024.0 << std::setw(10) << entries
+                      << std::setw(11) << static_cast<double>(notes) / best / 1e6
+                      << std::setw(13) << 100.0 * static_cast<double>(jointDraws) / static_cast<double>(notes) << "%"
+                      << std::setprecision(3) << std::setw(14) << generated.mutualInformation()
+                      << " (corpus " << corpus.mutualInformation() << ")\n" << std::setprecision(1);
+        }
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+// The original vector-keyed MarkovModel, reduced to training, lookup and
+// sampling, kept as the baseline for the table and sampling benchmarks.
+class LegacyMarkov {
+public:
+    explicit LegacyMarkov(int order) : order_(order) {}
+
+    void train(const std::vector<int>& sequence) {
+        for (int t : sequence) unigramCounts_[t] += 1;
+        const size_t n = sequence.size();
+        for (size_t i = 0; i < n; ++i) {
+            int next = sequence[i];
+            for (int k = 1; k <= order_; ++k) {
+                if (i < static_cast<size_t>(k)) break;
+                std::vector<int> hist;
+                hist.reserve(k);
+                for (size_t j = i - k; j < i; ++j) hist.push_back(sequence[j]);
+                transitions_[hist][next] += 1;
+            }
+        }
+    }
+
+    size_t lookupSize(const std::vector<int>& history) const {
+        for (int k = std::min<int>(order_, static_cast<int>(history.size())); k >= 1; --k) {
+            std::vector<int> tail(history.end() - k, history.end());
+            auto it = transitions_.find(tail);
+            if (it != transitions_.end()) return it->second.size();
+        }
+        return unigramCounts_.size();
+    }
+
+    // Copies the row out by value and tempers with pow(), as the original did.
+    int sampleNext(const std::vector<int>& history, double temperature) {
+        std::unordered_map<int, uint32_t> counts = findWithBackoff(history);
+        if (counts.empty()) return 0;
+        std::vector<std::pair<int, double>> items;
+        items.reserve(counts.size());
+        double total = 0.0;
+        for (auto &kv : counts) {
+            double w = std::pow(static_cast<double>(kv.second), 1.0 / temperature);
+            items.emplace_back(kv.first, w);
+            total += w;
+        }
+        std::uniform_real_distribution<double> dist(0.0, total);
+        double r = dist(rng_);
+        double acc = 0.0;
+        for (auto &it : items) {
+            acc += it.second;
+            if (r <= acc) return it.first;
+        }
+        return items.back().first;
+    }
+
+    size_t transitionCount() const {
+        size_t n = 0;
+        for (const auto &kv : transitions_) n += kv.second.size();
+        return n;
+    }
+
+private:
+    std::unordered_map<int, uint32_t> findWithBackoff(const std::vector<int>& history) const {
+        for (int k = std::min<int>(order_, static_cast<int>(history.size())); k >= 1; --k) {
+            std::vector<int> tail(history.end() - k, history.end());
+            auto it = transitions_.find(tail);
+            if (it != transitions_.end()) return it->second;
+        }
+        return unigramCounts_;
+    }
+
+    struct VecHash {
+        size_t operator()(const std::vector<int>& v) const noexcept {
+            size_t h = 1469598103934665603ULL;
+            for (int x : v) {
+                h ^= static_cast<size_t>(x) + 0x9e3779b97f4a7c15ULL + (h<<6) + (h>>2);
+            }
+            return h;
+        }
+    };
+    int order_;
+    std::mt19937 rng_{42};
+    std::unordered_map<std::vector<int>, std::unordered_map<int, uint32_t>, VecHash> transitions_;
+    std::unordered_map<int, uint32_t> unigramCounts_;
+};
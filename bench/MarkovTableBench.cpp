@@ -0,0 +1,86 @@
+#include "Bench.h"
+#include "LegacyMarkov.h"
+#include "MarkovModel.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Full-order histories drawn from corpus positions, in shuffled order so the
+// lookups do not simply walk the table in insertion order.
+std::vector<std::vector<int>> sampleHistories(const std::vector<std::vector<int>>& corpus, int order, size_t count) {
+    std::vector<std::vector<int>> out;
+    std::mt19937 rng(1234);
+    for (const auto &seq : corpus) {
+        for (size_t i = static_cast<size_t>(order); i <= seq.size(); ++i) {
+            out.emplace_back(seq.begin() + (i - order), seq.begin() + i);
+        }
+    }
+    std::shuffle(out.begin(), out.end(), rng);
+    if (out.size() > count) out.resize(count);
+    return out;
+}
+
+}
+
+void runMarkovTableBench(const BenchOptions& opt) {
+    auto corpus = Bench::loadMelodies(opt.dataRoot);
+    if (corpus.empty()) {
+        std::cout << "  no melody sequences under " << opt.dataRoot << "/melodies\n";
+        return;
+    }
+    size_t notes = 0;
+    for (const auto &s : corpus) notes += s.size();
+    std::cout << "  corpus: " << corpus.size() << " sequences, " << notes << " tokens\n";
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "  order  transitions   legacy B/trans   flat B/trans   legacy ns/lookup   flat ns/lookup\n";
+
+    for (int order : { 1, 2, 4, 8 }) {
+        size_t before = Bench::liveBytes();
+        auto legacy = std::make_unique<LegacyMarkov>(order);
+        for (const auto &s : corpus) legacy->train(s);
+        size_t legacyBytes = Bench::liveBytes() - before;
+
+        before = Bench::liveBytes();
+        auto flat = std::make_unique<MarkovModel>(order);
+        flat->trainMany(corpus);
+        size_t flatBytes = Bench::liveBytes() - before;
+
+        const size_t transitions = flat->transitionCount();
+        if (transitions != legacy->transitionCount()) {
+            std::cout << "  MISMATCH: transition counts differ at order " << order << "\n";
+        }
+
+        auto histories = sampleHistories(corpus, order, 200000);
+        const std::string suffix = "/order" + std::to_string(order);
+        const Bench::Result legacyLookups{ "markov-table", "lookup/legacy" + suffix, histories.size(), "lookup", Bench::repeat(opt.repeats, [&] {
+            size_t acc = 0;
+            for (const auto &h : histories) acc += legacy->lookupSize(h);
+            Bench::consume(acc);
+        }) };
+        const Bench::Result flatLookups{ "markov-table", "lookup/flat" + suffix, histories.size(), "lookup", Bench::repeat(opt.repeats, [&] {
+            size_t acc = 0;
+            for (const auto &h : histories) acc += flat->lookup(h.data(), h.size()).size;
+            Bench::consume(acc);
+        }) };
+        Bench::record(legacyLookups);
+        Bench::record(flatLookups);
+        Bench::metric("markov-table", "bytes-per-transition/legacy" + suffix, static_cast<double>(legacyBytes) / transitions, "byte");
+        Bench::metric("markov-table", "bytes-per-transition/flat" + suffix, static_cast<double>(flatBytes) / transitions, "byte");
+        const double bestLegacy = Bench::best(legacyLookups.seconds);
+        const double bestFlat = Bench::best(flatLookups.seconds);
+
+        const double n = static_cast<double>(std::max<size_t>(1, histories.size()));
+        std::cout << "  " << std::setw(5) << order << "  " << std::setw(11) << transitions
+                  << "  " << std::setw(15) << static_cast<double>(legacyBytes) / transitions
+                  << "  " << std::setw(13) << static_cast<double>(flatBytes) / transitions
+                  << "  " << std::setw(17) << bestLegacy * 1e9 / n
+                  << "  " << std::setw(15) << bestFlat * 1e9 / n << "\n";
+    }
+}
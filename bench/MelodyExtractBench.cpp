@@ -0,0 +1,55 @@
+#include "Bench.h"
+#include "MarkovModel.h"
+#include "MelodyExtractor.h"
+#include "MidiParser.h"
+#include "NoteStore.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+void runMelodyExtractBench(const BenchOptions& opt) {
+    auto files = Bench::listFiles(opt.dataRoot + "/raw_midis", { ".mid", ".midi" });
+    if (files.empty()) {
+        std::cout << "  no MIDI files under " << opt.dataRoot << "/raw_midis\n";
+        return;
+    }
+    Parser parser;
+    std::vector<NoteStore> parsed(files.size());
+    size_t parsedNotes = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+        parser.parseMidiFile(files[i], parsed[i], NoteFilter::melodic());
+        parsedNotes += parsed[i].size();
+    }
+    std::cout << "  files: " << files.size() << ", notes after the melodic filter: " << parsedNotes << "\n";
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "  mode       notes kept   ns/input note   order-2 entries   table KiB\n";
+
+    for (MelodyMode mode : { MelodyMode::All, MelodyMode::Skyline, MelodyMode::Track, MelodyMode::Voice }) {
+        MelodyExtractor extractor(mode);
+        std::vector<NoteStore> lines(files.size());
+        const std::string name = MelodyExtractor::modeName(mode);
+        const Bench::Result extract{ "melody-extract", name, parsedNotes, "note", Bench::repeat(opt.repeats, [&] {
+            for (size_t i = 0; i < files.size(); ++i) extractor.extract(parsed[i], lines[i]);
+        }) };
+        Bench::record(extract);
+        const double best = Bench::best(extract.seconds);
+
+        size_t kept = 0;
+        std::vector<Span<const uint8_t>> sequences;
+        for (const auto &l : lines) {
+            kept += l.size();
+            sequences.push_back(l.pitches());
+        }
+        MarkovModel model(2);
+        model.trainMany(sequences);
+        Bench::metric("melody-extract", name + "/notes-kept", static_cast<double>(kept), "note");
+        Bench::metric("melody-extract", name + "/order2-entries", static_cast<double>(model.transitionCount()), "entry");
+        Bench::metric("melody-extract", name + "/table-bytes", static_cast<double>(model.memoryBytes()), "byte");
+        std::cout << "  " << std::left << std::setw(9) << MelodyExtractor::modeName(mode) << std::right
+                  << std::setw(12) << kept << std::setw(16) << best * 1e9 / static_cast<double>(std::max<size_t>(1, parsedNotes))
+                  << std::setw(18) << model.transitionCount() << std::setw(12) << static_cast<double>(model.memoryBytes()) / 1024.0 << "\n";
+    }
+}
@@ -0,0 +1,130 @@
+#include "Bench.h"
+#include "MarkovModel.h"
+#include "MelodyGenerator.h"
+#include "MelodyStream.h"
+#include "MidiStreamWriter.h"
+#include "MidiWriter.h"
+#include "RhythmModel.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<unsigned char> readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<unsigned char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+}
+
+void runMidiStreamBench(const BenchOptions& opt) {
+    auto melodies = Bench::loadMelodies(opt.dataRoot);
+    auto durations = Bench::loadDurations(opt.dataRoot);
+    if (melodies.empty() || durations.empty()) {
+        std::cout << "  no training sequences under " << opt.dataRoot << "\n";
+        return;
+    }
+    const int order = 2;
+    MarkovModel melody(order);
+    RhythmModel rhythm(order);
+    melody.trainMany(melodies);
+    rhythm.trainMany(durations);
+    MelodyGenerator gen(melody, rhythm, order, 8);
+    MelodyRequest request;
+    request.minPitch = 48;
+    request.maxPitch = 84;
+
+    const auto tmp = std::filesystem::temp_directory_path();
+    const std::string batchPath = (tmp / "musicgen_bench_batch.mid").string();
+    const std::string streamPath = (tmp / "musicgen_bench_stream.mid").string();
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "  notes      writer        ms   peak heap KiB   allocs   identical\n";
+    for (size_t notes : { size_t(1000), size_t(100000), size_t(1000000) }) {
+        // The batch writer needs the whole piece in memory first; that vector
+        // is the caller's and is not charged to the writer.
+        MelodyStream source = gen.stream(request, MelodyGenerator::streamFor(11, 0));
+        std::vector<NoteEvent> piece(notes);
+        source.next(piece.data(), piece.size());
+
+        std::vector<double> batchSeconds, fileSeconds, sinkSeconds;
+        size_t batchPeak = 0, filePeak = 0, sinkPeak = 0;
+        size_t batchAllocs = 0, fileAllocs = 0, sinkAllocs = 0;
+        uint64_t sinkBytes = 0;
+        for (int r = 0; r < opt.repeats; ++r) {
+            MidiWriter writer;
+            size_t live0 = Bench::liveBytes();
+            size_t allocs0 = Bench::allocationCount();
+            Bench::resetPeak();
+            auto t0 = Bench::clock::now();
+            writer.write(batchPath, piece);
+            batchSeconds.push_back(Bench::secondsSince(t0));
+            batchPeak = Bench::peakBytes() - live0;
+            batchAllocs = Bench::allocationCount() - allocs0;
+
+            live0 = Bench::liveBytes();
+            allocs0 = Bench::allocationCount();
+            Bench::resetPeak();
+            t0 = Bench::clock::now();
+            {
+                MidiStreamWriter out;
+                out.open(streamPath);
+                for (const auto &n : piece) out.add(n);
+                out.finish();
+            }
+            fileSeconds.push_back(Bench::secondsSince(t0));
+            filePeak = Bench::peakBytes() - live0;
+            fileAllocs = Bench::allocationCount() - allocs0;
+
+            // Non-seekable sink: both passes regenerate the notes from the same
+            // seed, so nothing of size O(notes) exists anywhere.
+            live0 = Bench::liveBytes();
+            allocs0 = Bench::allocationCount();
+            Bench::resetPeak();
+            t0 = Bench::clock::now();
+            sinkBytes = 0;
+            MidiStreamWriter::writeTwoPass(
+                [&](const unsigned char*, size_t n) { sinkBytes += n; return true; },
+                [&](MidiStreamWriter& w) {
+                    MelodyStream replay = gen.stream(request, MelodyGenerator::streamFor(11, 0));
+                    for (size_t i = 0; i < notes; ++i) {
+                        if (!w.add(replay.next())) return false;
+                    }
+                    return true;
+                });
+            sinkSeconds.push_back(Bench::secondsSince(t0));
+            sinkPeak = Bench::peakBytes() - live0;
+            sinkAllocs = Bench::allocationCount() - allocs0;
+        }
+
+        const auto batchBytes = readFile(batchPath);
+        const auto streamBytes = readFile(streamPath);
+        const bool same = batchBytes == streamBytes;
+        const bool sinkSame = sinkBytes == streamBytes.size();
+        auto row = [&](const char* label, const std::vector<double>& seconds, size_t peak, size_t allocs, const char* identical) {
+            const std::string name = std::string(label) + "/" + std::to_string(notes);
+            Bench::record(Bench::Result{ "midi-stream", name, notes, "note", seconds });
+            Bench::metric("midi-stream", name + "/peak-heap", static_cast<double>(peak), "byte");
+            Bench::metric("midi-stream", name + "/allocations", static_cast<double>(allocs), "alloc");
+            const double s = Bench::best(seconds);
+            std::cout << "  " << std::left << std::setw(9) << notes << "  " << std::setw(12) << label << std::right
+                      << std::setw(8) << s * 1e3 << std::setw(16) << static_cast<double>(peak) / 1024.0
+                      << std::setw(9) << allocs << "   " << identical << "\n";
+        };
+        row("batch", batchSeconds, batchPeak, batchAllocs, "-");
+        row("stream/file", fileSeconds, filePeak, fileAllocs, same ? "yes" : "NO");
+        row("stream/pipe", sinkSeconds, sinkPeak, sinkAllocs, sinkSame ? "same size" : "SIZE DIFFERS");
+        Bench::metric("midi-stream", "stream/file/" + std::to_string(notes) + "/differs", same ? 0.0 : 1.0, "file");
+        Bench::metric("midi-stream", "stream/pipe/" + std::to_string(notes) + "/size-differs", sinkSame ? 0.0 : 1.0, "file");
+    }
+    std::remove(batchPath.c_str());
+    std::remove(streamPath.c_str());
+}
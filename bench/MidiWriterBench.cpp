@@ -0,0 +1,113 @@
+#include "Bench.h"
+#include "LegacyMidiWriter.h"
+#include "MarkovModel.h"
+#include "MelodyGenerator.h"
+#include "MelodyStream.h"
+#include "MidiWriter.h"
+#include "RhythmModel.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<unsigned char> readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<unsigned char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Generated melodies plus a chord layer, so the writer sees overlapping notes
+// and events out of insertion order.
+std::vector<NoteEvent> makePiece(const MelodyGenerator& gen, size_t notes, uint64_t seed) {
+    MelodyRequest request;
+    request.minPitch = 48;
+    request.maxPitch = 84;
+    MelodyStream stream = gen.stream(request, MelodyGenerator::streamFor(seed, 0));
+    std::vector<NoteEvent> piece(notes);
+    stream.next(piece.data(), piece.size());
+    for (size_t i = 0; i + 4 <= notes; i += 4) {
+        NoteEvent chord = piece[i];
+        chord.pitch -= 12;
+        chord.duration = piece[i + 3].startTime + piece[i + 3].duration - chord.startTime;
+        piece.push_back(chord);
+    }
+    std::stable_sort(piece.begin(), piece.end(), [](const NoteEvent& a, const NoteEvent& b) { return a.startTime < b.startTime; });
+    return piece;
+}
+
+}
+
+void runMidiWriterBench(const BenchOptions& opt) {
+    auto melodies = Bench::loadMelodies(opt.dataRoot);
+    auto durations = Bench::loadDurations(opt.dataRoot);
+    if (melodies.empty() || durations.empty()) {
+        std::cout << "  no training sequences under " << opt.dataRoot << "\n";
+        return;
+    }
+    const int order = 2;
+    MarkovModel melody(order);
+    RhythmModel rhythm(order);
+    melody.trainMany(melodies);
+    rhythm.trainMany(durations);
+    MelodyGenerator gen(melody, rhythm, order, 8);
+
+    const std::string path = (std::filesystem::temp_directory_path() / "musicgen_bench_writer.mid").string();
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "  notes/file   writer              files/s   allocs/file   identical\n";
+    for (size_t notes : { size_t(128), size_t(1024), size_t(16384) }) {
+        const size_t files = std::max<size_t>(20, 400000 / notes);
+        auto piece = makePiece(gen, notes, notes);
+
+        MidiWriter writer;
+        LegacyMidiWriter::write(path, piece, 480, 500000, 0, 90);
+        const auto legacyBytes = readFile(path);
+        writer.write(path, piece);
+        const bool same = readFile(path) == legacyBytes;
+
+        std::vector<double> legacySeconds, fileSeconds, encodeSeconds;
+        size_t legacyAllocs = 0, fileAllocs = 0, encodeAllocs = 0;
+        for (int r = 0; r < opt.repeats; ++r) {
+            size_t allocs0 = Bench::allocationCount();
+            auto t0 = Bench::clock::now();
+            for (size_t f = 0; f < files; ++f) LegacyMidiWriter::write(path, piece, 480, 500000, 0, 90);
+            legacySeconds.push_back(Bench::secondsSince(t0));
+            legacyAllocs = Bench::allocationCount() - allocs0;
+
+            allocs0 = Bench::allocationCount();
+            t0 = Bench::clock::now();
+            for (size_t f = 0; f < files; ++f) writer.write(path, piece);
+            fileSeconds.push_back(Bench::secondsSince(t0));
+            fileAllocs = Bench::allocationCount() - allocs0;
+
+            allocs0 = Bench::allocationCount();
+            t0 = Bench::clock::now();
+            size_t acc = 0;
+            for (size_t f = 0; f < files; ++f) acc += writer.encode(piece).size();
+            encodeSeconds.push_back(Bench::secondsSince(t0));
+            encodeAllocs = Bench::allocationCount() - allocs0;
+            Bench::consume(acc);
+        }
+
+        auto row = [&](const char* label, const char* name, const std::vector<double>& seconds, size_t allocs, const char* identical) {
+            const std::string key = std::string(name) + "/" + std::to_string(notes);
+            Bench::record(Bench::Result{ "midi-writer", key, files, "file", seconds });
+            Bench::metric("midi-writer", key + "/allocs-per-file", static_cast<double>(allocs) / static_cast<double>(files), "alloc");
+            const double s = Bench::best(seconds);
+            std::cout << "  " << std::left << std::setw(11) << piece.size() << "  " << std::setw(16) << label << std::right
+                      << std::setw(11) << static_cast<double>(files) / s
+                      << std::setw(14) << static_cast<double>(allocs) / static_cast<double>(files) << "   " << identical << "\n";
+        };
+        row("legacy", "legacy", legacySeconds, legacyAllocs, "-");
+        row("pod+radix", "write", fileSeconds, fileAllocs, same ? "yes" : "NO");
+        row("pod+radix, memory", "encode", encodeSeconds, encodeAllocs, "-");
+        Bench::metric("midi-writer", "write/" + std::to_string(notes) + "/differs-from-legacy", same ? 0.0 : 1.0, "file");
+    }
+    std::remove(path.c_str());
+}
@@ -0,0 +1,86 @@
+#include "Bench.h"
+#include "MarkovModel.h"
+#include "ModelFile.h"
+#include "RhythmModel.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+void runModelFileBench(const BenchOptions& opt) {
+    auto melodies = Bench::loadMelodies(opt.dataRoot);
+    auto durations = Bench::loadDurations(opt.dataRoot);
+    if (melodies.empty()) {
+        std::cout << "  no melody sequences under " << opt.dataRoot << "/melodies\n";
+        return;
+    }
+    const std::string path = (std::filesystem::temp_directory_path() / "musicgen_bench_model.bin").string();
+    const int order = 2;
+
+    size_t notes = 0;
+    for (const auto &seq : melodies) notes += seq.size();
+    std::vector<double> train, save, load, loadNoVerify;
+    size_t mismatches = 0, fileBytes = 0, loadAllocs = 0;
+    for (int r = 0; r < opt.repeats; ++r) {
+        auto t0 = Bench::clock::now();
+        MarkovModel melody(order);
+        RhythmModel rhythm(order);
+        melody.trainMany(melodies);
+        rhythm.trainMany(durations);
+        train.push_back(Bench::secondsSince(t0));
+
+        t0 = Bench::clock::now();
+        ModelFile::save(path, melody, rhythm);
+        save.push_back(Bench::secondsSince(t0));
+
+        MarkovModel loadedMelody;
+        RhythmModel loadedRhythm;
+        size_t allocs0 = Bench::allocationCount();
+        t0 = Bench::clock::now();
+        bool ok = ModelFile::load(path, loadedMelody, loadedRhythm, true);
+        load.push_back(Bench::secondsSince(t0));
+        loadAllocs = Bench::allocationCount() - allocs0;
+
+        MarkovModel fastMelody;
+        RhythmModel fastRhythm;
+        t0 = Bench::clock::now();
+        ok = ModelFile::load(path, fastMelody, fastRhythm, false) && ok;
+        loadNoVerify.push_back(Bench::secondsSince(t0));
+
+        if (r == 0) {
+            // Every trained row must come back identical from the mapping.
+            for (const auto &seq : melodies) {
+                for (size_t i = order; i <= seq.size(); ++i) {
+                    auto a = melody.lookup(seq.data() + i - order, order);
+                    auto b = loadedMelody.lookup(seq.data() + i - order, order);
+                    if (a.size != b.size || !std::equal(a.begin(), a.end(), b.begin(), [](const NGramTable::Entry &x, const NGramTable::Entry &y) {
+                            return x.token == y.token && x.count == y.count;
+                        })) {
+                        ++mismatches;
+                    }
+                }
+            }
+            if (!ok || loadedRhythm.unit() != rhythm.unit() || loadedRhythm.vocabularySize() != rhythm.vocabularySize()) ++mismatches;
+            fileBytes = std::filesystem::file_size(path);
+            std::cout << "  file: " << fileBytes << " bytes, heap allocations during load: " << loadAllocs << "\n";
+        }
+    }
+    std::remove(path.c_str());
+    Bench::record(Bench::Result{ "model-file", "train", notes, "note", train });
+    Bench::record(Bench::Result{ "model-file", "save", fileBytes, "byte", save });
+    Bench::record(Bench::Result{ "model-file", "load-verified", fileBytes, "byte", load });
+    Bench::record(Bench::Result{ "model-file", "load-unverified", fileBytes, "byte", loadNoVerify });
+    Bench::metric("model-file", "file-bytes", static_cast<double>(fileBytes), "byte");
+    Bench::metric("model-file", "load-allocations", static_cast<double>(loadAllocs), "alloc");
+    Bench::metric("model-file", "row-mismatches", static_cast<double>(mismatches), "row");
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "  row mismatches after reload: " << mismatches << "\n";
+    std::cout << "  train (melody + rhythm):   " << std::setw(9) << Bench::best(train) * 1e3 << " ms\n";
+    std::cout << "  save:                      " << std::setw(9) << Bench::best(save) * 1e3 << " ms\n";
+    std::cout << "  load (mmap + checksum):    " << std::setw(9) << Bench::best(load) * 1e3 << " ms\n";
+    std::cout << "  load (mmap, no checksum):  " << std::setw(9) << Bench::best(loadNoVerify) * 1e3 << " ms\n";
+}
@@ -0,0 +1,323 @@
+#include "Bench.h"
+#include "MappedFile.h"
+#include "MidiParser.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+// The original std::ifstream-based parser, kept as the baseline the
+// in-memory decoder is measured against. The only change since is that notes
+// are paired per (channel, pitch) and carry channel, velocity and track.
+struct RawEvent {
+    int pitch;
+    uint64_t tick;
+    bool on;
+    int track;
+    uint64_t seq;
+    int channel;
+    int velocity;
+};
+
+struct TempoEvent {
+    uint64_t tick;
+    uint32_t microsecondsPerQuarter;
+};
+
+int readByte(std::ifstream &f) {
+    int c = f.get();
+    if (c == EOF) return -1;
+    return c & 0xFF;
+}
+
+std::vector<NoteEvent> referenceParseMidiFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return {};
+    }
+
+    char hdr[4] = {0};
+    file.read(hdr, 4);
+    if (!file.good()) {
+        return {};
+    }
+    if (std::string(hdr, 4) != "MThd") {
+        return {};
+    }
+
+    uint32_t headerSize = Utils::readBE32(file);
+    (void)Utils::readBE16(file);  // format: every track is read alike
+    uint16_t nTracks = Utils::readBE16(file);
+    uint16_t division = Utils::readBE16(file);
+
+    if (!file.good()) {
+        return {};
+    }
+
+    if (headerSize > 6) file.seekg(headerSize - 6, std::ios::cur);
+
+    bool isSMPTE = (division & 0x8000) != 0;
+    int PPQ = 480;
+    if (!isSMPTE) {
+        PPQ = division;
+        if (PPQ == 0) {
+            PPQ = 480;
+        }
+    } else {
+        PPQ = 480;
+    }
+
+    std::vector<RawEvent> rawEvents;
+    std::vector<TempoEvent> tempoEvents;
+    uint64_t globalSeq = 0;
+
+    for (int trackIndex = 0; trackIndex < nTracks; ++trackIndex) {
+        uint64_t absoluteTick = 0;
+
+        char chunkId[4] = {0};
+        file.read(chunkId, 4);
+        if (!file.good()) {
+            break;
+        }
+
+        uint32_t trackSize = Utils::readBE32(file);
+        std::streampos trackEnd = file.tellg() + std::streamoff(trackSize);
+
+        if (std::string(chunkId,4) != "MTrk") {
+        }
+
+        unsigned char runningStatus = 0;
+
+        while (file.good() && file.tellg() < trackEnd) {
+            uint32_t delta = Utils::readVarLen(file);
+            absoluteTick += delta;
+
+            int first = readByte(file);
+            if (first < 0) {
+                break;
+            }
+
+            unsigned char status;
+            int dataByte1 = -1;
+
+            if (first & 0x80) {
+                // status byte
+                status = static_cast<unsigned char>(first);
+                runningStatus = status;
+            } else {
+                if (runningStatus == 0) {
+                    break;
+                }
+                status = runningStatus;
+                dataByte1 = first;
+            }
+
+            if (status == 0xFF) {
+                // Meta event
+                int metaType = readByte(file);
+                if (metaType < 0) break;
+                uint32_t len = Utils::readVarLen(file);
+                if (metaType == 0x51 && len == 3) {
+                    int b1 = readByte(file);
+                    int b2 = readByte(file);
+                    int b3 = readByte(file);
+                    if (b1 < 0 || b2 < 0 || b3 < 0) break;
+                    uint32_t micro = (static_cast<uint32_t>(b1) << 16) | (static_cast<uint32_t>(b2) << 8) | static_cast<uint32_t>(b3);
+                    tempoEvents.push_back({ absoluteTick, micro });
+                } else {
+                    file.seekg((std::streamoff)len, std::ios::cur);
+                }
+                continue;
+            }
+
+            if (status == 0xF0 || status == 0xF7) {
+                uint32_t len = Utils::readVarLen(file);
+                file.seekg((std::streamoff)len, std::ios::cur);
+                continue;
+            }
+
+            unsigned char eventType = status & 0xF0;
+
+            auto readData = [&](int already)->int {
+                if (already >= 0) return already;
+                return readByte(file);
+            };
+
+            if (eventType == 0x90 || eventType == 0x80) {
+                int pitch = readData(dataByte1);
+                int velocity = readData(-1);
+                if (pitch < 0 || velocity < 0) break;
+
+                bool isNoteOn = (eventType == 0x90 && velocity > 0);
+                rawEvents.push_back({ pitch, absoluteTick, isNoteOn, trackIndex, globalSeq++, status & 0x0F, velocity });
+            } else if (eventType == 0xC0 || eventType == 0xD0) {
+                (void)readData(dataByte1);
+            } else {
+                (void)readData(dataByte1);
+                (void)readData(-1);
+            }
+        }
+
+        if (file.tellg() < trackEnd) {
+            file.seekg(trackEnd);
+        }
+    }
+
+    std::sort(rawEvents.begin(), rawEvents.end(), [](const RawEvent &a, const RawEvent &b) {
+        if (a.tick != b.tick) return a.tick < b.tick;
+        if (a.track != b.track) return a.track < b.track;
+        return a.seq < b.seq;
+    });
+
+    std::map<int, std::deque<const RawEvent*>> active;
+    struct TempNote { int pitch; uint64_t startTick; uint64_t durTicks; const RawEvent* on; };
+    std::vector<TempNote> tempNotes;
+    tempNotes.reserve(rawEvents.size() / 2);
+
+    for (const auto &e : rawEvents) {
+        const int key = e.channel * 256 + e.pitch;
+        if (e.on) {
+            active[key].push_back(&e);
+        } else {
+            auto &dq = active[key];
+            if (!dq.empty()) {
+                const RawEvent *on = dq.front(); dq.pop_front();
+                uint64_t s = on->tick;
+                uint64_t dur = (e.tick > s) ? (e.tick - s) : 0;
+                tempNotes.push_back({ e.pitch, s, dur, on });
+            } else {
+                
+            }
+        }
+    }
+    std::sort(tempoEvents.begin(), tempoEvents.end(), [](const TempoEvent &a, const TempoEvent &b){ return a.tick < b.tick; });
+
+    struct Segment { uint64_t tickStart; uint32_t microPerQuarter; };
+    std::vector<Segment> segments;
+    segments.reserve(tempoEvents.size() + 1);
+
+    uint32_t defaultMicro = 500000;
+    uint64_t prevTick = 0;
+    uint32_t currMicro = defaultMicro;
+
+    for (const auto &te : tempoEvents) {
+        if (te.tick > prevTick) {
+            segments.push_back({ prevTick, currMicro });
+            prevTick = te.tick;
+        }
+        currMicro = te.microsecondsPerQuarter;
+    }
+    segments.push_back({ prevTick, currMicro });
+
+    std::vector<double> prefixSeconds; prefixSeconds.reserve(segments.size()+1);
+    prefixSeconds.push_back(0.0);
+    for (size_t i = 0; i < segments.size(); ++i) {
+        uint64_t t0 = segments[i].tickStart;
+        uint64_t t1 = (i + 1 < segments.size()) ? segments[i+1].tickStart : std::numeric_limits<uint64_t>::max();
+        double micro = static_cast<double>(segments[i].microPerQuarter);
+        double secondsInSegment = 0.0;
+        if (t1 != std::numeric_limits<uint64_t>::max()) {
+            uint64_t dt = t1 - t0;
+            secondsInSegment = (static_cast<double>(dt) * micro) / (1e6 * static_cast<double>(PPQ));
+        }
+        prefixSeconds.push_back(prefixSeconds.back() + secondsInSegment);
+    }
+
+    auto ticksToSecondsAt = [&](uint64_t tick) -> double {
+        size_t lo = 0, hi = segments.size();
+        while (lo + 1 < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (segments[mid].tickStart <= tick) lo = mid;
+            else hi = mid;
+        }
+        uint64_t segTickStart = segments[lo].tickStart;
+        double micro = static_cast<double>(segments[lo].microPerQuarter);
+        double baseSec = prefixSeconds[lo];
+        uint64_t dt = tick - segTickStart;
+        double extra = (static_cast<double>(dt) * micro) / (1e6 * static_cast<double>(PPQ));
+        return baseSec + extra;
+    };
+
+    std::vector<NoteEvent> out;
+    out.reserve(tempNotes.size());
+    for (const auto &tn : tempNotes) {
+        NoteEvent ne;
+        ne.pitch = tn.pitch;
+        ne.velocity = static_cast<uint8_t>(tn.on->velocity);
+        ne.channel = static_cast<uint8_t>(tn.on->channel);
+        ne.track = static_cast<uint16_t>(tn.on->track);
+        ne.startTime = ticksToSecondsAt(tn.startTick);
+        double endSec = ticksToSecondsAt(tn.startTick + tn.durTicks);
+        ne.duration = endSec - ne.startTime;
+        out.push_back(ne);
+    }
+
+    return out;
+}
+
+bool sameNotes(const std::vector<NoteEvent>& a, const std::vector<NoteEvent>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].pitch != b[i].pitch || a[i].startTime != b[i].startTime || a[i].duration != b[i].duration) return false;
+        if (a[i].velocity != b[i].velocity || a[i].channel != b[i].channel || a[i].track != b[i].track) return false;
+    }
+    return true;
+}
+
+}
+
+void runParserBench(const BenchOptions& opt) {
+    auto files = Bench::listFiles(opt.dataRoot + "/raw_midis", { ".mid", ".midi" });
+    if (files.empty()) {
+        std::cout << "  no MIDI files under " << opt.dataRoot << "/raw_midis\n";
+        return;
+    }
+
+    Parser parser;
+    size_t totalBytes = 0;
+    size_t mismatches = 0;
+    std::vector<MappedFile> mapped;
+    mapped.reserve(files.size());
+    for (const auto& f : files) {
+        mapped.emplace_back(f);
+        totalBytes += mapped.back().size();
+        if (!sameNotes(referenceParseMidiFile(f), parser.parseMidiFile(f))) {
+            std::cout << "  MISMATCH: " << f << "\n";
+            ++mismatches;
+        }
+    }
+
+    // Each pass parses the whole directory; enough passes to get past timer noise.
+    const int passes = std::max(1, opt.repeats) * 20;
+    auto runPasses = [&](const char* name, auto&& parseOne) {
+        Bench::Result result{ "parser", name, totalBytes, "byte", Bench::repeat(passes, [&] {
+            size_t notes = 0;
+            for (size_t i = 0; i < files.size(); ++i) notes += parseOne(i);
+            Bench::consume(notes);
+        }) };
+        Bench::record(result);
+        return Bench::best(result.seconds);
+    };
+
+    double tStream = runPasses("ifstream-baseline", [&](size_t i) { return referenceParseMidiFile(files[i]).size(); });
+    double tMapped = runPasses("parse-file-mmap", [&](size_t i) { return parser.parseMidiFile(files[i]).size(); });
+    double tBuffer = runPasses("parse-buffer", [&](size_t i) { return parser.parseMidiBuffer(mapped[i].data(), mapped[i].size()).size(); });
+    Bench::metric("parser", "output-mismatches", static_cast<double>(mismatches), "file");
+
+    const double mb = static_cast<double>(totalBytes) / (1024.0 * 1024.0);
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "  files: " << files.size() << ", bytes: " << totalBytes << ", output mismatches: " << mismatches << "\n";
+    std::cout << "  ifstream (baseline):   " << std::setw(9) << mb / tStream << " MB/s\n";
+    std::cout << "  parseMidiFile (mmap):  " << std::setw(9) << mb / tMapped << " MB/s  (" << tStream / tMapped << "x)\n";
+    std::cout << "  parseMidiBuffer:       " << std::setw(9) << mb / tBuffer << " MB/s  (" << tStream / tBuffer << "x)\n";
+}
@@ -0,0 +1,149 @@
+#include "Bench.h"
+#include "MarkovModel.h"
+#include "MelodyGenerator.h"
+#include "MidiParser.h"
+#include "MidiWriter.h"
+#include "NoteStore.h"
+#include "RhythmModel.h"
+#include "Rng.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+// Every phase main() runs, on a synthetic corpus of opt.syntheticNotes notes
+// (--notes), each repeated opt.repeats times and reported through
+// Bench::report so --json can track them. Files go to a scratch directory
+// that is removed afterwards.
+void runPipelineBench(const BenchOptions& opt) {
+    namespace fs = std::filesystem;
+    using Bench::Result;
+
+    Bench::SyntheticCorpus corpus;
+    const size_t target = opt.syntheticNotes;
+    Bench::report(Result{ "pipeline", "synthesize", target, "note",
+                          Bench::repeat(opt.repeats, [&] { corpus = Bench::synthesize(target, 1); }) });
+    std::cout << "  corpus: " << corpus.melodies.size() << " sequences, " << corpus.notes << " notes\n";
+
+    std::vector<std::vector<NoteEvent>> events(corpus.melodies.size());
+    for (size_t s = 0; s < events.size(); ++s) {
+        double t = 0.0;
+        for (size_t i = 0; i < corpus.melodies[s].size(); ++i) {
+            NoteEvent n;
+            n.pitch = corpus.melodies[s][i];
+            n.startTime = t;
+            n.duration = corpus.durations[s][i];
+            t += n.duration;
+            events[s].push_back(n);
+        }
+    }
+
+    std::error_code ec;
+    const fs::path dir = fs::temp_directory_path(ec) / ("musicgen-pipeline-bench-" + std::to_string(Rng(target, 0)() & 0xFFFFFF));
+    fs::create_directories(dir, ec);
+    if (ec) {
+        std::cout << "  cannot create " << dir.string() << ": " << ec.message() << "\n";
+        return;
+    }
+    std::vector<std::string> midiPaths, melodyPaths, durationPaths;
+    for (size_t s = 0; s < events.size(); ++s) {
+        const std::string stem = (dir / ("seq" + std::to_string(s))).string();
+        midiPaths.push_back(stem + ".mid");
+        melodyPaths.push_back(stem + ".txt");
+        durationPaths.push_back(stem + "_dur.txt");
+    }
+
+    // Phase F's writer, then Phase A's parser on what it wrote.
+    MidiWriter writer;
+    Bench::report(Result{ "pipeline", "midi-write", corpus.notes, "note", Bench::repeat(opt.repeats, [&] {
+        for (size_t s = 0; s < events.size(); ++s) writer.write(midiPaths[s], events[s]);
+    }) });
+    Parser parser;
+    NoteStore store;
+    size_t parsed = 0;
+    Bench::report(Result{ "pipeline", "midi-parse", corpus.notes, "note", Bench::repeat(opt.repeats, [&] {
+        parsed = 0;
+        for (const auto &path : midiPaths) {
+            store.clear();
+            parser.parseMidiFile(path, store);
+            parsed += store.size();
+        }
+    }) });
+    if (parsed != corpus.notes) std::cout << "  warning: parsed " << parsed << " of " << corpus.notes << " notes\n";
+
+    // The text training files.
+    Bench::report(Result{ "pipeline", "text-export", corpus.notes, "note", Bench::repeat(opt.repeats, [&] {
+        for (size_t s = 0; s < events.size(); ++s) {
+            parser.exportMelodyTxt(events[s], melodyPaths[s]);
+            parser.exportDurationTxt(events[s], durationPaths[s]);
+        }
+    }) });
+    Bench::report(Result{ "pipeline", "text-parse", corpus.notes, "note", Bench::repeat(opt.repeats, [&] {
+        size_t n = 0;
+        for (size_t s = 0; s < events.size(); ++s) {
+            n += parser.parseMelodyTxt(melodyPaths[s]).size();
+            n += parser.parseDurationTxt(durationPaths[s]).size();
+        }
+        Bench::consume(n);
+    }) });
+    fs::remove_all(dir, ec);
+
+    // Phase C, serial.
+    const int order = 2;
+    MarkovModel melody(order);
+    RhythmModel rhythm(order);
+    Bench::report(Result{ "pipeline", "markov-train", corpus.notes, "note", Bench::repeat(opt.repeats, [&] {
+        melody = MarkovModel(order);
+        melody.trainMany(corpus.melodies);
+    }) });
+    Bench::report(Result{ "pipeline", "rhythm-train", corpus.notes, "note", Bench::repeat(opt.repeats, [&] {
+        rhythm = RhythmModel(order);
+        rhythm.trainMany(corpus.durations);
+    }) });
+
+    // Single draws against histories taken from the corpus, scanning the row
+    // (a temperature nothing is frozen at) and from the alias tables.
+    std::vector<int> pitches;
+    std::vector<double> durations;
+    for (size_t s = 0; s < corpus.melodies.size(); ++s) {
+        pitches.insert(pitches.end(), corpus.melodies[s].begin(), corpus.melodies[s].end());
+        durations.insert(durations.end(), corpus.durations[s].begin(), corpus.durations[s].end());
+    }
+    const size_t draws = 1000000;
+    const size_t windows = pitches.size() > static_cast<size_t>(order) ? pitches.size() - order : 0;
+    if (windows == 0) return;
+    for (bool frozen : { false, true }) {
+        if (frozen) {
+            melody.freeze(1.0);
+            rhythm.freeze(1.0);
+        }
+        const double temperature = frozen ? 1.0 : 0.9;
+        Rng rng(7);
+        Bench::report(Result{ "pipeline", frozen ? "markov-sample-alias" : "markov-sample", draws, "draw", Bench::repeat(opt.repeats, [&] {
+            size_t sum = 0;
+            for (size_t d = 0; d < draws; ++d) sum += static_cast<size_t>(melody.sampleNext(pitches.data() + d % windows, order, temperature, rng));
+            Bench::consume(sum);
+        }) });
+        Bench::report(Result{ "pipeline", frozen ? "rhythm-sample-alias" : "rhythm-sample", draws, "draw", Bench::repeat(opt.repeats, [&] {
+            double sum = 0.0;
+            for (size_t d = 0; d < draws; ++d) sum += rhythm.sampleNext(durations.data() + d % windows, order, temperature, rng);
+            Bench::consume(static_cast<size_t>(sum));
+        }) });
+    }
+
+    // Phase E: whole melodies, as many notes as the corpus, up to a million;
+    // then Phase F on one of them.
+    const int length = 1024;
+    const size_t melodies = std::max<size_t>(1, std::min<size_t>(corpus.notes, draws) / length);
+    MelodyGenerator gen(melody, rhythm, order, 8, 3);
+    std::vector<NoteEvent> generated;
+    Bench::report(Result{ "pipeline", "generate", melodies * length, "note", Bench::repeat(opt.repeats, [&] {
+        for (size_t m = 0; m < melodies; ++m) generated = gen.generate(length, 60, 48, 84);
+    }) });
+    Bench::report(Result{ "pipeline", "encode-generated", generated.size(), "note", Bench::repeat(opt.repeats, [&] {
+        Bench::consume(writer.encode(generated).size());
+    }) });
+}
@@ -0,0 +1,138 @@
+#include "Bench.h"
+#include "MarkovModel.h"
+#include "RhythmModel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+// The previous tokenizer: the GCD of the first sequence's durations in
+// milliseconds, floored at 0.1 ms, and one token per multiple of it.
+struct GcdTokenizer {
+    double unit = 0.0;
+
+    static long long gcd(long long a, long long b) {
+        while (b) {
+            long long t = a % b;
+            a = b;
+            b = t;
+        }
+        return a;
+    }
+
+    void fit(const std::vector<std::vector<double>>& sequences) {
+        for (const auto &s : sequences) {
+            long long g = 0;
+            for (double d : s) {
+                const long long v = std::llround(d * 1000.0);
+                if (d > 0.0 && v > 0) g = gcd(g, v);
+            }
+            if (g > 0) {
+                unit = std::max(1e-4, static_cast<double>(g) / 1000.0);
+                return;
+            }
+        }
+    }
+    int token(double d) const { return static_cast<int>(std::llround(d / unit)); }
+    double duration(int t) const { return t * unit; }
+};
+
+// Sixteenth-note grid multiples at one tempo, with every duration off by up
+// to `jitter` either way, as a human performance would be.
+std::vector<std::vector<double>> humanized(size_t pieces, size_t length, double jitter, uint64_t seed) {
+    static const int kCommon[] = { 1, 2, 2, 3, 4, 4, 4, 6, 8, 8, 12, 16 };
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<size_t> pick(0, sizeof(kCommon) / sizeof(kCommon[0]) - 1);
+    std::uniform_real_distribution<double> wobble(1.0 - jitter, 1.0 + jitter);
+    std::vector<std::vector<double>> out(pieces);
+    for (auto &s : out) {
+        s.resize(length);
+        for (double &d : s) d = kCommon[pick(rng)] * 0.125 * wobble(rng);
+    }
+    return out;
+}
+
+template <class Tokenizer>
+void report(const char* name, const char* corpusName, const std::vector<std::vector<double>>& corpus, const Tokenizer& tok,
+            double unit, size_t tableBytes, size_t entries, int repeats) {
+    std::set<int> distinct;
+    double error = 0.0;
+    size_t count = 0;
+    for (const auto &s : corpus) {
+        for (double d : s) {
+            if (!(d > 0.0)) continue;
+            const int t = tok.token(d);
+            distinct.insert(t);
+            error += std::fabs(tok.duration(t) - d);
+            ++count;
+        }
+    }
+    const std::string key = std::string(corpusName) + "/" + name;
+    const Bench::Result result{ "rhythm-quantizer", key, count, "duration", Bench::repeat(repeats, [&] {
+        size_t sum = 0;
+        for (const auto &s : corpus) {
+            for (double d : s) sum += static_cast<size_t>(tok.token(d));
+        }
+        Bench::consume(sum);
+    }) };
+    Bench::record(result);
+    Bench::metric("rhythm-quantizer", key + "/tokens", static_cast<double>(distinct.size()), "token");
+    Bench::metric("rhythm-quantizer", key + "/entries", static_cast<double>(entries), "entry");
+    Bench::metric("rhythm-quantizer", key + "/table-bytes", static_cast<double>(tableBytes), "byte");
+    Bench::metric("rhythm-quantizer", key + "/mean-error", 1e3 * error / static_cast<double>(std::max<size_t>(1, count)), "ms");
+    const double best = Bench::best(result.seconds);
+    std::cout << "  " << std::left << std::setw(11) << corpusName << std::setw(11) << name << std::right
+              << std::setw(10) << std::setprecision(4) << unit << std::setw(9) << distinct.size()
+              << std::setw(11) << entries << std::setw(12) << std::setprecision(1) << static_cast<double>(tableBytes) / 1024.0
+              << std::setw(13) << std::setprecision(2) << 1e3 * error / static_cast<double>(std::max<size_t>(1, count))
+              << std::setw(10) << best * 1e9 / static_cast<double>(std::max<size_t>(1, count)) << "\n";
+}
+
+struct NewTokenizer {
+    const RhythmModel& model;
+    int token(double d) const { return model.durationToToken(d); }
+    double duration(int t) const { return model.tokenToDuration(t); }
+};
+
+}
+
+void runRhythmQuantizerBench(const BenchOptions& opt) {
+    struct Corpus {
+        const char* name;
+        std::vector<std::vector<double>> sequences;
+    };
+    std::vector<Corpus> corpora;
+    auto bundled = Bench::loadDurations(opt.dataRoot);
+    if (!bundled.empty()) corpora.push_back({ "bundled", std::move(bundled) });
+    corpora.push_back({ "human 3%", humanized(64, 512, 0.03, 1) });
+    corpora.push_back({ "human 10%", humanized(64, 512, 0.10, 2) });
+
+    const int order = 2;
+    std::cout << std::fixed;
+    std::cout << "  corpus     tokenizer       unit   tokens   entries   table KiB   mean err ms   ns/dur\n";
+    for (const Corpus &c : corpora) {
+        GcdTokenizer gcd;
+        gcd.fit(c.sequences);
+        MarkovModel legacy(order);
+        for (const auto &s : c.sequences) {
+            std::vector<int> tokens;
+            for (double d : s) {
+                if (d > 0.0) tokens.push_back(gcd.token(d));
+            }
+            legacy.train(tokens);
+        }
+        report("gcd", c.name, c.sequences, gcd, gcd.unit, legacy.memoryBytes(), legacy.transitionCount(), opt.repeats);
+
+        RhythmModel model(order);
+        model.trainMany(c.sequences);
+        report("histogram", c.name, c.sequences, NewTokenizer{ model }, model.unit(), model.memoryBytes(),
+               model.transitionCount(), opt.repeats);
+    }
+}
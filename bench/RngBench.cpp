@@ -0,0 +1,141 @@
+#include "Bench.h"
+#include "MarkovModel.h"
+#include "MelodyGenerator.h"
+#include "MelodyStream.h"
+#include "RhythmModel.h"
+#include "Rng.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Records n calls of fn(i), i in [0, n), as `name` and returns the
+// best-of-repeats nanoseconds per call.
+template <class F>
+double nsPerCall(const std::string& name, size_t n, int repeats, F&& fn) {
+    const Bench::Result result{ "rng", name, n, "call", Bench::repeat(repeats, [&] {
+        uint64_t sink = 0;
+        for (size_t i = 0; i < n; ++i) sink += static_cast<uint64_t>(fn(i));
+        Bench::consume(static_cast<size_t>(sink));
+    }) };
+    Bench::record(result);
+    return Bench::best(result.seconds) * 1e9 / static_cast<double>(n);
+}
+
+bool sameNotes(const std::vector<NoteEvent>& a, const std::vector<NoteEvent>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].pitch != b[i].pitch || a[i].startTime != b[i].startTime || a[i].duration != b[i].duration) return false;
+    }
+    return true;
+}
+
+}
+
+void runRngBench(const BenchOptions& opt) {
+    const size_t n = 10000000;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "  generator          state B   ns/raw   ns/below(37)   ns/uniform\n";
+    {
+        std::mt19937 mt(1);
+        std::uniform_int_distribution<uint32_t> pick(0, 36);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        const double raw = nsPerCall("mt19937/raw", n, opt.repeats, [&](size_t) { return mt(); });
+        const double below = nsPerCall("mt19937/below37", n, opt.repeats, [&](size_t) { return pick(mt); });
+        const double uniform = nsPerCall("mt19937/uniform", n, opt.repeats, [&](size_t) { return unit(mt) * 1e6; });
+        Bench::metric("rng", "mt19937/state-bytes", static_cast<double>(sizeof(mt)), "byte");
+        std::cout << "  std::mt19937   " << std::setw(11) << sizeof(mt) << std::setw(9) << raw << std::setw(15) << below
+                  << std::setw(13) << uniform << "\n";
+    }
+    {
+        Rng rng(1);
+        const double raw = nsPerCall("rng/raw", n, opt.repeats, [&](size_t) { return rng(); });
+        const double below = nsPerCall("rng/below37", n, opt.repeats, [&](size_t) { return rng.below(37); });
+        const double uniform = nsPerCall("rng/uniform", n, opt.repeats, [&](size_t) { return rng.uniform() * 1e6; });
+        Bench::metric("rng", "rng/state-bytes", static_cast<double>(sizeof(rng)), "byte");
+        std::cout << "  Rng            " << std::setw(11) << sizeof(rng) << std::setw(9) << raw << std::setw(15) << below
+                  << std::setw(13) << uniform << "\n";
+    }
+
+    // Seeking must land exactly where drawing would have.
+    size_t mismatches = 0;
+    {
+        Rng a(5, 3);
+        std::vector<uint64_t> draws(1000);
+        for (auto &d : draws) d = a();
+        Rng b(5, 3);
+        b.seek(500);
+        for (size_t i = 500; i < draws.size(); ++i) mismatches += b() != draws[i];
+    }
+    Bench::metric("rng", "seek-mismatches", static_cast<double>(mismatches), "draw");
+    std::cout << "  seek mismatches: " << mismatches << "\n";
+
+    auto melodies = Bench::loadMelodies(opt.dataRoot);
+    auto durations = Bench::loadDurations(opt.dataRoot);
+    if (melodies.empty() || durations.empty()) {
+        std::cout << "  no training sequences under " << opt.dataRoot << "\n";
+        return;
+    }
+    const int order = 2;
+    MarkovModel melody(order);
+    RhythmModel rhythm(order);
+    melody.trainMany(melodies);
+    rhythm.trainMany(durations);
+    melody.freeze(1.0);
+    rhythm.freeze(1.0);
+
+    // What the stream costs inside a draw: frozen sampling is one alias
+    // lookup, so the raw draw is a large share of it.
+    std::vector<int> histories;
+    for (const auto &m : melodies) {
+        for (size_t i = 0; i + order <= m.size() && histories.size() < 2 * 100000; ++i) histories.insert(histories.end(), m.begin() + i, m.begin() + i + order);
+    }
+    const size_t count = histories.size() / order;
+    Rng rng(9);
+    const double frozen = nsPerCall("markov-sample/frozen", count, opt.repeats, [&](size_t i) { return melody.sampleNext(histories.data() + i * order, order, 1.0, rng); });
+    const double tempered = nsPerCall("markov-sample/tempered", count, opt.repeats, [&](size_t i) { return melody.sampleNext(histories.data() + i * order, order, 0.8, rng); });
+    std::cout << "  MarkovModel::sampleNext: " << frozen << " ns frozen (T=1), " << tempered << " ns scanning (T=0.8)\n";
+
+    // Determinism: a melody depends only on (seed, request index).
+    MelodyGenerator gen(melody, rhythm, order, 8);
+    std::vector<MelodyRequest> requests(64);
+    for (size_t i = 0; i < requests.size(); ++i) {
+        requests[i].length = 512;
+        requests[i].minPitch = 36;
+        requests[i].maxPitch = 96;
+        requests[i].melodyTemp = (i % 2) ? 1.0 : 0.8;
+    }
+    ThreadPool one(1), many(8);
+    const auto serial = gen.generateBatch(requests, 42, one);
+    const auto parallel = gen.generateBatch(requests, 42, many);
+    const auto again = gen.generateBatch(requests, 42, many);
+    size_t batchMismatches = 0, streamMismatches = 0;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        batchMismatches += !sameNotes(serial[i], parallel[i]) + !sameNotes(parallel[i], again[i]);
+        MelodyStream stream = gen.stream(requests[i], MelodyGenerator::streamFor(42, i));
+        std::vector<NoteEvent> pulled(static_cast<size_t>(requests[i].length));
+        stream.next(pulled.data(), pulled.size());
+        streamMismatches += !sameNotes(serial[i], pulled);
+    }
+    MelodyGenerator first(melody, rhythm, order, 8, 7), second(melody, rhythm, order, 8, 7), other(melody, rhythm, order, 8, 8);
+    size_t callMismatches = 0, seedCollisions = 0;
+    for (int call = 0; call < 4; ++call) {
+        const auto a = first.generate(256, 60, 36, 96);
+        callMismatches += !sameNotes(a, second.generate(256, 60, 36, 96));
+        seedCollisions += sameNotes(a, other.generate(256, 60, 36, 96));
+    }
+    Bench::metric("rng", "batch-mismatches", static_cast<double>(batchMismatches), "melody");
+    Bench::metric("rng", "stream-mismatches", static_cast<double>(streamMismatches), "melody");
+    Bench::metric("rng", "equal-seed-mismatches", static_cast<double>(callMismatches), "melody");
+    Bench::metric("rng", "different-seed-collisions", static_cast<double>(seedCollisions), "melody");
+    std::cout << "  " << requests.size() << " requests on 1 and " << many.size() << " threads, twice: " << batchMismatches
+              << " mismatches; replayed as streams: " << streamMismatches << " mismatches\n";
+    std::cout << "  generate() with equal seeds: " << callMismatches << " mismatches; different seeds: "
+              << seedCollisions << " identical melodies\n";
+}
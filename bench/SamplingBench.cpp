@@ -0,0 +1,115 @@
+#include "Bench.h"
+#include "LegacyMarkov.h"
+#include "MarkovModel.h"
+#include "MelodyGenerator.h"
+#include "RhythmModel.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct SampleStats {
+    double nsPerCall;
+    double allocsPerCall;
+};
+
+// Times `calls` calls of fn(i), each worth `items` units, and records the
+// result and its allocations per call under `name`.
+template <class F>
+SampleStats measure(const std::string& name, size_t calls, size_t items, const char* unit, int repeats, F&& fn) {
+    double allocs = 0.0;
+    Bench::Result result{ "sampling", name, calls * items, unit, Bench::repeat(repeats, [&] {
+        size_t a0 = Bench::allocationCount();
+        size_t acc = 0;
+        for (size_t i = 0; i < calls; ++i) acc += static_cast<size_t>(fn(i));
+        allocs = static_cast<double>(Bench::allocationCount() - a0) / static_cast<double>(calls);
+        Bench::consume(acc);
+    }) };
+    Bench::record(result);
+    Bench::metric("sampling", name + "/allocs", allocs, "alloc/call");
+    return { Bench::best(result.seconds) * 1e9 / static_cast<double>(calls), allocs };
+}
+
+std::string temperatureName(double temp) {
+    return temp == 1.0 ? "T1.0" : "T0.8";
+}
+
+}
+
+void runSamplingBench(const BenchOptions& opt) {
+    auto corpus = Bench::loadMelodies(opt.dataRoot);
+    if (corpus.empty()) {
+        std::cout << "  no melody sequences under " << opt.dataRoot << "/melodies\n";
+        return;
+    }
+
+    const int order = 2;
+    LegacyMarkov legacy(order);
+    for (const auto &s : corpus) legacy.train(s);
+    MarkovModel model(order);
+    model.trainMany(corpus);
+
+    std::vector<std::vector<int>> histories;
+    std::mt19937 rng(99);
+    for (const auto &seq : corpus) {
+        for (size_t i = order; i <= seq.size(); ++i) histories.emplace_back(seq.begin() + (i - order), seq.begin() + i);
+    }
+    std::shuffle(histories.begin(), histories.end(), rng);
+    if (histories.size() > 100000) histories.resize(100000);
+    const size_t n = histories.size();
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "  order " << order << ", " << n << " histories from the corpus\n";
+    std::cout << "  temperature   legacy ns/sample  allocs   current ns/sample  allocs\n";
+    Rng stream(99);
+    for (double temp : { 1.0, 0.8 }) {
+        auto before = measure("legacy/" + temperatureName(temp), n, 1, "sample", opt.repeats,
+                              [&](size_t i) { return legacy.sampleNext(histories[i], temp); });
+        auto after = measure("scan/" + temperatureName(temp), n, 1, "sample", opt.repeats,
+                             [&](size_t i) { return model.sampleNext(histories[i].data(), histories[i].size(), temp, stream); });
+        std::cout << "  " << std::setw(11) << temp << "  " << std::setw(16) << before.nsPerCall << "  " << std::setw(6) << before.allocsPerCall
+                  << "  " << std::setw(17) << after.nsPerCall << "  " << std::setw(6) << after.allocsPerCall << "\n";
+    }
+
+    // Same draws from alias tables frozen at each temperature.
+    std::cout << "  frozen (alias) ns/sample:";
+    for (double temp : { 1.0, 0.8 }) {
+        MarkovModel frozen(order);
+        frozen.trainMany(corpus);
+        frozen.freeze(temp);
+        auto st = measure("alias/" + temperatureName(temp), n, 1, "sample", opt.repeats,
+                          [&](size_t i) { return frozen.sampleNext(histories[i].data(), histories[i].size(), temp, stream); });
+        std::cout << "  T=" << temp << ": " << st.nsPerCall << " (" << st.allocsPerCall << " allocs)";
+        if (temp == 1.0) {
+            std::cout << ", tables " << frozen.frozenMemoryBytes() << " B on " << frozen.memoryBytes() << " B of counts";
+            Bench::metric("sampling", "alias-table-bytes", static_cast<double>(frozen.frozenMemoryBytes()), "byte");
+            Bench::metric("sampling", "count-bytes", static_cast<double>(frozen.memoryBytes()), "byte");
+        }
+    }
+    std::cout << "\n";
+
+    // End-to-end per-note cost of MelodyGenerator on the trained models.
+    std::vector<std::vector<double>> durations;
+    for (const auto &seq : corpus) {
+        std::vector<double> d(seq.size());
+        for (size_t i = 0; i < d.size(); ++i) d[i] = 0.125 * static_cast<double>(1 + (seq[i] % 4));
+        durations.push_back(std::move(d));
+    }
+    RhythmModel rhythm(order);
+    rhythm.trainMany(durations);
+    MelodyGenerator gen(model, rhythm, order, 8);
+    const int length = 4096;
+    auto perCall = measure("generate", 1, length, "note", opt.repeats, [&](size_t) { return gen.generate(length, 60, 48, 84).size(); });
+    std::cout << "  MelodyGenerator::generate: " << perCall.nsPerCall / length << " ns/note, "
+              << perCall.allocsPerCall << " allocations per " << length << "-note call\n";
+    model.freeze(1.0);
+    rhythm.freeze(1.0);
+    auto frozenCall = measure("generate-frozen", 1, length, "note", opt.repeats, [&](size_t) { return gen.generate(length, 60, 48, 84).size(); });
+    std::cout << "  MelodyGenerator::generate (frozen): " << frozenCall.nsPerCall / length << " ns/note\n";
+}
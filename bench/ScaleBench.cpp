@@ -0,0 +1,139 @@
+#include "Bench.h"
+#include "Rng.h"
+#include "Scale.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// The repair MelodyStream used to run per note: a pitch-class scan over the
+// request's list for every candidate, up to 26 candidates, then a clamp.
+struct LegacyRepair {
+    int minPitch;
+    int maxPitch;
+    std::vector<int> allowed;
+
+    bool pitchClassAllowed(int pitch) const {
+        if (allowed.empty()) return true;
+        int pc = ((pitch % 12) + 12) % 12;
+        for (int a : allowed) if ((a % 12 + 12) % 12 == pc) return true;
+        return false;
+    }
+    int clampPitch(int p) const { return p < minPitch ? minPitch : p > maxPitch ? maxPitch : p; }
+    int repair(int pitch) const {
+        if (!pitchClassAllowed(pitch)) {
+            for (int d = 0; d <= 12; ++d) {
+                if (pitch + d <= maxPitch && pitchClassAllowed(pitch + d)) { pitch += d; break; }
+                if (pitch - d >= minPitch && pitchClassAllowed(pitch - d)) { pitch -= d; break; }
+            }
+        }
+        return clampPitch(pitch);
+    }
+};
+
+}
+
+void runScaleBench(const BenchOptions& opt) {
+    // Repair of drawn pitches, C major between G3 and G5. Draws are spread
+    // over 0..127 so most need moving, the worst case for the scan.
+    const int lo = 55, hi = 79;
+    Scale cMajor;
+    Scale::parse("C:major", cMajor);
+    LegacyRepair legacy{ lo, hi, cMajor.pitchClasses() };
+    const size_t n = 4000000;
+    std::vector<uint8_t> drawn(n);
+    Rng rng(5);
+    for (auto &p : drawn) p = static_cast<uint8_t>(rng.below(128));
+
+    const Bench::Result compile{ "scale", "compile-constraint", 1000, "constraint", Bench::repeat(opt.repeats, [&] {
+        for (int i = 0; i < 1000; ++i) {
+            PitchConstraint c(PitchMask::pitchClasses(legacy.allowed), lo, hi + (i & 1));
+            Bench::consume(static_cast<size_t>(c.nearest(i & 127)));
+        }
+    }) };
+    Bench::record(compile);
+    const double compileNs = Bench::best(compile.seconds) * 1e6;
+    const PitchConstraint constraint(PitchMask::pitchClasses(legacy.allowed), lo, hi);
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "  repair          ns/note   in scale and range\n";
+    for (bool table : { false, true }) {
+        size_t inside = 0;
+        const std::string key = table ? "repair/lookup-table" : "repair/class-scan";
+        const Bench::Result repair{ "scale", key, n, "note", Bench::repeat(opt.repeats, [&] {
+            size_t sum = 0;
+            inside = 0;
+            for (uint8_t p : drawn) {
+                const int q = table ? constraint.nearest(p) : legacy.repair(p);
+                sum += static_cast<size_t>(q);
+                inside += cMajor.contains(q) && q >= lo && q <= hi;
+            }
+            Bench::consume(sum);
+        }) };
+        Bench::record(repair);
+        Bench::metric("scale", key + "/in-scale-and-range", static_cast<double>(inside) / static_cast<double>(n), "ratio");
+        const double best = Bench::best(repair.seconds);
+        std::cout << "  " << std::left << std::setw(14) << (table ? "lookup table" : "class scan") << std::right
+                  << std::setw(9) << best * 1e9 / static_cast<double>(n)
+                  << std::setw(20) << 100.0 * static_cast<double>(inside) / static_cast<double>(n) << "%\n";
+    }
+    size_t differ = 0;
+    for (int p = 0; p < 128; ++p) {
+        const int old = legacy.repair(p);
+        // Only where the scan stopped inside the scale; elsewhere its clamp
+        // could leave the scale, which the table never does.
+        if (cMajor.contains(old) && old != constraint.nearest(p)) ++differ;
+    }
+    Bench::metric("scale", "repair/differs-in-scale", static_cast<double>(differ), "pitch");
+    std::cout << "  compiling a constraint: " << compileNs << " ns; pitches repaired differently where the scan stayed in scale: "
+              << differ << "\n";
+
+    // Corpus transposition: share of notes inside each scale as recorded and
+    // with every melody moved by its best shift.
+    auto melodies = Bench::loadMelodies(opt.dataRoot);
+    if (melodies.empty()) {
+        std::cout << "  no training sequences under " << opt.dataRoot << "\n";
+        return;
+    }
+    std::vector<std::vector<uint8_t>> corpus;
+    size_t notes = 0;
+    for (const auto &m : melodies) {
+        std::vector<uint8_t> seq;
+        for (int p : m) seq.push_back(static_cast<uint8_t>(std::min(127, std::max(0, p))));
+        notes += seq.size();
+        corpus.push_back(std::move(seq));
+    }
+    std::cout << "  transpose to         in scale before   after   melodies moved   ns/note\n";
+    for (const char *spec : { "C:major", "A:minor", "D:dorian", "C:major-pentatonic", "A:blues" }) {
+        Scale scale;
+        Scale::parse(spec, scale);
+        size_t before = 0, after = 0, moved = 0;
+        const std::string key = std::string("transpose/") + spec;
+        const Bench::Result transpose{ "scale", key, notes, "note", Bench::repeat(opt.repeats, [&] {
+            before = after = moved = 0;
+            for (const auto &seq : corpus) {
+                const int shift = scale.bestTransposition(Span<const uint8_t>(seq));
+                moved += shift != 0;
+                for (uint8_t p : seq) {
+                    before += scale.contains(p);
+                    after += scale.contains(p + shift);
+                }
+            }
+        }) };
+        Bench::record(transpose);
+        Bench::metric("scale", key + "/in-scale-before", static_cast<double>(before) / static_cast<double>(notes), "ratio");
+        Bench::metric("scale", key + "/in-scale-after", static_cast<double>(after) / static_cast<double>(notes), "ratio");
+        Bench::metric("scale", key + "/melodies-moved", static_cast<double>(moved), "melody");
+        const double best = Bench::best(transpose.seconds);
+        std::cout << "  " << std::left << std::setw(20) << spec << std::right
+                  << std::setw(17) << 100.0 * static_cast<double>(before) / static_cast<double>(notes) << "%"
+                  << std::setw(7) << 100.0 * static_cast<double>(after) / static_cast<double>(notes) << "%"
+                  << std::setw(11) << moved << " / " << corpus.size()
+                  << std::setw(10) << best * 1e9 / static_cast<double>(notes) << "\n";
+    }
+}
@@ -0,0 +1,104 @@
+#include "Bench.h"
+#include "MarkovModel.h"
+#include "MelodyGenerator.h"
+#include "MelodyStream.h"
+#include "RhythmModel.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Latency {
+    double p50, p99, p999, max;
+};
+
+Latency percentiles(std::vector<double>& ns) {
+    std::sort(ns.begin(), ns.end());
+    auto at = [&](double q) { return ns[std::min(ns.size() - 1, static_cast<size_t>(q * static_cast<double>(ns.size())))]; };
+    return { at(0.50), at(0.99), at(0.999), ns.back() };
+}
+
+void recordLatency(const std::string& name, const Latency& l) {
+    Bench::metric("streaming", name + "/p50", l.p50, "ns");
+    Bench::metric("streaming", name + "/p99", l.p99, "ns");
+    Bench::metric("streaming", name + "/p99.9", l.p999, "ns");
+    Bench::metric("streaming", name + "/max", l.max, "ns");
+}
+
+}
+
+void runStreamingBench(const BenchOptions& opt) {
+    auto melodies = Bench::loadMelodies(opt.dataRoot);
+    auto durations = Bench::loadDurations(opt.dataRoot);
+    if (melodies.empty() || durations.empty()) {
+        std::cout << "  no training sequences under " << opt.dataRoot << "\n";
+        return;
+    }
+    const int order = 2;
+    MarkovModel melody(order);
+    RhythmModel rhythm(order);
+    melody.trainMany(melodies);
+    rhythm.trainMany(durations);
+    MelodyGenerator gen(melody, rhythm, order, 8);
+
+    const size_t notes = 1000000;
+    const size_t block = 16;
+    std::vector<double> perNote(notes);
+    std::vector<double> perBlock(notes / block);
+
+    std::cout << std::fixed << std::setprecision(0);
+    std::cout << "  " << notes << " notes per stream, latency in ns\n";
+    std::cout << "  mode                  p50    p99   p99.9     max   allocs   live-bytes delta\n";
+    for (int pass = 0; pass < 3; ++pass) {
+        const char *label = pass == 0 ? "scan, T=1.0" : pass == 1 ? "scan, T=0.8" : "frozen, T=1.0";
+        const std::string name = pass == 0 ? "scan-T1.0" : pass == 1 ? "scan-T0.8" : "frozen-T1.0";
+        MelodyRequest request;
+        request.minPitch = 48;
+        request.maxPitch = 84;
+        request.melodyTemp = pass == 1 ? 0.8 : 1.0;
+        if (pass == 2) {
+            melody.freeze(1.0);
+            rhythm.freeze(1.0);
+        }
+        MelodyStream stream = gen.stream(request, MelodyGenerator::streamFor(7, 0));
+
+        const size_t live0 = Bench::liveBytes();
+        const size_t allocs0 = Bench::allocationCount();
+        size_t acc = 0;
+        for (size_t i = 0; i < notes; ++i) {
+            auto t0 = Bench::clock::now();
+            NoteEvent n = stream.next();
+            perNote[i] = Bench::secondsSince(t0) * 1e9;
+            acc += static_cast<size_t>(n.pitch);
+        }
+        const size_t allocs = Bench::allocationCount() - allocs0;
+        const long long liveDelta = static_cast<long long>(Bench::liveBytes()) - static_cast<long long>(live0);
+        Bench::consume(acc);
+
+        double total = 0.0;
+        for (double ns : perNote) total += ns;
+        Bench::record(Bench::Result{ "streaming", name + "/next", notes, "note", { total * 1e-9 } });
+        Latency l = percentiles(perNote);
+        recordLatency(name + "/next", l);
+        Bench::metric("streaming", name + "/allocations", static_cast<double>(allocs), "alloc");
+        Bench::metric("streaming", name + "/live-bytes-delta", static_cast<double>(liveDelta), "byte");
+        std::cout << "  " << std::left << std::setw(18) << label << std::right << std::setw(7) << l.p50 << std::setw(7) << l.p99
+                  << std::setw(8) << l.p999 << std::setw(8) << l.max << std::setw(9) << allocs << std::setw(19) << liveDelta << "\n";
+
+        NoteEvent buf[block];
+        for (size_t b = 0; b < perBlock.size(); ++b) {
+            auto t0 = Bench::clock::now();
+            stream.next(buf, block);
+            perBlock[b] = Bench::secondsSince(t0) * 1e9;
+            Bench::consume(static_cast<size_t>(buf[block - 1].pitch));
+        }
+        Latency lb = percentiles(perBlock);
+        recordLatency(name + "/block" + std::to_string(block), lb);
+        std::cout << "  " << std::left << std::setw(18) << ("  blocks of " + std::to_string(block)) << std::right << std::setw(7) << lb.p50 << std::setw(7) << lb.p99
+                  << std::setw(8) << lb.p999 << std::setw(8) << lb.max << "\n";
+    }
+}
@@ -0,0 +1,64 @@
+#include "Bench.h"
+#include "Rng.h"
+#include "Scale.h"
+
+#include <algorithm>
+
+namespace {
+
+// Draws an index with probability proportional to weights[i].
+size_t pick(Rng& rng, const uint32_t* weights, size_t n) {
+    uint32_t total = 0;
+    for (size_t i = 0; i < n; ++i) total += weights[i];
+    uint32_t r = rng.below(total);
+    size_t i = 0;
+    while (r >= weights[i]) r -= weights[i++];
+    return i;
+}
+
+}
+
+Bench::SyntheticCorpus Bench::synthesize(size_t notes, uint64_t seed, size_t sequenceLength) {
+    // Mostly steps and repeats, some thirds and fourths.
+    static const int kMoves[] = { -3, -2, -1, 0, 1, 2, 3 };
+    static const uint32_t kMoveWeights[] = { 1, 3, 8, 4, 8, 3, 1 };
+    static const double kDurations[] = { 0.125, 0.25, 0.375, 0.5, 0.75, 1.0 };
+    static const uint32_t kDurationWeights[] = { 2, 8, 2, 5, 2, 1 };
+    const size_t kPhrase = 8;
+    const int kDegrees = 21;    // three octaves
+
+    Scale major, minor;
+    Scale::parse("C:major", major);
+    Scale::parse("C:minor", minor);
+    const std::vector<int> steps[2] = { major.pitchClasses(), minor.pitchClasses() };
+
+    SyntheticCorpus out;
+    sequenceLength = std::max<size_t>(1, sequenceLength);
+    for (uint64_t s = 0; out.notes < notes; ++s) {
+        Rng rng(seed, s);
+        const size_t length = std::min(notes - out.notes, sequenceLength);
+        const int tonic = static_cast<int>(rng.below(12));
+        const std::vector<int> &scale = steps[rng.below(2)];
+        std::vector<int> melody(length);
+        std::vector<double> durations(length);
+        std::vector<int> moves(length);
+        int degree = 7 + static_cast<int>(rng.below(7));
+        bool replay = false;
+        for (size_t i = 0; i < length; ++i) {
+            // Some phrases repeat the moves of the one before, in a new place.
+            const size_t inPhrase = i % kPhrase;
+            if (inPhrase == 0) replay = i >= kPhrase && rng.below(10) < 4;
+            const int move = replay ? moves[i - kPhrase] : kMoves[pick(rng, kMoveWeights, 7)];
+            moves[i] = move;
+            degree += move;
+            if (degree < 0) degree = -degree;
+            if (degree >= kDegrees) degree = 2 * (kDegrees - 1) - degree;
+            melody[i] = 48 + tonic + 12 * (degree / 7) + scale[degree % 7];
+            durations[i] = inPhrase == kPhrase - 1 && rng.below(2) ? 1.0 : kDurations[pick(rng, kDurationWeights, 6)];
+        }
+        out.notes += length;
+        out.melodies.push_back(std::move(melody));
+        out.durations.push_back(std::move(durations));
+    }
+    return out;
+}
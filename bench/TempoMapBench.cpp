@@ -0,0 +1,141 @@
+#include "Bench.h"
+#include "MidiParser.h"
+#include "MidiStreamWriter.h"
+#include "MidiWriter.h"
+#include "TempoMap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// A tempo change every `spacing` ticks, at 60..180 bpm.
+TempoMap makeMap(int ppq, size_t changes, uint64_t spacing, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<uint32_t> micro(333333, 1000000);
+    std::vector<TempoMap::Change> list;
+    for (size_t i = 0; i < changes; ++i) list.push_back(TempoMap::Change{ i * spacing, micro(rng) });
+    return TempoMap(ppq, std::move(list));
+}
+
+// Sorted note times with some overlap, so the off times are only nearly sorted.
+std::vector<NoteEvent> makeNotes(size_t count, double span, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> start(0.0, span), length(0.05, 2.0);
+    std::uniform_int_distribution<int> pitch(48, 84);
+    std::vector<NoteEvent> notes(count);
+    for (auto &n : notes) {
+        n.pitch = pitch(rng);
+        n.startTime = start(rng);
+        n.duration = length(rng);
+    }
+    std::sort(notes.begin(), notes.end(), [](const NoteEvent& a, const NoteEvent& b) { return a.startTime < b.startTime; });
+    return notes;
+}
+
+// Records `repeats` runs of f(), `items` conversions each, as `name`; returns the best.
+template <class F>
+double bestOf(const std::string& name, size_t items, int repeats, F&& f) {
+    const Bench::Result result{ "tempo-map", name, items, "conversion", Bench::repeat(repeats, f) };
+    Bench::record(result);
+    return Bench::best(result.seconds);
+}
+
+}
+
+void runTempoMapBench(const BenchOptions& opt) {
+    const size_t conversions = 1000000;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "  changes   ticks->s search   ticks->s cursor   s->ticks search   s->ticks cursor   (ns/conversion)\n";
+    for (size_t changes : { size_t(1), size_t(64), size_t(4096), size_t(65536) }) {
+        const TempoMap map = makeMap(480, changes, 120, 7);
+        const uint64_t lastTick = std::max<uint64_t>(1, changes * 120);
+        std::vector<uint64_t> ticks(conversions);
+        for (size_t i = 0; i < conversions; ++i) ticks[i] = lastTick * i / conversions;
+        std::vector<double> seconds(conversions);
+        for (size_t i = 0; i < conversions; ++i) seconds[i] = map.seconds(ticks[i]);
+
+        double sink = 0.0;
+        uint64_t tickSink = 0;
+        const std::string suffix = "/changes" + std::to_string(changes);
+        const double searchSeconds = bestOf("ticks-to-seconds/search" + suffix, conversions, opt.repeats, [&] { for (uint64_t t : ticks) sink += map.seconds(t); });
+        const double cursorSeconds = bestOf("ticks-to-seconds/cursor" + suffix, conversions, opt.repeats, [&] {
+            TempoMap::Cursor c = map.cursor();
+            for (uint64_t t : ticks) sink += c.seconds(t);
+        });
+        const double searchTicks = bestOf("seconds-to-ticks/search" + suffix, conversions, opt.repeats, [&] { for (double s : seconds) tickSink += map.ticks(s); });
+        const double cursorTicks = bestOf("seconds-to-ticks/cursor" + suffix, conversions, opt.repeats, [&] {
+            TempoMap::Cursor c = map.cursor();
+            for (double s : seconds) tickSink += c.ticks(s);
+        });
+        Bench::consume(static_cast<size_t>(sink) + static_cast<size_t>(tickSink));
+
+        const double n = static_cast<double>(conversions) / 1e9;
+        std::cout << "  " << std::setw(7) << changes << std::setw(18) << searchSeconds / n << std::setw(18) << cursorSeconds / n
+                  << std::setw(18) << searchTicks / n << std::setw(18) << cursorTicks / n << "\n";
+    }
+
+    // Write through each map, parse back and compare note times; the error
+    // should stay within half a tick. The streaming writer must match the
+    // batch writer byte for byte.
+    std::cout << std::setprecision(3);
+    std::cout << "  map                 notes   max error ms   half tick ms   stream identical\n";
+    struct Case {
+        const char* name;
+        const char* key;    // name in the JSON report
+        TempoMap map;
+    };
+    const Case cases[] = {
+        { "ppq 480, constant", "ppq480-constant", TempoMap(480, 500000) },
+        { "ppq 480, 256 chg", "ppq480-256changes", makeMap(480, 256, 480, 3) },
+        { "ppq 96, 4096 chg", "ppq96-4096changes", makeMap(96, 4096, 24, 5) },
+        { "smpte 25 x 40", "smpte25x40", TempoMap::smpte(25, 40) },
+        { "smpte 29.97 x 80", "smpte29.97x80", TempoMap::smpte(29, 80) },
+    };
+    const std::vector<NoteEvent> notes = makeNotes(20000, 600.0, 9);
+    Parser parser;
+    MidiWriter writer;
+    for (const Case &c : cases) {
+        const std::vector<unsigned char> batch = writer.encode(notes, c.map);
+        std::vector<NoteEvent> back = parser.parseMidiBuffer(batch.data(), batch.size());
+        std::stable_sort(back.begin(), back.end(), [](const NoteEvent& a, const NoteEvent& b) { return a.startTime < b.startTime; });
+
+        double maxError = back.size() == notes.size() ? 0.0 : std::numeric_limits<double>::infinity();
+        for (size_t i = 0; i < back.size() && i < notes.size(); ++i) {
+            maxError = std::max(maxError, std::fabs(back[i].startTime - notes[i].startTime));
+        }
+        // The widest tick in the map bounds the rounding error.
+        double widest = 0.0;
+        for (const auto &seg : c.map.segments()) {
+            widest = std::max(widest, c.map.seconds(seg.tick + 1) - c.map.seconds(seg.tick));
+        }
+
+        std::vector<unsigned char> streamed;
+        const bool ok = MidiStreamWriter::writeTwoPass(
+            [&](const unsigned char* data, size_t size) {
+                streamed.insert(streamed.end(), data, data + size);
+                return true;
+            },
+            [&](MidiStreamWriter& w) {
+                for (const auto &n : notes) {
+                    if (!w.add(n)) return false;
+                }
+                return true;
+            },
+            c.map);
+
+        const std::string key = std::string("round-trip/") + c.key;
+        Bench::metric("tempo-map", key + "/max-error", maxError * 1e3, "ms");
+        Bench::metric("tempo-map", key + "/half-tick", widest * 0.5e3, "ms");
+        Bench::metric("tempo-map", key + "/stream-differs", ok && streamed == batch ? 0.0 : 1.0, "file");
+        std::cout << "  " << std::left << std::setw(18) << c.name << std::right << std::setw(7) << back.size()
+                  << std::setw(15) << maxError * 1e3 << std::setw(15) << widest * 0.5e3
+                  << std::setw(19) << (ok && streamed == batch ? "yes" : "NO") << "\n";
+    }
+}
@@ -0,0 +1,117 @@
+#include "Bench.h"
+#include "MarkovModel.h"
+#include "RhythmModel.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// The corpus transposed into every key, repeated: a bigger training set with
+// the same statistics, so shards have enough work to be worth splitting.
+std::vector<std::vector<int>> enlarge(const std::vector<std::vector<int>>& corpus, int copies) {
+    std::vector<std::vector<int>> out;
+    for (int c = 0; c < copies; ++c) {
+        for (int shift = -6; shift < 6; ++shift) {
+            for (const auto &s : corpus) {
+                std::vector<int> t(s);
+                for (int &p : t) p = std::min(127, std::max(0, p + shift));
+                out.push_back(std::move(t));
+            }
+        }
+    }
+    return out;
+}
+
+// Every row reachable from the corpus must hold the same counts.
+size_t countMismatches(const MarkovModel& a, const MarkovModel& b, const std::vector<std::vector<int>>& corpus) {
+    size_t bad = (a.historyCount() != b.historyCount() || a.transitionCount() != b.transitionCount() ||
+                  a.observationCount() != b.observationCount() || a.vocabularySize() != b.vocabularySize()) ? 1 : 0;
+    for (const auto &seq : corpus) {
+        for (size_t i = 0; i < seq.size(); ++i) {
+            for (size_t k = 1; k <= static_cast<size_t>(a.order()) && k <= i; ++k) {
+                auto x = a.lookup(seq.data() + i - k, k);
+                auto y = b.lookup(seq.data() + i - k, k);
+                if (x.size != y.size || !std::equal(x.begin(), x.end(), y.begin(), [](const NGramTable::Entry &p, const NGramTable::Entry &q) {
+                        return p.token == q.token && p.count == q.count;
+                    })) {
+                    ++bad;
+                }
+            }
+        }
+    }
+    return bad;
+}
+
+}
+
+void runTrainingBench(const BenchOptions& opt) {
+    auto base = Bench::loadMelodies(opt.dataRoot);
+    auto durations = Bench::loadDurations(opt.dataRoot);
+    if (base.empty()) {
+        std::cout << "  no melody sequences under " << opt.dataRoot << "/melodies\n";
+        return;
+    }
+    auto corpus = enlarge(base, 4);
+    size_t tokens = 0;
+    for (const auto &s : corpus) tokens += s.size();
+    std::cout << "  corpus: " << corpus.size() << " sequences, " << tokens << " tokens (base transposed x12, repeated x4)\n";
+
+    std::vector<size_t> threadCounts;
+    const size_t hw = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t t = 1; t < hw; t *= 2) threadCounts.push_back(t);
+    threadCounts.push_back(hw);
+    if (hw < 4) threadCounts.push_back(4); // still exercises the sharded merge on small machines
+
+    std::cout << std::fixed << std::setprecision(2);
+    for (int order : { 2, 4 }) {
+        const std::string prefix = "order" + std::to_string(order) + "/";
+        MarkovModel serial(order);
+        bool first = true;
+        const Bench::Result serialRun{ "training", prefix + "serial", tokens, "token", Bench::repeat(opt.repeats, [&] {
+            MarkovModel m(order);
+            m.trainMany(corpus);
+            if (first) serial = std::move(m);
+            first = false;
+        }) };
+        Bench::record(serialRun);
+        const double bestSerial = Bench::best(serialRun.seconds);
+        std::cout << "  order " << order << ": serial " << bestSerial * 1e3 << " ms\n";
+        std::cout << "    threads   ms       speedup   Mtokens/s   mismatches\n";
+        for (size_t threads : threadCounts) {
+            ThreadPool pool(threads);
+            size_t mismatches = 0;
+            std::vector<double> seconds;
+            for (int r = 0; r < opt.repeats; ++r) {
+                auto t0 = Bench::clock::now();
+                MarkovModel m(order);
+                m.trainMany(corpus, pool);
+                seconds.push_back(Bench::secondsSince(t0));
+                if (r == 0) mismatches = countMismatches(serial, m, corpus);
+            }
+            const std::string name = prefix + "threads" + std::to_string(threads);
+            Bench::record(Bench::Result{ "training", name, tokens, "token", seconds });
+            Bench::metric("training", name + "/mismatches", static_cast<double>(mismatches), "row");
+            const double best = Bench::best(seconds);
+            std::cout << "    " << std::setw(7) << threads << "  " << std::setw(7) << best * 1e3
+                      << "  " << std::setw(8) << bestSerial / best << "  " << std::setw(10) << tokens / best / 1e6
+                      << "  " << std::setw(11) << mismatches << "\n";
+        }
+    }
+
+    if (!durations.empty()) {
+        RhythmModel serial(2);
+        serial.trainMany(durations);
+        ThreadPool pool(std::max<size_t>(4, hw));
+        RhythmModel parallel(2);
+        parallel.trainMany(durations, pool);
+        const bool same = serial.unit() == parallel.unit() && serial.vocabularySize() == parallel.vocabularySize();
+        std::cout << "  rhythm model (" << pool.size() << " threads): " << (same ? "matches serial" : "MISMATCH") << "\n";
+        Bench::metric("training", "rhythm-mismatch", same ? 0.0 : 1.0, "model");
+    }
+}
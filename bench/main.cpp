@@ -0,0 +1,205 @@
+#include "Bench.h"
+#include "MidiParser.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct BenchEntry {
+    const char* name;
+    void (*run)(const BenchOptions&);
+};
+
+const BenchEntry kBenches[] = {
+    { "parser", runParserBench },
+    { "markov-table", runMarkovTableBench },
+    { "sampling", runSamplingBench },
+    { "model-file", runModelFileBench },
+    { "corpus", runCorpusBench },
+    { "training", runTrainingBench },
+    { "incremental", runIncrementalBench },
+    { "generation", runGenerationBench },
+    { "streaming", runStreamingBench },
+    { "midi-stream", runMidiStreamBench },
+    { "midi-writer", runMidiWriterBench },
+    { "melody-extract", runMelodyExtractBench },
+    { "tempo-map", runTempoMapBench },
+    { "rhythm-quantizer", runRhythmQuantizerBench },
+    { "joint-model", runJointModelBench },
+    { "context-tree", runContextTreeBench },
+    { "compact-model", runCompactModelBench },
+    { "rng", runRngBench },
+    { "beam-search", runBeamSearchBench },
+    { "scale", runScaleBench },
+    { "interval-model", runIntervalModelBench },
+    { "pipeline", runPipelineBench },
+};
+
+std::atomic<size_t> g_sink{0};
+std::vector<Bench::Result> g_results;
+
+struct Metric {
+    std::string bench;
+    std::string name;
+    double value;
+    std::string unit;
+};
+std::vector<Metric> g_metrics;
+
+std::string jsonString(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        if (static_cast<unsigned char>(c) >= 0x20) out += c;
+    }
+    return out + "\"";
+}
+
+// Per result: the raw seconds of every repeat plus the best and median, and
+// the rate at the best; regressions are judged on the best. Metrics follow
+// as plain values.
+bool writeJson(const std::string& path, const BenchOptions& opt) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "cannot write " << path << "\n";
+        return false;
+    }
+    out << std::setprecision(9);
+    out << "{\n  \"repeats\": " << opt.repeats << ",\n  \"synthetic_notes\": " << opt.syntheticNotes << ",\n  \"results\": [";
+    for (size_t i = 0; i < g_results.size(); ++i) {
+        const Bench::Result &r = g_results[i];
+        std::vector<double> sorted = r.seconds;
+        std::sort(sorted.begin(), sorted.end());
+        const double best = sorted.empty() ? 0.0 : sorted.front();
+        const double median = sorted.empty() ? 0.0 : sorted[sorted.size() / 2];
+        out << (i ? "," : "") << "\n    { \"bench\": " << jsonString(r.bench) << ", \"name\": " << jsonString(r.name)
+            << ", \"items\": " << r.items << ", \"unit\": " << jsonString(r.unit) << ", \"best_s\": " << best
+            << ", \"median_s\": " << median << ", \"ns_per_item\": " << (r.items ? best * 1e9 / static_cast<double>(r.items) : 0.0)
+            << ", \"items_per_s\": " << (best > 0.0 ? static_cast<double>(r.items) / best : 0.0) << ", \"seconds\": [";
+        for (size_t k = 0; k < r.seconds.size(); ++k) out << (k ? ", " : "") << r.seconds[k];
+        out << "] }";
+    }
+    out << "\n  ],\n  \"metrics\": [";
+    for (size_t i = 0; i < g_metrics.size(); ++i) {
+        const Metric &m = g_metrics[i];
+        out << (i ? "," : "") << "\n    { \"bench\": " << jsonString(m.bench) << ", \"name\": " << jsonString(m.name)
+            << ", \"value\": ";
+        if (std::isfinite(m.value)) out << m.value;
+        else out << "null";
+        out << ", \"unit\": " << jsonString(m.unit) << " }";
+    }
+    out << "\n  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+}
+
+void Bench::report(const Result& result) {
+    std::vector<double> sorted = result.seconds;
+    std::sort(sorted.begin(), sorted.end());
+    const double best = sorted.empty() ? 0.0 : sorted.front();
+    const double median = sorted.empty() ? 0.0 : sorted[sorted.size() / 2];
+    std::cout << "  " << std::left << std::setw(20) << result.name << std::right << std::setw(10) << result.items << ' '
+              << std::left << std::setw(6) << result.unit << std::right << std::fixed << std::setprecision(3)
+              << "  best " << std::setw(9) << best * 1e3 << " ms  median " << std::setw(9) << median * 1e3 << " ms  "
+              << std::setprecision(1) << std::setw(8) << (result.items ? best * 1e9 / static_cast<double>(result.items) : 0.0)
+              << " ns/" << result.unit << "\n";
+    std::cout.unsetf(std::ios::floatfield);
+    record(result);
+}
+
+void Bench::record(const Result& result) {
+    g_results.push_back(result);
+}
+
+double Bench::best(const std::vector<double>& seconds) {
+    return seconds.empty() ? 0.0 : *std::min_element(seconds.begin(), seconds.end());
+}
+
+void Bench::metric(const std::string& bench, const std::string& name, double value, const std::string& unit) {
+    g_metrics.push_back(Metric{ bench, name, value, unit });
+}
+
+std::vector<std::string> Bench::listFiles(const std::string& dir, const std::vector<std::string>& exts) {
+    namespace fs = std::filesystem;
+    std::vector<std::string> out;
+    if (!fs::exists(dir)) return out;
+    for (auto& entry : fs::directory_iterator(dir)) {
+        if (!entry.is_regular_file()) continue;
+        std::string ext = entry.path().extension().string();
+        if (std::find(exts.begin(), exts.end(), ext) != exts.end()) out.push_back(entry.path().string());
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+std::vector<std::vector<int>> Bench::loadMelodies(const std::string& dataRoot) {
+    Parser parser;
+    std::vector<std::vector<int>> out;
+    for (const auto& f : listFiles(dataRoot + "/melodies", { ".txt" })) {
+        auto seq = parser.parseMelodyTxt(f);
+        if (!seq.empty()) out.push_back(std::move(seq));
+    }
+    return out;
+}
+
+std::vector<std::vector<double>> Bench::loadDurations(const std::string& dataRoot) {
+    Parser parser;
+    std::vector<std::vector<double>> out;
+    for (const auto& f : listFiles(dataRoot + "/durations", { ".txt" })) {
+        auto seq = parser.parseDurationTxt(f);
+        if (!seq.empty()) out.push_back(std::move(seq));
+    }
+    return out;
+}
+
+void Bench::consume(size_t v) {
+    g_sink.fetch_add(v, std::memory_order_relaxed);
+}
+
+int main(int argc, char** argv) {
+    BenchOptions opt;
+    std::vector<std::string> selected;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a == "--data" && i + 1 < argc) {
+            opt.dataRoot = argv[++i];
+        } else if (a == "--repeats" && i + 1 < argc) {
+            opt.repeats = std::max(1, std::atoi(argv[++i]));
+        } else if (a == "--notes" && i + 1 < argc) {
+            opt.syntheticNotes = static_cast<size_t>(std::max(1000.0, std::atof(argv[++i])));
+        } else if (a == "--json" && i + 1 < argc) {
+            opt.jsonPath = argv[++i];
+        } else if (a == "--list") {
+            for (const auto& b : kBenches) std::cout << b.name << "\n";
+            return 0;
+        } else {
+            selected.push_back(a);
+        }
+    }
+
+    for (const auto& b : kBenches) {
+        if (!selected.empty() && std::find(selected.begin(), selected.end(), b.name) == selected.end()) continue;
+        std::cout << "== " << b.name << " ==\n";
+        auto t0 = Bench::clock::now();
+        b.run(opt);
+        // Wall time of the whole bench, so every bench shows up in the JSON.
+        g_results.push_back(Bench::Result{ b.name, "total", 1, "run", { Bench::secondsSince(t0) } });
+        std::cout << "\n";
+    }
+    if (!opt.jsonPath.empty()) {
+        if (!writeJson(opt.jsonPath, opt)) return 1;
+        std::cout << "Wrote " << g_results.size() << " results and " << g_metrics.size() << " metrics -> " << opt.jsonPath << "\n";
+    }
+    return 0;
+}
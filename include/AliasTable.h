@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Walker/Vose alias method: O(n) construction, O(1) draws from a discrete
+// distribution. Tables for many distributions can live back to back in one
+// pair of arrays; callers pass the slice for each.
+namespace AliasTable {
+
+    // Fills threshold[0..n) and alias[0..n) for the (unnormalized, positive)
+    // weights, which are used as scratch and overwritten. `small`/`large` are
+    // scratch buffers reused across calls. If the weights sum to infinity the
+    // table always draws the first largest one.
+    void build(double* weights, uint32_t n, uint32_t* threshold, uint32_t* alias,
+               std::vector<uint32_t>& small, std::vector<uint32_t>& large);
+
+    // Picks an index in [0, n) from 64 random bits: the high half chooses the
+    // column, the low half is compared against its threshold.
+    inline uint32_t draw(const uint32_t* threshold, const uint32_t* alias, uint32_t n, uint64_t bits) {
+        uint32_t column = static_cast<uint32_t>(((bits >> 32) * n) >> 32);
+        return static_cast<uint32_t>(bits) < threshold[column] ? column : alias[column];
+    }
+}
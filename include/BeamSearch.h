@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "MarkovModel.h"
+#include "MelodyStream.h"
+#include "PitchMask.h"
+#include "RhythmModel.h"
+
+// Deterministic decoding: the melody with the highest log-likelihood under
+// the melody and rhythm models that satisfies a request's constraints, found
+// by keeping the `width` best partial melodies after every note.
+//
+// Pitches are masked to allowedPitches(request) and renormalized over the
+// allowed successors of the longest context that has any. With
+// request.targetDuration > 0, melodies end exactly at that time (durations
+// add up in grid steps) within request.length notes; otherwise they are
+// request.length notes long. With request.endPitch >= 0 the last note is
+// that pitch.
+//
+// Partial melodies live in arenas owned by the BeamSearch: every kept note
+// is one node pointing at its predecessor, so extending a beam copies
+// nothing and histories are read by walking back a few nodes. The arenas
+// keep their capacity, so repeated searches of similar size do not allocate.
+// A BeamSearch is not thread-safe; the models it reads are shared.
+class BeamSearch {
+public:
+    BeamSearch(const MarkovModel& melodyModel, const RhythmModel& rhythmModel, int melodyOrder = 2, int historyMax = 8);
+
+    // Writes the best melody to `out`. Returns false, leaving `out` empty,
+    // if no melody meets the constraints within the beam.
+    bool search(const MelodyRequest& request, int width, std::vector<NoteEvent>& out);
+
+    // Natural-log likelihood of the last result.
+    double logLikelihood() const { return logLikelihood_; }
+    // Partial melodies expanded by the last search.
+    uint64_t expanded() const { return expanded_; }
+    size_t arenaBytes() const;
+
+private:
+    struct Node {
+        uint32_t parent;
+        int16_t pitch;
+        uint8_t durationToken;
+        uint32_t steps;     // grid steps from the start to the end of this note
+        double logp;
+    };
+    struct Option {
+        int token;          // pitch or duration token
+        double logp;
+        bool endOnly;       // only from a shorter context, so only as the last note
+    };
+
+    // Best first; ties are broken on the rest of the node so the order, and
+    // so the result, is the same under any standard library.
+    static bool better(const Node& a, const Node& b);
+    // Fills pitchOptions_ and durationOptions_ for extending `node`.
+    void expandOptions(uint32_t node, const PitchMask& mask, int endPitch);
+
+    const MarkovModel& melodyModel_;
+    const RhythmModel& rhythmModel_;
+    int melodyOrder_;
+    int historyMax_;
+    double logLikelihood_ = 0.0;
+    uint64_t expanded_ = 0;
+
+    std::vector<Node> nodes_;           // every kept note of this search; [0] is the start pitch
+    std::vector<Node> candidates_;      // extensions of the current beams
+    std::vector<uint32_t> frontier_;
+    std::vector<Option> pitchOptions_;
+    std::vector<Option> durationOptions_;
+};
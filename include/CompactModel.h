@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "NGramTable.h"
+#include "PitchMask.h"
+#include "Rng.h"
+
+class MarkovModel;
+
+// How CompactModel::build() trims a MarkovModel. With a budget, minCount and
+// minHistoryCount are ignored and chosen by build() instead.
+struct CompactionOptions {
+    uint32_t minCount = 1;          // successors seen fewer times are dropped
+    uint32_t minHistoryCount = 1;   // histories seen fewer times are dropped
+    uint32_t topK = 0;              // most frequent successors kept per history; 0 keeps all
+    int countBits = 8;              // 8 or 16 bits per stored count
+    size_t budgetBytes = 0;         // memoryBytes() to stay under; 0 for no limit
+};
+
+// Read-only, memory-bounded copy of a MarkovModel for serving. Rare
+// successors and histories are pruned, each row keeps at most its top K
+// successors, and counts are stored as 8- or 16-bit log-scale codes (exact
+// while they fit the code range). Histories are one sorted array of packed
+// keys and successors are 16-bit token ids, so an entry costs 3 or 4 bytes
+// against about 12 in the trainable tables. Unigrams are kept exact, and
+// lookups back off exactly as MarkovModel's do.
+//
+// Any number of threads may sample concurrently, each with its own stream.
+class CompactModel {
+public:
+    using Options = CompactionOptions;
+
+    CompactModel() = default;
+
+    // Replaces the contents with a compaction of `model`, which must have at
+    // most 65535 distinct tokens. Returns false if the options are invalid
+    // or the budget cannot be met even with every history pruned; in the
+    // latter case only the unigrams are kept.
+    bool build(const MarkovModel& model, const Options& options = Options());
+
+    int sampleNext(const int* history, size_t length, double temperature, Rng& rng) const;
+    // Constrained draw over the tokens in `mask`, backing off past contexts
+    // with no allowed successor; see MarkovModel::sampleMasked.
+    bool sampleMasked(const int* history, size_t length, double temperature, const PitchMask& mask, Rng& rng, int& out) const;
+    // Probability of `token` after `history`: the longest known context's
+    // counts, Witten-Bell interpolated with an add-one unigram estimate so
+    // unseen tokens keep some mass. perplexity() scores sequences with it.
+    double probability(const int* history, size_t length, int token) const;
+    double perplexity(const std::vector<std::vector<int>>& sequences) const;
+    // The same score for the uncompacted model, for comparison.
+    static double perplexity(const MarkovModel& model, const std::vector<std::vector<int>>& sequences);
+
+    int order() const { return order_; }
+    bool empty() const { return unigrams_.empty(); }
+    // The thresholds in effect, as chosen under a budget.
+    uint32_t minCount() const { return minCount_; }
+    uint32_t minHistoryCount() const { return minHistoryCount_; }
+    uint32_t topK() const { return topK_; }
+    int countBits() const { return countBits_; }
+    size_t historyCount() const { return keys_.size(); }
+    size_t entryCount() const { return ids_.size(); }
+    size_t memoryBytes() const;
+
+private:
+    struct Row {
+        const uint16_t* ids = nullptr;
+        size_t first = 0;       // position in the code array
+        uint32_t size = 0;
+    };
+
+    uint32_t idOf(int token) const;
+    uint32_t countAt(size_t entry) const;
+    // Longest stored suffix of `history`, skipping those with no successor in
+    // `mask` when one is given; size 0 means back off to unigrams.
+    Row find(const int* history, size_t length, const PitchMask* mask = nullptr) const;
+    uint64_t unigramCount(int token) const;
+
+    int order_ = 1;
+    int bitsPerToken_ = 32;
+    uint32_t maxPackedId_ = 0;
+    uint32_t minCount_ = 1;
+    uint32_t minHistoryCount_ = 1;
+    uint32_t topK_ = 0;
+    int countBits_ = 8;
+    // MarkovModel's token ids, so keys pack identically.
+    std::vector<uint32_t> denseIds_;
+    std::vector<std::pair<int32_t, uint32_t>> sparseIds_;
+    std::vector<int32_t> tokens_;               // id - 1 -> token
+    std::vector<uint64_t> keys_;                // sorted
+    std::vector<uint32_t> rowStart_;            // keys_.size() + 1 offsets into ids_
+    std::vector<uint16_t> ids_;                 // successor ids, sorted within a row
+    std::vector<uint8_t> codes_;                // countBits_ / 8 bytes per entry
+    std::vector<uint32_t> levels_;              // 8-bit code -> count
+    std::vector<NGramTable::Entry> unigrams_;   // sorted by token
+    uint64_t unigramTotal_ = 0;
+};
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "NGramTable.h"
+#include "PitchMask.h"
+#include "Rng.h"
+#include "Span.h"
+
+// Variable-order Markov model stored as a context tree: node = context, its
+// children = that context extended one token further into the past. Children
+// of a node sit contiguously, sorted by token, and contexts share their
+// common suffixes, so an order-16 model costs little more than its distinct
+// contexts. The longest known context is found in one root-to-leaf walk of at
+// most `maxOrder` binary searches, with no hashing and no per-length probes.
+//
+// Contexts seen fewer than `minCount` times are pruned along with everything
+// below them; the root (the unigram distribution) always stays. The tree is
+// built in one batch and read-only afterwards, so any number of threads may
+// sample from it, each with its own stream.
+class ContextTree {
+public:
+    static constexpr int kMaxOrder = 32;
+    // Root children with tokens below this are found by direct index.
+    static constexpr int32_t kRootIndexLimit = 4096;
+
+    explicit ContextTree(int maxOrder = 16, uint32_t minCount = 2);
+
+    // Replaces the tree with one counted from `sequences`.
+    void build(const std::vector<std::vector<int>>& sequences);
+    void build(const std::vector<Span<const uint8_t>>& sequences);
+
+    // Successors of the longest context of `history` (newest token last) in
+    // the tree; `depth`, if given, receives that context's length.
+    NGramTable::Row lookup(const int* history, size_t length, size_t* depth = nullptr) const;
+    int sampleNext(const int* history, size_t length, double temperature, Rng& rng) const;
+    // Constrained draw over the tokens in `mask`, from the longest context
+    // with an allowed successor; see MarkovModel::sampleMasked.
+    bool sampleMasked(const int* history, size_t length, double temperature, const PitchMask& mask, Rng& rng, int& out) const;
+
+    int maxOrder() const { return maxOrder_; }
+    uint32_t minCount() const { return minCount_; }
+    bool empty() const { return nodes_.size() <= 1 && entries_.empty(); }
+    size_t nodeCount() const { return nodes_.size(); }
+    size_t entryCount() const { return entries_.size(); }
+    size_t memoryBytes() const;
+
+private:
+    struct Node {
+        uint32_t firstChild;
+        uint32_t childCount;
+        uint32_t firstEntry;    // successor counts, sorted by token
+        uint32_t entryCount;
+    };
+
+    template <class Seq>
+    void buildFrom(const std::vector<Seq>& sequences);
+    NGramTable::Row row(const Node& n) const;
+
+    int maxOrder_;
+    uint32_t minCount_;
+    std::vector<Node> nodes_;                   // breadth-first; nodes_[0] is the root
+    std::vector<int32_t> tokens_;               // per node, the token it adds to its parent's context
+    std::vector<uint32_t> rootChild_;           // root child by token for small tokens, 0 if none
+    std::vector<NGramTable::Entry> entries_;
+    std::vector<uint32_t> cumulative_;          // inclusive prefix sums per row
+};
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+#include "MidiParser.h"
+#include "Span.h"
+
+// Packed training corpus: one file holding every sequence's pitches (uint8)
+// and durations (float64 seconds) behind an index, replacing the per-file
+// melody/duration text. Readers map it and hand out spans into the mapping.
+// Durations stay double because tempo maps put many of them exactly on the
+// rhythm model's rounding boundaries, where float32 would change the token.
+//
+// Layout (native-endian, sections 64-byte aligned):
+//   Header | SequenceEntry[sequenceCount] | names | pitches | durations
+class CorpusFile {
+public:
+    static constexpr uint32_t kVersion = 2;
+
+    struct Sequence {
+        std::string name;
+        std::vector<uint8_t> pitches;
+        std::vector<double> durations;
+    };
+
+    // Converts parsed notes into a corpus sequence; pitches are clamped to 0..127.
+    static Sequence fromNotes(const std::string& name, const std::vector<NoteEvent>& notes);
+    static Sequence fromNotes(const std::string& name, const NoteStore& notes);
+    static bool write(const std::string& path, const std::vector<Sequence>& sequences);
+
+    bool open(const std::string& path, bool verifyChecksum = true);
+    void close();
+    bool isOpen() const { return file_.isOpen(); }
+
+    size_t size() const { return count_; }
+    size_t totalNotes() const { return totalNotes_; }
+    std::string name(size_t i) const;
+    Span<const uint8_t> pitches(size_t i) const;
+    Span<const double> durations(size_t i) const;
+
+    // All sequences at once, for the trainMany overloads.
+    std::vector<Span<const uint8_t>> allPitches() const;
+    std::vector<Span<const double>> allDurations() const;
+
+private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint64_t fileSize;
+        uint64_t checksum;      // over the whole file, this field read as 0
+        uint64_t sequenceCount;
+        uint64_t totalNotes;
+        uint64_t namesOffset;
+        uint64_t pitchesOffset;
+        uint64_t durationsOffset;
+        uint64_t reserved;
+    };
+
+    struct SequenceEntry {
+        uint64_t firstNote;
+        uint32_t noteCount;
+        uint32_t nameOffset;
+        uint32_t nameLength;
+        uint32_t reserved;
+    };
+
+    MappedFile file_;
+    const SequenceEntry* index_ = nullptr;
+    const char* names_ = nullptr;
+    const uint8_t* pitches_ = nullptr;
+    const double* durations_ = nullptr;
+    size_t count_ = 0;
+    size_t totalNotes_ = 0;
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "CorpusFile.h"
+#include "MelodyExtractor.h"
+#include "MidiParser.h"
+#include "Scale.h"
+#include "ThreadPool.h"
+
+struct IngestedFile {
+    std::string path;
+    // Name of the exported text files (<name>.txt, <name>_dur.txt): the stem,
+    // unless another MIDI file shares it (see CorpusIngest::outputNames).
+    std::string name;
+    uintmax_t bytes = 0;
+    size_t notes = 0;
+    int transposition = 0;  // semitones the melody was moved by
+};
+
+struct IngestResult {
+    // One entry per input path, in the order the paths were given, regardless
+    // of which worker handled them or when they finished.
+    std::vector<IngestedFile> files;
+    // Parallel to `files`: the packed training sequence for each file, named
+    // by its path so it matches the file's manifest entry.
+    std::vector<CorpusFile::Sequence> sequences;
+    size_t totalNotes = 0;
+    uintmax_t totalBytes = 0;
+    double seconds = 0.0;
+};
+
+struct IngestOptions {
+    // Also write the per-file melody/duration text.
+    bool exportText = false;
+    // Notes kept by the parser; by default the drum channel and bass parts go.
+    NoteFilter filter = NoteFilter::melodic();
+    // How the kept notes are reduced to one training line.
+    MelodyMode melody = MelodyMode::Skyline;
+    // Each melody is transposed by the shift that fits most of its notes into
+    // this scale, so the models learn one key; chromatic leaves them alone.
+    Scale transposeTo;
+};
+
+// Phase A: parses MIDI files into corpus sequences, spreading files across a
+// ThreadPool.
+class CorpusIngest {
+public:
+    CorpusIngest(std::string melodyFolder, std::string durationFolder, IngestOptions options = IngestOptions());
+
+    // One-line description of everything in the options that shapes the
+    // corpus, for the manifest.
+    std::string settings() const;
+
+    // Sorted paths of the .mid/.midi files directly inside `folder`.
+    static std::vector<std::string> listMidiFiles(const std::string& folder);
+
+    IngestResult run(const std::vector<std::string>& midiPaths, ThreadPool& pool) const;
+
+private:
+    // One text output name per path. A file whose stem another MIDI file
+    // shares (x.mid beside x.midi, or in the same batch from another folder)
+    // is named by its file name instead, then by folder and file name; if
+    // even that repeats, later files get an empty name and are not exported.
+    static std::vector<std::string> outputNames(const std::vector<std::string>& midiPaths);
+
+    std::string melodyFolder_;
+    std::string durationFolder_;
+    IngestOptions options_;
+};
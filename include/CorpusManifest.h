@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct ManifestEntry {
+    std::string path;
+    uint64_t hash = 0;      // Utils::checksum64 of the file contents
+    uintmax_t bytes = 0;
+    int64_t mtime = 0;      // last_write_time ticks; only a hint to skip hashing
+};
+
+// Record of the MIDI files already counted into the compiled model, keyed by
+// path and content hash, so a run only parses and trains what changed.
+// Stored as text: a version line, an "# ingest <settings>" line, then
+// "hash bytes mtime path" per file.
+class CorpusManifest {
+public:
+    struct Delta {
+        std::vector<ManifestEntry> added;    // paths the manifest does not know
+        std::vector<ManifestEntry> changed;  // new state of paths whose contents differ
+        std::vector<ManifestEntry> removed;  // manifest entries whose file is gone
+        std::vector<ManifestEntry> touched;  // same contents, new size/mtime stamp
+        bool empty() const { return added.empty() && changed.empty() && removed.empty(); }
+    };
+
+    bool load(const std::string& path);
+    bool save(const std::string& path) const;
+
+    // Compares `paths` on disk with the manifest. Files whose size and mtime
+    // match their entry are trusted without being read; the rest are hashed.
+    Delta diff(const std::vector<std::string>& paths) const;
+    void apply(const Delta& delta);
+
+    // How the corpus was parsed (CorpusIngest::settings()); a corpus built with
+    // other settings cannot be updated incrementally.
+    const std::string& ingest() const { return ingest_; }
+    void setIngest(const std::string& settings) { ingest_ = settings; }
+
+    const std::vector<ManifestEntry>& entries() const { return entries_; }
+    size_t size() const { return entries_.size(); }
+
+    // Stats and hashes one file.
+    static bool describe(const std::string& path, ManifestEntry& out);
+
+private:
+    const ManifestEntry* find(const std::string& path) const;
+
+    std::vector<ManifestEntry> entries_;   // sorted by path
+    std::string ingest_;
+};
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Contiguous array that either owns its elements or views memory owned by
+// someone else (a mapped model file). Readers never care which; the first
+// mutable access to a view copies it into owned storage.
+template <class T>
+class FlatArray {
+public:
+    FlatArray() = default;
+    FlatArray(const FlatArray& other) { *this = other; }
+    FlatArray& operator=(const FlatArray& other) {
+        if (this != &other) {
+            owned_ = other.owned_;
+            view_ = other.view_;
+            viewSize_ = other.viewSize_;
+        }
+        return *this;
+    }
+    FlatArray(FlatArray&&) = default;
+    FlatArray& operator=(FlatArray&&) = default;
+
+    const T* data() const { return view_ ? view_ : owned_.data(); }
+    size_t size() const { return view_ ? viewSize_ : owned_.size(); }
+    bool empty() const { return size() == 0; }
+    const T& operator[](size_t i) const { return data()[i]; }
+    const T* begin() const { return data(); }
+    const T* end() const { return data() + size(); }
+
+    bool isView() const { return view_ != nullptr; }
+    void attach(const T* data, size_t n) {
+        owned_.clear();
+        owned_.shrink_to_fit();
+        view_ = data;
+        viewSize_ = n;
+        if (!view_) viewSize_ = 0;
+    }
+
+    // Owned storage, copied out of the view first if necessary.
+    std::vector<T>& mut() {
+        if (view_) {
+            owned_.assign(view_, view_ + viewSize_);
+            view_ = nullptr;
+            viewSize_ = 0;
+        }
+        return owned_;
+    }
+
+    // Heap bytes owned by this array (0 for a view).
+    size_t ownedBytes() const { return owned_.capacity() * sizeof(T); }
+
+private:
+    std::vector<T> owned_;
+    const T* view_ = nullptr;
+    size_t viewSize_ = 0;
+};
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "MarkovModel.h"
+#include "PitchMask.h"
+#include "Rng.h"
+#include "Span.h"
+
+class ThreadPool;
+
+// Melody model over the steps between pitches instead of the pitches
+// themselves, so a motif played in any key counts towards the same histories
+// and rows. Each step is one token, interval + kOffset, in 0..127; leaps
+// beyond -64..+63 semitones are folded by octaves, so tokens stay in the
+// range a PitchMask covers and MarkovModel maps them through its flat array.
+//
+// Callers pass absolute pitches both ways: sampling reads the last order() + 1
+// pitches of the history and returns the next absolute pitch, which may fall
+// outside 0..127 when sampling without a mask.
+class IntervalModel {
+public:
+    static constexpr int kOffset = 64;
+
+    explicit IntervalModel(int order = 2) : markov_(order) {}
+
+    static int token(int from, int to) {
+        int step = to - from;
+        while (step >= kOffset) step -= 12;
+        while (step < -kOffset) step += 12;
+        return step + kOffset;
+    }
+
+    void trainMany(const std::vector<Span<const uint8_t>>& pitches, ThreadPool& pool);
+    void trainMany(const std::vector<std::vector<int>>& pitches);
+
+    // `pitches` must hold at least the current pitch; with nothing else the
+    // step comes from the interval unigrams.
+    int sampleNext(const int* pitches, size_t length, double temperature, Rng& rng) const;
+    // Constrained draw over the pitches in `allowed`, which map to a shifted
+    // mask of interval tokens; see MarkovModel::sampleMasked.
+    bool sampleMasked(const int* pitches, size_t length, double temperature, const PitchMask& allowed, Rng& rng, int& out) const;
+
+    // Share of the transitions in `pitches` whose full order() history of
+    // steps was seen in training followed by the same step. Only notes with
+    // order() + 1 predecessors count, so coverage() of an absolute-pitch
+    // model of the same order scores the same positions.
+    double coverage(const std::vector<std::vector<int>>& pitches) const;
+    // The same measure for an absolute-pitch model.
+    static double coverage(const MarkovModel& model, const std::vector<std::vector<int>>& pitches);
+
+    int order() const { return markov_.order(); }
+    bool trained() const { return markov_.transitionCount() > 0; }
+    size_t vocabularySize() const { return markov_.vocabularySize(); }
+    size_t historyCount() const { return markov_.historyCount(); }
+    size_t transitionCount() const { return markov_.transitionCount(); }
+    size_t memoryBytes() const { return markov_.memoryBytes(); }
+    void freeze(double temperature = 1.0) { markov_.freeze(temperature); }
+    size_t frozenMemoryBytes() const { return markov_.frozenMemoryBytes(); }
+
+private:
+    template <class PitchSeq>
+    static void tokenize(const PitchSeq& pitches, std::vector<int>& out);
+    // Steps between the newest order() + 1 pitches into steps[]; returns how many.
+    size_t steps(const int* pitches, size_t length, int* steps) const;
+
+    MarkovModel markov_;
+};
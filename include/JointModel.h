@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "MarkovModel.h"
+#include "RhythmQuantizer.h"
+#include "Span.h"
+
+class ThreadPool;
+
+// Markov model over notes rather than over pitches and durations apart: each
+// token packs (pitch, duration token) as pitch * kTokenCount + duration token,
+// at most 1280 values, which MarkovModel maps to dense ids through its flat
+// array. One lookup and one draw give both halves of the next note, and
+// rhythm can depend on melody and vice versa.
+//
+// The joint table is much sparser than the factored ones, so sampleNext()
+// only answers from a fully seen history; otherwise the caller falls back to
+// the separate melody and rhythm models (see MelodyStream).
+class JointModel {
+public:
+    explicit JointModel(int order = 2) : markov_(order) {}
+
+    static int pack(int pitch, int durationToken) { return pitch * RhythmQuantizer::kTokenCount + durationToken; }
+    static int pitchOf(int token) { return token / RhythmQuantizer::kTokenCount; }
+    static int durationTokenOf(int token) { return token % RhythmQuantizer::kTokenCount; }
+
+    // Pitch and duration sequences pair up index by index; the pair is
+    // truncated to the shorter of the two. Durations are tokenized with
+    // `quantizer`, which must have its grid and is kept for decoding.
+    void trainMany(const std::vector<Span<const uint8_t>>& pitches, const std::vector<Span<const double>>& durations,
+                   const RhythmQuantizer& quantizer, ThreadPool& pool);
+    void trainMany(const std::vector<std::vector<int>>& pitches, const std::vector<std::vector<double>>& durations,
+                   const RhythmQuantizer& quantizer);
+
+    // The token for a note, with its duration quantized as in training.
+    int token(int pitch, double duration) const { return pack(pitch, quantizer_.token(duration)); }
+    double duration(int token) const { return quantizer_.duration(durationTokenOf(token)); }
+
+    // Draws the next note token if the last order() tokens of `history` were
+    // seen in training; returns false, without advancing `rng`, otherwise.
+    bool sampleNext(const int* history, size_t length, double temperature, Rng& rng, int& out) const;
+
+    int order() const { return markov_.order(); }
+    bool trained() const { return quantizer_.hasGrid() && markov_.transitionCount() > 0; }
+    size_t vocabularySize() const { return markov_.vocabularySize(); }
+    size_t transitionCount() const { return markov_.transitionCount(); }
+    size_t memoryBytes() const { return markov_.memoryBytes(); }
+    void freeze(double temperature = 1.0) { markov_.freeze(temperature); }
+    size_t frozenMemoryBytes() const { return markov_.frozenMemoryBytes(); }
+
+private:
+    template <class PitchSeq, class DurationSeq>
+    static void tokenize(const PitchSeq& pitches, const DurationSeq& durations, const RhythmQuantizer& quantizer, std::vector<int>& out);
+
+    MarkovModel markov_;
+    RhythmQuantizer quantizer_;
+};
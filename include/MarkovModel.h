@@ -1,30 +1,149 @@
 #pragma once
 #include <vector>
 #include <unordered_map>
-#include <random>
+#include <cstdint>
+#include <memory>
+#include "FlatArray.h"
+#include "MappedFile.h"
+#include "NGramTable.h"
+#include "PitchMask.h"
+#include "Rng.h"
+#include "Span.h"
+
+class ThreadPool;
 
 class MarkovModel {
 public:
+    // Longest supported history; histories are packed into one 64-bit key.
+    static constexpr int kMaxOrder = 8;
+
     explicit MarkovModel(int order = 2);
     void train(const std::vector<int>& sequence);
+    void train(Span<const int> sequence);
+    // Pitch sequences straight out of a mapped CorpusFile.
+    void train(Span<const uint8_t> sequence);
     void trainMany(const std::vector<std::vector<int>>& sequences);
-    int sampleNext(const std::vector<int>& history, double temperature = 1.0) const;
+    void trainMany(const std::vector<Span<const uint8_t>>& sequences);
+    // Sharded training: each thread counts a contiguous shard of sequences
+    // into its own table and the tables are merged pairwise. The resulting
+    // counts and token ids are identical to the serial overloads.
+    void trainMany(const std::vector<std::vector<int>>& sequences, ThreadPool& pool);
+    void trainMany(const std::vector<Span<const uint8_t>>& sequences, ThreadPool& pool);
+    // Removes one previously trained sequence's counts, leaving the model as
+    // if it had never seen it. Returns false if some count was missing (the
+    // sequence was not trained); the counts that were present are removed.
+    bool untrain(const std::vector<int>& sequence);
+    bool untrain(Span<const int> sequence);
+    bool untrain(Span<const uint8_t> sequence);
+    // Repacks the tables and rebuilds the prefix sums that sampling uses.
+    // trainMany() does this itself; call it after a batch of train()/untrain().
+    void compact();
+    int sampleNext(const std::vector<int>& history, double temperature, Rng& rng) const;
+    // Allocation-free form; `history` is read, never copied. The model holds
+    // no random state, so any number of threads may sample concurrently,
+    // each with its own stream.
+    int sampleNext(const int* history, size_t length, double temperature, Rng& rng) const;
+    // Draws only from a seen history of at least `minLength` (>= 1) of the
+    // newest tokens, never from shorter ones or the unigrams. Returns false,
+    // leaving `out` and `rng` untouched, if there is none.
+    bool sampleSeen(const int* history, size_t length, size_t minLength, double temperature, Rng& rng, int& out) const;
+    // Constrained draw: only tokens in `mask` are candidates, weighted as
+    // sampleNext would weight them, from the longest seen suffix of `history`
+    // that has any. Returns false, leaving `out` and `rng` untouched, if not
+    // even the unigrams do.
+    bool sampleMasked(const int* history, size_t length, double temperature, const PitchMask& mask, Rng& rng, int& out) const;
+    // Successor counts of the longest seen suffix of at least `minLength`
+    // (>= 1) of the newest tokens; empty if there is none.
+    NGramTable::Row lookupSeen(const int* history, size_t length, size_t minLength) const;
     std::unordered_map<int, uint32_t> getCountsForHistory(const std::vector<int>& history) const;
+    // Successor counts for the longest known suffix of `history` (falling back
+    // to unigrams), borrowed from the model; invalidated by further training.
+    NGramTable::Row lookup(const int* history, size_t length) const;
+    // As lookup(), skipping suffixes whose successors are all outside `mask`;
+    // the unigrams, masked or not, are the last resort.
+    NGramTable::Row lookupMasked(const int* history, size_t length, const PitchMask& mask) const;
     size_t vocabularySize() const;
+    int order() const { return order_; }
+    size_t transitionCount() const { return transitions_.entryCount(); }
+    size_t historyCount() const { return transitions_.historyCount(); }
+    // Sum of all history -> token counts.
+    uint64_t observationCount() const;
+    // Heap bytes owned by the model; tables viewed from a mapped file count 0.
+    size_t memoryBytes() const;
+
+    // Builds a Walker/Vose alias table for every history at `temperature`, so
+    // sampleNext draws in O(1) instead of scanning the row. Draws at any other
+    // temperature keep scanning; training drops the tables and they are
+    // rebuilt on the next draw.
+    void freeze(double temperature = 1.0);
+    void thaw();
+    bool isFrozen() const { return frozen_; }
+    // Extra memory held by the alias tables (0 until built).
+    size_t frozenMemoryBytes() const;
 
 private:
-    int order_;
-    struct VecHash {
-        size_t operator()(const std::vector<int>& v) const noexcept {
-            size_t h = 1469598103934665603ULL;
-            for (int x : v) {
-                h ^= static_cast<size_t>(x) + 0x9e3779b97f4a7c15ULL + (h<<6) + (h>>2);
-            }
-            return h;
-        }
+    friend class ModelFile;
+    friend class CompactModel;
+
+    struct TokenId {
+        int32_t token;
+        uint32_t id;
     };
-    std::unordered_map<std::vector<int>, std::unordered_map<int, uint32_t>, VecHash> transitions_;
-    std::unordered_map<int, uint32_t> unigramCounts_;
-    mutable std::mt19937 rng_;
-    std::unordered_map<int, uint32_t> findWithBackoff(const std::vector<int>& history) const;
+
+    struct FrozenTables {
+        double temperature = 1.0;
+        // Parallel to the transition pool; row slices line up with the rows.
+        std::vector<uint32_t> threshold;
+        std::vector<uint32_t> alias;
+        std::vector<uint32_t> unigramThreshold;
+        std::vector<uint32_t> unigramAlias;
+    };
+
+    int order_;
+    // Dense ids (1-based) are packed bitsPerToken_ bits apiece, most recent
+    // token in the low bits; id 0 never occurs, so histories of different
+    // lengths never share a key.
+    int bitsPerToken_;
+    uint32_t maxPackedId_;
+    // Small non-negative tokens (pitches, most duration tokens) map through a
+    // flat array; anything else is binary-searched in a sorted side table.
+    static constexpr int kDenseTokens = 4096;
+    FlatArray<uint32_t> denseIds_;
+    FlatArray<TokenId> sparseIds_;
+    uint32_t vocabIds_ = 0;
+    NGramTable transitions_;
+    FlatArray<NGramTable::Entry> unigramCounts_;
+    FlatArray<uint32_t> unigramCumulative_;
+    // Keeps a mapped model file alive while the arrays above view it.
+    std::shared_ptr<const MappedFile> backing_;
+    bool frozen_ = false;
+    double frozenTemperature_ = 1.0;
+    // Swapped atomically so a lazy rebuild never invalidates a concurrent draw.
+    mutable std::shared_ptr<const FrozenTables> frozenTables_;
+    std::shared_ptr<const FrozenTables> buildFrozen(double temperature) const;
+    int drawFrozen(const FrozenTables& tables, const NGramTable::Row& counts, Rng& rng) const;
+    uint32_t idForTraining(int token);
+    template <class T>
+    void trainSequence(const T* sequence, size_t length);
+    template <class Seq>
+    void trainParallel(const std::vector<Seq>& sequences, ThreadPool& pool);
+    // Drops derived state (unigram prefix sums, alias tables) before counting.
+    void beginTraining();
+    template <class T>
+    bool untrainSequence(const T* sequence, size_t length);
+    // Walks one sequence, passing each token to `onToken` and each (history
+    // key, token) pair to `onTransition`. Tokens must already have ids, so
+    // this only reads the model and may run on many threads.
+    template <class T, class OnToken, class OnTransition>
+    void countSequence(const T* sequence, size_t length, OnToken&& onToken, OnTransition&& onTransition) const;
+    static void addUnigram(std::vector<NGramTable::Entry>& unigrams, int token);
+    uint32_t idOf(int token) const;
+    // Packed keys of the newest 1..n tokens of `history` into keys[0, n);
+    // returns n, which stops at the first token with no usable id.
+    size_t historyKeys(const int* history, size_t length, uint64_t* keys) const;
+    NGramTable::Row unigramRow() const;
+    // Longest seen suffix of `history`; with minLength > 0, an empty row
+    // rather than anything shorter than minLength or the unigrams.
+    NGramTable::Row findWithBackoff(const int* history, size_t length, size_t minLength = 0) const;
+    int draw(const NGramTable::Row& counts, double temperature, Rng& rng) const;
 };
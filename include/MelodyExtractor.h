@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MidiParser.h"
+
+class NoteStore;
+
+// How the training melody is pulled out of a polyphonic file.
+enum class MelodyMode {
+    All,        // every note, in parser order (chords flattened as they come)
+    Skyline,    // the highest note at each onset, unless a higher note still sounds
+    Track,      // the (track, channel) part that looks most like a melody, then skyline
+    Voice,      // sweep-line voice separation; the highest sustained voice
+};
+
+// Reduces parsed notes to one monophonic line before training, so chords and
+// accompaniment stop feeding the Markov tables transitions nobody played. All
+// modes sort once and sweep, O(n log n). Outputs are in start order with no
+// two notes overlapping; a kept note cut short by the next one is truncated.
+// Scratch buffers are reused between calls; use one extractor per thread.
+class MelodyExtractor {
+public:
+    explicit MelodyExtractor(MelodyMode mode = MelodyMode::Skyline) : mode_(mode) {}
+
+    MelodyMode mode() const { return mode_; }
+
+    void extract(const NoteStore& notes, NoteStore& out);
+    std::vector<NoteEvent> extract(const std::vector<NoteEvent>& notes);
+
+    static const char* modeName(MelodyMode mode);
+    static bool parseMode(const std::string& name, MelodyMode& out);
+
+private:
+    // Views of the input columns the sweeps read.
+    struct Columns {
+        const uint8_t* pitch;
+        const uint8_t* channel;
+        const uint16_t* track;
+        const double* start;
+        const double* duration;
+        size_t size;
+    };
+
+    // Each fills `picked_` with (note index, kept duration) in start order.
+    void skyline(const Columns& c);
+    void track(const Columns& c);
+    void voice(const Columns& c);
+    // Skyline over order_[begin, end), which must be sorted by (start, pitch desc).
+    void skylineRange(const Columns& c, size_t begin, size_t end);
+    void sortByOnset(const Columns& c, size_t begin, size_t end);
+
+    struct Picked {
+        uint32_t index;
+        double duration;
+    };
+
+    MelodyMode mode_;
+    std::vector<uint32_t> order_;
+    std::vector<Picked> picked_;
+};
@@ -1,21 +1,53 @@
 #pragma once
+#include <cstdint>
 #include <vector>
-#include <random>
 #include "MarkovModel.h"
 #include "RhythmModel.h"
 #include "MidiParser.h"
+#include "MelodyStream.h"
+#include "Rng.h"
+
+class ThreadPool;
 
 class MelodyGenerator {
 public:
-    MelodyGenerator(MarkovModel& melodyModel, RhythmModel& rhythmModel, int melodyOrder = 2, int historyMax = 8);
+    // `seed` fixes everything generate() produces: its i-th call draws from
+    // streamFor(seed, i).
+    MelodyGenerator(const MarkovModel& melodyModel, const RhythmModel& rhythmModel, int melodyOrder = 2, int historyMax = 8,
+                    uint64_t seed = 0);
     std::vector<NoteEvent> generate(int length, int startPitch = 60, int minPitch = 0, int maxPitch = 127, double melodyTemp = 1.0, double rhythmTemp = 1.0, int startVelocity = 80, bool enforceScale = false, const std::vector<int>& allowedPitchClasses = {}) ;
+
+    // Generates every request on `pool` against the shared, read-only models.
+    // Request i draws from streamFor(baseSeed, i), so the result depends only
+    // on the arguments, never on thread count or timing.
+    std::vector<std::vector<NoteEvent>> generateBatch(const std::vector<MelodyRequest>& requests, uint64_t baseSeed, ThreadPool& pool) const;
+    // The random stream generateBatch gives request `index`.
+    static Rng streamFor(uint64_t baseSeed, uint64_t index) { return Rng(baseSeed, index); }
+    // Unbounded note-by-note generation for `request`, drawing from `rng`.
+    MelodyStream stream(const MelodyRequest& request, Rng rng) const;
+    // Draws notes from `joint` where it has seen the history (see
+    // MelodyStream); null goes back to the separate models only.
+    void setJointModel(const JointModel* joint) { jointModel_ = joint; }
+    // Draws pitches from `tree` instead of the melody MarkovModel; null goes
+    // back to the MarkovModel.
+    void setMelodyTree(const ContextTree* tree) { melodyTree_ = tree; }
+    // Draws pitches from `compact`, a compaction of the melody model, unless
+    // a tree is set; null goes back to the MarkovModel.
+    void setMelodyCompact(const CompactModel* compact) { melodyCompact_ = compact; }
+    // Draws pitches as steps from `intervals`, unless a tree or compaction
+    // is set; null goes back to the MarkovModel.
+    void setMelodyIntervals(const IntervalModel* intervals) { melodyIntervals_ = intervals; }
+
 private:
-    MarkovModel& melodyModel_;
-    RhythmModel& rhythmModel_;
+    const MarkovModel& melodyModel_;
+    const RhythmModel& rhythmModel_;
+    const JointModel* jointModel_ = nullptr;
+    const ContextTree* melodyTree_ = nullptr;
+    const CompactModel* melodyCompact_ = nullptr;
+    const IntervalModel* melodyIntervals_ = nullptr;
     int melodyOrder_;
     int historyMax_;
-    mutable std::mt19937 rng_;
-    int clampPitch(int p, int minP, int maxP) const;
-    bool pitchClassAllowed(int pitch, const std::vector<int>& allowed) const;
-    int nearestAllowedPitch(int pitch, int minP, int maxP, const std::vector<int>& allowed) const;
+    uint64_t seed_;
+    uint64_t generated_ = 0;    // generate() calls so far
+    std::vector<NoteEvent> generateWith(const MelodyRequest& request, Rng rng) const;
 };
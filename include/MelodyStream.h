@@ -0,0 +1,120 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "CompactModel.h"
+#include "ContextTree.h"
+#include "IntervalModel.h"
+#include "JointModel.h"
+#include "MarkovModel.h"
+#include "PitchMask.h"
+#include "Rng.h"
+#include "RhythmModel.h"
+#include "Scale.h"
+#include "MidiParser.h"
+
+// One melody to generate; the parameters of MelodyGenerator::generate.
+struct MelodyRequest {
+    int length = 128;
+    int startPitch = 60;
+    int minPitch = 0;
+    int maxPitch = 127;
+    double melodyTemp = 1.0;
+    double rhythmTemp = 1.0;
+    // Note-on velocity of every note, 1..127; 0 leaves it to the MIDI writer.
+    int velocity = 0;
+    bool enforceScale = false;
+    std::vector<int> allowedPitchClasses;
+    // Mask pitches outside the range (and, with enforceScale, the scale)
+    // before drawing, instead of drawing freely and moving the result.
+    bool constrained = false;
+    // Beam search only (see BeamSearch): with targetDuration > 0 the melody
+    // ends exactly that many seconds in, with at most `length` notes; with
+    // endPitch >= 0 its last note is that pitch.
+    double targetDuration = 0.0;
+    int endPitch = -1;
+};
+
+// The pitches `request` allows: its range, narrowed to its scale when it
+// enforces one.
+PitchMask allowedPitches(const MelodyRequest& request);
+
+// Pull-based generator for melodies of unbounded length: every next() samples
+// one note in constant time and memory, without allocating. The pitch and
+// duration histories live in fixed ring buffers. `request.length` is ignored;
+// the stream ends when the caller stops pulling.
+//
+// With a JointModel, each note comes from one joint draw whenever the last
+// notes form a history the joint model has seen, and from the separate
+// melody and rhythm models otherwise. With a ContextTree, pitches come from
+// the tree (up to its maximum order) instead of the melody MarkovModel; with
+// a CompactModel, from that compaction of it; with an IntervalModel, as steps
+// from the previous pitch, starting from request.startPitch.
+//
+// A constrained request draws pitches with the disallowed ones masked out,
+// from whichever pitch model is in use; a joint draw whose pitch is masked
+// falls back to it. Otherwise pitches are drawn freely and repaired: a pitch
+// outside the range (or the scale, with enforceScale) moves to the nearest
+// allowed one, one table lookup per note. The repair also catches the rare
+// constrained draw where not even the unigrams hold an allowed pitch.
+class MelodyStream {
+public:
+    // Longest history kept; no model looks further back than
+    // ContextTree::kMaxOrder.
+    static constexpr int kHistoryCapacity = ContextTree::kMaxOrder;
+
+    MelodyStream(const MarkovModel& melodyModel, const RhythmModel& rhythmModel, const MelodyRequest& request,
+                 Rng rng, int melodyOrder = 2, int historyMax = 8, const JointModel* joint = nullptr,
+                 const ContextTree* melodyTree = nullptr, const CompactModel* melodyCompact = nullptr,
+                 const IntervalModel* melodyIntervals = nullptr);
+
+    NoteEvent next();
+    // Fills out[0, n) with the next n notes.
+    void next(NoteEvent* out, size_t n);
+
+    uint64_t emitted() const { return emitted_; }
+    // Notes drawn from the joint model rather than the separate ones.
+    uint64_t jointDraws() const { return jointDraws_; }
+    const Rng& engine() const { return rng_; }
+
+private:
+    // Each value is stored twice, N apart, so the newest size() values are
+    // always contiguous and can be handed to the models as a plain array.
+    template <class T, int N>
+    class HistoryRing {
+    public:
+        void push(T v) {
+            buf_[pos_] = v;
+            buf_[pos_ + N] = v;
+            pos_ = (pos_ + 1) % N;
+            if (size_ < N) ++size_;
+        }
+        int size() const { return size_; }
+        // The newest k <= size() values, oldest first.
+        const T* last(int k) const { return buf_ + pos_ + N - k; }
+
+    private:
+        T buf_[2 * N] = {};
+        int pos_ = 0;
+        int size_ = 0;
+    };
+
+    const MarkovModel& melodyModel_;
+    const RhythmModel& rhythmModel_;
+    const JointModel* joint_;
+    const ContextTree* melodyTree_;
+    const CompactModel* melodyCompact_;
+    const IntervalModel* melodyIntervals_;
+    MelodyRequest request_;
+    PitchConstraint allowed_;   // compiled once from allowedPitches(request_)
+    bool constrained_;
+    uint8_t velocity_;          // request_.velocity clamped to 0..127
+    Rng rng_;
+    int melodyOrder_;
+    int historyMax_;
+    HistoryRing<int, kHistoryCapacity> pitches_;
+    HistoryRing<double, kHistoryCapacity> durations_;
+    HistoryRing<int, kHistoryCapacity> notes_;     // joint tokens, with a joint model
+    double timeCursor_ = 0.0;
+    uint64_t emitted_ = 0;
+    uint64_t jointDraws_ = 0;
+};
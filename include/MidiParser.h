@@ -1,16 +1,45 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <cstddef>
+#include <cstdint>
 
+// Fields are ordered so the channel-level data fits in the padding after
+// `pitch`; the struct is no bigger than pitch/start/duration alone.
 struct NoteEvent {
     int pitch;
+    uint8_t velocity = 0;   // 0 means unspecified: writers use their default
+    uint8_t channel = 0;    // 0-15
+    uint16_t track = 0;     // index of the MTrk chunk the note came from
     double startTime;
     double duration;
 };
 
+// Which notes the parser keeps. Channel and track filters are applied while
+// events are decoded, so rejected notes never cost a pairing step.
+struct NoteFilter {
+    uint16_t channels = 0xFFFF;     // bit c keeps channel c (0-based)
+    std::vector<int> tracks;        // empty keeps every track
+    bool skipBass = false;          // drop notes played with a GM bass program (33-40)
+
+    // Every channel but the GM percussion channel (10), without bass parts:
+    // what the melody corpus trains on.
+    static NoteFilter melodic();
+
+    bool keepsChannel(int channel) const { return (channels >> channel) & 1u; }
+    bool keepsTrack(int track) const;
+};
+
+class NoteStore;
+
 class Parser {
 public:
-    std::vector<NoteEvent> parseMidiFile(const std::string& path);
+    std::vector<NoteEvent> parseMidiFile(const std::string& path, const NoteFilter& filter = NoteFilter());
+    // Parses an in-memory SMF image; parseMidiFile maps the file and forwards here.
+    std::vector<NoteEvent> parseMidiBuffer(const unsigned char* data, size_t size, const NoteFilter& filter = NoteFilter());
+    // Same notes, appended column-wise to `out`; false if the header is unusable.
+    bool parseMidiBuffer(const unsigned char* data, size_t size, NoteStore& out, const NoteFilter& filter = NoteFilter());
+    bool parseMidiFile(const std::string& path, NoteStore& out, const NoteFilter& filter = NoteFilter());
     std::vector<int> parseMelodyTxt(const std::string& path);
     std::vector<double> parseDurationTxt(const std::string& path);
     void exportMelodyTxt(const std::vector<NoteEvent>& notes, const std::string& outPath);
@@ -0,0 +1,100 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+#include "MidiParser.h"
+#include "TempoMap.h"
+
+// Single-track SMF writer that encodes notes as they arrive instead of
+// collecting the whole piece first. Notes must come in start-time order; only
+// the note-offs still pending are kept (a min-heap keyed on tick), so memory is
+// O(polyphony) however long the piece runs. Encoded events go through one
+// fixed-size buffer that is flushed whenever it fills.
+//
+// The MTrk chunk length is not known until the last note. A seekable file gets
+// a placeholder that finish() patches; a non-seekable sink must be told the
+// length up front, which writeTwoPass() obtains by replaying the notes through
+// a measuring writer first.
+//
+// Every note goes on the writer's channel; notes with a velocity of 0 get the
+// writer's default. Tempo changes are emitted as the notes pass them. For the
+// same notes and tempo map the output is byte-identical to MidiWriter::write.
+class MidiStreamWriter {
+public:
+    // Receives the file bytes in order; returns false to abort the write.
+    using Sink = std::function<bool(const unsigned char* data, size_t size)>;
+    // Adds the same notes to `writer` on every call; returns false to abort.
+    using Replay = std::function<bool(MidiStreamWriter& writer)>;
+
+    static constexpr size_t kBufferSize = 16384;
+
+    MidiStreamWriter(int ppq = 480, uint32_t microsecondsPerQuarter = 500000, int channel = 0, int velocity = 90);
+    explicit MidiStreamWriter(const TempoMap& tempo, int channel = 0, int velocity = 90);
+    // The tempo cursors point into this writer's own map.
+    MidiStreamWriter(const MidiStreamWriter&) = delete;
+    MidiStreamWriter& operator=(const MidiStreamWriter&) = delete;
+
+    // Seekable file; the track length is patched in by finish().
+    bool open(const std::string& outPath);
+    // Non-seekable output; `trackLength` must be the exact MTrk data size.
+    bool open(Sink sink, uint32_t trackLength);
+    // Counts bytes without producing output (the first of two passes).
+    void openMeasure();
+
+    // Encodes one note. Returns false, changing nothing, if it starts before
+    // the previous note or the writer is not open.
+    bool add(const NoteEvent& note);
+    // Releases the pending note-offs, ends the track and completes the output.
+    bool finish();
+
+    // MTrk data bytes produced so far (the full length after finish()).
+    uint64_t trackBytes() const { return trackBytes_; }
+    size_t pendingNotes() const { return pending_.size(); }
+
+    // Measures `replay`'s notes, then writes them to `sink`.
+    static bool writeTwoPass(const Sink& sink, const Replay& replay, int ppq = 480, uint32_t microsecondsPerQuarter = 500000,
+                             int channel = 0, int velocity = 90);
+    static bool writeTwoPass(const Sink& sink, const Replay& replay, const TempoMap& tempo, int channel = 0, int velocity = 90);
+
+private:
+    enum class Mode { Closed, File, Sink, Measure };
+
+    struct PendingOff {
+        uint64_t tick;
+        uint64_t sequence;
+        uint8_t pitch;
+    };
+
+    void reset(Mode mode);
+    void writeHeader();
+    // Emits every tempo change at or before `tick` not yet written.
+    void emitTempoUntil(uint64_t tick);
+    void emit(uint64_t tick, unsigned char status, unsigned char data1, unsigned char data2);
+    // Emits every pending note-off due at or before `tick`.
+    void releaseUntil(uint64_t tick);
+    void put(const unsigned char* bytes, size_t n);
+    bool flush();
+
+    TempoMap tempo_;
+    TempoMap::Cursor onClock_;
+    TempoMap::Cursor offClock_;
+    int channel_;
+    int velocity_;
+
+    Mode mode_ = Mode::Closed;
+    std::ofstream file_;
+    Sink sink_;
+    uint32_t declaredLength_ = 0;
+    bool failed_ = false;
+
+    std::vector<unsigned char> buffer_;
+    size_t buffered_ = 0;
+    std::vector<PendingOff> pending_;
+    uint64_t sequence_ = 0;
+    size_t nextTempo_ = 0;
+    uint64_t lastOnTick_ = 0;
+    uint64_t lastTick_ = 0;
+    uint64_t trackBytes_ = 0;
+};
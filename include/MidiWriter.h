@@ -2,9 +2,59 @@
 #include <string>
 #include <vector>
 #include "MidiParser.h"
+#include "TempoMap.h"
 #include <stdint.h>
 
+// SMF writer for a complete piece: write() produces a single-track format-0
+// file with every note on one channel; writeTracks() a format-1 file with one
+// track per NoteEvent::track and each note on its own channel. Notes with a
+// velocity of 0 get `velocity`. Note times are converted to ticks through a
+// TempoMap, whose tempo changes are written out as meta events (in the
+// conductor track for format 1); SMPTE maps write none. Events are fixed-size records
+// with their bytes inline, ordered by a stable radix sort on tick, and encoded
+// straight into one pre-sized image. The writer keeps those buffers between
+// calls, so reusing one writer for many files does not allocate once they have
+// grown; it is therefore not safe to share one writer between threads.
 class MidiWriter {
 public:
-    bool write(const std::string& outPath, const std::vector<NoteEvent>& notes, int ppq = 480, uint32_t microsecondsPerQuarter = 500000, int channel = 0, int velocity = 90) const;
+    bool write(const std::string& outPath, const std::vector<NoteEvent>& notes, int ppq = 480, uint32_t microsecondsPerQuarter = 500000, int channel = 0, int velocity = 90);
+
+    bool writeTracks(const std::string& outPath, const std::vector<NoteEvent>& notes, int ppq = 480, uint32_t microsecondsPerQuarter = 500000, int velocity = 90);
+
+    // The complete file image write()/writeTracks() would produce; valid until
+    // the next call. encodeTracks() returns an empty image on failure.
+    const std::vector<unsigned char>& encode(const std::vector<NoteEvent>& notes, int ppq = 480, uint32_t microsecondsPerQuarter = 500000, int channel = 0, int velocity = 90);
+    const std::vector<unsigned char>& encodeTracks(const std::vector<NoteEvent>& notes, int ppq = 480, uint32_t microsecondsPerQuarter = 500000, int velocity = 90);
+
+    bool write(const std::string& outPath, const std::vector<NoteEvent>& notes, const TempoMap& tempo, int channel = 0, int velocity = 90);
+    bool writeTracks(const std::string& outPath, const std::vector<NoteEvent>& notes, const TempoMap& tempo, int velocity = 90);
+    const std::vector<unsigned char>& encode(const std::vector<NoteEvent>& notes, const TempoMap& tempo, int channel = 0, int velocity = 90);
+    const std::vector<unsigned char>& encodeTracks(const std::vector<NoteEvent>& notes, const TempoMap& tempo, int velocity = 90);
+
+private:
+    struct Event {
+        uint64_t tick;
+        unsigned char bytes[6];
+        uint8_t size;
+        uint8_t reserved;
+    };
+
+    // The map for a single (ppq, tempo) pair, rebuilt only when either changes.
+    const TempoMap& constantTempo(int ppq, uint32_t microsecondsPerQuarter);
+    void beginImage(uint16_t format, uint16_t trackCount, uint16_t division);
+    // Queues one meta event per tempo segment and returns the last one's tick.
+    uint64_t addTempo(const TempoMap& tempo);
+    // Queues the note's on/off pair and returns the off tick. The cursors
+    // convert the on and off times, each of which arrives nearly sorted.
+    uint64_t addNote(const NoteEvent& n, int channel, int velocity, TempoMap::Cursor& onClock, TempoMap::Cursor& offClock);
+    void sortByTick(uint64_t maxTick);
+    // Appends the queued events to the image as one MTrk chunk.
+    void endTrack(uint64_t maxTick);
+    static bool save(const std::string& outPath, const std::vector<unsigned char>& image);
+
+    std::vector<Event> events_;
+    std::vector<Event> scratch_;
+    std::vector<unsigned char> image_;
+    std::vector<uint32_t> order_;
+    TempoMap constantTempo_;
 };
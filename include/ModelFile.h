@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "MarkovModel.h"
+#include "RhythmModel.h"
+
+// Compiled model file: the melody and rhythm models' flat tables written as
+// 64-byte-aligned sections behind a versioned, checksummed header. Loading
+// maps the file and points the models' arrays straight at the sections.
+//
+// Layout: FileHeader, SectionEntry[sectionCount], then section payloads.
+// All integers are native-endian; byteOrder rejects files from the other one.
+class ModelFile {
+public:
+    static constexpr uint32_t kVersion = 2;
+
+    static bool save(const std::string& path, const MarkovModel& melody, const RhythmModel& rhythm);
+
+    // Replaces both models with views of the file. Skipping the checksum makes
+    // load time independent of file size; the structural checks still run.
+    static bool load(const std::string& path, MarkovModel& melody, RhythmModel& rhythm, bool verifyChecksum = true);
+
+private:
+    struct FileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint64_t fileSize;
+        uint64_t checksum;      // over everything after the header
+        uint32_t sectionCount;
+        uint32_t reserved0;
+        uint64_t reserved[3];
+    };
+
+    struct SectionEntry {
+        uint32_t id;
+        uint32_t elemSize;
+        uint64_t offset;
+        uint64_t count;
+    };
+
+    // Scalar state of one MarkovModel, stored as its own section.
+    struct MarkovParams {
+        uint64_t order;
+        uint64_t bitsPerToken;
+        uint64_t maxPackedId;
+        uint64_t vocabIds;
+        uint64_t historyCount;
+        uint64_t entryCount;
+        uint64_t cumulativeValid;
+        uint64_t reserved;
+    };
+
+    struct RhythmParams {
+        double unit;            // RhythmQuantizer grid, seconds
+        int64_t tokenCount;     // RhythmQuantizer::kTokenCount when saved
+        int64_t order;
+        int64_t reserved;
+    };
+
+    // A section as seen by save() (source data) or load() (mapped data).
+    struct Section {
+        uint32_t id;
+        uint32_t elemSize;
+        const void* data;
+        uint64_t count;
+    };
+
+    static void collect(const MarkovModel& model, uint32_t base, MarkovParams& params, std::vector<Section>& out);
+    static bool attach(MarkovModel& model, uint32_t base, const std::vector<Section>& sections, const std::shared_ptr<const MappedFile>& file);
+};
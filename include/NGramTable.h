@@ -0,0 +1,93 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "FlatArray.h"
+
+// Open-addressing map from packed 64-bit history keys to successor rows.
+// Every row is a contiguous run of (token, count) entries sorted by token,
+// stored CSR-style in one shared pool. Key 0 marks an empty slot.
+class NGramTable {
+public:
+    struct Entry {
+        int32_t token;
+        uint32_t count;
+    };
+
+    // Borrowed view of one history's successors; valid until the next add().
+    // `cumulative` holds inclusive prefix sums of the counts when the table is
+    // compacted and nullptr otherwise.
+    struct Row {
+        const Entry* data = nullptr;
+        uint32_t size = 0;
+        const uint32_t* cumulative = nullptr;
+        bool empty() const { return size == 0; }
+        const Entry* begin() const { return data; }
+        const Entry* end() const { return data + size; }
+        const Entry& operator[](size_t i) const { return data[i]; }
+    };
+
+    void add(uint64_t key, int token, uint32_t count = 1);
+    // Takes `count` back off (key, token); entries that reach zero are erased,
+    // and so is a history whose row empties. Returns false, changing nothing,
+    // if the table holds fewer than `count` of them.
+    bool subtract(uint64_t key, int token, uint32_t count = 1);
+    // Adds every count in `other`, as if its add()s had been replayed here.
+    void merge(const NGramTable& other);
+    Row find(uint64_t key) const;
+
+    // Repacks rows back-to-back in slot order, dropping the slack left by
+    // row growth, and rebuilds the per-row prefix sums. Call after a batch of
+    // add()s.
+    void compact();
+
+    // Rows in slot order; `fn` receives each non-empty history's Row.
+    template <class F>
+    void forEachRow(F&& fn) const {
+        for (const auto &s : slots_) {
+            if (s.key != 0 && s.size != 0) fn(Row{ pool_.data() + s.offset, s.size, nullptr });
+        }
+    }
+    // As forEachRow(), with each row's history key: fn(key, row).
+    template <class F>
+    void forEachHistory(F&& fn) const {
+        for (const auto &s : slots_) {
+            if (s.key != 0 && s.size != 0) fn(s.key, Row{ pool_.data() + s.offset, s.size, nullptr });
+        }
+    }
+    // Position of a row returned by find()/forEachRow() in the entry pool, for
+    // side arrays that parallel it.
+    size_t offsetOf(const Row& row) const { return static_cast<size_t>(row.data - pool_.data()); }
+    size_t poolSize() const { return pool_.size(); }
+
+    size_t historyCount() const { return used_; }
+    size_t entryCount() const { return entries_; }
+    // Heap bytes owned by the table; arrays viewed from a mapped file count 0.
+    size_t memoryBytes() const;
+
+private:
+    friend class ModelFile;
+
+    struct Slot {
+        uint64_t key;
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    size_t probe(uint64_t key) const;
+    void rehash(size_t newSize);
+    void growRow(size_t slot);
+    void eraseSlot(size_t slot);
+    void repack();
+    void makeOwned();
+
+    FlatArray<Slot> slots_;
+    // Row capacities; only meaningful while building, rebuilt by makeOwned().
+    std::vector<uint32_t> capacity_;
+    FlatArray<Entry> pool_;
+    FlatArray<uint32_t> cumulative_;
+    bool cumulativeValid_ = false;
+    size_t used_ = 0;
+    size_t entries_ = 0;
+    size_t slack_ = 0;
+};
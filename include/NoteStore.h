@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "MidiParser.h"
+#include "Span.h"
+
+// Notes stored column by column. Passes that read one or two fields (pitch
+// and duration for training, track for splitting output) stream through
+// exactly the bytes they use: one byte per note for pitch, velocity and
+// channel, two for track.
+class NoteStore {
+public:
+    void reserve(size_t n);
+    void clear();
+    void push_back(const NoteEvent& note);
+
+    size_t size() const { return pitches_.size(); }
+    bool empty() const { return pitches_.empty(); }
+
+    NoteEvent operator[](size_t i) const {
+        NoteEvent n;
+        n.pitch = pitches_[i];
+        n.velocity = velocities_[i];
+        n.channel = channels_[i];
+        n.track = tracks_[i];
+        n.startTime = starts_[i];
+        n.duration = durations_[i];
+        return n;
+    }
+
+    Span<const uint8_t> pitches() const { return Span<const uint8_t>(pitches_); }
+    Span<const uint8_t> velocities() const { return Span<const uint8_t>(velocities_); }
+    Span<const uint8_t> channels() const { return Span<const uint8_t>(channels_); }
+    Span<const uint16_t> tracks() const { return Span<const uint16_t>(tracks_); }
+    Span<const double> startTimes() const { return Span<const double>(starts_); }
+    Span<const double> durations() const { return Span<const double>(durations_); }
+
+    std::vector<NoteEvent> toEvents() const;
+
+    // Moves every pitch by `semitones`; a pitch that would leave 0..127 is
+    // moved by whole octaves less, so it keeps its pitch class.
+    void transpose(int semitones);
+
+private:
+    std::vector<uint8_t> pitches_;
+    std::vector<uint8_t> velocities_;
+    std::vector<uint8_t> channels_;
+    std::vector<uint16_t> tracks_;
+    std::vector<double> starts_;
+    std::vector<double> durations_;
+};
@@ -0,0 +1,83 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Set of MIDI pitches 0..127 as two 64-bit words. Constrained decoding tests
+// every candidate against one, so a membership test is a shift and a mask;
+// anything outside 0..127 is never a member.
+class PitchMask {
+public:
+    PitchMask() = default;
+
+    static PitchMask all() { return range(0, 127); }
+    // Pitches lo..hi inclusive, clipped to 0..127.
+    static PitchMask range(int lo, int hi) {
+        PitchMask m;
+        for (int p = lo < 0 ? 0 : lo; p <= hi && p < 128; ++p) m.set(p);
+        return m;
+    }
+    // Every pitch whose pitch class (mod 12, negatives wrapped) is listed.
+    static PitchMask pitchClasses(const std::vector<int>& classes) {
+        bool in[12] = {};
+        for (int c : classes) in[((c % 12) + 12) % 12] = true;
+        PitchMask m;
+        for (int p = 0; p < 128; ++p) {
+            if (in[p % 12]) m.set(p);
+        }
+        return m;
+    }
+    static PitchMask single(int pitch) {
+        PitchMask m;
+        m.set(pitch);
+        return m;
+    }
+
+    bool test(int pitch) const {
+        return static_cast<unsigned>(pitch) < 128u && ((bits_[pitch >> 6] >> (pitch & 63)) & 1u) != 0;
+    }
+    void set(int pitch) {
+        if (static_cast<unsigned>(pitch) < 128u) bits_[pitch >> 6] |= uint64_t(1) << (pitch & 63);
+    }
+    void reset(int pitch) {
+        if (static_cast<unsigned>(pitch) < 128u) bits_[pitch >> 6] &= ~(uint64_t(1) << (pitch & 63));
+    }
+    bool empty() const { return (bits_[0] | bits_[1]) == 0; }
+    int count() const { return popcount(bits_[0]) + popcount(bits_[1]); }
+
+    // Every member moved up by `semitones` (down when negative); members
+    // moved outside 0..127 drop out.
+    PitchMask shifted(int semitones) const {
+        uint64_t low = bits_[0], high = bits_[1];
+        if (semitones >= 128 || semitones <= -128) return PitchMask();
+        if (semitones >= 64) {
+            high = low << (semitones - 64);
+            low = 0;
+        } else if (semitones > 0) {
+            high = (high << semitones) | (low >> (64 - semitones));
+            low <<= semitones;
+        } else if (semitones <= -64) {
+            low = high >> (-semitones - 64);
+            high = 0;
+        } else if (semitones < 0) {
+            low = (low >> -semitones) | (high << (64 + semitones));
+            high >>= -semitones;
+        }
+        return PitchMask(low, high);
+    }
+
+    PitchMask operator&(const PitchMask& o) const { return PitchMask(bits_[0] & o.bits_[0], bits_[1] & o.bits_[1]); }
+    PitchMask operator|(const PitchMask& o) const { return PitchMask(bits_[0] | o.bits_[0], bits_[1] | o.bits_[1]); }
+    bool operator==(const PitchMask& o) const { return bits_[0] == o.bits_[0] && bits_[1] == o.bits_[1]; }
+    bool operator!=(const PitchMask& o) const { return !(*this == o); }
+
+private:
+    PitchMask(uint64_t low, uint64_t high) : bits_{ low, high } {}
+
+    static int popcount(uint64_t v) {
+        int n = 0;
+        for (; v; v &= v - 1) ++n;
+        return n;
+    }
+
+    uint64_t bits_[2] = { 0, 0 };
+};
@@ -3,21 +3,62 @@
 #include <unordered_map>
 #include <cstdint>
 #include "MarkovModel.h"
+#include "RhythmQuantizer.h"
+#include "Span.h"
 
+// Markov model over quantized durations. The first training batch fixes the
+// quantization grid from a histogram of all its durations (see
+// RhythmQuantizer); every duration after that maps to one of
+// RhythmQuantizer::kTokenCount tokens.
 class RhythmModel {
 public:
-    explicit RhythmModel(int order = 2, double unitScale = 1000.0);
+    explicit RhythmModel(int order = 2, const RhythmQuantizer::Options& quantizer = RhythmQuantizer::Options());
     void train(const std::vector<double>& durations);
     void trainMany(const std::vector<std::vector<double>>& sequences);
-    double sampleNext(const std::vector<double>& history, double temperature = 1.0) const;
-    double unit() const { return unit_; }
-    bool hasUnit() const { return unit_ > 0.0; }
+    // Durations straight out of a mapped CorpusFile.
+    void train(Span<const double> durations);
+    void trainMany(const std::vector<Span<const double>>& sequences);
+    // Tokenizes on the pool, then trains through MarkovModel's sharded
+    // trainMany; same counts as the serial overloads.
+    void trainMany(const std::vector<std::vector<double>>& sequences, ThreadPool& pool);
+    void trainMany(const std::vector<Span<const double>>& sequences, ThreadPool& pool);
+    // Removes one trained sequence's counts; see MarkovModel::untrain. The
+    // quantization unit is kept.
+    bool untrain(const std::vector<double>& durations);
+    bool untrain(Span<const double> durations);
+    void compact() { markov_.compact(); }
+    // Draws from the caller's stream; see MarkovModel::sampleNext.
+    double sampleNext(const std::vector<double>& history, double temperature, Rng& rng) const;
+    double sampleNext(const double* history, size_t length, double temperature, Rng& rng) const;
+    // Duration-token counts for the longest known suffix of `history`; see
+    // MarkovModel::lookup. Empty without a unit.
+    NGramTable::Row lookup(const double* history, size_t length) const;
+    // The grid step in seconds, the shortest duration the model produces.
+    double unit() const { return quantizer_.grid(); }
+    bool hasUnit() const { return quantizer_.hasGrid(); }
+    const RhythmQuantizer& quantizer() const { return quantizer_; }
+    // Alias-table sampling at a fixed temperature; see MarkovModel::freeze.
+    void freeze(double temperature = 1.0) { markov_.freeze(temperature); }
+    void thaw() { markov_.thaw(); }
+    size_t frozenMemoryBytes() const { return markov_.frozenMemoryBytes(); }
+    size_t memoryBytes() const { return markov_.memoryBytes(); }
+    // Distinct duration tokens seen in training.
+    size_t vocabularySize() const { return markov_.vocabularySize(); }
+    size_t transitionCount() const { return markov_.transitionCount(); }
     int durationToToken(double d) const;
     double tokenToDuration(int token) const;
 private:
-    void computeUnitFromDurations(const std::vector<double>& durations);
+    friend class ModelFile;
+    // Fixes the grid from the durations of `sequences` if none is set yet.
+    template <class Seq>
+    bool detectUnit(const std::vector<Seq>& sequences, ThreadPool* pool);
+    size_t historyTokens(const double* history, size_t length, int* tokens) const;
+    void trainDurations(const double* durations, size_t length);
+    template <class Seq>
+    void trainBatch(const std::vector<Seq>& sequences);
+    template <class Seq>
+    void trainBatchParallel(const std::vector<Seq>& sequences, ThreadPool& pool);
     int order_;
-    double unit_;
-    double unitScale_;
+    RhythmQuantizer quantizer_;
     MarkovModel markov_;
 };
\ No newline at end of file
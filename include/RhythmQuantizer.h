@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct QuantizerOptions {
+    double binSeconds = 0.001;      // histogram resolution
+    double maxSeconds = 8.0;        // longer durations are left out of grid detection
+    double minGrid = 0.02;          // shortest grid step considered
+    double maxGrid = 2.0;           // longest duration taken as the reference value
+    double tolerance = 0.12;        // relative timing slack a duration may have
+    double coverage = 0.9;          // a coarser grid wins if it explains this share of what the best one does
+};
+
+// Maps note durations onto a small, fixed set of grid multiples. The grid is
+// detected once from a histogram of every training duration: the most common
+// duration or a subdivision of it (1/2, 1/3, 1/4, 1/6, 1/8), whichever is the
+// coarsest whose multiples explain nearly as many durations, within
+// `tolerance`, as the best candidate; then refined to the mean of the
+// durations it explains.
+// Durations then snap to the nearest of kSteps grid steps in log distance, so
+// the token vocabulary is dense (0..kTokenCount-1) however loosely the input
+// was played.
+class RhythmQuantizer {
+public:
+    using Options = QuantizerOptions;
+
+    // Grid multiples a duration can become: 1/16 .. two whole notes when the
+    // grid is a sixteenth.
+    static constexpr int kTokenCount = 10;
+    static const uint16_t kSteps[kTokenCount];
+
+    // Duration counts at Options::binSeconds resolution.
+    class Histogram {
+    public:
+        explicit Histogram(const Options& options = Options());
+        void add(const double* durations, size_t length);
+        void merge(const Histogram& other);
+        size_t total() const { return total_; }
+
+    private:
+        friend class RhythmQuantizer;
+        double binSeconds_;
+        std::vector<uint32_t> bins_;
+        size_t total_ = 0;
+    };
+
+    explicit RhythmQuantizer(const Options& options = Options()) : options_(options) {}
+
+    const Options& options() const { return options_; }
+    // Picks the grid from `h`. Returns false, leaving the grid unset, if the
+    // histogram holds no usable durations.
+    bool detectGrid(const Histogram& h);
+    double grid() const { return grid_; }
+    void setGrid(double grid);
+    bool hasGrid() const { return grid_ > 0.0; }
+    // Share of the histogram the chosen grid explained; 0 after setGrid().
+    double coverage() const { return coverage_; }
+
+    int token(double seconds) const;
+    double duration(int token) const;
+
+private:
+    Options options_;
+    double grid_ = 0.0;
+    double inverseGrid_ = 0.0;
+    double coverage_ = 0.0;
+};
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+
+// Counter-based random stream: draw i is a fixed function (the splitmix64
+// finalizer) of (key, i), so the whole state is 16 bytes, copying a stream
+// forks it, and any position can be reached without replaying the ones
+// before it. Rng(seed, stream) gives every (seed, stream) pair an unrelated
+// key, which is what makes each melody reproducible from its seed and
+// request index alone.
+//
+// Models take the caller's Rng by reference and hold none of their own, so
+// they stay immutable while sampling. Rng satisfies UniformRandomBitGenerator,
+// but the samplers draw through below() and uniform(): <random>'s
+// distributions are slower and their output differs between standard
+// libraries.
+class Rng {
+public:
+    using result_type = uint64_t;
+
+    explicit Rng(uint64_t seed = 0, uint64_t stream = 0)
+        : key_(mix(mix(seed + kGamma) + stream * kStreamGamma)) {}
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return ~result_type(0); }
+
+    result_type operator()() { return mix(key_ + ++counter_ * kGamma); }
+
+    // Uniform in [0, n), n > 0, without modulo bias (Lemire's method).
+    uint32_t below(uint32_t n) {
+        uint64_t m = static_cast<uint64_t>(static_cast<uint32_t>((*this)())) * n;
+        if (static_cast<uint32_t>(m) < n) {
+            const uint32_t floor = static_cast<uint32_t>(-n) % n;
+            while (static_cast<uint32_t>(m) < floor) m = static_cast<uint64_t>(static_cast<uint32_t>((*this)())) * n;
+        }
+        return static_cast<uint32_t>(m >> 32);
+    }
+    // As below(), for totals past 32 bits.
+    uint64_t below64(uint64_t n) {
+        if (n <= 0xFFFFFFFFull) return below(static_cast<uint32_t>(n));
+        const uint64_t floor = (0 - n) % n;
+        uint64_t x;
+        do x = (*this)(); while (x < floor);
+        return x % n;
+    }
+    // Uniform in [0, 1) with 53 random bits.
+    double uniform() { return static_cast<double>((*this)() >> 11) * (1.0 / 9007199254740992.0); }
+
+    // Draws taken so far; seek() jumps to any position of the stream.
+    uint64_t position() const { return counter_; }
+    void seek(uint64_t position) { counter_ = position; }
+
+    bool operator==(const Rng& other) const { return key_ == other.key_ && counter_ == other.counter_; }
+    bool operator!=(const Rng& other) const { return !(*this == other); }
+
+private:
+    static constexpr uint64_t kGamma = 0x9E3779B97F4A7C15ull;
+    static constexpr uint64_t kStreamGamma = 0xD1B54A32D192ED03ull;
+
+    static uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t key_;
+    uint64_t counter_ = 0;
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "PitchMask.h"
+#include "Span.h"
+
+// A key: a tonic pitch class and the pitch classes of a named scale or mode
+// on it, as a 12-bit set. The default is chromatic on C, which allows every
+// pitch and never transposes anything.
+class Scale {
+public:
+    Scale() = default;
+
+    // Parses "TONIC[:NAME]", e.g. "D:dorian", "F#:minor-pentatonic" or "Bb"
+    // (major). Tonics are C..B with any number of '#' or 'b'; names are
+    // listed by names(). Returns false, leaving `out` alone, on anything else.
+    static bool parse(const std::string& spec, Scale& out);
+    // The accepted scale names, comma-separated.
+    static std::string names();
+
+    int tonic() const { return tonic_; }
+    // Bit c set when pitch class c (C = 0) is in the scale.
+    uint16_t classes() const { return classes_; }
+    bool chromatic() const { return classes_ == 0xFFF; }
+    bool contains(int pitch) const { return ((classes_ >> (((pitch % 12) + 12) % 12)) & 1u) != 0; }
+    std::vector<int> pitchClasses() const;
+    // Canonical "TONIC:NAME", which parse() reads back.
+    std::string name() const;
+
+    // The shift in -6..5 semitones that puts the most of `pitches` in the
+    // scale; ties go to the smallest move, then downwards. One histogram
+    // pass, then 12 x 12 compares.
+    int bestTransposition(Span<const uint8_t> pitches) const;
+
+private:
+    int tonic_ = 0;
+    int mode_ = 0;              // index into the scale table
+    uint16_t classes_ = 0xFFF;
+};
+
+// A request's pitch constraint compiled once: the allowed pitches as a mask,
+// and for every MIDI pitch the nearest allowed one (ties go up), so the
+// generation path checks and repairs a pitch with one lookup each instead of
+// scanning pitch classes.
+class PitchConstraint {
+public:
+    // Allows every pitch.
+    PitchConstraint() : PitchConstraint(PitchMask::all(), 0, 127) {}
+    // `allowed` within minPitch..maxPitch. Pitches are repaired to the nearest
+    // allowed one; if none is allowed, they are only clamped to the range.
+    PitchConstraint(const PitchMask& allowed, int minPitch, int maxPitch);
+
+    const PitchMask& mask() const { return mask_; }
+    bool allows(int pitch) const { return mask_.test(pitch); }
+    int nearest(int pitch) const { return nearest_[pitch < 0 ? 0 : pitch > 127 ? 127 : pitch]; }
+
+private:
+    PitchMask mask_;
+    uint8_t nearest_[128];
+};
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Piecewise-constant mapping between MIDI ticks and seconds, shared by the
+// parser (ticks -> seconds) and the writers (seconds -> ticks, plus the tempo
+// events to emit). Built once from a time division and a list of tempo
+// changes, then immutable.
+//
+// SMPTE divisions count ticks in real time: tempo changes do not move them,
+// and the map holds a single segment.
+class TempoMap {
+public:
+    static constexpr uint32_t kDefaultMicrosecondsPerQuarter = 500000;
+
+    struct Change {
+        uint64_t tick;
+        uint32_t microsecondsPerQuarter;
+    };
+
+    struct Segment {
+        uint64_t tick;                      // first tick of the segment
+        uint32_t microsecondsPerQuarter;
+        double seconds;                     // time at `tick`
+    };
+
+    // Constant tempo from tick 0.
+    explicit TempoMap(int ppq = 480, uint32_t microsecondsPerQuarter = kDefaultMicrosecondsPerQuarter);
+    // Tempo changes in any order; of several at one tick the last listed wins.
+    // The tempo before the first change is the SMF default of 120 bpm.
+    TempoMap(int ppq, std::vector<Change> changes);
+    // From an SMF header division word: PPQ, or SMPTE frames/ticks per frame.
+    // Returns false (leaving a 480 PPQ map) for a zero PPQ or an unknown
+    // SMPTE frame rate.
+    static bool fromDivision(uint16_t division, const std::vector<Change>& changes, TempoMap& out);
+    static TempoMap smpte(int framesPerSecond, int ticksPerFrame);
+
+    bool isSmpte() const { return smpteFps_ != 0; }
+    // Ticks per quarter note; 0 for SMPTE maps.
+    int ppq() const { return isSmpte() ? 0 : ppq_; }
+    // The division word to put in an SMF header.
+    uint16_t division() const;
+    const std::vector<Segment>& segments() const { return segments_; }
+
+    double seconds(uint64_t tick) const { return secondsIn(segmentForTick(tick), tick); }
+    // Nearest tick; negative times map to tick 0.
+    uint64_t ticks(double seconds) const { return ticksIn(segmentForSeconds(seconds), seconds); }
+
+    // Conversions for a run of nearly sorted inputs. Each call starts looking
+    // from the segment the previous one ended in, so a sorted batch costs
+    // O(1) amortized per conversion; a jump elsewhere falls back to a search.
+    class Cursor {
+    public:
+        explicit Cursor(const TempoMap& map) : map_(&map) {}
+        double seconds(uint64_t tick);
+        uint64_t ticks(double seconds);
+
+    private:
+        const TempoMap* map_;
+        size_t tickSegment_ = 0;
+        size_t secondsSegment_ = 0;
+    };
+    Cursor cursor() const { return Cursor(*this); }
+
+private:
+    void build(std::vector<Change> changes);
+    size_t segmentForTick(uint64_t tick) const;
+    size_t segmentForSeconds(double seconds) const;
+    double secondsIn(size_t segment, uint64_t tick) const;
+    uint64_t ticksIn(size_t segment, double seconds) const;
+
+    int ppq_ = 480;
+    int smpteFps_ = 0;          // 24, 25, 29 (29.97 drop-frame) or 30; 0 for PPQ
+    int ticksPerFrame_ = 0;
+    double ticksPerQuarter_ = 480.0;
+    std::vector<Segment> segments_;
+};
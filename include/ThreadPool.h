@@ -0,0 +1,51 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool for data-parallel loops. Each worker owns a deque of task
+// indices; it pops from the back of its own deque and, when that runs dry,
+// steals from the front of the others, so uneven task sizes still balance.
+class ThreadPool {
+public:
+    // threads == 0 uses std::thread::hardware_concurrency().
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Number of threads that execute tasks, including the calling thread.
+    size_t size() const { return queues_.size(); }
+
+    // Runs fn(i) for every i in [0, n) and blocks until all calls returned.
+    // The calling thread takes part as worker 0. Not reentrant.
+    void parallelFor(size_t n, const std::function<void(size_t)>& fn);
+
+private:
+    struct Queue {
+        std::mutex m;
+        std::deque<size_t> tasks;
+    };
+
+    bool popOrSteal(size_t self, size_t& task);
+    void runTasks(size_t self, const std::function<void(size_t)>& job);
+    void workerLoop(size_t self);
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+
+    std::mutex jobMutex_;
+    std::condition_variable jobCv_;
+    std::condition_variable doneCv_;
+    const std::function<void(size_t)>* job_ = nullptr;
+    uint64_t jobGeneration_ = 0;
+    size_t busyWorkers_ = 0;
+    std::atomic<size_t> remaining_{0};
+    bool stop_ = false;
+};
@@ -3,13 +3,38 @@
 #include <vector>
 #include <fstream>
 #include <stdint.h>
+#include <cstddef>
 
 namespace Utils {
 
+    // Bounds-checked read position over an in-memory byte range. Reads past
+    // `end` return zero / -1 and clear `ok` instead of touching memory.
+    struct ByteCursor {
+        const unsigned char* pos;
+        const unsigned char* end;
+        bool ok = true;
+
+        ByteCursor(const unsigned char* data, size_t size) : pos(data), end(data + size) {}
+        size_t remaining() const { return static_cast<size_t>(end - pos); }
+        bool atEnd() const { return pos >= end; }
+    };
+
     uint16_t readBE16(std::ifstream& file);
     uint32_t readBE32(std::ifstream& file);
     uint32_t readVarLen(std::ifstream& file);
 
+    int readByte(ByteCursor& cur);
+    uint16_t readBE16(ByteCursor& cur);
+    uint32_t readBE32(ByteCursor& cur);
+    uint32_t readVarLen(ByteCursor& cur);
+    void skipBytes(ByteCursor& cur, size_t n);
+
+    // 64-bit FNV-1a folded over little-endian 8-byte words (tail bytewise);
+    // used to checksum binary model and corpus files. Passing one result as
+    // the next call's `seed` continues the checksum, when the first piece's
+    // size is a multiple of 8.
+    uint64_t checksum64(const unsigned char* data, size_t size, uint64_t seed = 0xcbf29ce484222325ULL);
+
     int noteNameToMidi(const std::string& name);
     std::string midiToNoteName(int midi);
 
@@ -0,0 +1,84 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "Rng.h"
+
+// The scan draw every count table shares: one of `size` items, item i
+// weighted by count(i)^(1/temperature). Items whose count is 0 are never
+// drawn, so a masked draw passes a count() that is 0 outside the mask.
+namespace WeightedDraw {
+
+    // Rows up to this length keep their tempered weights on the stack; longer
+    // rows pay for a second pow() pass instead of a heap allocation.
+    constexpr uint32_t kStackWeights = 256;
+
+    // The first item with the highest count; `size` if every count is 0.
+    template <class Count>
+    uint32_t argmax(uint32_t size, Count count) {
+        uint32_t best = size;
+        uint64_t bestCount = 0;
+        for (uint32_t i = 0; i < size; ++i) {
+            const uint64_t c = count(i);
+            if (c > bestCount) {
+                bestCount = c;
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    // Index of the drawn item, or `size` if no item has any weight. At
+    // temperature <= 0 this is argmax(). At 1 it draws an integer, then
+    // binary-searches `cumulative` (prefix sums of the counts, which count()
+    // must agree with) when given, and accumulates in one pass otherwise.
+    template <class Count>
+    uint32_t draw(uint32_t size, Count count, const uint32_t* cumulative, double temperature, Rng& rng) {
+        if (temperature <= 0.0) return argmax(size, count);
+
+        if (temperature == 1.0) {
+            if (cumulative) {
+                if (size == 0 || cumulative[size - 1] == 0) return size;
+                const uint32_t r = rng.below(cumulative[size - 1]);
+                return static_cast<uint32_t>(std::upper_bound(cumulative, cumulative + size, r) - cumulative);
+            }
+            uint64_t total = 0;
+            for (uint32_t i = 0; i < size; ++i) total += count(i);
+            if (total == 0) return size;
+            const uint64_t r = rng.below64(total);
+            uint64_t acc = 0;
+            for (uint32_t i = 0; i < size; ++i) {
+                acc += count(i);
+                if (r < acc) return i;
+            }
+            return size - 1;
+        }
+
+        const double invTemp = 1.0 / temperature;
+        auto weight = [&](uint32_t i) {
+            const uint64_t c = count(i);
+            return c ? std::pow(static_cast<double>(c), invTemp) : 0.0;
+        };
+        double weights[kStackWeights];
+        const bool buffered = size <= kStackWeights;
+        double total = 0.0;
+        for (uint32_t i = 0; i < size; ++i) {
+            const double w = weight(i);
+            if (buffered) weights[i] = w;
+            total += w;
+        }
+        if (!(total > 0.0) || !std::isfinite(total)) return argmax(size, count);
+
+        const double r = rng.uniform() * total;
+        double acc = 0.0;
+        uint32_t last = size;
+        for (uint32_t i = 0; i < size; ++i) {
+            const double w = buffered ? weights[i] : weight(i);
+            if (!(w > 0.0)) continue;
+            acc += w;
+            last = i;
+            if (r < acc) return i;
+        }
+        return last;
+    }
+}
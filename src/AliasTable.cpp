@@ -0,0 +1,45 @@
+#include "AliasTable.h"
+
+#include <cmath>
+
+void AliasTable::build(double* weights, uint32_t n, uint32_t* threshold, uint32_t* alias,
+                       std::vector<uint32_t>& small, std::vector<uint32_t>& large) {
+    if (n == 0) return;
+    double total = 0.0;
+    for (uint32_t i = 0; i < n; ++i) total += weights[i];
+    if (!std::isfinite(total)) {
+        // Scaling by an infinite total would give NaN thresholds; always
+        // draw the first heaviest entry instead, as WeightedDraw does.
+        uint32_t best = 0;
+        for (uint32_t i = 1; i < n; ++i) {
+            if (weights[i] > weights[best]) best = i;
+        }
+        for (uint32_t i = 0; i < n; ++i) { threshold[i] = 0; alias[i] = best; }
+        threshold[best] = 0xFFFFFFFFu;
+        return;
+    }
+
+    double* scaled = weights;
+    small.clear();
+    large.clear();
+    for (uint32_t i = 0; i < n; ++i) {
+        scaled[i] = (total > 0.0) ? weights[i] * static_cast<double>(n) / total : 1.0;
+        (scaled[i] < 1.0 ? small : large).push_back(i);
+    }
+
+    const double scale = 4294967296.0;
+    while (!small.empty() && !large.empty()) {
+        uint32_t s = small.back(); small.pop_back();
+        uint32_t l = large.back();
+        threshold[s] = static_cast<uint32_t>(scaled[s] * scale);
+        alias[s] = l;
+        scaled[l] -= 1.0 - scaled[s];
+        if (scaled[l] < 1.0) {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+    // Leftovers are 1.0 up to rounding error: always accept.
+    for (uint32_t i : large) { threshold[i] = 0xFFFFFFFFu; alias[i] = i; }
+    for (uint32_t i : small) { threshold[i] = 0xFFFFFFFFu; alias[i] = i; }
+}
@@ -0,0 +1,157 @@
+#include "BeamSearch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+namespace {
+
+const uint32_t kNoParent = std::numeric_limits<uint32_t>::max();
+const uint8_t kNoDuration = 0xFF;
+
+}
+
+BeamSearch::BeamSearch(const MarkovModel& melodyModel, const RhythmModel& rhythmModel, int melodyOrder, int historyMax)
+    : melodyModel_(melodyModel), rhythmModel_(rhythmModel),
+      melodyOrder_(std::min(MarkovModel::kMaxOrder, std::max(1, melodyOrder))),
+      historyMax_(std::min(MelodyStream::kHistoryCapacity, std::max(melodyOrder_, historyMax))) {}
+
+bool BeamSearch::better(const Node& a, const Node& b) {
+    if (a.logp != b.logp) return a.logp > b.logp;
+    if (a.parent != b.parent) return a.parent < b.parent;
+    if (a.pitch != b.pitch) return a.pitch < b.pitch;
+    return a.durationToken < b.durationToken;
+}
+
+void BeamSearch::expandOptions(uint32_t node, const PitchMask& mask, int endPitch) {
+    int pitches[MarkovModel::kMaxOrder];
+    double durations[MelodyStream::kHistoryCapacity];
+    int p = melodyOrder_, d = historyMax_;
+    for (uint32_t n = node; n != kNoParent && (p > 0 || d > 0); n = nodes_[n].parent) {
+        if (p > 0) pitches[--p] = nodes_[n].pitch;
+        if (d > 0 && nodes_[n].durationToken != kNoDuration) durations[--d] = rhythmModel_.tokenToDuration(nodes_[n].durationToken);
+    }
+    const size_t pitchCount = static_cast<size_t>(melodyOrder_ - p);
+    const size_t durationCount = static_cast<size_t>(historyMax_ - d);
+
+    // Successor probabilities renormalized over the allowed pitches.
+    auto allowedTotal = [&](const NGramTable::Row& row) {
+        uint64_t total = 0;
+        for (const auto &e : row) {
+            if (mask.test(e.token)) total += e.count;
+        }
+        return total;
+    };
+    pitchOptions_.clear();
+    const NGramTable::Row row = melodyModel_.lookupMasked(pitches + p, pitchCount, mask);
+    const double logTotal = std::log(static_cast<double>(allowedTotal(row)));
+    bool hasEnd = false;
+    for (const auto &e : row) {
+        if (!mask.test(e.token)) continue;
+        pitchOptions_.push_back(Option{ e.token, std::log(static_cast<double>(e.count)) - logTotal, false });
+        hasEnd = hasEnd || e.token == endPitch;
+    }
+    // The end pitch may only follow a shorter context; score it there.
+    if (endPitch >= 0 && !hasEnd) {
+        const NGramTable::Row endRow = melodyModel_.lookupMasked(pitches + p, pitchCount, PitchMask::single(endPitch));
+        for (const auto &e : endRow) {
+            if (e.token != endPitch) continue;
+            pitchOptions_.push_back(Option{ e.token, std::log(static_cast<double>(e.count) / static_cast<double>(allowedTotal(endRow))), true });
+        }
+    }
+
+    durationOptions_.clear();
+    const NGramTable::Row durationRow = rhythmModel_.lookup(durations + d, durationCount);
+    uint64_t durationTotal = 0;
+    for (const auto &e : durationRow) {
+        if (e.token >= 0 && e.token < RhythmQuantizer::kTokenCount) durationTotal += e.count;
+    }
+    for (const auto &e : durationRow) {
+        if (e.token < 0 || e.token >= RhythmQuantizer::kTokenCount) continue;
+        durationOptions_.push_back(Option{ e.token, std::log(static_cast<double>(e.count) / static_cast<double>(durationTotal)), false });
+    }
+}
+
+bool BeamSearch::search(const MelodyRequest& request, int width, std::vector<NoteEvent>& out) {
+    out.clear();
+    logLikelihood_ = 0.0;
+    expanded_ = 0;
+    if (!rhythmModel_.hasUnit()) {
+        std::cerr << "BeamSearch::search: the rhythm model has no unit\n";
+        return false;
+    }
+    const PitchMask mask = allowedPitches(request);
+    if (request.endPitch >= 0 && !mask.test(request.endPitch)) {
+        std::cerr << "BeamSearch::search: end pitch " << request.endPitch << " is outside the allowed pitches\n";
+        return false;
+    }
+    const size_t beams = static_cast<size_t>(std::max(1, width));
+    const int maxNotes = std::max(1, request.length);
+    const bool timed = request.targetDuration > 0.0;
+    const uint32_t target = timed ? static_cast<uint32_t>(std::max(1.0, std::round(request.targetDuration / rhythmModel_.unit()))) : 0;
+
+    nodes_.clear();
+    nodes_.reserve(beams * static_cast<size_t>(maxNotes) + 1);
+    nodes_.push_back(Node{ kNoParent, static_cast<int16_t>(request.startPitch), kNoDuration, 0, 0.0 });
+    frontier_.assign(1, 0);
+    Node best{ kNoParent, 0, kNoDuration, 0, -std::numeric_limits<double>::infinity() };
+
+    for (int step = 0; step < maxNotes && !frontier_.empty(); ++step) {
+        const bool lastStep = step + 1 == maxNotes;
+        candidates_.clear();
+        for (uint32_t parent : frontier_) {
+            expandOptions(parent, mask, request.endPitch);
+            ++expanded_;
+            const Node &from = nodes_[parent];
+            for (const Option &p : pitchOptions_) {
+                for (const Option &d : durationOptions_) {
+                    const Node next{ parent, static_cast<int16_t>(p.token), static_cast<uint8_t>(d.token),
+                                     from.steps + RhythmQuantizer::kSteps[d.token], from.logp + p.logp + d.logp };
+                    if (timed && next.steps > target) continue;
+                    const bool finishing = timed ? next.steps == target : lastStep;
+                    if (finishing) {
+                        if (request.endPitch >= 0 && p.token != request.endPitch) continue;
+                        if (better(next, best)) best = next;
+                        continue;
+                    }
+                    if (p.endOnly || lastStep) continue;
+                    // Log-likelihoods only fall, so nothing below a finished
+                    // melody can overtake it.
+                    if (next.logp <= best.logp) continue;
+                    candidates_.push_back(next);
+                }
+            }
+        }
+        if (candidates_.size() > beams) {
+            std::nth_element(candidates_.begin(), candidates_.begin() + static_cast<std::ptrdiff_t>(beams), candidates_.end(), better);
+            candidates_.resize(beams);
+        }
+        frontier_.clear();
+        for (const Node &c : candidates_) {
+            if (c.logp <= best.logp) continue;
+            frontier_.push_back(static_cast<uint32_t>(nodes_.size()));
+            nodes_.push_back(c);
+        }
+    }
+    if (best.parent == kNoParent) return false;
+
+    size_t count = 1;
+    for (uint32_t n = best.parent; n != 0; n = nodes_[n].parent) ++count;
+    out.resize(count);
+    const uint8_t velocity = static_cast<uint8_t>(std::clamp(request.velocity, 0, 127));
+    const Node *note = &best;
+    for (size_t i = count; i-- > 0; note = &nodes_[note->parent]) {
+        out[i].pitch = note->pitch;
+        out[i].duration = rhythmModel_.tokenToDuration(note->durationToken);
+        out[i].velocity = velocity;
+        out[i].startTime = static_cast<double>(note->steps - RhythmQuantizer::kSteps[note->durationToken]) * rhythmModel_.unit();
+    }
+    logLikelihood_ = best.logp;
+    return true;
+}
+
+size_t BeamSearch::arenaBytes() const {
+    return nodes_.capacity() * sizeof(Node) + candidates_.capacity() * sizeof(Node) + frontier_.capacity() * sizeof(uint32_t) +
+           (pitchOptions_.capacity() + durationOptions_.capacity()) * sizeof(Option);
+}
@@ -0,0 +1,330 @@
+#include "CompactModel.h"
+#include "MarkovModel.h"
+#include "WeightedDraw.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+namespace {
+
+// Successors of `row` that survive `minCount` and `topK`, most frequent
+// first when trimmed.
+void select(const NGramTable::Row& row, uint32_t minCount, uint32_t topK, std::vector<NGramTable::Entry>& out) {
+    out.clear();
+    for (const auto &e : row) {
+        if (e.count >= minCount) out.push_back(e);
+    }
+    if (topK > 0 && out.size() > topK) {
+        std::partial_sort(out.begin(), out.begin() + topK, out.end(), [](const NGramTable::Entry& a, const NGramTable::Entry& b) {
+            return a.count != b.count ? a.count > b.count : a.token < b.token;
+        });
+        out.resize(topK);
+    }
+}
+
+// Add-one unigram estimate, with one extra slot for tokens never seen.
+double unigramEstimate(uint64_t count, uint64_t total, size_t vocabulary) {
+    return (static_cast<double>(count) + 1.0) / (static_cast<double>(total) + static_cast<double>(vocabulary) + 1.0);
+}
+
+// Witten-Bell: a context with `types` distinct successors gives that many
+// pseudo-counts to the unigram estimate.
+double interpolate(uint64_t count, uint64_t total, uint32_t types, double unigram) {
+    return (static_cast<double>(count) + types * unigram) / (static_cast<double>(total) + types);
+}
+
+// 16-bit codes are small floats: an 11-bit mantissa shifted left by a
+// 5-bit exponent, exact below 2048 and within 2^-11 of the count above.
+uint32_t encode16(uint32_t count) {
+    uint32_t e = 0;
+    while ((count >> e) >= 2048) ++e;
+    uint32_t m = e > 0 ? static_cast<uint32_t>((static_cast<uint64_t>(count) + (1u << (e - 1))) >> e) : count;
+    if (m == 2048) {
+        m = 1024;
+        ++e;
+    }
+    return (e << 11) | m;
+}
+
+uint32_t decode16(uint32_t code) {
+    return (code & 0x7FFu) << (code >> 11);
+}
+
+template <class Probability>
+double score(const std::vector<std::vector<int>>& sequences, Probability probability) {
+    double logSum = 0.0;
+    size_t n = 0;
+    for (const auto &s : sequences) {
+        for (size_t i = 0; i < s.size(); ++i) {
+            logSum += std::log(probability(s.data(), i, s[i]));
+            ++n;
+        }
+    }
+    return n > 0 ? std::exp(-logSum / static_cast<double>(n)) : 0.0;
+}
+
+}
+
+bool CompactModel::build(const MarkovModel& model, const Options& options) {
+    if (options.countBits != 8 && options.countBits != 16) {
+        std::cerr << "CompactModel: counts must be 8 or 16 bits, not " << options.countBits << "\n";
+        return false;
+    }
+    if (model.vocabIds_ > 0xFFFFu) {
+        std::cerr << "CompactModel: " << model.vocabIds_ << " tokens do not fit 16-bit ids\n";
+        return false;
+    }
+    order_ = model.order_;
+    bitsPerToken_ = model.bitsPerToken_;
+    maxPackedId_ = model.maxPackedId_;
+    topK_ = options.topK;
+    countBits_ = options.countBits;
+
+    denseIds_.assign(model.denseIds_.begin(), model.denseIds_.end());
+    sparseIds_.clear();
+    for (const auto &t : model.sparseIds_) sparseIds_.emplace_back(t.token, t.id);
+    tokens_.assign(model.vocabIds_, 0);
+    for (size_t t = 0; t < denseIds_.size(); ++t) {
+        if (denseIds_[t] != 0) tokens_[denseIds_[t] - 1] = static_cast<int32_t>(t);
+    }
+    for (const auto &t : sparseIds_) tokens_[t.second - 1] = t.first;
+    unigrams_.assign(model.unigramCounts_.begin(), model.unigramCounts_.end());
+    unigramTotal_ = 0;
+    for (const auto &e : unigrams_) unigramTotal_ += e.count;
+
+    struct Source {
+        uint64_t key;
+        NGramTable::Row row;
+        uint64_t total;
+    };
+    std::vector<Source> sources;
+    sources.reserve(model.transitions_.historyCount());
+    uint32_t maxCount = 1;
+    model.transitions_.forEachHistory([&](uint64_t key, const NGramTable::Row& row) {
+        uint64_t total = 0;
+        for (const auto &e : row) {
+            total += e.count;
+            maxCount = std::max(maxCount, e.count);
+        }
+        sources.push_back(Source{ key, row, total });
+    });
+    std::sort(sources.begin(), sources.end(), [](const Source& a, const Source& b) { return a.key < b.key; });
+
+    // 8-bit codes index a table: exact while the counts fit, otherwise code
+    // c stands for exp(c * step), within about step / 2 of the count in log
+    // terms. 16-bit codes decode arithmetically (see encode16).
+    const size_t levelCount = countBits_ == 8 ? 256 : 0;
+    levels_.assign(levelCount, 0);
+    const bool logScale = maxCount > levelCount;
+    const double step = logScale && levelCount > 0 ? std::log(static_cast<double>(maxCount)) / static_cast<double>(levelCount - 1) : 1.0;
+    for (size_t c = 0; c < levelCount; ++c) {
+        levels_[c] = logScale ? static_cast<uint32_t>(std::max(1.0, std::round(std::exp(static_cast<double>(c) * step))))
+                              : static_cast<uint32_t>(c + 1);
+    }
+    auto encode = [&](uint32_t count) -> uint32_t {
+        if (countBits_ == 16) return encode16(count);
+        if (!logScale) return count - 1;
+        const double c = std::round(std::log(static_cast<double>(count)) / step);
+        return static_cast<uint32_t>(std::min(static_cast<double>(levelCount - 1), std::max(0.0, c)));
+    };
+
+    const size_t entryBytes = sizeof(uint16_t) + static_cast<size_t>(countBits_ / 8);
+    const size_t historyBytes = sizeof(uint64_t) + sizeof(uint32_t);
+    const size_t fixedBytes = denseIds_.size() * sizeof(uint32_t) + sparseIds_.size() * sizeof(sparseIds_[0]) +
+                              tokens_.size() * sizeof(int32_t) + levels_.size() * sizeof(uint32_t) +
+                              unigrams_.size() * sizeof(NGramTable::Entry) + sizeof(uint32_t);
+
+    minCount_ = std::max<uint32_t>(1, options.minCount);
+    minHistoryCount_ = std::max<uint32_t>(1, options.minHistoryCount);
+    bool fits = true;
+    std::vector<NGramTable::Entry> kept;
+    if (options.budgetBytes > 0) {
+        // Every (successor, history) threshold pair on a roughly geometric
+        // grid; of those within budget, keep the one that retains the most
+        // training observations. Dropping every history is the last resort.
+        std::vector<uint32_t> minCounts;
+        for (uint64_t p = 1; p <= maxCount; p *= 2) {
+            minCounts.push_back(static_cast<uint32_t>(p));
+            if (p >= 2 && p * 3 / 2 <= maxCount) minCounts.push_back(static_cast<uint32_t>(p * 3 / 2));
+        }
+        static const uint32_t kHistoryFactors[] = { 1, 2, 4, 8 };
+        const size_t factors = sizeof(kHistoryFactors) / sizeof(kHistoryFactors[0]);
+        uint64_t bestMass = 0;
+        minCount_ = minHistoryCount_ = std::numeric_limits<uint32_t>::max();
+        fits = fixedBytes <= options.budgetBytes;
+        for (uint32_t s : minCounts) {
+            size_t histories[factors] = {}, entries[factors] = {};
+            uint64_t mass[factors] = {};
+            for (const auto &src : sources) {
+                select(src.row, s, topK_, kept);
+                if (kept.empty()) continue;
+                uint64_t m = 0;
+                for (const auto &e : kept) m += e.count;
+                for (size_t f = 0; f < factors; ++f) {
+                    if (src.total < static_cast<uint64_t>(s) * kHistoryFactors[f]) continue;
+                    ++histories[f];
+                    entries[f] += kept.size();
+                    mass[f] += m;
+                }
+            }
+            for (size_t f = 0; f < factors; ++f) {
+                const size_t bytes = fixedBytes + histories[f] * historyBytes + entries[f] * entryBytes;
+                if (bytes > options.budgetBytes || mass[f] <= bestMass) continue;
+                bestMass = mass[f];
+                minCount_ = s;
+                minHistoryCount_ = static_cast<uint32_t>(std::min<uint64_t>(std::numeric_limits<uint32_t>::max(),
+                                                                            static_cast<uint64_t>(s) * kHistoryFactors[f]));
+            }
+        }
+        if (!fits) {
+            std::cerr << "CompactModel: budget of " << options.budgetBytes << " bytes is below the " << fixedBytes
+                      << " needed for the vocabulary and unigrams\n";
+        }
+    }
+
+    keys_.clear();
+    rowStart_.assign(1, 0);
+    ids_.clear();
+    codes_.clear();
+    for (const auto &src : sources) {
+        if (src.total < minHistoryCount_) continue;
+        select(src.row, minCount_, topK_, kept);
+        if (kept.empty()) continue;
+        std::sort(kept.begin(), kept.end(), [&](const NGramTable::Entry& a, const NGramTable::Entry& b) { return idOf(a.token) < idOf(b.token); });
+        keys_.push_back(src.key);
+        for (const auto &e : kept) {
+            ids_.push_back(static_cast<uint16_t>(idOf(e.token)));
+            const uint32_t code = encode(e.count);
+            codes_.push_back(static_cast<uint8_t>(code));
+            if (countBits_ == 16) codes_.push_back(static_cast<uint8_t>(code >> 8));
+        }
+        rowStart_.push_back(static_cast<uint32_t>(ids_.size()));
+    }
+    denseIds_.shrink_to_fit();
+    sparseIds_.shrink_to_fit();
+    tokens_.shrink_to_fit();
+    levels_.shrink_to_fit();
+    unigrams_.shrink_to_fit();
+    keys_.shrink_to_fit();
+    rowStart_.shrink_to_fit();
+    ids_.shrink_to_fit();
+    codes_.shrink_to_fit();
+    return fits;
+}
+
+uint32_t CompactModel::idOf(int token) const {
+    if (token >= 0 && static_cast<size_t>(token) < denseIds_.size()) return denseIds_[static_cast<size_t>(token)];
+    auto pos = std::lower_bound(sparseIds_.begin(), sparseIds_.end(), token,
+                                [](const std::pair<int32_t, uint32_t>& e, int t) { return e.first < t; });
+    return (pos != sparseIds_.end() && pos->first == token) ? pos->second : 0;
+}
+
+uint32_t CompactModel::countAt(size_t entry) const {
+    if (countBits_ == 8) return levels_[codes_[entry]];
+    return decode16(codes_[2 * entry] | (static_cast<uint32_t>(codes_[2 * entry + 1]) << 8));
+}
+
+CompactModel::Row CompactModel::find(const int* history, size_t length, const PitchMask* mask) const {
+    const size_t maxK = std::min<size_t>(static_cast<size_t>(order_), length);
+    uint64_t keys[MarkovModel::kMaxOrder];
+    size_t known = 0;
+    uint64_t key = 0;
+    for (; known < maxK; ++known) {
+        const uint32_t id = idOf(history[length - 1 - known]);
+        if (id == 0 || id > maxPackedId_) break;
+        key |= static_cast<uint64_t>(id) << (bitsPerToken_ * known);
+        keys[known] = key;
+    }
+    for (size_t k = known; k >= 1; --k) {
+        auto pos = std::lower_bound(keys_.begin(), keys_.end(), keys[k - 1]);
+        if (pos == keys_.end() || *pos != keys[k - 1]) continue;
+        const size_t r = static_cast<size_t>(pos - keys_.begin());
+        Row row;
+        row.first = rowStart_[r];
+        row.ids = ids_.data() + row.first;
+        row.size = rowStart_[r + 1] - rowStart_[r];
+        if (mask && std::none_of(row.ids, row.ids + row.size, [&](uint16_t id) { return mask->test(tokens_[id - 1]); })) continue;
+        return row;
+    }
+    return Row();
+}
+
+uint64_t CompactModel::unigramCount(int token) const {
+    auto pos = std::lower_bound(unigrams_.begin(), unigrams_.end(), token,
+                                [](const NGramTable::Entry& e, int t) { return e.token < t; });
+    return (pos != unigrams_.end() && pos->token == token) ? pos->count : 0;
+}
+
+int CompactModel::sampleNext(const int* history, size_t length, double temperature, Rng& rng) const {
+    const Row row = find(history, length);
+    if (row.size == 0) {
+        const uint32_t size = static_cast<uint32_t>(unigrams_.size());
+        const uint32_t i = WeightedDraw::draw(size, [&](uint32_t k) { return unigrams_[k].count; }, nullptr, temperature, rng);
+        return i < size ? unigrams_[i].token : 0;
+    }
+    const uint32_t i = WeightedDraw::draw(row.size, [&](uint32_t k) { return countAt(row.first + k); }, nullptr, temperature, rng);
+    return i < row.size ? tokens_[row.ids[i] - 1] : 0;
+}
+
+bool CompactModel::sampleMasked(const int* history, size_t length, double temperature, const PitchMask& mask, Rng& rng, int& out) const {
+    const Row row = find(history, length, &mask);
+    if (row.size == 0) {
+        const uint32_t size = static_cast<uint32_t>(unigrams_.size());
+        const uint32_t i = WeightedDraw::draw(size, [&](uint32_t k) { return mask.test(unigrams_[k].token) ? unigrams_[k].count : 0u; },
+                                              nullptr, temperature, rng);
+        if (i == size) return false;
+        out = unigrams_[i].token;
+        return true;
+    }
+    const uint32_t i = WeightedDraw::draw(row.size, [&](uint32_t k) { return mask.test(tokens_[row.ids[k] - 1]) ? countAt(row.first + k) : 0u; },
+                                          nullptr, temperature, rng);
+    if (i == row.size) return false;
+    out = tokens_[row.ids[i] - 1];
+    return true;
+}
+
+double CompactModel::probability(const int* history, size_t length, int token) const {
+    const double unigram = unigramEstimate(unigramCount(token), unigramTotal_, unigrams_.size());
+    const Row row = find(history, length);
+    if (row.size == 0) return unigram;
+    const uint32_t id = idOf(token);
+    uint64_t total = 0, count = 0;
+    for (uint32_t i = 0; i < row.size; ++i) {
+        const uint32_t c = countAt(row.first + i);
+        total += c;
+        if (row.ids[i] == id) count = c;
+    }
+    return interpolate(count, total, row.size, unigram);
+}
+
+double CompactModel::perplexity(const std::vector<std::vector<int>>& sequences) const {
+    return score(sequences, [this](const int* history, size_t length, int token) { return probability(history, length, token); });
+}
+
+double CompactModel::perplexity(const MarkovModel& model, const std::vector<std::vector<int>>& sequences) {
+    uint64_t unigramTotal = 0;
+    for (const auto &e : model.unigramCounts_) unigramTotal += e.count;
+    return score(sequences, [&](const int* history, size_t length, int token) {
+        auto pos = std::lower_bound(model.unigramCounts_.begin(), model.unigramCounts_.end(), token,
+                                    [](const NGramTable::Entry& e, int t) { return e.token < t; });
+        const uint64_t u = (pos != model.unigramCounts_.end() && pos->token == token) ? pos->count : 0;
+        const double unigram = unigramEstimate(u, unigramTotal, model.unigramCounts_.size());
+        const NGramTable::Row row = model.findWithBackoff(history, length);
+        if (row.data == model.unigramCounts_.data()) return unigram;
+        uint64_t total = 0, count = 0;
+        for (const auto &e : row) {
+            total += e.count;
+            if (e.token == token) count = e.count;
+        }
+        return interpolate(count, total, row.size, unigram);
+    });
+}
+
+size_t CompactModel::memoryBytes() const {
+    return denseIds_.capacity() * sizeof(uint32_t) + sparseIds_.capacity() * sizeof(sparseIds_[0]) +
+           tokens_.capacity() * sizeof(int32_t) + keys_.capacity() * sizeof(uint64_t) +
+           rowStart_.capacity() * sizeof(uint32_t) + ids_.capacity() * sizeof(uint16_t) + codes_.capacity() +
+           levels_.capacity() * sizeof(uint32_t) + unigrams_.capacity() * sizeof(NGramTable::Entry);
+}
@@ -0,0 +1,177 @@
+#include "ContextTree.h"
+#include "WeightedDraw.h"
+
+#include <algorithm>
+
+ContextTree::ContextTree(int maxOrder, uint32_t minCount)
+    : maxOrder_(std::min(kMaxOrder, std::max(1, maxOrder))), minCount_(std::max<uint32_t>(1, minCount)) {}
+
+void ContextTree::build(const std::vector<std::vector<int>>& sequences) {
+    buildFrom(sequences);
+}
+
+void ContextTree::build(const std::vector<Span<const uint8_t>>& sequences) {
+    buildFrom(sequences);
+}
+
+template <class Seq>
+void ContextTree::buildFrom(const std::vector<Seq>& sequences) {
+    // Every token of every sequence is one occurrence of "token follows its
+    // context"; flat[] holds the tokens and start[] where each one's
+    // sequence begins, which bounds how far back its context reaches.
+    std::vector<int32_t> flat;
+    std::vector<uint32_t> start;
+    for (const auto &s : sequences) {
+        const uint32_t first = static_cast<uint32_t>(flat.size());
+        for (size_t i = 0; i < s.size(); ++i) {
+            flat.push_back(static_cast<int32_t>(s[i]));
+            start.push_back(first);
+        }
+    }
+    std::vector<uint32_t> pos(flat.size());
+    for (uint32_t p = 0; p < pos.size(); ++p) pos[p] = p;
+
+    nodes_.clear();
+    tokens_.clear();
+    rootChild_.clear();
+    entries_.clear();
+    cumulative_.clear();
+    nodes_.push_back(Node{ 0, 0, 0, 0 });
+    tokens_.push_back(0);
+    if (flat.empty()) return;
+
+    // Breadth-first: each node's occurrences are a range of pos[] sharing
+    // its context. Sorting the range on the token one step further back
+    // splits it into the children, which are appended together, so every
+    // node's children end up contiguous and sorted by token.
+    struct Range {
+        uint32_t lo, hi;
+    };
+    std::vector<Range> ranges;
+    ranges.push_back(Range{ 0, static_cast<uint32_t>(pos.size()) });
+    std::vector<int32_t> next;
+    for (size_t n = 0, levelEnd = 1, depth = 0; n < nodes_.size(); ++n) {
+        if (n == levelEnd) {
+            levelEnd = nodes_.size();
+            ++depth;
+        }
+        const Range r = ranges[n];
+
+        // Successor counts.
+        next.clear();
+        for (uint32_t i = r.lo; i < r.hi; ++i) next.push_back(flat[pos[i]]);
+        std::sort(next.begin(), next.end());
+        nodes_[n].firstEntry = static_cast<uint32_t>(entries_.size());
+        uint32_t running = 0;
+        for (size_t i = 0; i < next.size();) {
+            size_t j = i;
+            while (j < next.size() && next[j] == next[i]) ++j;
+            running += static_cast<uint32_t>(j - i);
+            entries_.push_back(NGramTable::Entry{ next[i], static_cast<uint32_t>(j - i) });
+            cumulative_.push_back(running);
+            i = j;
+        }
+        nodes_[n].entryCount = static_cast<uint32_t>(entries_.size()) - nodes_[n].firstEntry;
+
+        // Children: occurrences whose context reaches one token further.
+        if (depth >= static_cast<size_t>(maxOrder_)) continue;
+        auto reaches = [&](uint32_t p) { return p - start[p] > depth; };
+        uint32_t *lo = pos.data() + r.lo, *hi = pos.data() + r.hi;
+        uint32_t *mid = std::partition(lo, hi, [&](uint32_t p) { return !reaches(p); });
+        std::sort(mid, hi, [&](uint32_t a, uint32_t b) { return flat[a - 1 - depth] < flat[b - 1 - depth]; });
+        nodes_[n].firstChild = static_cast<uint32_t>(nodes_.size());
+        for (uint32_t *i = mid; i < hi;) {
+            const int32_t token = flat[*i - 1 - depth];
+            uint32_t *j = i;
+            while (j < hi && flat[*j - 1 - depth] == token) ++j;
+            if (static_cast<uint32_t>(j - i) >= minCount_) {
+                nodes_.push_back(Node{ 0, 0, 0, 0 });
+                tokens_.push_back(token);
+                ranges.push_back(Range{ static_cast<uint32_t>(i - pos.data()), static_cast<uint32_t>(j - pos.data()) });
+            }
+            i = j;
+        }
+        nodes_[n].childCount = static_cast<uint32_t>(nodes_.size()) - nodes_[n].firstChild;
+    }
+    nodes_.shrink_to_fit();
+    tokens_.shrink_to_fit();
+    entries_.shrink_to_fit();
+    cumulative_.shrink_to_fit();
+
+    // Pitches and note tokens are small, so the first step, which every
+    // lookup takes, is an array index rather than a search.
+    const Node &root = nodes_[0];
+    const int32_t *first = tokens_.data() + root.firstChild;
+    if (root.childCount > 0 && first[0] >= 0 && first[root.childCount - 1] < kRootIndexLimit) {
+        rootChild_.assign(static_cast<size_t>(first[root.childCount - 1]) + 1, 0);
+        for (uint32_t c = 0; c < root.childCount; ++c) rootChild_[static_cast<size_t>(first[c])] = root.firstChild + c;
+    }
+}
+
+NGramTable::Row ContextTree::row(const Node& n) const {
+    NGramTable::Row out;
+    out.data = entries_.data() + n.firstEntry;
+    out.size = n.entryCount;
+    out.cumulative = cumulative_.data() + n.firstEntry;
+    return out;
+}
+
+NGramTable::Row ContextTree::lookup(const int* history, size_t length, size_t* depth) const {
+    size_t d = 0;
+    if (nodes_.empty()) {
+        if (depth) *depth = 0;
+        return NGramTable::Row();
+    }
+    const Node *node = &nodes_[0];
+    const size_t maxK = std::min<size_t>(length, static_cast<size_t>(maxOrder_));
+    if (maxK > 0 && !rootChild_.empty()) {
+        const int token = history[length - 1];
+        const uint32_t child = token >= 0 && static_cast<size_t>(token) < rootChild_.size() ? rootChild_[static_cast<size_t>(token)] : 0;
+        if (child == 0) {
+            if (depth) *depth = 0;
+            return row(*node);
+        }
+        node = &nodes_[child];
+        d = 1;
+    }
+    for (; d < maxK && node->childCount > 0; ++d) {
+        const int token = history[length - 1 - d];
+        const int32_t *first = tokens_.data() + node->firstChild;
+        const int32_t *last = first + node->childCount;
+        const int32_t *child = std::lower_bound(first, last, token);
+        if (child == last || *child != token) break;
+        node = &nodes_[static_cast<size_t>(child - tokens_.data())];
+    }
+    if (depth) *depth = d;
+    return row(*node);
+}
+
+int ContextTree::sampleNext(const int* history, size_t length, double temperature, Rng& rng) const {
+    const NGramTable::Row counts = lookup(history, length);
+    // Prefix sums restart at every row.
+    const uint32_t i = WeightedDraw::draw(counts.size, [&](uint32_t k) { return counts[k].count; }, counts.cumulative, temperature, rng);
+    return i < counts.size ? counts[i].token : 0;
+}
+
+bool ContextTree::sampleMasked(const int* history, size_t length, double temperature, const PitchMask& mask, Rng& rng, int& out) const {
+    size_t depth = 0;
+    NGramTable::Row counts = lookup(history, length, &depth);
+    for (;;) {
+        // A row with nothing allowed leaves rng alone; every suffix of a
+        // context in the tree is in the tree too, so back off one token.
+        const uint32_t i = WeightedDraw::draw(counts.size, [&](uint32_t k) { return mask.test(counts[k].token) ? counts[k].count : 0u; },
+                                              nullptr, temperature, rng);
+        if (i < counts.size) {
+            out = counts[i].token;
+            return true;
+        }
+        if (depth == 0) return false;
+        counts = lookup(history + length - (depth - 1), depth - 1, &depth);
+    }
+}
+
+size_t ContextTree::memoryBytes() const {
+    return nodes_.capacity() * sizeof(Node) + tokens_.capacity() * sizeof(int32_t) +
+           rootChild_.capacity() * sizeof(uint32_t) + entries_.capacity() * sizeof(NGramTable::Entry) +
+           cumulative_.capacity() * sizeof(uint32_t);
+}
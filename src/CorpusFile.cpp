@@ -0,0 +1,207 @@
+#include "CorpusFile.h"
+#include "NoteStore.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+const char kMagic[8] = { 'M', 'G', 'C', 'O', 'R', 'P', 'U', 'S' };
+const uint32_t kByteOrder = 0x01020304u;
+const size_t kAlign = 64;
+
+size_t alignUp(size_t v) {
+    return (v + kAlign - 1) / kAlign * kAlign;
+}
+
+// The header, with its checksum field zeroed, followed by the rest of the
+// file; the offsets and counts the reader trusts are covered too.
+template <class Header>
+uint64_t fileChecksum(Header header, const unsigned char* base, size_t size) {
+    static_assert(sizeof(Header) % 8 == 0, "checksum64 continues only after whole words");
+    header.checksum = 0;
+    const uint64_t h = Utils::checksum64(reinterpret_cast<const unsigned char*>(&header), sizeof(header));
+    return Utils::checksum64(base + sizeof(Header), size - sizeof(Header), h);
+}
+
+}
+
+CorpusFile::Sequence CorpusFile::fromNotes(const std::string& name, const std::vector<NoteEvent>& notes) {
+    Sequence seq;
+    seq.name = name;
+    seq.pitches.reserve(notes.size());
+    seq.durations.reserve(notes.size());
+    for (const auto &n : notes) {
+        seq.pitches.push_back(static_cast<uint8_t>(std::min(127, std::max(0, n.pitch))));
+        seq.durations.push_back(n.duration);
+    }
+    return seq;
+}
+
+CorpusFile::Sequence CorpusFile::fromNotes(const std::string& name, const NoteStore& notes) {
+    Sequence seq;
+    seq.name = name;
+    Span<const uint8_t> pitches = notes.pitches();
+    seq.pitches.resize(pitches.size());
+    for (size_t i = 0; i < pitches.size(); ++i) seq.pitches[i] = std::min<uint8_t>(127, pitches[i]);
+    seq.durations.assign(notes.durations().begin(), notes.durations().end());
+    return seq;
+}
+
+bool CorpusFile::write(const std::string& path, const std::vector<Sequence>& sequences) {
+    std::vector<SequenceEntry> index(sequences.size());
+    std::string names;
+    uint64_t totalNotes = 0;
+    for (size_t i = 0; i < sequences.size(); ++i) {
+        const Sequence &s = sequences[i];
+        index[i] = SequenceEntry{ totalNotes, static_cast<uint32_t>(s.pitches.size()),
+                                  static_cast<uint32_t>(names.size()), static_cast<uint32_t>(s.name.size()), 0 };
+        names += s.name;
+        totalNotes += s.pitches.size();
+    }
+
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.byteOrder = kByteOrder;
+    header.sequenceCount = sequences.size();
+    header.totalNotes = totalNotes;
+    header.namesOffset = alignUp(sizeof(Header) + index.size() * sizeof(SequenceEntry));
+    header.pitchesOffset = alignUp(header.namesOffset + names.size());
+    header.durationsOffset = alignUp(header.pitchesOffset + totalNotes);
+    header.fileSize = alignUp(header.durationsOffset + totalNotes * sizeof(double));
+
+    std::vector<unsigned char> image(header.fileSize, 0);
+    if (!index.empty()) std::memcpy(image.data() + sizeof(Header), index.data(), index.size() * sizeof(SequenceEntry));
+    if (!names.empty()) std::memcpy(image.data() + header.namesOffset, names.data(), names.size());
+    for (size_t i = 0; i < sequences.size(); ++i) {
+        const Sequence &s = sequences[i];
+        const size_t n = std::min(s.pitches.size(), s.durations.size());
+        if (n != s.pitches.size() || n != s.durations.size()) {
+            std::cerr << "CorpusFile::write: sequence '" << s.name << "' has mismatched pitch/duration counts\n";
+            return false;
+        }
+        if (n == 0) continue;
+        std::memcpy(image.data() + header.pitchesOffset + index[i].firstNote, s.pitches.data(), n);
+        std::memcpy(image.data() + header.durationsOffset + index[i].firstNote * sizeof(double), s.durations.data(), n * sizeof(double));
+    }
+    header.checksum = fileChecksum(header, image.data(), image.size());
+    std::memcpy(image.data(), &header, sizeof(header));
+
+    const std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            std::cerr << "CorpusFile::write: failed to open " << tmpPath << " for writing\n";
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(image.data()), static_cast<std::streamsize>(image.size()));
+        if (!out.good()) {
+            std::cerr << "CorpusFile::write: write failed for " << tmpPath << '\n';
+            return false;
+        }
+    }
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "CorpusFile::write: failed to move " << tmpPath << " to " << path << '\n';
+        return false;
+    }
+    return true;
+}
+
+bool CorpusFile::open(const std::string& path, bool verifyChecksum) {
+    close();
+    if (!file_.open(path)) return false;
+
+    const unsigned char *base = file_.data();
+    const size_t size = file_.size();
+    Header h;
+    if (size < sizeof(h)) {
+        std::cerr << "CorpusFile::open: " << path << " is too small to be a corpus file\n";
+        close();
+        return false;
+    }
+    std::memcpy(&h, base, sizeof(h));
+    if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.byteOrder != kByteOrder || h.version != kVersion) {
+        std::cerr << "CorpusFile::open: " << path << " is not a version " << kVersion << " corpus file for this platform\n";
+        close();
+        return false;
+    }
+    // Every bound is a comparison against what is left of the file, so no
+    // header value can wrap the arithmetic around.
+    const bool fits = h.fileSize == size &&
+                      h.sequenceCount <= (size - sizeof(Header)) / sizeof(SequenceEntry) &&
+                      h.namesOffset >= sizeof(Header) + h.sequenceCount * sizeof(SequenceEntry) &&
+                      h.pitchesOffset >= h.namesOffset && h.pitchesOffset <= size && h.totalNotes <= size - h.pitchesOffset &&
+                      h.durationsOffset % alignof(double) == 0 && h.durationsOffset >= h.pitchesOffset &&
+                      h.durationsOffset - h.pitchesOffset >= h.totalNotes && h.durationsOffset <= size &&
+                      h.totalNotes <= (size - h.durationsOffset) / sizeof(double);
+    if (!fits) {
+        std::cerr << "CorpusFile::open: " << path << " is truncated or corrupt\n";
+        close();
+        return false;
+    }
+    if (verifyChecksum && fileChecksum(h, base, size) != h.checksum) {
+        std::cerr << "CorpusFile::open: checksum mismatch in " << path << '\n';
+        close();
+        return false;
+    }
+
+    index_ = reinterpret_cast<const SequenceEntry*>(base + sizeof(Header));
+    names_ = reinterpret_cast<const char*>(base + h.namesOffset);
+    pitches_ = base + h.pitchesOffset;
+    durations_ = reinterpret_cast<const double*>(base + h.durationsOffset);
+    count_ = static_cast<size_t>(h.sequenceCount);
+    totalNotes_ = static_cast<size_t>(h.totalNotes);
+
+    const uint64_t namesBytes = h.pitchesOffset - h.namesOffset;
+    for (size_t i = 0; i < count_; ++i) {
+        const SequenceEntry &e = index_[i];
+        if (e.firstNote > totalNotes_ || e.noteCount > totalNotes_ - e.firstNote || e.nameOffset > namesBytes ||
+            e.nameLength > namesBytes - e.nameOffset) {
+            std::cerr << "CorpusFile::open: sequence " << i << " lies outside " << path << '\n';
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void CorpusFile::close() {
+    file_.close();
+    index_ = nullptr;
+    names_ = nullptr;
+    pitches_ = nullptr;
+    durations_ = nullptr;
+    count_ = 0;
+    totalNotes_ = 0;
+}
+
+std::string CorpusFile::name(size_t i) const {
+    return std::string(names_ + index_[i].nameOffset, index_[i].nameLength);
+}
+
+Span<const uint8_t> CorpusFile::pitches(size_t i) const {
+    return Span<const uint8_t>(pitches_ + index_[i].firstNote, index_[i].noteCount);
+}
+
+Span<const double> CorpusFile::durations(size_t i) const {
+    return Span<const double>(durations_ + index_[i].firstNote, index_[i].noteCount);
+}
+
+std::vector<Span<const uint8_t>> CorpusFile::allPitches() const {
+    std::vector<Span<const uint8_t>> out;
+    out.reserve(count_);
+    for (size_t i = 0; i < count_; ++i) out.push_back(pitches(i));
+    return out;
+}
+
+std::vector<Span<const double>> CorpusFile::allDurations() const {
+    std::vector<Span<const double>> out;
+    out.reserve(count_);
+    for (size_t i = 0; i < count_; ++i) out.push_back(durations(i));
+    return out;
+}
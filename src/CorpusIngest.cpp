@@ -0,0 +1,124 @@
+#include "CorpusIngest.h"
+#include "MidiParser.h"
+#include "NoteStore.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <set>
+#include <sstream>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+CorpusIngest::CorpusIngest(std::string melodyFolder, std::string durationFolder, IngestOptions options)
+    : melodyFolder_(std::move(melodyFolder)), durationFolder_(std::move(durationFolder)), options_(std::move(options)) {}
+
+std::string CorpusIngest::settings() const {
+    std::ostringstream out;
+    out << "channels=" << std::hex << options_.filter.channels << std::dec << " tracks=";
+    if (options_.filter.tracks.empty()) out << "all";
+    for (size_t i = 0; i < options_.filter.tracks.size(); ++i) out << (i ? "," : "") << options_.filter.tracks[i];
+    out << " bass=" << (options_.filter.skipBass ? "skip" : "keep") << " melody=" << MelodyExtractor::modeName(options_.melody);
+    if (!options_.transposeTo.chromatic()) out << " transpose=" << options_.transposeTo.name();
+    return out.str();
+}
+
+std::vector<std::string> CorpusIngest::listMidiFiles(const std::string& folder) {
+    std::vector<std::string> out;
+    if (!fs::exists(folder)) return out;
+    for (auto& entry : fs::directory_iterator(folder)) {
+        if (!entry.is_regular_file()) continue;
+        if (entry.path().extension() == ".mid" || entry.path().extension() == ".midi") {
+            out.push_back(entry.path().string());
+        }
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+std::vector<std::string> CorpusIngest::outputNames(const std::vector<std::string>& midiPaths) {
+    std::map<std::string, size_t> stems;
+    for (const auto &p : midiPaths) ++stems[fs::path(p).stem().string()];
+
+    std::vector<std::string> names(midiPaths.size());
+    std::map<std::string, size_t> fileNames;
+    for (size_t i = 0; i < midiPaths.size(); ++i) {
+        const fs::path path(midiPaths[i]);
+        const std::string stem = path.stem().string();
+        bool shared = stems[stem] > 1;
+        for (const char *ext : { ".mid", ".midi" }) {
+            std::error_code ec;
+            const fs::path sibling = path.parent_path() / (stem + ext);
+            shared = shared || (sibling != path && fs::exists(sibling, ec));
+        }
+        names[i] = shared ? path.filename().string() : stem;
+        if (shared) ++fileNames[names[i]];
+    }
+    std::set<std::string> taken;
+    for (size_t i = 0; i < midiPaths.size(); ++i) {
+        const fs::path path(midiPaths[i]);
+        auto it = fileNames.find(names[i]);
+        if (it != fileNames.end() && it->second > 1) names[i] = path.parent_path().filename().string() + "_" + names[i];
+        if (!taken.insert(names[i]).second) {
+            std::cerr << "CorpusIngest: text output '" << names[i] << "' of " << midiPaths[i]
+                      << " is already used by another file; not exporting it\n";
+            names[i].clear();
+        }
+    }
+    return names;
+}
+
+IngestResult CorpusIngest::run(const std::vector<std::string>& midiPaths, ThreadPool& pool) const {
+    auto t0 = std::chrono::steady_clock::now();
+
+    IngestResult result;
+    result.files.resize(midiPaths.size());
+    result.sequences.resize(midiPaths.size());
+    std::vector<std::string> names;
+    if (options_.exportText) names = outputNames(midiPaths);
+    for (size_t i = 0; i < midiPaths.size(); ++i) {
+        std::error_code ec;
+        result.files[i].path = midiPaths[i];
+        result.files[i].name = options_.exportText ? names[i] : fs::path(midiPaths[i]).stem().string();
+        result.files[i].bytes = fs::file_size(midiPaths[i], ec);
+        if (ec) result.files[i].bytes = 0;
+    }
+
+    // Hand out the biggest files first so a large straggler does not start last;
+    // stealing evens out the rest.
+    std::vector<size_t> order(midiPaths.size());
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return result.files[a].bytes > result.files[b].bytes;
+    });
+
+    pool.parallelFor(order.size(), [&](size_t k) {
+        IngestedFile &f = result.files[order[k]];
+        Parser parser;
+        NoteStore parsed, notes;
+        parser.parseMidiFile(f.path, parsed, options_.filter);
+        MelodyExtractor(options_.melody).extract(parsed, notes);
+        if (!options_.transposeTo.chromatic()) {
+            f.transposition = options_.transposeTo.bestTransposition(notes.pitches());
+            notes.transpose(f.transposition);
+        }
+        if (options_.exportText && !f.name.empty()) {
+            auto events = notes.toEvents();
+            parser.exportMelodyTxt(events, (fs::path(melodyFolder_) / (f.name + ".txt")).string());
+            parser.exportDurationTxt(events, (fs::path(durationFolder_) / (f.name + "_dur.txt")).string());
+        }
+        result.sequences[order[k]] = CorpusFile::fromNotes(f.path, notes);
+        f.notes = notes.size();
+    });
+
+    for (const auto &f : result.files) {
+        result.totalNotes += f.notes;
+        result.totalBytes += f.bytes;
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return result;
+}
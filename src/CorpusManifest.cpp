@@ -0,0 +1,146 @@
+#include "CorpusManifest.h"
+#include "MappedFile.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// v3 records the ingest settings the corpus was built with; v4 corpora name
+// their sequences by manifest path rather than by stem.
+const char kHeader[] = "# musicgen manifest v4";
+const char kIngestPrefix[] = "# ingest ";
+
+bool byPath(const ManifestEntry& a, const ManifestEntry& b) {
+    return a.path < b.path;
+}
+
+bool stat(const std::string& path, ManifestEntry& out) {
+    std::error_code ec;
+    out.path = path;
+    out.bytes = fs::file_size(path, ec);
+    if (ec) return false;
+    out.mtime = static_cast<int64_t>(fs::last_write_time(path, ec).time_since_epoch().count());
+    return !ec;
+}
+
+}
+
+bool CorpusManifest::describe(const std::string& path, ManifestEntry& out) {
+    if (!stat(path, out)) return false;
+    MappedFile file;
+    if (out.bytes != 0 && !file.open(path)) return false;
+    out.hash = Utils::checksum64(file.data(), file.size());
+    return true;
+}
+
+bool CorpusManifest::load(const std::string& path) {
+    entries_.clear();
+    ingest_.clear();
+    std::ifstream in(path);
+    if (!in.is_open()) return false;
+    std::string line;
+    if (!std::getline(in, line) || line != kHeader) {
+        std::cerr << "CorpusManifest::load: " << path << " is not a version 4 manifest\n";
+        return false;
+    }
+    if (!std::getline(in, line) || line.compare(0, sizeof(kIngestPrefix) - 1, kIngestPrefix) != 0) {
+        std::cerr << "CorpusManifest::load: " << path << " has no ingest line\n";
+        return false;
+    }
+    ingest_ = line.substr(sizeof(kIngestPrefix) - 1);
+    while (std::getline(in, line)) {
+        if (line.empty()) continue;
+        std::istringstream fields(line);
+        ManifestEntry e;
+        fields >> std::hex >> e.hash >> std::dec >> e.bytes >> e.mtime;
+        fields.get();   // the single space before the path
+        std::getline(fields, e.path);
+        if (fields.fail() || e.path.empty()) {
+            std::cerr << "CorpusManifest::load: malformed line in " << path << '\n';
+            entries_.clear();
+            return false;
+        }
+        entries_.push_back(std::move(e));
+    }
+    std::sort(entries_.begin(), entries_.end(), byPath);
+    return true;
+}
+
+bool CorpusManifest::save(const std::string& path) const {
+    const std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::trunc);
+        if (!out.is_open()) {
+            std::cerr << "CorpusManifest::save: failed to open " << tmpPath << " for writing\n";
+            return false;
+        }
+        out << kHeader << '\n';
+        out << kIngestPrefix << ingest_ << '\n';
+        for (const auto &e : entries_) {
+            out << std::hex << e.hash << std::dec << ' ' << e.bytes << ' ' << e.mtime << ' ' << e.path << '\n';
+        }
+        if (!out.good()) {
+            std::cerr << "CorpusManifest::save: write failed for " << tmpPath << '\n';
+            return false;
+        }
+    }
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "CorpusManifest::save: failed to move " << tmpPath << " to " << path << '\n';
+        return false;
+    }
+    return true;
+}
+
+const ManifestEntry* CorpusManifest::find(const std::string& path) const {
+    ManifestEntry key;
+    key.path = path;
+    auto pos = std::lower_bound(entries_.begin(), entries_.end(), key, byPath);
+    return (pos != entries_.end() && pos->path == path) ? &*pos : nullptr;
+}
+
+CorpusManifest::Delta CorpusManifest::diff(const std::vector<std::string>& paths) const {
+    Delta delta;
+    std::vector<std::string> present(paths);
+    std::sort(present.begin(), present.end());
+    for (const auto &p : present) {
+        const ManifestEntry *known = find(p);
+        ManifestEntry now;
+        if (!stat(p, now)) continue;
+        if (known && known->bytes == now.bytes && known->mtime == now.mtime) continue;
+        if (!describe(p, now)) {
+            std::cerr << "CorpusManifest::diff: failed to read " << p << '\n';
+            continue;
+        }
+        if (!known) delta.added.push_back(now);
+        else if (known->hash != now.hash || known->bytes != now.bytes) delta.changed.push_back(now);
+        else delta.touched.push_back(now);
+    }
+    for (const auto &e : entries_) {
+        if (!std::binary_search(present.begin(), present.end(), e.path)) delta.removed.push_back(e);
+    }
+    return delta;
+}
+
+void CorpusManifest::apply(const Delta& delta) {
+    std::vector<ManifestEntry> updates;
+    updates.insert(updates.end(), delta.added.begin(), delta.added.end());
+    updates.insert(updates.end(), delta.changed.begin(), delta.changed.end());
+    updates.insert(updates.end(), delta.touched.begin(), delta.touched.end());
+    for (const auto &e : delta.removed) {
+        auto pos = std::lower_bound(entries_.begin(), entries_.end(), e, byPath);
+        if (pos != entries_.end() && pos->path == e.path) entries_.erase(pos);
+    }
+    for (const auto &e : updates) {
+        auto pos = std::lower_bound(entries_.begin(), entries_.end(), e, byPath);
+        if (pos != entries_.end() && pos->path == e.path) *pos = e;
+        else entries_.insert(pos, e);
+    }
+}
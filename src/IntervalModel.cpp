@@ -0,0 +1,88 @@
+#include "IntervalModel.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace {
+
+bool rowHas(const NGramTable::Row& row, int token) {
+    for (const auto &e : row) {
+        if (e.token == token) return true;
+    }
+    return false;
+}
+
+}
+
+template <class PitchSeq>
+void IntervalModel::tokenize(const PitchSeq& pitches, std::vector<int>& out) {
+    out.clear();
+    if (pitches.size() < 2) return;
+    out.reserve(pitches.size() - 1);
+    for (size_t i = 1; i < pitches.size(); ++i) out.push_back(token(static_cast<int>(pitches[i - 1]), static_cast<int>(pitches[i])));
+}
+
+void IntervalModel::trainMany(const std::vector<Span<const uint8_t>>& pitches, ThreadPool& pool) {
+    std::vector<std::vector<int>> tokens(pitches.size());
+    pool.parallelFor(tokens.size(), [&](size_t i) { tokenize(pitches[i], tokens[i]); });
+    markov_.trainMany(tokens, pool);
+}
+
+void IntervalModel::trainMany(const std::vector<std::vector<int>>& pitches) {
+    std::vector<std::vector<int>> tokens(pitches.size());
+    for (size_t i = 0; i < tokens.size(); ++i) tokenize(pitches[i], tokens[i]);
+    markov_.trainMany(tokens);
+}
+
+size_t IntervalModel::steps(const int* pitches, size_t length, int* out) const {
+    const size_t n = std::min(length, static_cast<size_t>(markov_.order()) + 1);
+    const int* newest = pitches + length - n;
+    for (size_t i = 1; i < n; ++i) out[i - 1] = token(newest[i - 1], newest[i]);
+    return n ? n - 1 : 0;
+}
+
+int IntervalModel::sampleNext(const int* pitches, size_t length, double temperature, Rng& rng) const {
+    if (length == 0) return 0;
+    int history[MarkovModel::kMaxOrder];
+    const size_t n = steps(pitches, length, history);
+    return pitches[length - 1] + markov_.sampleNext(history, n, temperature, rng) - kOffset;
+}
+
+bool IntervalModel::sampleMasked(const int* pitches, size_t length, double temperature, const PitchMask& allowed, Rng& rng, int& out) const {
+    if (length == 0) return false;
+    int history[MarkovModel::kMaxOrder];
+    const size_t n = steps(pitches, length, history);
+    const int last = pitches[length - 1];
+    // Pitch p is allowed exactly when token p - last + kOffset is.
+    int step;
+    if (!markov_.sampleMasked(history, n, temperature, allowed.shifted(kOffset - last), rng, step)) return false;
+    out = last + step - kOffset;
+    return true;
+}
+
+double IntervalModel::coverage(const std::vector<std::vector<int>>& pitches) const {
+    const size_t order = static_cast<size_t>(markov_.order());
+    uint64_t seen = 0, total = 0;
+    std::vector<int> tokens;
+    for (const auto &seq : pitches) {
+        tokenize(seq, tokens);
+        // Step j leads to note j + 1, which has j + 1 predecessors.
+        for (size_t j = order; j < tokens.size(); ++j) {
+            ++total;
+            seen += rowHas(markov_.lookupSeen(tokens.data() + j - order, order, order), tokens[j]);
+        }
+    }
+    return total ? static_cast<double>(seen) / static_cast<double>(total) : 0.0;
+}
+
+double IntervalModel::coverage(const MarkovModel& model, const std::vector<std::vector<int>>& pitches) {
+    const size_t order = static_cast<size_t>(model.order());
+    uint64_t seen = 0, total = 0;
+    for (const auto &seq : pitches) {
+        for (size_t i = order + 1; i < seq.size(); ++i) {
+            ++total;
+            seen += rowHas(model.lookupSeen(seq.data() + i - order, order, order), seq[i]);
+        }
+    }
+    return total ? static_cast<double>(seen) / static_cast<double>(total) : 0.0;
+}
@@ -0,0 +1,50 @@
+#include "JointModel.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <iostream>
+
+template <class PitchSeq, class DurationSeq>
+void JointModel::tokenize(const PitchSeq& pitches, const DurationSeq& durations, const RhythmQuantizer& quantizer, std::vector<int>& out) {
+    const size_t n = std::min<size_t>(pitches.size(), durations.size());
+    out.clear();
+    out.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        const int pitch = static_cast<int>(pitches[i]);
+        const double d = durations[i];
+        // Rests and out-of-range pitches have no joint token; as in the
+        // factored models, the sequence closes up around them.
+        if (!(d > 0.0) || pitch < 0 || pitch > 127) continue;
+        out.push_back(pack(pitch, quantizer.token(d)));
+    }
+}
+
+void JointModel::trainMany(const std::vector<Span<const uint8_t>>& pitches, const std::vector<Span<const double>>& durations,
+                           const RhythmQuantizer& quantizer, ThreadPool& pool) {
+    if (!quantizer.hasGrid()) {
+        std::cerr << "JointModel::trainMany: the rhythm quantizer has no grid\n";
+        return;
+    }
+    quantizer_ = quantizer;
+    std::vector<std::vector<int>> tokens(std::min(pitches.size(), durations.size()));
+    pool.parallelFor(tokens.size(), [&](size_t i) { tokenize(pitches[i], durations[i], quantizer_, tokens[i]); });
+    markov_.trainMany(tokens, pool);
+}
+
+void JointModel::trainMany(const std::vector<std::vector<int>>& pitches, const std::vector<std::vector<double>>& durations,
+                           const RhythmQuantizer& quantizer) {
+    if (!quantizer.hasGrid()) {
+        std::cerr << "JointModel::trainMany: the rhythm quantizer has no grid\n";
+        return;
+    }
+    quantizer_ = quantizer;
+    std::vector<std::vector<int>> tokens(std::min(pitches.size(), durations.size()));
+    for (size_t i = 0; i < tokens.size(); ++i) tokenize(pitches[i], durations[i], quantizer_, tokens[i]);
+    markov_.trainMany(tokens);
+}
+
+bool JointModel::sampleNext(const int* history, size_t length, double temperature, Rng& rng, int& out) const {
+    const size_t order = static_cast<size_t>(markov_.order());
+    if (length < order) return false;
+    return markov_.sampleSeen(history, length, order, temperature, rng, out);
+}
@@ -1,103 +1,438 @@
 #include "MarkovModel.h"
+#include "AliasTable.h"
+#include "ThreadPool.h"
+#include "WeightedDraw.h"
 #include <algorithm>
 #include <cmath>
-#include <chrono>
 #include <iostream>
 
-MarkovModel::MarkovModel(int order) : order_(std::max(1, order)) {
-    std::random_device rd;
-    rng_.seed(rd() ^ static_cast<unsigned long>(std::chrono::high_resolution_clock::now().time_since_epoch().count()));
+MarkovModel::MarkovModel(int order) : order_(std::min(kMaxOrder, std::max(1, order))) {
+    if (order > kMaxOrder) {
+        std::cerr << "MarkovModel: order " << order << " exceeds maximum " << kMaxOrder << ", clamping\n";
+    }
+    bitsPerToken_ = std::min(32, 64 / order_);
+    maxPackedId_ = (bitsPerToken_ >= 32) ? 0xFFFFFFFFu : ((1u << bitsPerToken_) - 1u);
+}
+
+uint32_t MarkovModel::idForTraining(int token) {
+    uint32_t id = idOf(token);
+    if (id != 0) return id;
+    id = ++vocabIds_;
+    if (token >= 0 && token < kDenseTokens) {
+        std::vector<uint32_t> &dense = denseIds_.mut();
+        if (dense.size() <= static_cast<size_t>(token)) dense.resize(static_cast<size_t>(token) + 1, 0);
+        dense[token] = id;
+    } else {
+        std::vector<TokenId> &sparse = sparseIds_.mut();
+        auto pos = std::lower_bound(sparse.begin(), sparse.end(), token, [](const TokenId &e, int t) { return e.token < t; });
+        sparse.insert(pos, TokenId{ token, id });
+    }
+    if (id == maxPackedId_ + 1) {
+        std::cerr << "MarkovModel: vocabulary exceeds " << maxPackedId_ << " tokens at order " << order_
+                  << "; histories containing newer tokens are not stored\n";
+    }
+    return id;
+}
+
+uint32_t MarkovModel::idOf(int token) const {
+    if (token >= 0 && token < kDenseTokens) return static_cast<size_t>(token) < denseIds_.size() ? denseIds_[token] : 0;
+    auto pos = std::lower_bound(sparseIds_.begin(), sparseIds_.end(), token, [](const TokenId &e, int t) { return e.token < t; });
+    return (pos != sparseIds_.end() && pos->token == token) ? pos->id : 0;
 }
 
 void MarkovModel::train(const std::vector<int>& sequence) {
-    if (sequence.empty()) return;
+    trainSequence(sequence.data(), sequence.size());
+}
 
-    for (int t : sequence) {
-        unigramCounts_[t] += 1;
-    }
+void MarkovModel::train(Span<const int> sequence) {
+    trainSequence(sequence.data(), sequence.size());
+}
+
+void MarkovModel::train(Span<const uint8_t> sequence) {
+    trainSequence(sequence.data(), sequence.size());
+}
 
-    const size_t n = sequence.size();
-    for (size_t i = 0; i < n; ++i) {
-        int next = sequence[i];
-        for (int k = 1; k <= order_; ++k) {
-            if (i < static_cast<size_t>(k)) break;
-            std::vector<int> hist;
-            hist.reserve(k);
-            for (size_t j = i - k; j < i; ++j) hist.push_back(sequence[j]);
-            transitions_[hist][next] += 1;
+template <class T>
+void MarkovModel::trainSequence(const T* sequence, size_t length) {
+    if (length == 0) return;
+    for (size_t i = 0; i < length; ++i) idForTraining(static_cast<int>(sequence[i]));
+    beginTraining();
+    std::vector<NGramTable::Entry> &unigrams = unigramCounts_.mut();
+    countSequence(sequence, length, [&](int token) { addUnigram(unigrams, token); },
+                  [this](uint64_t key, int token) { transitions_.add(key, token); });
+}
+
+bool MarkovModel::untrain(const std::vector<int>& sequence) {
+    return untrainSequence(sequence.data(), sequence.size());
+}
+
+bool MarkovModel::untrain(Span<const int> sequence) {
+    return untrainSequence(sequence.data(), sequence.size());
+}
+
+bool MarkovModel::untrain(Span<const uint8_t> sequence) {
+    return untrainSequence(sequence.data(), sequence.size());
+}
+
+template <class T>
+bool MarkovModel::untrainSequence(const T* sequence, size_t length) {
+    if (length == 0) return true;
+    beginTraining();
+    // Token ids stay assigned; only the counts go.
+    std::vector<NGramTable::Entry> &unigrams = unigramCounts_.mut();
+    bool complete = true;
+    countSequence(sequence, length,
+                  [&](int token) {
+                      auto pos = std::lower_bound(unigrams.begin(), unigrams.end(), token,
+                                                  [](const NGramTable::Entry &e, int tok) { return e.token < tok; });
+                      if (pos == unigrams.end() || pos->token != token) complete = false;
+                      else if (--pos->count == 0) unigrams.erase(pos);
+                  },
+                  [&](uint64_t key, int token) { complete = transitions_.subtract(key, token) && complete; });
+    return complete;
+}
+
+void MarkovModel::addUnigram(std::vector<NGramTable::Entry>& unigrams, int token) {
+    auto pos = std::lower_bound(unigrams.begin(), unigrams.end(), token,
+                                [](const NGramTable::Entry &e, int tok) { return e.token < tok; });
+    if (pos != unigrams.end() && pos->token == token) pos->count += 1;
+    else unigrams.insert(pos, NGramTable::Entry{ token, 1 });
+}
+
+void MarkovModel::beginTraining() {
+    unigramCumulative_.mut().clear();
+    if (frozen_) std::atomic_store(&frozenTables_, std::shared_ptr<const FrozenTables>());
+}
+
+template <class T, class OnToken, class OnTransition>
+void MarkovModel::countSequence(const T* sequence, size_t length, OnToken&& onToken, OnTransition&& onTransition) const {
+    for (size_t i = 0; i < length; ++i) onToken(static_cast<int>(sequence[i]));
+
+    // Sliding window of the previous order_ ids, most recent first.
+    uint32_t window[kMaxOrder] = {0};
+    size_t filled = 0;
+    for (size_t i = 0; i < length; ++i) {
+        const int next = static_cast<int>(sequence[i]);
+        uint64_t key = 0;
+        for (size_t k = 0; k < filled; ++k) {
+            uint32_t id = window[k];
+            if (id == 0 || id > maxPackedId_) break;
+            key |= static_cast<uint64_t>(id) << (bitsPerToken_ * k);
+            onTransition(key, next);
         }
+        for (size_t k = static_cast<size_t>(order_) - 1; k > 0; --k) window[k] = window[k - 1];
+        window[0] = idOf(next);
+        if (filled < static_cast<size_t>(order_)) ++filled;
     }
 }
 
 void MarkovModel::trainMany(const std::vector<std::vector<int>>& sequences) {
     for (const auto &s : sequences) train(s);
+    compact();
 }
 
-std::unordered_map<int, uint32_t> MarkovModel::findWithBackoff(const std::vector<int>& history) const {
-    for (int k = std::min<int>(order_, static_cast<int>(history.size())); k >= 1; --k) {
-        std::vector<int> tail(history.end() - k, history.end());
-        auto it = transitions_.find(tail);
-        if (it != transitions_.end()) return it->second;
-    }
-    if (!unigramCounts_.empty()) return unigramCounts_;
-    return {};
+void MarkovModel::trainMany(const std::vector<Span<const uint8_t>>& sequences) {
+    for (const auto &s : sequences) train(s);
+    compact();
 }
 
-std::unordered_map<int, uint32_t> MarkovModel::getCountsForHistory(const std::vector<int>& history) const {
-    return findWithBackoff(history);
+void MarkovModel::trainMany(const std::vector<std::vector<int>>& sequences, ThreadPool& pool) {
+    trainParallel(sequences, pool);
+}
+
+void MarkovModel::trainMany(const std::vector<Span<const uint8_t>>& sequences, ThreadPool& pool) {
+    trainParallel(sequences, pool);
+}
+
+namespace {
+
+void mergeUnigrams(std::vector<NGramTable::Entry>& into, const std::vector<NGramTable::Entry>& from) {
+    std::vector<NGramTable::Entry> merged;
+    merged.reserve(into.size() + from.size());
+    size_t i = 0, j = 0;
+    while (i < into.size() || j < from.size()) {
+        if (j == from.size() || (i < into.size() && into[i].token < from[j].token)) merged.push_back(into[i++]);
+        else if (i == into.size() || from[j].token < into[i].token) merged.push_back(from[j++]);
+        else {
+            merged.push_back(NGramTable::Entry{ into[i].token, into[i].count + from[j].count });
+            ++i;
+            ++j;
+        }
+    }
+    into.swap(merged);
 }
 
-int MarkovModel::sampleNext(const std::vector<int>& history, double temperature) const {
-    auto counts = findWithBackoff(history);
+}
 
-    if (counts.empty()) {
-        if (unigramCounts_.empty()) return 0;
-        counts = unigramCounts_;
+template <class Seq>
+void MarkovModel::trainParallel(const std::vector<Seq>& sequences, ThreadPool& pool) {
+    // Contiguous shards of roughly equal token counts, one per thread.
+    size_t total = 0;
+    for (const auto &s : sequences) total += s.size();
+    const size_t shardCount = std::min(pool.size(), sequences.size());
+    if (shardCount <= 1 || total == 0) {
+        trainMany(sequences);
+        return;
+    }
+    std::vector<size_t> bounds(1, 0);
+    size_t acc = 0;
+    for (size_t i = 0; i < sequences.size() && bounds.size() < shardCount; ++i) {
+        acc += sequences[i].size();
+        if (acc * shardCount >= total * bounds.size()) bounds.push_back(i + 1);
     }
+    bounds.push_back(sequences.size());
+    const size_t shards = bounds.size() - 1;
 
-    if (temperature <= 0.0) {
-        int bestTok = 0;
-        uint32_t bestCnt = 0;
-        for (auto &p : counts) {
-            if (p.second > bestCnt) {
-                bestCnt = p.second;
-                bestTok = p.first;
+    // Ids are handed out in first-appearance order, exactly as serial
+    // training would: each shard lists its new tokens in order, then the
+    // lists are registered shard by shard.
+    std::vector<std::vector<int>> firstSeen(shards);
+    pool.parallelFor(shards, [&](size_t s) {
+        std::vector<bool> seenDense(kDenseTokens, false);
+        std::vector<int> seenSparse;
+        for (size_t q = bounds[s]; q < bounds[s + 1]; ++q) {
+            for (auto v : sequences[q]) {
+                const int t = static_cast<int>(v);
+                if (t >= 0 && t < kDenseTokens) {
+                    if (seenDense[t]) continue;
+                    seenDense[t] = true;
+                } else {
+                    auto pos = std::lower_bound(seenSparse.begin(), seenSparse.end(), t);
+                    if (pos != seenSparse.end() && *pos == t) continue;
+                    seenSparse.insert(pos, t);
+                }
+                firstSeen[s].push_back(t);
             }
         }
-        return bestTok;
+    });
+    for (const auto &tokens : firstSeen) {
+        for (int t : tokens) idForTraining(t);
     }
+    beginTraining();
 
-    std::vector<std::pair<int, double>> items;
-    items.reserve(counts.size());
-    double total = 0.0;
-    for (auto &kv : counts) {
-        double w = std::pow(static_cast<double>(kv.second), 1.0 / temperature);
-        items.emplace_back(kv.first, w);
-        total += w;
+    // Each shard counts into private tables split by key hash; partition p
+    // of every shard is then merged on its own thread, and the partitions
+    // hold disjoint keys, so the final merge only appends rows.
+    const size_t parts = shards;
+    auto partOf = [parts](uint64_t key) { return static_cast<size_t>(((key * 0x9E3779B97F4A7C15ULL) >> 32) % parts); };
+    struct Shard {
+        std::vector<NGramTable> tables;
+        std::vector<NGramTable::Entry> unigrams;
+    };
+    std::vector<Shard> local(shards);
+    pool.parallelFor(shards, [&](size_t s) {
+        Shard &shard = local[s];
+        shard.tables.resize(parts);
+        for (size_t q = bounds[s]; q < bounds[s + 1]; ++q) {
+            countSequence(sequences[q].data(), sequences[q].size(), [&](int token) { addUnigram(shard.unigrams, token); },
+                          [&](uint64_t key, int token) { shard.tables[partOf(key)].add(key, token); });
+        }
+    });
+    pool.parallelFor(parts, [&](size_t p) {
+        for (size_t s = 1; s < shards; ++s) {
+            local[0].tables[p].merge(local[s].tables[p]);
+            local[s].tables[p] = NGramTable();
+        }
+    });
+    for (size_t s = 1; s < shards; ++s) mergeUnigrams(local[0].unigrams, local[s].unigrams);
+
+    for (size_t p = 0; p < parts; ++p) {
+        if (transitions_.historyCount() == 0) transitions_ = std::move(local[0].tables[p]);
+        else transitions_.merge(local[0].tables[p]);
+        local[0].tables[p] = NGramTable();
     }
+    mergeUnigrams(unigramCounts_.mut(), local[0].unigrams);
+    compact();
+}
 
-    if (total <= 0.0) {
-        int bestTok = items.front().first;
-        uint32_t bestCnt = 0;
-        for (auto &p : counts) {
-            if (p.second > bestCnt) {
-                bestCnt = p.second;
-                bestTok = p.first;
-            }
+void MarkovModel::compact() {
+    transitions_.compact();
+    if (unigramCumulative_.size() == unigramCounts_.size()) return;
+    std::vector<uint32_t> &cumulative = unigramCumulative_.mut();
+    cumulative.resize(unigramCounts_.size());
+    uint32_t acc = 0;
+    for (size_t i = 0; i < unigramCounts_.size(); ++i) cumulative[i] = (acc += unigramCounts_[i].count);
+}
+
+size_t MarkovModel::historyKeys(const int* history, size_t length, uint64_t* keys) const {
+    const size_t maxK = std::min<size_t>(order_, length);
+    size_t known = 0;
+    uint64_t key = 0;
+    for (; known < maxK; ++known) {
+        uint32_t id = idOf(history[length - 1 - known]);
+        if (id == 0 || id > maxPackedId_) break;
+        key |= static_cast<uint64_t>(id) << (bitsPerToken_ * known);
+        keys[known] = key;
+    }
+    return known;
+}
+
+NGramTable::Row MarkovModel::unigramRow() const {
+    NGramTable::Row unigrams{ unigramCounts_.data(), static_cast<uint32_t>(unigramCounts_.size()) };
+    if (unigramCumulative_.size() == unigramCounts_.size()) unigrams.cumulative = unigramCumulative_.data();
+    return unigrams;
+}
+
+NGramTable::Row MarkovModel::findWithBackoff(const int* history, size_t length, size_t minLength) const {
+    uint64_t keys[kMaxOrder];
+    const size_t known = historyKeys(history, length, keys);
+    for (size_t k = known; k >= std::max<size_t>(1, minLength); --k) {
+        NGramTable::Row row = transitions_.find(keys[k - 1]);
+        if (!row.empty()) return row;
+    }
+    if (minLength > 0) return NGramTable::Row();
+    return unigramRow();
+}
+
+NGramTable::Row MarkovModel::lookup(const int* history, size_t length) const {
+    return findWithBackoff(history, length);
+}
+
+NGramTable::Row MarkovModel::lookupMasked(const int* history, size_t length, const PitchMask& mask) const {
+    uint64_t keys[kMaxOrder];
+    const size_t known = historyKeys(history, length, keys);
+    auto anyAllowed = [&](const NGramTable::Row& row) {
+        for (const auto &e : row) {
+            if (mask.test(e.token)) return true;
+        }
+        return false;
+    };
+    for (size_t k = known; k >= 1; --k) {
+        NGramTable::Row row = transitions_.find(keys[k - 1]);
+        if (anyAllowed(row)) return row;
+    }
+    return unigramRow();
+}
+
+NGramTable::Row MarkovModel::lookupSeen(const int* history, size_t length, size_t minLength) const {
+    return findWithBackoff(history, length, std::max<size_t>(1, minLength));
+}
+
+std::unordered_map<int, uint32_t> MarkovModel::getCountsForHistory(const std::vector<int>& history) const {
+    std::unordered_map<int, uint32_t> out;
+    for (const auto &e : findWithBackoff(history.data(), history.size())) out.emplace(e.token, e.count);
+    return out;
+}
+
+int MarkovModel::sampleNext(const std::vector<int>& history, double temperature, Rng& rng) const {
+    return sampleNext(history.data(), history.size(), temperature, rng);
+}
+
+int MarkovModel::sampleNext(const int* history, size_t length, double temperature, Rng& rng) const {
+    NGramTable::Row counts = findWithBackoff(history, length);
+    if (counts.empty()) return 0;
+    return draw(counts, temperature, rng);
+}
+
+bool MarkovModel::sampleSeen(const int* history, size_t length, size_t minLength, double temperature, Rng& rng, int& out) const {
+    NGramTable::Row counts = findWithBackoff(history, length, std::max<size_t>(1, minLength));
+    if (counts.empty()) return false;
+    out = draw(counts, temperature, rng);
+    return true;
+}
+
+bool MarkovModel::sampleMasked(const int* history, size_t length, double temperature, const PitchMask& mask, Rng& rng, int& out) const {
+    const NGramTable::Row counts = lookupMasked(history, length, mask);
+    // Alias tables cover whole rows, so masked draws always scan.
+    const uint32_t i = WeightedDraw::draw(counts.size, [&](uint32_t k) { return mask.test(counts[k].token) ? counts[k].count : 0u; },
+                                          nullptr, temperature, rng);
+    if (i == counts.size) return false;
+    out = counts[i].token;
+    return true;
+}
+
+int MarkovModel::draw(const NGramTable::Row& counts, double temperature, Rng& rng) const {
+    // At the frozen temperature rows draw from their alias tables; otherwise they are scanned.
+    if (temperature > 0.0 && frozen_ && temperature == frozenTemperature_) {
+        auto tables = std::atomic_load(&frozenTables_);
+        if (!tables) {
+            tables = buildFrozen(temperature);
+            std::atomic_store(&frozenTables_, tables);
         }
-        return bestTok;
+        return drawFrozen(*tables, counts, rng);
     }
+    const uint32_t i = WeightedDraw::draw(counts.size, [&](uint32_t k) { return counts[k].count; }, counts.cumulative, temperature, rng);
+    return i < counts.size ? counts[i].token : 0;
+}
+
+void MarkovModel::freeze(double temperature) {
+    frozen_ = true;
+    frozenTemperature_ = temperature;
+    std::atomic_store(&frozenTables_, temperature > 0.0 ? buildFrozen(temperature) : std::shared_ptr<const FrozenTables>());
+}
+
+void MarkovModel::thaw() {
+    frozen_ = false;
+    std::atomic_store(&frozenTables_, std::shared_ptr<const FrozenTables>());
+}
 
-    std::uniform_real_distribution<double> dist(0.0, total);
-    double r = dist(rng_);
-    double acc = 0.0;
-    for (auto &it : items) {
-        acc += it.second;
-        if (r <= acc) return it.first;
+std::shared_ptr<const MarkovModel::FrozenTables> MarkovModel::buildFrozen(double temperature) const {
+    auto tables = std::make_shared<FrozenTables>();
+    tables->temperature = temperature;
+    tables->threshold.resize(transitions_.poolSize());
+    tables->alias.resize(transitions_.poolSize());
+    tables->unigramThreshold.resize(unigramCounts_.size());
+    tables->unigramAlias.resize(unigramCounts_.size());
+
+    const double invTemp = 1.0 / temperature;
+    std::vector<double> weights;
+    std::vector<uint32_t> small, large;
+    auto buildRow = [&](const NGramTable::Row& row, uint32_t* threshold, uint32_t* alias) {
+        weights.resize(row.size);
+        // Tempered weights are taken relative to the row's largest count, so
+        // they stay in [0, 1] instead of overflowing at low temperatures.
+        uint32_t rowMax = 0;
+        for (uint32_t i = 0; i < row.size; ++i) rowMax = std::max(rowMax, row[i].count);
+        for (uint32_t i = 0; i < row.size; ++i) {
+            weights[i] = (temperature == 1.0) ? static_cast<double>(row[i].count)
+                                              : std::pow(static_cast<double>(row[i].count) / static_cast<double>(rowMax), invTemp);
+        }
+        AliasTable::build(weights.data(), row.size, threshold, alias, small, large);
+    };
+
+    transitions_.forEachRow([&](const NGramTable::Row& row) {
+        size_t off = transitions_.offsetOf(row);
+        buildRow(row, tables->threshold.data() + off, tables->alias.data() + off);
+    });
+    buildRow(NGramTable::Row{ unigramCounts_.data(), static_cast<uint32_t>(unigramCounts_.size()) },
+             tables->unigramThreshold.data(), tables->unigramAlias.data());
+    return tables;
+}
+
+int MarkovModel::drawFrozen(const FrozenTables& tables, const NGramTable::Row& counts, Rng& rng) const {
+    const uint32_t *threshold, *alias;
+    if (counts.data == unigramCounts_.data()) {
+        threshold = tables.unigramThreshold.data();
+        alias = tables.unigramAlias.data();
+    } else {
+        size_t off = transitions_.offsetOf(counts);
+        threshold = tables.threshold.data() + off;
+        alias = tables.alias.data() + off;
     }
-    return items.back().first;
+    uint64_t bits = rng();
+    return counts[AliasTable::draw(threshold, alias, counts.size, bits)].token;
+}
+
+size_t MarkovModel::frozenMemoryBytes() const {
+    auto tables = std::atomic_load(&frozenTables_);
+    if (!tables) return 0;
+    return sizeof(FrozenTables) + (tables->threshold.capacity() + tables->alias.capacity() +
+                                   tables->unigramThreshold.capacity() + tables->unigramAlias.capacity()) * sizeof(uint32_t);
 }
 
 size_t MarkovModel::vocabularySize() const {
     return unigramCounts_.size();
 }
+
+uint64_t MarkovModel::observationCount() const {
+    uint64_t n = 0;
+    transitions_.forEachRow([&](const NGramTable::Row& row) {
+        for (const auto &e : row) n += e.count;
+    });
+    return n;
+}
+
+size_t MarkovModel::memoryBytes() const {
+    return transitions_.memoryBytes() + unigramCounts_.ownedBytes() + unigramCumulative_.ownedBytes() +
+           denseIds_.ownedBytes() + sparseIds_.ownedBytes();
+}
@@ -0,0 +1,208 @@
+#include "MelodyExtractor.h"
+#include "NoteStore.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <queue>
+#include <utility>
+
+namespace {
+
+// Mean pitch range where melody parts usually sit (G3..C6).
+const double kMelodyLow = 55.0;
+const double kMelodyHigh = 84.0;
+
+}
+
+const char* MelodyExtractor::modeName(MelodyMode mode) {
+    switch (mode) {
+    case MelodyMode::All: return "all";
+    case MelodyMode::Skyline: return "skyline";
+    case MelodyMode::Track: return "track";
+    case MelodyMode::Voice: return "voice";
+    }
+    return "?";
+}
+
+bool MelodyExtractor::parseMode(const std::string& name, MelodyMode& out) {
+    for (MelodyMode m : { MelodyMode::All, MelodyMode::Skyline, MelodyMode::Track, MelodyMode::Voice }) {
+        if (name == modeName(m)) {
+            out = m;
+            return true;
+        }
+    }
+    return false;
+}
+
+void MelodyExtractor::sortByOnset(const Columns& c, size_t begin, size_t end) {
+    std::sort(order_.begin() + begin, order_.begin() + end, [&](uint32_t a, uint32_t b) {
+        if (c.start[a] != c.start[b]) return c.start[a] < c.start[b];
+        if (c.pitch[a] != c.pitch[b]) return c.pitch[a] > c.pitch[b];
+        return a < b;
+    });
+}
+
+void MelodyExtractor::skylineRange(const Columns& c, size_t begin, size_t end) {
+    size_t i = begin;
+    while (i < end) {
+        // order_[i] is the highest note of the onset group starting here.
+        const uint32_t cand = order_[i];
+        const double start = c.start[cand];
+        while (i < end && c.start[order_[i]] == start) ++i;
+
+        if (!picked_.empty()) {
+            Picked &last = picked_.back();
+            const double lastEnd = c.start[last.index] + last.duration;
+            if (lastEnd > start) {
+                // A higher note still sounding masks the new one; otherwise the
+                // new onset takes over and the held note is cut short.
+                if (c.pitch[last.index] > c.pitch[cand]) continue;
+                last.duration = start - c.start[last.index];
+            }
+        }
+        picked_.push_back(Picked{ cand, c.duration[cand] });
+    }
+}
+
+void MelodyExtractor::skyline(const Columns& c) {
+    sortByOnset(c, 0, order_.size());
+    skylineRange(c, 0, order_.size());
+}
+
+void MelodyExtractor::track(const Columns& c) {
+    auto part = [&](uint32_t i) { return static_cast<uint32_t>(c.track[i]) * 16u + c.channel[i]; };
+    std::sort(order_.begin(), order_.end(), [&](uint32_t a, uint32_t b) {
+        if (part(a) != part(b)) return part(a) < part(b);
+        if (c.start[a] != c.start[b]) return c.start[a] < c.start[b];
+        if (c.pitch[a] != c.pitch[b]) return c.pitch[a] > c.pitch[b];
+        return a < b;
+    });
+
+    // Score each part: many notes, little overlap between them, and a mean
+    // pitch in the melody range.
+    size_t bestBegin = 0, bestEnd = 0;
+    double bestScore = -1.0;
+    for (size_t begin = 0; begin < order_.size();) {
+        const uint32_t key = part(order_[begin]);
+        size_t end = begin;
+        double pitchSum = 0.0, maxEnd = -1.0;
+        size_t overlapping = 0;
+        for (; end < order_.size() && part(order_[end]) == key; ++end) {
+            const uint32_t n = order_[end];
+            pitchSum += c.pitch[n];
+            if (c.start[n] < maxEnd) ++overlapping;
+            maxEnd = std::max(maxEnd, c.start[n] + c.duration[n]);
+        }
+        const double count = static_cast<double>(end - begin);
+        const double mean = pitchSum / count;
+        const double mono = 1.0 - static_cast<double>(overlapping) / count;
+        const double outside = mean < kMelodyLow ? kMelodyLow - mean : mean > kMelodyHigh ? mean - kMelodyHigh : 0.0;
+        const double score = std::sqrt(count) * mono * mono * std::exp(-outside / 12.0);
+        if (score > bestScore) {
+            bestScore = score;
+            bestBegin = begin;
+            bestEnd = end;
+        }
+        begin = end;
+    }
+    skylineRange(c, bestBegin, bestEnd);
+}
+
+void MelodyExtractor::voice(const Columns& c) {
+    sortByOnset(c, 0, order_.size());
+
+    // Sweep in onset order, highest first within a chord. Each note joins the
+    // free voice (last note already ended) nearest to it in pitch, or opens a
+    // new voice if every voice is still sounding.
+    struct Voice {
+        int lastPitch;
+        double end;
+        size_t count;
+        double pitchSum;
+    };
+    std::vector<Voice> voices;
+    std::vector<uint32_t> voiceOf(c.size);
+    using Busy = std::pair<double, uint32_t>;
+    std::priority_queue<Busy, std::vector<Busy>, std::greater<Busy>> busy;
+    std::multimap<int, uint32_t> idle;
+
+    for (uint32_t n : order_) {
+        const double start = c.start[n];
+        while (!busy.empty() && busy.top().first <= start) {
+            const uint32_t v = busy.top().second;
+            busy.pop();
+            idle.emplace(voices[v].lastPitch, v);
+        }
+        const int pitch = c.pitch[n];
+        uint32_t v;
+        if (idle.empty()) {
+            v = static_cast<uint32_t>(voices.size());
+            voices.push_back(Voice{ pitch, 0.0, 0, 0.0 });
+        } else {
+            auto it = idle.lower_bound(pitch);
+            if (it == idle.end() || (it != idle.begin() && pitch - std::prev(it)->first < it->first - pitch)) --it;
+            v = it->second;
+            idle.erase(it);
+        }
+        Voice &voice = voices[v];
+        voice.lastPitch = pitch;
+        voice.end = start + c.duration[n];
+        ++voice.count;
+        voice.pitchSum += pitch;
+        voiceOf[n] = v;
+        busy.emplace(voice.end, v);
+    }
+    if (voices.empty()) return;
+
+    // The melody: the highest voice among those carrying a real share of notes.
+    size_t maxCount = 0;
+    for (const auto &v : voices) maxCount = std::max(maxCount, v.count);
+    uint32_t best = 0;
+    double bestMean = -1.0;
+    for (uint32_t v = 0; v < voices.size(); ++v) {
+        if (voices[v].count * 4 < maxCount) continue;
+        const double mean = voices[v].pitchSum / static_cast<double>(voices[v].count);
+        if (mean > bestMean) {
+            bestMean = mean;
+            best = v;
+        }
+    }
+    for (uint32_t n : order_) {
+        if (voiceOf[n] == best) picked_.push_back(Picked{ n, c.duration[n] });
+    }
+}
+
+void MelodyExtractor::extract(const NoteStore& notes, NoteStore& out) {
+    out.clear();
+    if (mode_ == MelodyMode::All) {
+        out.reserve(notes.size());
+        for (size_t i = 0; i < notes.size(); ++i) out.push_back(notes[i]);
+        return;
+    }
+
+    const Columns c{ notes.pitches().data(), notes.channels().data(), notes.tracks().data(),
+                     notes.startTimes().data(), notes.durations().data(), notes.size() };
+    order_.resize(c.size);
+    for (size_t i = 0; i < c.size; ++i) order_[i] = static_cast<uint32_t>(i);
+    picked_.clear();
+    if (mode_ == MelodyMode::Skyline) skyline(c);
+    else if (mode_ == MelodyMode::Track) track(c);
+    else voice(c);
+
+    out.reserve(picked_.size());
+    for (const Picked &p : picked_) {
+        NoteEvent n = notes[p.index];
+        n.duration = p.duration;
+        out.push_back(n);
+    }
+}
+
+std::vector<NoteEvent> MelodyExtractor::extract(const std::vector<NoteEvent>& notes) {
+    NoteStore in, out;
+    in.reserve(notes.size());
+    for (const auto &n : notes) in.push_back(n);
+    extract(in, out);
+    return out.toEvents();
+}
@@ -1,84 +1,40 @@
 #include "MelodyGenerator.h"
-#include <chrono>
+#include "ThreadPool.h"
 #include <algorithm>
 #include <iostream>
 
-MelodyGenerator::MelodyGenerator(MarkovModel& melodyModel, RhythmModel& rhythmModel, int melodyOrder, int historyMax) : melodyModel_(melodyModel), rhythmModel_(rhythmModel), melodyOrder_(std::max(1, melodyOrder)), historyMax_(std::max(melodyOrder_, historyMax)) {
-    std::random_device rd;
-    rng_.seed(rd() ^ static_cast<unsigned long>(std::chrono::high_resolution_clock::now().time_since_epoch().count()));
-}
+MelodyGenerator::MelodyGenerator(const MarkovModel& melodyModel, const RhythmModel& rhythmModel, int melodyOrder, int historyMax, uint64_t seed) : melodyModel_(melodyModel), rhythmModel_(rhythmModel), melodyOrder_(std::max(1, melodyOrder)), historyMax_(std::max(melodyOrder_, historyMax)), seed_(seed) {}
 
-int MelodyGenerator::clampPitch(int p, int minP, int maxP) const {
-    if (p < minP) return minP;
-    if (p > maxP) return maxP;
-    return p;
+std::vector<std::vector<NoteEvent>> MelodyGenerator::generateBatch(const std::vector<MelodyRequest>& requests, uint64_t baseSeed, ThreadPool& pool) const {
+    std::vector<std::vector<NoteEvent>> out(requests.size());
+    pool.parallelFor(requests.size(), [&](size_t i) {
+        out[i] = generateWith(requests[i], streamFor(baseSeed, i));
+    });
+    return out;
 }
 
-bool MelodyGenerator::pitchClassAllowed(int pitch, const std::vector<int>& allowed) const {
-    if (allowed.empty()) return true;
-    int pc = ((pitch % 12) + 12) % 12;
-    for (int a : allowed) if ((a % 12 + 12) % 12 == pc) return true;
-    return false;
+std::vector<NoteEvent> MelodyGenerator::generate(int length, int startPitch, int minPitch, int maxPitch, double melodyTemp, double rhythmTemp, int startVelocity, bool enforceScale, const std::vector<int>& allowedPitchClasses) {
+    MelodyRequest request;
+    request.length = length;
+    request.startPitch = startPitch;
+    request.minPitch = minPitch;
+    request.maxPitch = maxPitch;
+    request.melodyTemp = melodyTemp;
+    request.rhythmTemp = rhythmTemp;
+    request.velocity = startVelocity;
+    request.enforceScale = enforceScale;
+    request.allowedPitchClasses = allowedPitchClasses;
+    return generateWith(request, streamFor(seed_, generated_++));
 }
 
-int MelodyGenerator::nearestAllowedPitch(int pitch, int minP, int maxP, const std::vector<int>& allowed) const {
-    if (allowed.empty()) return clampPitch(pitch, minP, maxP);
-    int best = pitch;
-    for (int d = 0; d <= 12; ++d) {
-        int up = pitch + d;
-        if (up <= maxP && pitchClassAllowed(up, allowed)) return up;
-        int down = pitch - d;
-        if (down >= minP && pitchClassAllowed(down, allowed)) return down;
-    }
-    return clampPitch(pitch, minP, maxP);
+MelodyStream MelodyGenerator::stream(const MelodyRequest& request, Rng rng) const {
+    return MelodyStream(melodyModel_, rhythmModel_, request, rng, melodyOrder_, historyMax_, jointModel_, melodyTree_, melodyCompact_, melodyIntervals_);
 }
 
-std::vector<NoteEvent> MelodyGenerator::generate(int length, int startPitch, int minPitch, int maxPitch, double melodyTemp, double rhythmTemp, int startVelocity, bool enforceScale, const std::vector<int>& allowedPitchClasses) {
-    std::vector<NoteEvent> out;
-    if (length <= 0) return out;
-
-    std::vector<int> pitchHistory;
-    std::vector<double> durHistory;
-
-    pitchHistory.push_back(startPitch);
-
-    double timeCursor = 0.0;
-
-    for (int i = 0; i < length; ++i) {
-        std::vector<int> histForMelody;
-        int histTake = std::min((int)pitchHistory.size(), melodyOrder_);
-        if (histTake > 0) histForMelody.insert(histForMelody.end(), pitchHistory.end() - histTake, pitchHistory.end());
-
-        int sampledPitch = melodyModel_.sampleNext(histForMelody, melodyTemp);
-
-        if (enforceScale) {
-            if (!pitchClassAllowed(sampledPitch, allowedPitchClasses)) {
-                sampledPitch = nearestAllowedPitch(sampledPitch, minPitch, maxPitch, allowedPitchClasses);
-            }
-        }
-
-        sampledPitch = clampPitch(sampledPitch, minPitch, maxPitch);
-
-        std::vector<double> histForRhythm;
-        int rhTake = std::min((int)durHistory.size(), historyMax_);
-        if (rhTake > 0) histForRhythm.insert(histForRhythm.end(), durHistory.end() - rhTake, durHistory.end());
-
-        double sampledDur = rhythmModel_.sampleNext(histForRhythm, rhythmTemp);
-
-        if (!(sampledDur > 0.0)) sampledDur = 0.25;
-
-        NoteEvent ne;
-        ne.pitch = sampledPitch;
-        ne.startTime = timeCursor;
-        ne.duration = sampledDur;
-        out.push_back(ne);
-
-        timeCursor += sampledDur;
-        pitchHistory.push_back(sampledPitch);
-        if ((int)pitchHistory.size() > historyMax_) pitchHistory.erase(pitchHistory.begin(), pitchHistory.begin() + (pitchHistory.size() - historyMax_));
-        durHistory.push_back(sampledDur);
-        if ((int)durHistory.size() > historyMax_) durHistory.erase(durHistory.begin(), durHistory.begin() + (durHistory.size() - historyMax_));
-    }
-
+std::vector<NoteEvent> MelodyGenerator::generateWith(const MelodyRequest& request, Rng rng) const {
+    if (request.length <= 0) return {};
+    MelodyStream notes(melodyModel_, rhythmModel_, request, rng, melodyOrder_, historyMax_, jointModel_, melodyTree_, melodyCompact_, melodyIntervals_);
+    std::vector<NoteEvent> out(static_cast<size_t>(request.length));
+    notes.next(out.data(), out.size());
     return out;
 }
@@ -0,0 +1,88 @@
+#include "MelodyStream.h"
+#include <algorithm>
+
+PitchMask allowedPitches(const MelodyRequest& request) {
+    PitchMask mask = PitchMask::range(request.minPitch, request.maxPitch);
+    if (request.enforceScale && !request.allowedPitchClasses.empty()) mask = mask & PitchMask::pitchClasses(request.allowedPitchClasses);
+    return mask;
+}
+
+MelodyStream::MelodyStream(const MarkovModel& melodyModel, const RhythmModel& rhythmModel, const MelodyRequest& request,
+                           Rng rng, int melodyOrder, int historyMax, const JointModel* joint,
+                           const ContextTree* melodyTree, const CompactModel* melodyCompact,
+                           const IntervalModel* melodyIntervals)
+    : melodyModel_(melodyModel), rhythmModel_(rhythmModel), joint_(joint && joint->trained() ? joint : nullptr),
+      melodyTree_(melodyTree && !melodyTree->empty() ? melodyTree : nullptr),
+      melodyCompact_(melodyCompact && !melodyCompact->empty() ? melodyCompact : nullptr),
+      melodyIntervals_(melodyIntervals && melodyIntervals->trained() ? melodyIntervals : nullptr),
+      request_(request), allowed_(allowedPitches(request), request.minPitch, request.maxPitch),
+      constrained_(request.constrained && !allowed_.mask().empty()),
+      velocity_(static_cast<uint8_t>(std::clamp(request.velocity, 0, 127))), rng_(rng) {
+    // Beyond kHistoryCapacity the window is longer than any model order, so
+    // clamping it changes no draw.
+    melodyOrder_ = std::min(kHistoryCapacity, std::max(1, melodyOrder));
+    historyMax_ = std::min(kHistoryCapacity, std::max(melodyOrder_, historyMax));
+    pitches_.push(request_.startPitch);
+}
+
+NoteEvent MelodyStream::next() {
+    int sampledPitch = 0;
+    double sampledDur = 0.0;
+    int note;
+    const int jointTake = joint_ ? std::min(notes_.size(), joint_->order()) : 0;
+    if (joint_ && joint_->sampleNext(notes_.last(jointTake), jointTake, request_.melodyTemp, rng_, note) &&
+        (!constrained_ || allowed_.allows(JointModel::pitchOf(note)))) {
+        sampledPitch = JointModel::pitchOf(note);
+        sampledDur = joint_->duration(note);
+        ++jointDraws_;
+    } else {
+        if (melodyTree_) {
+            const int treeTake = std::min(pitches_.size(), melodyTree_->maxOrder());
+            if (!constrained_ ||
+                !melodyTree_->sampleMasked(pitches_.last(treeTake), treeTake, request_.melodyTemp, allowed_.mask(), rng_, sampledPitch)) {
+                sampledPitch = melodyTree_->sampleNext(pitches_.last(treeTake), treeTake, request_.melodyTemp, rng_);
+            }
+        } else if (melodyCompact_) {
+            const int compactTake = std::min(pitches_.size(), melodyCompact_->order());
+            if (!constrained_ ||
+                !melodyCompact_->sampleMasked(pitches_.last(compactTake), compactTake, request_.melodyTemp, allowed_.mask(), rng_, sampledPitch)) {
+                sampledPitch = melodyCompact_->sampleNext(pitches_.last(compactTake), compactTake, request_.melodyTemp, rng_);
+            }
+        } else if (melodyIntervals_) {
+            // order() steps take one pitch more than that.
+            const int intervalTake = std::min(pitches_.size(), melodyIntervals_->order() + 1);
+            if (!constrained_ ||
+                !melodyIntervals_->sampleMasked(pitches_.last(intervalTake), intervalTake, request_.melodyTemp, allowed_.mask(), rng_, sampledPitch)) {
+                sampledPitch = melodyIntervals_->sampleNext(pitches_.last(intervalTake), intervalTake, request_.melodyTemp, rng_);
+            }
+        } else {
+            int histTake = std::min(pitches_.size(), melodyOrder_);
+            if (!constrained_ ||
+                !melodyModel_.sampleMasked(pitches_.last(histTake), histTake, request_.melodyTemp, allowed_.mask(), rng_, sampledPitch)) {
+                sampledPitch = melodyModel_.sampleNext(pitches_.last(histTake), histTake, request_.melodyTemp, rng_);
+            }
+        }
+        int rhTake = std::min(durations_.size(), historyMax_);
+        sampledDur = rhythmModel_.sampleNext(durations_.last(rhTake), rhTake, request_.rhythmTemp, rng_);
+    }
+
+    sampledPitch = allowed_.nearest(sampledPitch);
+    if (!(sampledDur > 0.0)) sampledDur = 0.25;
+
+    NoteEvent ne;
+    ne.pitch = sampledPitch;
+    ne.startTime = timeCursor_;
+    ne.duration = sampledDur;
+    ne.velocity = velocity_;
+
+    timeCursor_ += sampledDur;
+    pitches_.push(sampledPitch);
+    durations_.push(sampledDur);
+    if (joint_) notes_.push(joint_->token(sampledPitch, sampledDur));
+    ++emitted_;
+    return ne;
+}
+
+void MelodyStream::next(NoteEvent* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) out[i] = next();
+}
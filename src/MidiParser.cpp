@@ -1,110 +1,105 @@
-#include "midiparser.h"
+#include "MidiParser.h"
+#include "MappedFile.h"
+#include "NoteStore.h"
+#include "TempoMap.h"
 #include "Utils.h"
 
 #include <fstream>
+#include <cstring>
 #include <iostream>
 #include <vector>
-#include <map>
-#include <deque>
 #include <algorithm>
 #include <cstdint>
-#include <limits>
 #include <string>
 
 namespace {
 
+enum class RawKind : uint8_t { Off, On, Program };
+
 struct RawEvent {
-    int pitch;
     uint64_t tick;
-    bool on;
-    int track;
     uint64_t seq;
+    uint16_t track;
+    uint8_t channel;
+    uint8_t data1;      // pitch, or the program for a program change
+    uint8_t velocity;
+    RawKind kind;
 };
 
-struct TempoEvent {
-    uint64_t tick;
-    uint32_t microsecondsPerQuarter;
-};
+const int kBassProgramFirst = 32;   // GM programs 33-40, 0-based
+const int kBassProgramLast = 39;
 
-static int readByte(std::ifstream &f) {
-    int c = f.get();
-    if (c == EOF) return -1;
-    return c & 0xFF;
-}
+// Decodes one SMF image and appends every kept note to `out` (a NoteEvent
+// vector or a NoteStore), in the order the notes end. Returns false if the
+// header is unusable.
+template <class Out>
+bool decodeNotes(const unsigned char* data, size_t size, const NoteFilter& filter, Out& out) {
+    Utils::ByteCursor file(data, size);
 
-}
-
-std::vector<NoteEvent> Parser::parseMidiFile(const std::string& path) {
-    std::ifstream file(path, std::ios::binary);
-    if (!file.is_open()) {
-        std::cerr << "Parser::parseMidiFile: failed to open MIDI file: " << path << '\n';
-        return {};
-    }
-
-    char hdr[4] = {0};
-    file.read(hdr, 4);
-    if (!file.good()) {
+    if (file.remaining() < 4) {
         std::cerr << "Parser::parseMidiFile: failed reading header id\n";
-        return {};
+        return false;
     }
-    if (std::string(hdr, 4) != "MThd") {
+    if (std::memcmp(file.pos, "MThd", 4) != 0) {
         std::cerr << "Parser::parseMidiFile: not a MIDI file (MThd missing)\n";
-        return {};
+        return false;
     }
+    file.pos += 4;
 
     uint32_t headerSize = Utils::readBE32(file);
     uint16_t format = Utils::readBE16(file);
     uint16_t nTracks = Utils::readBE16(file);
     uint16_t division = Utils::readBE16(file);
+    (void)format;
 
-    if (!file.good()) {
+    if (!file.ok) {
         std::cerr << "Parser::parseMidiFile: truncated header\n";
-        return {};
+        return false;
     }
 
-    if (headerSize > 6) file.seekg(headerSize - 6, std::ios::cur);
-
-    bool isSMPTE = (division & 0x8000) != 0;
-    int PPQ = 480;
-    if (!isSMPTE) {
-        PPQ = division;
-        if (PPQ == 0) {
-            std::cerr << "Parser::parseMidiFile: division/PPQ is zero, falling back to 480\n";
-            PPQ = 480;
-        }
-    } else {
-        std::cerr << "Parser::parseMidiFile: SMPTE time division detected - not fully supported. Using fallback PPQ=480\n";
-        PPQ = 480;
-    }
+    if (headerSize > 6) Utils::skipBytes(file, headerSize - 6);
 
     std::vector<RawEvent> rawEvents;
-    std::vector<TempoEvent> tempoEvents;
+    std::vector<TempoMap::Change> tempoEvents;
     uint64_t globalSeq = 0;
+    // Roughly three bytes per channel event; avoids regrowth on large files.
+    rawEvents.reserve(size / 4);
+
+    std::vector<size_t> trackStarts;
+    trackStarts.reserve(nTracks);
 
     for (int trackIndex = 0; trackIndex < nTracks; ++trackIndex) {
         uint64_t absoluteTick = 0;
+        trackStarts.push_back(rawEvents.size());
+        // A rejected track is still walked for its tempo events.
+        const bool keepTrack = filter.keepsTrack(trackIndex);
 
-        char chunkId[4] = {0};
-        file.read(chunkId, 4);
-        if (!file.good()) {
+        if (file.remaining() < 8) {
             std::cerr << "Parser::parseMidiFile: unexpected EOF while reading track header\n";
             break;
         }
+        const unsigned char* chunkId = file.pos;
+        file.pos += 4;
 
         uint32_t trackSize = Utils::readBE32(file);
-        std::streampos trackEnd = file.tellg() + std::streamoff(trackSize);
+        size_t trackBytes = std::min<size_t>(trackSize, file.remaining());
 
-        if (std::string(chunkId,4) != "MTrk") {
-            std::cerr << "Parser::parseMidiFile: warning - expected MTrk chunk, got '" << std::string(chunkId,4) << "'\n";
+        if (std::memcmp(chunkId, "MTrk", 4) != 0) {
+            std::cerr << "Parser::parseMidiFile: warning - expected MTrk chunk, got '" << std::string(reinterpret_cast<const char*>(chunkId), 4) << "'\n";
         }
 
+        // Events are decoded from a cursor confined to this chunk, so a corrupt
+        // length can never read into the next track or past the buffer.
+        Utils::ByteCursor track(file.pos, trackBytes);
+        file.pos += trackBytes;
+
         unsigned char runningStatus = 0;
 
-        while (file.good() && file.tellg() < trackEnd) {
-            uint32_t delta = Utils::readVarLen(file);
+        while (track.ok && !track.atEnd()) {
+            uint32_t delta = Utils::readVarLen(track);
             absoluteTick += delta;
 
-            int first = readByte(file);
+            int first = Utils::readByte(track);
             if (first < 0) {
                 break;
             }
@@ -127,25 +122,25 @@ std::vector<NoteEvent> Parser::parseMidiFile(const std::string& path) {
 
             if (status == 0xFF) {
                 // Meta event
-                int metaType = readByte(file);
+                int metaType = Utils::readByte(track);
                 if (metaType < 0) break;
-                uint32_t len = Utils::readVarLen(file);
+                uint32_t len = Utils::readVarLen(track);
                 if (metaType == 0x51 && len == 3) {
-                    int b1 = readByte(file);
-                    int b2 = readByte(file);
-                    int b3 = readByte(file);
+                    int b1 = Utils::readByte(track);
+                    int b2 = Utils::readByte(track);
+                    int b3 = Utils::readByte(track);
                     if (b1 < 0 || b2 < 0 || b3 < 0) break;
                     uint32_t micro = (static_cast<uint32_t>(b1) << 16) | (static_cast<uint32_t>(b2) << 8) | static_cast<uint32_t>(b3);
                     tempoEvents.push_back({ absoluteTick, micro });
                 } else {
-                    file.seekg((std::streamoff)len, std::ios::cur);
+                    Utils::skipBytes(track, len);
                 }
                 continue;
             }
 
             if (status == 0xF0 || status == 0xF7) {
-                uint32_t len = Utils::readVarLen(file);
-                file.seekg((std::streamoff)len, std::ios::cur);
+                uint32_t len = Utils::readVarLen(track);
+                Utils::skipBytes(track, len);
                 continue;
             }
 
@@ -153,7 +148,7 @@ std::vector<NoteEvent> Parser::parseMidiFile(const std::string& path) {
 
             auto readData = [&](int already)->int {
                 if (already >= 0) return already;
-                return readByte(file);
+                return Utils::readByte(track);
             };
 
             if (eventType == 0x90 || eventType == 0x80) {
@@ -161,108 +156,144 @@ std::vector<NoteEvent> Parser::parseMidiFile(const std::string& path) {
                 int velocity = readData(-1);
                 if (pitch < 0 || velocity < 0) break;
 
+                const int channel = status & 0x0F;
+                if (!keepTrack || !filter.keepsChannel(channel)) continue;
                 bool isNoteOn = (eventType == 0x90 && velocity > 0);
-                rawEvents.push_back({ pitch, absoluteTick, isNoteOn, trackIndex, globalSeq++ });
-            } else if (eventType == 0xC0 || eventType == 0xD0) {
+                rawEvents.push_back({ absoluteTick, globalSeq++, static_cast<uint16_t>(trackIndex), static_cast<uint8_t>(channel),
+                                      static_cast<uint8_t>(pitch), static_cast<uint8_t>(velocity), isNoteOn ? RawKind::On : RawKind::Off });
+            } else if (eventType == 0xC0) {
+                int program = readData(dataByte1);
+                if (program < 0) break;
+                // Programs only matter to the bass filter; a channel's program
+                // applies to notes from every track, so it ignores the track filter.
+                if (filter.skipBass) {
+                    rawEvents.push_back({ absoluteTick, globalSeq++, static_cast<uint16_t>(trackIndex), static_cast<uint8_t>(status & 0x0F),
+                                          static_cast<uint8_t>(program), 0, RawKind::Program });
+                }
+            } else if (eventType == 0xD0) {
                 (void)readData(dataByte1);
             } else {
                 (void)readData(dataByte1);
                 (void)readData(-1);
             }
         }
+    }
 
-        if (file.tellg() < trackEnd) {
-            file.seekg(trackEnd);
+    // Each track's events are already in tick order and tracks were appended in
+    // index order, so the (tick, track, seq) ordering is a stable k-way merge of
+    // the per-track runs rather than a full sort.
+    for (size_t width = 1; width < trackStarts.size(); width *= 2) {
+        for (size_t i = 0; i + width < trackStarts.size(); i += 2 * width) {
+            auto first = rawEvents.begin() + trackStarts[i];
+            auto middle = rawEvents.begin() + trackStarts[i + width];
+            auto last = (i + 2 * width < trackStarts.size()) ? rawEvents.begin() + trackStarts[i + 2 * width] : rawEvents.end();
+            std::inplace_merge(first, middle, last, [](const RawEvent &a, const RawEvent &b) { return a.tick < b.tick; });
         }
     }
 
-    std::sort(rawEvents.begin(), rawEvents.end(), [](const RawEvent &a, const RawEvent &b) {
-        if (a.tick != b.tick) return a.tick < b.tick;
-        if (a.track != b.track) return a.track < b.track;
-        return a.seq < b.seq;
-    });
-
-    std::map<int, std::deque<uint64_t>> active;
-    struct TempNote { int pitch; uint64_t startTick; uint64_t durTicks; };
+    // Open note-ons per (channel, pitch), FIFO. Queues are created on first
+    // use; `queueOf` maps the key to one, indexed directly since pitches are
+    // data bytes.
+    struct OpenNote { uint64_t tick; uint16_t track; uint8_t velocity; bool keep; };
+    struct PitchQueue { std::vector<OpenNote> notes; size_t head = 0; };
+    std::vector<int32_t> queueOf(16 * 256, -1);
+    std::vector<PitchQueue> active;
+    uint8_t programs[16] = {};
+    struct TempNote { uint64_t startTick; uint64_t durTicks; uint16_t track; uint8_t pitch; uint8_t velocity; uint8_t channel; };
     std::vector<TempNote> tempNotes;
     tempNotes.reserve(rawEvents.size() / 2);
 
     for (const auto &e : rawEvents) {
-        if (e.on) {
-            active[e.pitch].push_back(e.tick);
-        } else {
-            auto &dq = active[e.pitch];
-            if (!dq.empty()) {
-                uint64_t s = dq.front(); dq.pop_front();
-                uint64_t dur = (e.tick > s) ? (e.tick - s) : 0;
-                tempNotes.push_back({ e.pitch, s, dur });
-            } else {
-                
-            }
+        if (e.kind == RawKind::Program) {
+            programs[e.channel] = e.data1;
+            continue;
         }
-    }
-    std::sort(tempoEvents.begin(), tempoEvents.end(), [](const TempoEvent &a, const TempoEvent &b){ return a.tick < b.tick; });
-
-    struct Segment { uint64_t tickStart; uint32_t microPerQuarter; };
-    std::vector<Segment> segments;
-    segments.reserve(tempoEvents.size() + 1);
-
-    uint32_t defaultMicro = 500000;
-    uint64_t prevTick = 0;
-    uint32_t currMicro = defaultMicro;
-
-    for (const auto &te : tempoEvents) {
-        if (te.tick > prevTick) {
-            segments.push_back({ prevTick, currMicro });
-            prevTick = te.tick;
+        int32_t &qi = queueOf[e.channel * 256 + e.data1];
+        if (qi < 0) {
+            qi = static_cast<int32_t>(active.size());
+            active.emplace_back();
         }
-        currMicro = te.microsecondsPerQuarter;
-    }
-    segments.push_back({ prevTick, currMicro });
-
-    std::vector<double> prefixSeconds; prefixSeconds.reserve(segments.size()+1);
-    prefixSeconds.push_back(0.0);
-    for (size_t i = 0; i < segments.size(); ++i) {
-        uint64_t t0 = segments[i].tickStart;
-        uint64_t t1 = (i + 1 < segments.size()) ? segments[i+1].tickStart : std::numeric_limits<uint64_t>::max();
-        double micro = static_cast<double>(segments[i].microPerQuarter);
-        double secondsInSegment = 0.0;
-        if (t1 != std::numeric_limits<uint64_t>::max()) {
-            uint64_t dt = t1 - t0;
-            secondsInSegment = (static_cast<double>(dt) * micro) / (1e6 * static_cast<double>(PPQ));
+        auto &q = active[qi];
+        if (e.kind == RawKind::On) {
+            const bool bass = programs[e.channel] >= kBassProgramFirst && programs[e.channel] <= kBassProgramLast;
+            q.notes.push_back({ e.tick, e.track, e.velocity, !(filter.skipBass && bass) });
+        } else if (q.head < q.notes.size()) {
+            OpenNote on = q.notes[q.head++];
+            if (q.head == q.notes.size()) {
+                q.notes.clear();
+                q.head = 0;
+            }
+            if (!on.keep) continue;
+            uint64_t dur = (e.tick > on.tick) ? (e.tick - on.tick) : 0;
+            tempNotes.push_back({ on.tick, dur, on.track, e.data1, on.velocity, e.channel });
         }
-        prefixSeconds.push_back(prefixSeconds.back() + secondsInSegment);
+    }
+    TempoMap tempo;
+    if (!TempoMap::fromDivision(division, tempoEvents, tempo)) {
+        if (division & 0x8000) std::cerr << "Parser::parseMidiFile: unsupported SMPTE division, falling back to 480 PPQ\n";
+        else std::cerr << "Parser::parseMidiFile: division/PPQ is zero, falling back to 480\n";
     }
 
-    auto ticksToSecondsAt = [&](uint64_t tick) -> double {
-        size_t lo = 0, hi = segments.size();
-        while (lo + 1 < hi) {
-            size_t mid = (lo + hi) / 2;
-            if (segments[mid].tickStart <= tick) lo = mid;
-            else hi = mid;
-        }
-        uint64_t segTickStart = segments[lo].tickStart;
-        double micro = static_cast<double>(segments[lo].microPerQuarter);
-        double baseSec = prefixSeconds[lo];
-        uint64_t dt = tick - segTickStart;
-        double extra = (static_cast<double>(dt) * micro) / (1e6 * static_cast<double>(PPQ));
-        return baseSec + extra;
-    };
-
-    std::vector<NoteEvent> out;
-    out.reserve(tempNotes.size());
+    // Notes come out in note-off order: end ticks are sorted and start ticks
+    // nearly so, which is the case the cursors are built for.
+    TempoMap::Cursor startClock = tempo.cursor();
+    TempoMap::Cursor endClock = tempo.cursor();
+    out.reserve(out.size() + tempNotes.size());
     for (const auto &tn : tempNotes) {
         NoteEvent ne;
         ne.pitch = tn.pitch;
-        ne.startTime = ticksToSecondsAt(tn.startTick);
-        double endSec = ticksToSecondsAt(tn.startTick + tn.durTicks);
+        ne.velocity = tn.velocity;
+        ne.channel = tn.channel;
+        ne.track = tn.track;
+        ne.startTime = startClock.seconds(tn.startTick);
+        double endSec = endClock.seconds(tn.startTick + tn.durTicks);
         ne.duration = endSec - ne.startTime;
         out.push_back(ne);
     }
+    return true;
+}
+
+}
+
+NoteFilter NoteFilter::melodic() {
+    NoteFilter f;
+    f.channels = static_cast<uint16_t>(0xFFFF & ~(1u << 9));
+    f.skipBass = true;
+    return f;
+}
+
+bool NoteFilter::keepsTrack(int track) const {
+    return tracks.empty() || std::find(tracks.begin(), tracks.end(), track) != tracks.end();
+}
+
+std::vector<NoteEvent> Parser::parseMidiFile(const std::string& path, const NoteFilter& filter) {
+    MappedFile file(path);
+    if (!file.isOpen()) {
+        std::cerr << "Parser::parseMidiFile: failed to open MIDI file: " << path << '\n';
+        return {};
+    }
+    return parseMidiBuffer(file.data(), file.size(), filter);
+}
 
+bool Parser::parseMidiFile(const std::string& path, NoteStore& out, const NoteFilter& filter) {
+    MappedFile file(path);
+    if (!file.isOpen()) {
+        std::cerr << "Parser::parseMidiFile: failed to open MIDI file: " << path << '\n';
+        return false;
+    }
+    return parseMidiBuffer(file.data(), file.size(), out, filter);
+}
+
+std::vector<NoteEvent> Parser::parseMidiBuffer(const unsigned char* data, size_t size, const NoteFilter& filter) {
+    std::vector<NoteEvent> out;
+    decodeNotes(data, size, filter, out);
     return out;
 }
 
+bool Parser::parseMidiBuffer(const unsigned char* data, size_t size, NoteStore& out, const NoteFilter& filter) {
+    return decodeNotes(data, size, filter, out);
+}
+
 std::vector<int> Parser::parseMelodyTxt(const std::string& path) {
     std::ifstream in(path);
     std::vector<int> seq;
@@ -0,0 +1,265 @@
+#include "MidiStreamWriter.h"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+namespace {
+
+// MThd chunk plus the MTrk tag; the track length follows at this offset.
+const std::streamoff kTrackLengthOffset = 18;
+
+void storeBE32(unsigned char* out, uint32_t v) {
+    out[0] = static_cast<unsigned char>((v >> 24) & 0xFF);
+    out[1] = static_cast<unsigned char>((v >> 16) & 0xFF);
+    out[2] = static_cast<unsigned char>((v >> 8) & 0xFF);
+    out[3] = static_cast<unsigned char>(v & 0xFF);
+}
+
+// Writes the VLQ form of `value` to `out` and returns its length (1..5).
+size_t encodeVarLen(unsigned char* out, uint32_t value) {
+    unsigned char buffer[5];
+    size_t idx = 0;
+    buffer[idx++] = value & 0x7F;
+    value >>= 7;
+    while (value) {
+        buffer[idx++] = 0x80 | (value & 0x7F);
+        value >>= 7;
+    }
+    for (size_t i = 0; i < idx; ++i) out[i] = buffer[idx - 1 - i];
+    return idx;
+}
+
+// Orders the heap so that its front is the earliest (tick, sequence).
+struct LaterOff {
+    template <class T>
+    bool operator()(const T& a, const T& b) const {
+        if (a.tick != b.tick) return a.tick > b.tick;
+        return a.sequence > b.sequence;
+    }
+};
+
+}
+
+MidiStreamWriter::MidiStreamWriter(int ppq, uint32_t microsecondsPerQuarter, int channel, int velocity)
+    : MidiStreamWriter(TempoMap(ppq, microsecondsPerQuarter), channel, velocity) {}
+
+MidiStreamWriter::MidiStreamWriter(const TempoMap& tempo, int channel, int velocity)
+    : tempo_(tempo),
+      onClock_(tempo_),
+      offClock_(tempo_),
+      channel_(channel < 0 || channel > 15 ? 0 : channel),
+      velocity_(velocity < 0 ? 64 : std::min(velocity, 127)),
+      buffer_(kBufferSize) {
+    pending_.reserve(16);
+}
+
+void MidiStreamWriter::reset(Mode mode) {
+    mode_ = mode;
+    failed_ = false;
+    buffered_ = 0;
+    pending_.clear();
+    sequence_ = 0;
+    nextTempo_ = tempo_.isSmpte() ? tempo_.segments().size() : 0;
+    onClock_ = tempo_.cursor();
+    offClock_ = tempo_.cursor();
+    lastOnTick_ = 0;
+    lastTick_ = 0;
+    trackBytes_ = 0;
+}
+
+bool MidiStreamWriter::open(const std::string& outPath) {
+    if (file_.is_open()) file_.close();
+    file_.open(outPath, std::ios::binary | std::ios::trunc);
+    if (!file_.is_open()) {
+        std::cerr << "MidiStreamWriter::open: failed to open " << outPath << " for writing\n";
+        mode_ = Mode::Closed;
+        return false;
+    }
+    if (file_.tellp() < 0) {
+        std::cerr << "MidiStreamWriter::open: " << outPath << " is not seekable; use writeTwoPass\n";
+        file_.close();
+        mode_ = Mode::Closed;
+        return false;
+    }
+    reset(Mode::File);
+    writeHeader();
+    return true;
+}
+
+bool MidiStreamWriter::open(Sink sink, uint32_t trackLength) {
+    if (!sink) {
+        std::cerr << "MidiStreamWriter::open: empty sink\n";
+        mode_ = Mode::Closed;
+        return false;
+    }
+    sink_ = std::move(sink);
+    declaredLength_ = trackLength;
+    reset(Mode::Sink);
+    writeHeader();
+    return true;
+}
+
+void MidiStreamWriter::openMeasure() {
+    reset(Mode::Measure);
+    writeHeader();
+}
+
+void MidiStreamWriter::writeHeader() {
+    unsigned char header[22] = { 'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0, 0, 'M', 'T', 'r', 'k', 0, 0, 0, 0 };
+    const uint16_t division = tempo_.division();
+    header[12] = static_cast<unsigned char>((division >> 8) & 0xFF);
+    header[13] = static_cast<unsigned char>(division & 0xFF);
+    storeBE32(header + 18, mode_ == Mode::Sink ? declaredLength_ : 0);
+    put(header, sizeof(header));
+}
+
+void MidiStreamWriter::emitTempoUntil(uint64_t tick) {
+    const auto &segs = tempo_.segments();
+    for (; nextTempo_ < segs.size() && segs[nextTempo_].tick <= tick; ++nextTempo_) {
+        const TempoMap::Segment &seg = segs[nextTempo_];
+        unsigned char event[11];
+        size_t n = encodeVarLen(event, static_cast<uint32_t>(seg.tick - lastTick_));
+        const unsigned char meta[6] = { 0xFF, 0x51, 0x03,
+                                        static_cast<unsigned char>((seg.microsecondsPerQuarter >> 16) & 0xFF),
+                                        static_cast<unsigned char>((seg.microsecondsPerQuarter >> 8) & 0xFF),
+                                        static_cast<unsigned char>(seg.microsecondsPerQuarter & 0xFF) };
+        std::copy(meta, meta + sizeof(meta), event + n);
+        n += sizeof(meta);
+        put(event, n);
+        trackBytes_ += n;
+        lastTick_ = seg.tick;
+    }
+}
+
+void MidiStreamWriter::emit(uint64_t tick, unsigned char status, unsigned char data1, unsigned char data2) {
+    // A tempo change at the same tick goes ahead of the notes, as in MidiWriter.
+    emitTempoUntil(tick);
+    unsigned char event[8];
+    size_t n = encodeVarLen(event, static_cast<uint32_t>(tick - lastTick_));
+    event[n++] = status;
+    event[n++] = data1;
+    event[n++] = data2;
+    put(event, n);
+    trackBytes_ += n;
+    lastTick_ = tick;
+}
+
+void MidiStreamWriter::releaseUntil(uint64_t tick) {
+    const unsigned char statusOff = static_cast<unsigned char>(0x80 | (channel_ & 0x0F));
+    while (!pending_.empty() && pending_.front().tick <= tick) {
+        std::pop_heap(pending_.begin(), pending_.end(), LaterOff());
+        const PendingOff off = pending_.back();
+        pending_.pop_back();
+        emit(off.tick, statusOff, off.pitch, 0);
+    }
+}
+
+bool MidiStreamWriter::add(const NoteEvent& note) {
+    if (mode_ == Mode::Closed) {
+        std::cerr << "MidiStreamWriter::add: writer is not open\n";
+        return false;
+    }
+    const uint64_t onTick = onClock_.ticks(note.startTime);
+    uint64_t offTick = offClock_.ticks(note.startTime + note.duration);
+    if (offTick < onTick) offTick = onTick;
+    if (onTick < lastOnTick_) {
+        std::cerr << "MidiStreamWriter::add: note at tick " << onTick << " starts before the previous note (tick "
+                  << lastOnTick_ << ")\n";
+        return false;
+    }
+
+    // Offs already due belong to earlier notes, so at an equal tick they go first.
+    releaseUntil(onTick);
+    const unsigned char pitch = static_cast<unsigned char>(note.pitch & 0x7F);
+    const int velocity = note.velocity != 0 ? note.velocity : velocity_;
+    emit(onTick, static_cast<unsigned char>(0x90 | (channel_ & 0x0F)), pitch, static_cast<unsigned char>(velocity & 0x7F));
+    pending_.push_back(PendingOff{ offTick, sequence_++, pitch });
+    std::push_heap(pending_.begin(), pending_.end(), LaterOff());
+    lastOnTick_ = onTick;
+    return !failed_;
+}
+
+void MidiStreamWriter::put(const unsigned char* bytes, size_t n) {
+    if (mode_ == Mode::Measure) return;
+    while (n > 0) {
+        if (buffered_ == buffer_.size() && !flush()) return;
+        const size_t take = std::min(n, buffer_.size() - buffered_);
+        std::copy(bytes, bytes + take, buffer_.data() + buffered_);
+        buffered_ += take;
+        bytes += take;
+        n -= take;
+    }
+}
+
+bool MidiStreamWriter::flush() {
+    if (buffered_ == 0 || failed_) {
+        buffered_ = 0;
+        return !failed_;
+    }
+    if (mode_ == Mode::File) {
+        file_.write(reinterpret_cast<const char*>(buffer_.data()), static_cast<std::streamsize>(buffered_));
+        failed_ = !file_.good();
+    } else if (mode_ == Mode::Sink) {
+        failed_ = !sink_(buffer_.data(), buffered_);
+    }
+    buffered_ = 0;
+    return !failed_;
+}
+
+bool MidiStreamWriter::finish() {
+    if (mode_ == Mode::Closed) {
+        std::cerr << "MidiStreamWriter::finish: writer is not open\n";
+        return false;
+    }
+    releaseUntil(std::numeric_limits<uint64_t>::max());
+    emitTempoUntil(std::numeric_limits<uint64_t>::max());
+    const unsigned char endOfTrack[4] = { 0x00, 0xFF, 0x2F, 0x00 };
+    put(endOfTrack, sizeof(endOfTrack));
+    trackBytes_ += sizeof(endOfTrack);
+    flush();
+
+    const Mode mode = mode_;
+    mode_ = Mode::Closed;
+    if (trackBytes_ > std::numeric_limits<uint32_t>::max()) {
+        std::cerr << "MidiStreamWriter::finish: track of " << trackBytes_ << " bytes exceeds the SMF chunk limit\n";
+        failed_ = true;
+    }
+    if (mode == Mode::File) {
+        if (!failed_) {
+            unsigned char length[4];
+            storeBE32(length, static_cast<uint32_t>(trackBytes_));
+            file_.seekp(kTrackLengthOffset);
+            file_.write(reinterpret_cast<const char*>(length), sizeof(length));
+            failed_ = !file_.good();
+        }
+        file_.close();
+    } else if (mode == Mode::Sink) {
+        if (!failed_ && trackBytes_ != declaredLength_) {
+            std::cerr << "MidiStreamWriter::finish: wrote " << trackBytes_ << " track bytes but declared " << declaredLength_ << "\n";
+            failed_ = true;
+        }
+        sink_ = nullptr;
+    }
+    if (failed_) {
+        std::cerr << "MidiStreamWriter::finish: output failed\n";
+        return false;
+    }
+    return true;
+}
+
+bool MidiStreamWriter::writeTwoPass(const Sink& sink, const Replay& replay, int ppq, uint32_t microsecondsPerQuarter,
+                                    int channel, int velocity) {
+    return writeTwoPass(sink, replay, TempoMap(ppq, microsecondsPerQuarter), channel, velocity);
+}
+
+bool MidiStreamWriter::writeTwoPass(const Sink& sink, const Replay& replay, const TempoMap& tempo, int channel, int velocity) {
+    MidiStreamWriter measure(tempo, channel, velocity);
+    measure.openMeasure();
+    if (!replay(measure) || !measure.finish()) return false;
+
+    MidiStreamWriter out(tempo, channel, velocity);
+    if (!out.open(sink, static_cast<uint32_t>(measure.trackBytes()))) return false;
+    if (!replay(out)) return false;
+    return out.finish();
+}
@@ -3,26 +3,27 @@
 #include <algorithm>
 #include <cstdint>
 #include <iostream>
-#include <map>
 #include <vector>
-#include <cassert>
 #include <cmath>
+#include <cstring>
+#include <type_traits>
 
-static void writeBE16(std::ofstream &f, uint16_t v) {
-    unsigned char b1 = (v >> 8) & 0xFF;
-    unsigned char b2 = v & 0xFF;
-    f.put(b1);
-    f.put(b2);
+namespace {
+
+void storeBE16(unsigned char* out, uint16_t v) {
+    out[0] = static_cast<unsigned char>((v >> 8) & 0xFF);
+    out[1] = static_cast<unsigned char>(v & 0xFF);
 }
-static void writeBE32(std::ofstream &f, uint32_t v) {
-    unsigned char b1 = (v >> 24) & 0xFF;
-    unsigned char b2 = (v >> 16) & 0xFF;
-    unsigned char b3 = (v >> 8) & 0xFF;
-    unsigned char b4 = v & 0xFF;
-    f.put(b1); f.put(b2); f.put(b3); f.put(b4);
+
+void storeBE32(unsigned char* out, uint32_t v) {
+    out[0] = static_cast<unsigned char>((v >> 24) & 0xFF);
+    out[1] = static_cast<unsigned char>((v >> 16) & 0xFF);
+    out[2] = static_cast<unsigned char>((v >> 8) & 0xFF);
+    out[3] = static_cast<unsigned char>(v & 0xFF);
 }
 
-static void writeVarLen(std::ofstream &f, uint32_t value) {
+// Writes the VLQ form of `value` at `out` and returns the byte after it.
+unsigned char* storeVarLen(unsigned char* out, uint32_t value) {
     unsigned char buffer[5];
     int idx = 0;
     buffer[idx++] = value & 0x7F;
@@ -31,121 +32,203 @@ static void writeVarLen(std::ofstream &f, uint32_t value) {
         buffer[idx++] = 0x80 | (value & 0x7F);
         value >>= 7;
     }
-    for (int i = idx - 1; i >= 0; --i) f.put(buffer[i]);
+    for (int i = idx - 1; i >= 0; --i) *out++ = buffer[i];
+    return out;
 }
 
-struct Event {
-    uint64_t tick;
-    std::vector<unsigned char> bytes;
-    bool isMeta = false;
-    int metaPriority = 0;
-};
+const size_t kMaxDeltaBytes = 5;
 
-bool MidiWriter::write(const std::string& outPath, const std::vector<NoteEvent>& notes, int ppq, uint32_t microsecondsPerQuarter, int channel, int velocity) const {
-    if (ppq <= 0) ppq = 480;
-    if (channel < 0 || channel > 15) channel = 0;
-    if (velocity < 0) velocity = 64;
-    if (velocity > 127) velocity = 127;
-    auto secToTicks = [&](double s)->uint64_t {
-        double v = s * 1'000'000.0 * static_cast<double>(ppq) / static_cast<double>(microsecondsPerQuarter);
-        if (v < 0.0) v = 0.0;
-        return static_cast<uint64_t>(std::llround(v));
-    };
-
-    std::vector<Event> events;
-    events.reserve(notes.size() * 2 + 2);
-
-    {
-        Event e;
-        e.tick = 0;
-        e.isMeta = true;
-        e.metaPriority = 0;
-        e.bytes.push_back(0xFF);
-        e.bytes.push_back(0x51);
-        e.bytes.push_back(0x03);
-        e.bytes.push_back((microsecondsPerQuarter >> 16) & 0xFF);
-        e.bytes.push_back((microsecondsPerQuarter >> 8) & 0xFF);
-        e.bytes.push_back(microsecondsPerQuarter & 0xFF);
-        events.push_back(std::move(e));
+}
+
+void MidiWriter::sortByTick(uint64_t maxTick) {
+    static_assert(std::is_trivially_copyable<Event>::value, "events are moved with memcpy");
+    const size_t n = events_.size();
+    bool sorted = true;
+    for (size_t i = 1; i < n && sorted; ++i) sorted = events_[i - 1].tick <= events_[i].tick;
+    if (sorted) return;
+
+    // LSD radix sort, one byte per pass. Each pass is stable, so events that
+    // share a tick keep insertion order: tempo meta events first, and each
+    // note's off ahead of any later note's on.
+    scratch_.resize(n);
+    for (int shift = 0; shift < 64 && (maxTick >> shift) != 0; shift += 8) {
+        size_t counts[256] = {};
+        for (size_t i = 0; i < n; ++i) ++counts[(events_[i].tick >> shift) & 0xFF];
+        if (counts[(events_[0].tick >> shift) & 0xFF] == n) continue;
+        size_t offset = 0;
+        for (size_t &c : counts) {
+            const size_t start = offset;
+            offset += c;
+            c = start;
+        }
+        for (size_t i = 0; i < n; ++i) scratch_[counts[(events_[i].tick >> shift) & 0xFF]++] = events_[i];
+        events_.swap(scratch_);
     }
+}
 
-    for (const auto &n : notes) {
-        int pitch = n.pitch;
-        uint64_t onTick = secToTicks(n.startTime);
-        uint64_t offTick = secToTicks(n.startTime + n.duration);
-        if (offTick < onTick) offTick = onTick;
-
-        Event onEv;
-        onEv.tick = onTick;
-        onEv.isMeta = false;
-        unsigned char statusOn = static_cast<unsigned char>(0x90 | (channel & 0x0F));
-        onEv.bytes.push_back(statusOn);
-        onEv.bytes.push_back(static_cast<unsigned char>(pitch & 0x7F));
-        onEv.bytes.push_back(static_cast<unsigned char>(velocity & 0x7F));
-        events.push_back(std::move(onEv));
-
-        Event offEv;
-        offEv.tick = offTick;
-        offEv.isMeta = false;
-        unsigned char statusOff = static_cast<unsigned char>(0x80 | (channel & 0x0F));
-        offEv.bytes.push_back(statusOff);
-        offEv.bytes.push_back(static_cast<unsigned char>(pitch & 0x7F));
-        offEv.bytes.push_back(static_cast<unsigned char>(0));
-        events.push_back(std::move(offEv));
+const TempoMap& MidiWriter::constantTempo(int ppq, uint32_t microsecondsPerQuarter) {
+    if (ppq <= 0) ppq = 480;
+    if (constantTempo_.ppq() != ppq || constantTempo_.segments().front().microsecondsPerQuarter != microsecondsPerQuarter) {
+        constantTempo_ = TempoMap(ppq, microsecondsPerQuarter);
     }
+    return constantTempo_;
+}
 
-    std::sort(events.begin(), events.end(), [](const Event &a, const Event &b){
-        if (a.tick != b.tick) return a.tick < b.tick;
-        if (a.isMeta != b.isMeta) return a.isMeta;
-        if (a.isMeta && b.isMeta) return a.metaPriority < b.metaPriority;
-        return false;
-    });
+void MidiWriter::beginImage(uint16_t format, uint16_t trackCount, uint16_t division) {
+    image_.resize(14);
+    unsigned char *out = image_.data();
+    std::memcpy(out, "MThd", 4);
+    storeBE32(out + 4, 6);
+    storeBE16(out + 8, format);
+    storeBE16(out + 10, trackCount);
+    storeBE16(out + 12, division);
+}
 
-    std::ofstream out(outPath, std::ios::binary);
-    if (!out.is_open()) {
-        std::cerr << "MidiWriter::write: failed to open " << outPath << " for writing\n";
-        return false;
+uint64_t MidiWriter::addTempo(const TempoMap& tempo) {
+    if (tempo.isSmpte()) return 0;
+    uint64_t lastTick = 0;
+    for (const auto &seg : tempo.segments()) {
+        const uint32_t micro = seg.microsecondsPerQuarter;
+        events_.push_back(Event{ seg.tick, { 0xFF, 0x51, 0x03,
+                                             static_cast<unsigned char>((micro >> 16) & 0xFF),
+                                             static_cast<unsigned char>((micro >> 8) & 0xFF),
+                                             static_cast<unsigned char>(micro & 0xFF) }, 6, 0 });
+        lastTick = seg.tick;
     }
+    return lastTick;
+}
 
-    out.write("MThd", 4);
-    writeBE32(out, 6);
-    writeBE16(out, 0);
-    writeBE16(out, 1);
-    writeBE16(out, static_cast<uint16_t>(ppq));
+uint64_t MidiWriter::addNote(const NoteEvent& n, int channel, int velocity, TempoMap::Cursor& onClock, TempoMap::Cursor& offClock) {
+    const unsigned char pitch = static_cast<unsigned char>(n.pitch & 0x7F);
+    const unsigned char vel = static_cast<unsigned char>((n.velocity != 0 ? n.velocity : velocity) & 0x7F);
+    uint64_t onTick = onClock.ticks(n.startTime);
+    uint64_t offTick = offClock.ticks(n.startTime + n.duration);
+    if (offTick < onTick) offTick = onTick;
+    events_.push_back(Event{ onTick, { static_cast<unsigned char>(0x90 | (channel & 0x0F)), pitch, vel }, 3, 0 });
+    events_.push_back(Event{ offTick, { static_cast<unsigned char>(0x80 | (channel & 0x0F)), pitch, 0 }, 3, 0 });
+    return offTick;
+}
 
-    std::vector<unsigned char> trackData;
-    trackData.reserve(events.size() * 16);
+void MidiWriter::endTrack(uint64_t maxTick) {
+    sortByTick(maxTick);
 
-    uint64_t prevTick = 0;
-    for (size_t i = 0; i < events.size(); ++i) {
-        const Event &ev = events[i];
-        uint64_t deltaTicks = ev.tick - prevTick;
-        {
-            unsigned char buffer[5];
-            int idx = 0;
-            uint32_t v = static_cast<uint32_t>(deltaTicks);
-            buffer[idx++] = v & 0x7F;
-            v >>= 7;
-            while (v) {
-                buffer[idx++] = 0x80 | (v & 0x7F);
-                v >>= 7;
-            }
-            for (int j = idx - 1; j >= 0; --j) trackData.push_back(buffer[j]);
-        }
-        for (unsigned char b : ev.bytes) trackData.push_back(b);
+    // Upper bound: every delta at its longest, plus the end-of-track event.
+    const size_t chunkStart = image_.size();
+    image_.resize(chunkStart + 8 + events_.size() * (kMaxDeltaBytes + sizeof(Event::bytes)) + 4);
+    unsigned char *chunk = image_.data() + chunkStart;
+    std::memcpy(chunk, "MTrk", 4);
+    unsigned char *p = chunk + 8;
 
+    uint64_t prevTick = 0;
+    for (const Event &ev : events_) {
+        p = storeVarLen(p, static_cast<uint32_t>(ev.tick - prevTick));
+        std::memcpy(p, ev.bytes, ev.size);
+        p += ev.size;
         prevTick = ev.tick;
     }
+    const unsigned char endOfTrack[4] = { 0x00, 0xFF, 0x2F, 0x00 };
+    std::memcpy(p, endOfTrack, sizeof(endOfTrack));
+    p += sizeof(endOfTrack);
+
+    storeBE32(chunk + 4, static_cast<uint32_t>(p - chunk - 8));
+    image_.resize(chunkStart + static_cast<size_t>(p - chunk));
+    events_.clear();
+}
+
+const std::vector<unsigned char>& MidiWriter::encode(const std::vector<NoteEvent>& notes, int ppq, uint32_t microsecondsPerQuarter, int channel, int velocity) {
+    return encode(notes, constantTempo(ppq, microsecondsPerQuarter), channel, velocity);
+}
+
+const std::vector<unsigned char>& MidiWriter::encode(const std::vector<NoteEvent>& notes, const TempoMap& tempo, int channel, int velocity) {
+    if (channel < 0 || channel > 15) channel = 0;
+    if (velocity < 0) velocity = 64;
+    if (velocity > 127) velocity = 127;
+
+    beginImage(0, 1, tempo.division());
+    events_.clear();
+    events_.reserve(notes.size() * 2 + tempo.segments().size());
+    uint64_t maxTick = addTempo(tempo);
+    TempoMap::Cursor onClock = tempo.cursor(), offClock = tempo.cursor();
+    for (const auto &n : notes) maxTick = std::max(maxTick, addNote(n, channel, velocity, onClock, offClock));
+    endTrack(maxTick);
+    return image_;
+}
+
+const std::vector<unsigned char>& MidiWriter::encodeTracks(const std::vector<NoteEvent>& notes, int ppq, uint32_t microsecondsPerQuarter, int velocity) {
+    return encodeTracks(notes, constantTempo(ppq, microsecondsPerQuarter), velocity);
+}
 
-    trackData.push_back(0x00);
-    trackData.push_back(0xFF);
-    trackData.push_back(0x2F);
-    trackData.push_back(0x00);
+const std::vector<unsigned char>& MidiWriter::encodeTracks(const std::vector<NoteEvent>& notes, const TempoMap& tempo, int velocity) {
+    if (velocity < 0) velocity = 64;
+    if (velocity > 127) velocity = 127;
 
-    out.write("MTrk", 4);
-    writeBE32(out, static_cast<uint32_t>(trackData.size()));
-    out.write(reinterpret_cast<const char*>(trackData.data()), trackData.size());
+    // Note indices grouped by track, in input order within each track.
+    order_.resize(notes.size());
+    for (size_t i = 0; i < notes.size(); ++i) order_[i] = static_cast<uint32_t>(i);
+    std::sort(order_.begin(), order_.end(), [&](uint32_t a, uint32_t b) {
+        if (notes[a].track != notes[b].track) return notes[a].track < notes[b].track;
+        return a < b;
+    });
+    size_t trackCount = 1;
+    for (size_t i = 1; i < order_.size(); ++i) trackCount += notes[order_[i]].track != notes[order_[i - 1]].track;
+    if (notes.empty()) trackCount = 0;
+    if (trackCount + 1 > 0xFFFF) {
+        std::cerr << "MidiWriter::encodeTracks: " << trackCount << " tracks exceed the SMF limit\n";
+        image_.clear();
+        return image_;
+    }
+
+    // Track 0 is the conductor track holding the tempo map; every note track follows.
+    beginImage(1, static_cast<uint16_t>(trackCount + 1), tempo.division());
+    events_.clear();
+    endTrack(addTempo(tempo));
+    for (size_t begin = 0; begin < order_.size();) {
+        size_t end = begin;
+        uint64_t maxTick = 0;
+        const uint16_t track = notes[order_[begin]].track;
+        TempoMap::Cursor onClock = tempo.cursor(), offClock = tempo.cursor();
+        for (; end < order_.size() && notes[order_[end]].track == track; ++end) {
+            const NoteEvent &n = notes[order_[end]];
+            maxTick = std::max(maxTick, addNote(n, n.channel, velocity, onClock, offClock));
+        }
+        endTrack(maxTick);
+        begin = end;
+    }
+    return image_;
+}
 
+bool MidiWriter::save(const std::string& outPath, const std::vector<unsigned char>& image) {
+    if (image.empty()) return false;
+    // The image is complete, so the stream's own buffer would only add a copy
+    // (and an allocation).
+    std::ofstream out;
+    out.rdbuf()->pubsetbuf(nullptr, 0);
+    out.open(outPath, std::ios::binary);
+    if (!out.is_open()) {
+        std::cerr << "MidiWriter::write: failed to open " << outPath << " for writing\n";
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(image.data()), static_cast<std::streamsize>(image.size()));
     out.close();
+    if (out.fail()) {
+        std::cerr << "MidiWriter::write: write failed for " << outPath << "\n";
+        return false;
+    }
     return true;
 }
+
+bool MidiWriter::write(const std::string& outPath, const std::vector<NoteEvent>& notes, int ppq, uint32_t microsecondsPerQuarter, int channel, int velocity) {
+    return save(outPath, encode(notes, ppq, microsecondsPerQuarter, channel, velocity));
+}
+
+bool MidiWriter::writeTracks(const std::string& outPath, const std::vector<NoteEvent>& notes, int ppq, uint32_t microsecondsPerQuarter, int velocity) {
+    return save(outPath, encodeTracks(notes, ppq, microsecondsPerQuarter, velocity));
+}
+
+bool MidiWriter::write(const std::string& outPath, const std::vector<NoteEvent>& notes, const TempoMap& tempo, int channel, int velocity) {
+    return save(outPath, encode(notes, tempo, channel, velocity));
+}
+
+bool MidiWriter::writeTracks(const std::string& outPath, const std::vector<NoteEvent>& notes, const TempoMap& tempo, int velocity) {
+    return save(outPath, encodeTracks(notes, tempo, velocity));
+}
\ No newline at end of file
@@ -0,0 +1,267 @@
+#include "ModelFile.h"
+#include "MappedFile.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+const char kMagic[8] = { 'M', 'G', 'M', 'O', 'D', 'E', 'L', '\0' };
+const uint32_t kByteOrder = 0x01020304u;
+const size_t kAlign = 64;
+
+// Section ids: model base | kind.
+const uint32_t kMelodyBase = 0x100;
+const uint32_t kRhythmBase = 0x200;
+enum SectionKind : uint32_t {
+    kParams = 1,
+    kSlots,
+    kPool,
+    kCumulative,
+    kDenseIds,
+    kSparseIds,
+    kUnigrams,
+    kUnigramCumulative,
+    kRhythmParams = 0xFF,
+};
+
+size_t alignUp(size_t v) {
+    return (v + kAlign - 1) / kAlign * kAlign;
+}
+
+}
+
+void ModelFile::collect(const MarkovModel& model, uint32_t base, MarkovParams& params, std::vector<Section>& out) {
+    const NGramTable &t = model.transitions_;
+    params = MarkovParams{};
+    params.order = static_cast<uint64_t>(model.order_);
+    params.bitsPerToken = static_cast<uint64_t>(model.bitsPerToken_);
+    params.maxPackedId = model.maxPackedId_;
+    params.vocabIds = model.vocabIds_;
+    params.historyCount = t.used_;
+    params.entryCount = t.entries_;
+    params.cumulativeValid = t.cumulativeValid_ ? 1 : 0;
+
+    out.push_back({ base | kParams, sizeof(MarkovParams), &params, 1 });
+    out.push_back({ base | kSlots, sizeof(NGramTable::Slot), t.slots_.data(), t.slots_.size() });
+    out.push_back({ base | kPool, sizeof(NGramTable::Entry), t.pool_.data(), t.pool_.size() });
+    out.push_back({ base | kCumulative, sizeof(uint32_t), t.cumulative_.data(), t.cumulativeValid_ ? t.cumulative_.size() : 0 });
+    out.push_back({ base | kDenseIds, sizeof(uint32_t), model.denseIds_.data(), model.denseIds_.size() });
+    out.push_back({ base | kSparseIds, sizeof(MarkovModel::TokenId), model.sparseIds_.data(), model.sparseIds_.size() });
+    out.push_back({ base | kUnigrams, sizeof(NGramTable::Entry), model.unigramCounts_.data(), model.unigramCounts_.size() });
+    out.push_back({ base | kUnigramCumulative, sizeof(uint32_t), model.unigramCumulative_.data(), model.unigramCumulative_.size() });
+}
+
+bool ModelFile::save(const std::string& path, const MarkovModel& melody, const RhythmModel& rhythm) {
+    MarkovParams melodyParams, rhythmMarkovParams;
+    RhythmParams rhythmParams{ rhythm.unit(), RhythmQuantizer::kTokenCount, rhythm.order_, 0 };
+    std::vector<Section> sections;
+    collect(melody, kMelodyBase, melodyParams, sections);
+    collect(rhythm.markov_, kRhythmBase, rhythmMarkovParams, sections);
+    sections.push_back({ kRhythmBase | kRhythmParams, sizeof(RhythmParams), &rhythmParams, 1 });
+
+    // Lay out header, section table, then each payload on a 64-byte boundary.
+    std::vector<SectionEntry> table(sections.size());
+    size_t cursor = alignUp(sizeof(FileHeader) + sizeof(SectionEntry) * sections.size());
+    for (size_t i = 0; i < sections.size(); ++i) {
+        table[i] = SectionEntry{ sections[i].id, sections[i].elemSize, cursor, sections[i].count };
+        cursor = alignUp(cursor + sections[i].elemSize * sections[i].count);
+    }
+
+    std::vector<unsigned char> image(cursor, 0);
+    std::memcpy(image.data() + sizeof(FileHeader), table.data(), sizeof(SectionEntry) * table.size());
+    for (size_t i = 0; i < sections.size(); ++i) {
+        if (sections[i].count) std::memcpy(image.data() + table[i].offset, sections[i].data, sections[i].elemSize * sections[i].count);
+    }
+
+    FileHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.byteOrder = kByteOrder;
+    header.fileSize = image.size();
+    header.sectionCount = static_cast<uint32_t>(sections.size());
+    header.checksum = Utils::checksum64(image.data() + sizeof(FileHeader), image.size() - sizeof(FileHeader));
+    std::memcpy(image.data(), &header, sizeof(header));
+
+    // Write to a temporary name and rename, so a crash never leaves a
+    // half-written file where a loader would find it.
+    const std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            std::cerr << "ModelFile::save: failed to open " << tmpPath << " for writing\n";
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(image.data()), static_cast<std::streamsize>(image.size()));
+        if (!out.good()) {
+            std::cerr << "ModelFile::save: write failed for " << tmpPath << '\n';
+            return false;
+        }
+    }
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "ModelFile::save: failed to move " << tmpPath << " to " << path << '\n';
+        return false;
+    }
+    return true;
+}
+
+bool ModelFile::attach(MarkovModel& model, uint32_t base, const std::vector<Section>& sections, const std::shared_ptr<const MappedFile>& file) {
+    auto get = [&](uint32_t kind, uint32_t elemSize) -> const Section* {
+        for (const auto &s : sections) {
+            if (s.id == (base | kind)) return s.elemSize == elemSize ? &s : nullptr;
+        }
+        return nullptr;
+    };
+    const Section *params = get(kParams, sizeof(MarkovParams));
+    const Section *slots = get(kSlots, sizeof(NGramTable::Slot));
+    const Section *pool = get(kPool, sizeof(NGramTable::Entry));
+    const Section *cumulative = get(kCumulative, sizeof(uint32_t));
+    const Section *dense = get(kDenseIds, sizeof(uint32_t));
+    const Section *sparse = get(kSparseIds, sizeof(MarkovModel::TokenId));
+    const Section *unigrams = get(kUnigrams, sizeof(NGramTable::Entry));
+    const Section *unigramCum = get(kUnigramCumulative, sizeof(uint32_t));
+    if (!params || params->count != 1 || !slots || !pool || !cumulative || !dense || !sparse || !unigrams || !unigramCum) return false;
+
+    MarkovParams p;
+    std::memcpy(&p, params->data, sizeof(p));
+    // Everything below is read straight from the file, which may be corrupt
+    // (the checksum can be skipped) or crafted; nothing may index past a
+    // section or shift past a key.
+    auto reject = [&](const char* what) {
+        std::cerr << "ModelFile::load: section " << std::hex << base << std::dec << " has " << what << '\n';
+        return false;
+    };
+    if (p.order < 1 || p.order > static_cast<uint64_t>(MarkovModel::kMaxOrder)) return reject("an invalid order");
+    const MarkovModel reference(static_cast<int>(p.order));
+    if (p.bitsPerToken != static_cast<uint64_t>(reference.bitsPerToken_) || p.maxPackedId != reference.maxPackedId_) {
+        return reject("a key packing that does not match its order");
+    }
+    // The probe sequence masks with slots-1, so the table size must be a power
+    // of two, and it stops at an empty slot, so one must exist. An empty table
+    // has no slots; every probe checks for that first.
+    if (slots->count == 0 ? (p.historyCount != 0 || p.entryCount != 0 || pool->count != 0)
+                          : (slots->count & (slots->count - 1)) != 0 || slots->count > (uint64_t(1) << 32)) {
+        return reject("an invalid slot count");
+    }
+    if (cumulative->count != 0 && cumulative->count != pool->count) return reject("a mismatched cumulative array");
+    if (unigramCum->count != 0 && unigramCum->count != unigrams->count) return reject("a mismatched unigram cumulative array");
+    const NGramTable::Slot *slotData = static_cast<const NGramTable::Slot*>(slots->data);
+    uint64_t used = 0, entries = 0;
+    for (uint64_t i = 0; i < slots->count; ++i) {
+        const NGramTable::Slot &s = slotData[i];
+        if (s.key == 0) continue;
+        if (static_cast<uint64_t>(s.offset) + s.size > pool->count) return reject("a row outside the pool");
+        ++used;
+        entries += s.size;
+    }
+    if (used != p.historyCount || entries != p.entryCount || (slots->count != 0 && used >= slots->count)) {
+        return reject("history or entry counts that do not match its slots");
+    }
+    if (p.vocabIds > 0xFFFFFFFFull || dense->count > static_cast<uint64_t>(MarkovModel::kDenseTokens)) return reject("an invalid vocabulary");
+    const uint32_t *denseData = static_cast<const uint32_t*>(dense->data);
+    for (uint64_t i = 0; i < dense->count; ++i) {
+        if (denseData[i] > p.vocabIds) return reject("a token id beyond its vocabulary");
+    }
+    const MarkovModel::TokenId *sparseData = static_cast<const MarkovModel::TokenId*>(sparse->data);
+    for (uint64_t i = 0; i < sparse->count; ++i) {
+        if (sparseData[i].id == 0 || sparseData[i].id > p.vocabIds) return reject("a token id beyond its vocabulary");
+        if (i > 0 && sparseData[i].token <= sparseData[i - 1].token) return reject("unsorted sparse token ids");
+    }
+
+    model.order_ = static_cast<int>(p.order);
+    model.bitsPerToken_ = static_cast<int>(p.bitsPerToken);
+    model.maxPackedId_ = static_cast<uint32_t>(p.maxPackedId);
+    model.vocabIds_ = static_cast<uint32_t>(p.vocabIds);
+    model.denseIds_.attach(static_cast<const uint32_t*>(dense->data), dense->count);
+    model.sparseIds_.attach(static_cast<const MarkovModel::TokenId*>(sparse->data), sparse->count);
+    model.unigramCounts_.attach(static_cast<const NGramTable::Entry*>(unigrams->data), unigrams->count);
+    model.unigramCumulative_.attach(static_cast<const uint32_t*>(unigramCum->data), unigramCum->count);
+
+    NGramTable &t = model.transitions_;
+    t.slots_.attach(static_cast<const NGramTable::Slot*>(slots->data), slots->count);
+    t.pool_.attach(static_cast<const NGramTable::Entry*>(pool->data), pool->count);
+    t.cumulative_.attach(static_cast<const uint32_t*>(cumulative->data), cumulative->count);
+    t.capacity_.clear();
+    t.used_ = p.historyCount;
+    t.entries_ = p.entryCount;
+    t.slack_ = 0;
+    t.cumulativeValid_ = p.cumulativeValid != 0 && cumulative->count == pool->count;
+
+    model.thaw();
+    model.backing_ = file;
+    return true;
+}
+
+bool ModelFile::load(const std::string& path, MarkovModel& melody, RhythmModel& rhythm, bool verifyChecksum) {
+    auto file = std::make_shared<MappedFile>();
+    if (!file->open(path)) return false;
+    const unsigned char *base = file->data();
+    const size_t size = file->size();
+
+    FileHeader header;
+    if (size < sizeof(header)) {
+        std::cerr << "ModelFile::load: " << path << " is too small to be a model file\n";
+        return false;
+    }
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.byteOrder != kByteOrder) {
+        std::cerr << "ModelFile::load: " << path << " is not a model file for this platform\n";
+        return false;
+    }
+    if (header.version != kVersion) {
+        std::cerr << "ModelFile::load: " << path << " has version " << header.version << ", expected " << kVersion << '\n';
+        return false;
+    }
+    if (header.fileSize != size || header.sectionCount > 1024 ||
+        sizeof(FileHeader) + sizeof(SectionEntry) * static_cast<size_t>(header.sectionCount) > size) {
+        std::cerr << "ModelFile::load: " << path << " is truncated or corrupt\n";
+        return false;
+    }
+    if (verifyChecksum && Utils::checksum64(base + sizeof(FileHeader), size - sizeof(FileHeader)) != header.checksum) {
+        std::cerr << "ModelFile::load: checksum mismatch in " << path << '\n';
+        return false;
+    }
+
+    std::vector<Section> sections;
+    sections.reserve(header.sectionCount);
+    for (uint32_t i = 0; i < header.sectionCount; ++i) {
+        SectionEntry e;
+        std::memcpy(&e, base + sizeof(FileHeader) + i * sizeof(SectionEntry), sizeof(e));
+        if (e.offset % kAlign != 0 || e.offset > size || e.elemSize == 0 || e.count > (size - e.offset) / e.elemSize) {
+            std::cerr << "ModelFile::load: section " << e.id << " lies outside " << path << '\n';
+            return false;
+        }
+        sections.push_back({ e.id, e.elemSize, base + e.offset, e.count });
+    }
+
+    const Section *rhythmParams = nullptr;
+    for (const auto &s : sections) {
+        if (s.id == (kRhythmBase | kRhythmParams) && s.elemSize == sizeof(RhythmParams) && s.count == 1) rhythmParams = &s;
+    }
+    // Attach into scratch models first so a bad file leaves the callers' untouched.
+    MarkovModel melodyView, rhythmView;
+    if (!rhythmParams || !attach(melodyView, kMelodyBase, sections, file) || !attach(rhythmView, kRhythmBase, sections, file)) {
+        std::cerr << "ModelFile::load: " << path << " is missing model sections or they are inconsistent\n";
+        return false;
+    }
+
+    RhythmParams rp;
+    std::memcpy(&rp, rhythmParams->data, sizeof(rp));
+    if (rp.order < 1 || rp.order > MarkovModel::kMaxOrder || !(rp.unit >= 0.0) || rp.unit > 1e9) {
+        std::cerr << "ModelFile::load: " << path << " has invalid rhythm parameters\n";
+        return false;
+    }
+    if (rp.tokenCount != RhythmQuantizer::kTokenCount) {
+        std::cerr << "ModelFile::load: " << path << " uses " << rp.tokenCount << " duration tokens, expected "
+                  << RhythmQuantizer::kTokenCount << '\n';
+        return false;
+    }
+    melody = std::move(melodyView);
+    rhythm.markov_ = std::move(rhythmView);
+    rhythm.quantizer_.setGrid(rp.unit);
+    rhythm.order_ = static_cast<int>(rp.order);
+    return true;
+}
@@ -0,0 +1,213 @@
+#include "NGramTable.h"
+#include <algorithm>
+
+namespace {
+
+inline size_t mixKey(uint64_t k) {
+    // splitmix64 finalizer; packed keys are highly structured, so spread them.
+    k ^= k >> 30; k *= 0xbf58476d1ce4e5b9ULL;
+    k ^= k >> 27; k *= 0x94d049bb133111ebULL;
+    k ^= k >> 31;
+    return static_cast<size_t>(k);
+}
+
+}
+
+size_t NGramTable::probe(uint64_t key) const {
+    const size_t mask = slots_.size() - 1;
+    size_t i = mixKey(key) & mask;
+    while (slots_[i].key != 0 && slots_[i].key != key) i = (i + 1) & mask;
+    return i;
+}
+
+void NGramTable::makeOwned() {
+    if (!slots_.isView() && !pool_.isView() && !cumulative_.isView() && capacity_.size() == slots_.size()) return;
+    std::vector<Slot> &slots = slots_.mut();
+    pool_.mut();
+    cumulative_.mut();
+    // Mapped tables are always compacted: every row is exactly full.
+    capacity_.resize(slots.size());
+    for (size_t i = 0; i < slots.size(); ++i) capacity_[i] = slots[i].size;
+}
+
+void NGramTable::rehash(size_t newSize) {
+    std::vector<Slot> oldSlots(newSize, Slot{0, 0, 0});
+    std::vector<uint32_t> oldCap(newSize, 0);
+    oldSlots.swap(slots_.mut());
+    oldCap.swap(capacity_);
+    std::vector<Slot> &slots = slots_.mut();
+    for (size_t i = 0; i < oldSlots.size(); ++i) {
+        if (oldSlots[i].key == 0) continue;
+        size_t j = probe(oldSlots[i].key);
+        slots[j] = oldSlots[i];
+        capacity_[j] = oldCap[i];
+    }
+}
+
+void NGramTable::growRow(size_t slot) {
+    std::vector<Entry> &pool = pool_.mut();
+    Slot &s = slots_.mut()[slot];
+    uint32_t cap = capacity_[slot];
+    uint32_t newCap = std::max<uint32_t>(2, cap * 2);
+    if (s.offset + cap == pool.size()) {
+        // Last row in the pool: extend in place.
+        pool.resize(s.offset + newCap);
+    } else {
+        uint32_t newOffset = static_cast<uint32_t>(pool.size());
+        pool.resize(pool.size() + newCap);
+        std::copy(pool.begin() + s.offset, pool.begin() + s.offset + s.size, pool.begin() + newOffset);
+        slack_ += cap;
+        s.offset = newOffset;
+    }
+    capacity_[slot] = newCap;
+}
+
+void NGramTable::add(uint64_t key, int token, uint32_t count) {
+    makeOwned();
+    cumulativeValid_ = false;
+    if (slots_.empty()) rehash(64);
+    else if ((used_ + 1) * 10 > slots_.size() * 7) rehash(slots_.size() * 2);
+
+    std::vector<Slot> &slots = slots_.mut();
+    std::vector<Entry> &pool = pool_.mut();
+    size_t i = probe(key);
+    if (slots[i].key == 0) {
+        slots[i] = Slot{ key, static_cast<uint32_t>(pool.size()), 0 };
+        capacity_[i] = 0;
+        ++used_;
+    }
+
+    Slot &s = slots[i];
+    Entry *row = pool.data() + s.offset;
+    Entry *pos = std::lower_bound(row, row + s.size, token, [](const Entry &e, int t) { return e.token < t; });
+    if (pos != row + s.size && pos->token == token) {
+        pos->count += count;
+        return;
+    }
+
+    size_t at = static_cast<size_t>(pos - row);
+    if (s.size == capacity_[i]) {
+        growRow(i);
+        row = pool.data() + s.offset;
+    }
+    std::copy_backward(row + at, row + s.size, row + s.size + 1);
+    row[at] = Entry{ token, count };
+    ++s.size;
+    ++entries_;
+
+    if (slack_ > pool.size() / 2 && pool.size() > 4096) repack();
+}
+
+bool NGramTable::subtract(uint64_t key, int token, uint32_t count) {
+    if (slots_.empty() || key == 0) return false;
+    size_t i = probe(key);
+    if (slots_[i].key == 0) return false;
+    const Slot &found = slots_[i];
+    const Entry *row = pool_.data() + found.offset;
+    const Entry *pos = std::lower_bound(row, row + found.size, token, [](const Entry &e, int t) { return e.token < t; });
+    if (pos == row + found.size || pos->token != token || pos->count < count) return false;
+    const size_t at = static_cast<size_t>(pos - row);
+
+    makeOwned();
+    cumulativeValid_ = false;
+    Slot &s = slots_.mut()[i];
+    Entry *entries = pool_.mut().data() + s.offset;
+    entries[at].count -= count;
+    if (entries[at].count != 0) return true;
+    std::copy(entries + at + 1, entries + s.size, entries + at);
+    --s.size;
+    --entries_;
+    if (s.size == 0) eraseSlot(i);
+    return true;
+}
+
+void NGramTable::eraseSlot(size_t slot) {
+    // Backward-shift deletion: pull later members of the probe run into the
+    // hole so lookups never stop early at it.
+    std::vector<Slot> &slots = slots_.mut();
+    const size_t mask = slots.size() - 1;
+    slack_ += capacity_[slot];
+    --used_;
+    size_t hole = slot;
+    for (size_t j = (hole + 1) & mask; slots[j].key != 0; j = (j + 1) & mask) {
+        const size_t home = mixKey(slots[j].key) & mask;
+        // Movable unless its home lies cyclically in (hole, j].
+        const bool stays = (hole <= j) ? (hole < home && home <= j) : (hole < home || home <= j);
+        if (stays) continue;
+        slots[hole] = slots[j];
+        capacity_[hole] = capacity_[j];
+        hole = j;
+    }
+    slots[hole] = Slot{ 0, 0, 0 };
+    capacity_[hole] = 0;
+}
+
+void NGramTable::merge(const NGramTable& other) {
+    if (other.used_ == 0) return;
+    makeOwned();
+    cumulativeValid_ = false;
+    size_t want = slots_.empty() ? 64 : slots_.size();
+    while ((used_ + other.used_) * 10 > want * 7) want *= 2;
+    if (want != slots_.size()) rehash(want);
+
+    for (const Slot &o : other.slots_) {
+        if (o.key == 0 || o.size == 0) continue;
+        const Entry *src = other.pool_.data() + o.offset;
+        size_t i = probe(o.key);
+        if (slots_[i].key == 0) {
+            // Unseen history: the row is already sorted, so append it whole.
+            std::vector<Entry> &pool = pool_.mut();
+            slots_.mut()[i] = Slot{ o.key, static_cast<uint32_t>(pool.size()), o.size };
+            capacity_[i] = o.size;
+            pool.insert(pool.end(), src, src + o.size);
+            ++used_;
+            entries_ += o.size;
+            continue;
+        }
+        for (uint32_t j = 0; j < o.size; ++j) add(o.key, src[j].token, src[j].count);
+    }
+}
+
+NGramTable::Row NGramTable::find(uint64_t key) const {
+    if (slots_.empty() || key == 0) return {};
+    const Slot &s = slots_[probe(key)];
+    if (s.key == 0) return {};
+    return Row{ pool_.data() + s.offset, s.size, cumulativeValid_ ? cumulative_.data() + s.offset : nullptr };
+}
+
+void NGramTable::repack() {
+    std::vector<Slot> &slots = slots_.mut();
+    std::vector<Entry> &pool = pool_.mut();
+    std::vector<Entry> packed;
+    packed.reserve(entries_);
+    for (size_t i = 0; i < slots.size(); ++i) {
+        Slot &s = slots[i];
+        if (s.key == 0) continue;
+        uint32_t offset = static_cast<uint32_t>(packed.size());
+        packed.insert(packed.end(), pool.begin() + s.offset, pool.begin() + s.offset + s.size);
+        s.offset = offset;
+        capacity_[i] = s.size;
+    }
+    pool.swap(packed);
+    slack_ = 0;
+}
+
+void NGramTable::compact() {
+    if (cumulativeValid_ && slack_ == 0) return;
+    makeOwned();
+    repack();
+    const std::vector<Slot> &slots = slots_.mut();
+    const std::vector<Entry> &pool = pool_.mut();
+    std::vector<uint32_t> &cumulative = cumulative_.mut();
+    cumulative.resize(pool.size());
+    for (const Slot &s : slots) {
+        if (s.key == 0) continue;
+        uint32_t acc = 0;
+        for (uint32_t j = 0; j < s.size; ++j) cumulative[s.offset + j] = (acc += pool[s.offset + j].count);
+    }
+    cumulativeValid_ = true;
+}
+
+size_t NGramTable::memoryBytes() const {
+    return slots_.ownedBytes() + capacity_.capacity() * sizeof(uint32_t) + pool_.ownedBytes() + cumulative_.ownedBytes();
+}
@@ -0,0 +1,44 @@
+#include "NoteStore.h"
+
+void NoteStore::reserve(size_t n) {
+    pitches_.reserve(n);
+    velocities_.reserve(n);
+    channels_.reserve(n);
+    tracks_.reserve(n);
+    starts_.reserve(n);
+    durations_.reserve(n);
+}
+
+void NoteStore::clear() {
+    pitches_.clear();
+    velocities_.clear();
+    channels_.clear();
+    tracks_.clear();
+    starts_.clear();
+    durations_.clear();
+}
+
+void NoteStore::push_back(const NoteEvent& note) {
+    pitches_.push_back(static_cast<uint8_t>(note.pitch));
+    velocities_.push_back(note.velocity);
+    channels_.push_back(note.channel);
+    tracks_.push_back(note.track);
+    starts_.push_back(note.startTime);
+    durations_.push_back(note.duration);
+}
+
+std::vector<NoteEvent> NoteStore::toEvents() const {
+    std::vector<NoteEvent> out(size());
+    for (size_t i = 0; i < out.size(); ++i) out[i] = (*this)[i];
+    return out;
+}
+
+void NoteStore::transpose(int semitones) {
+    if (semitones == 0) return;
+    for (uint8_t &p : pitches_) {
+        int q = p + semitones;
+        while (q > 127) q -= 12;
+        while (q < 0) q += 12;
+        p = static_cast<uint8_t>(q);
+    }
+}
@@ -1,63 +1,52 @@
 #include "RhythmModel.h"
+#include "ThreadPool.h"
 #include <algorithm>
 #include <numeric>
 #include <cmath>
 #include <iostream>
 
-static long long llgcd(long long a, long long b) {
-    if (a == 0) return b;
-    if (b == 0) return a;
-    a = std::llabs(a); b = std::llabs(b);
-    while (b) {
-        long long t = a % b;
-        a = b; b = t;
-    }
-    return a;
-}
-
-RhythmModel::RhythmModel(int order, double unitScale)
-    : order_(std::max(1, order)), unit_(0.0), unitScale_(unitScale), markov_(order)
+RhythmModel::RhythmModel(int order, const RhythmQuantizer::Options& quantizer)
+    : order_(std::min(MarkovModel::kMaxOrder, std::max(1, order))), quantizer_(quantizer), markov_(order)
 {}
 
-void RhythmModel::computeUnitFromDurations(const std::vector<double>& durations) {
-    std::vector<long long> ints;
-    ints.reserve(durations.size());
-    for (double d : durations) {
-        if (!(d > 0.0)) continue;
-        long long v = static_cast<long long>(std::llround(d * unitScale_));
-        if (v <= 0) continue;
-        ints.push_back(v);
+template <class Seq>
+bool RhythmModel::detectUnit(const std::vector<Seq>& sequences, ThreadPool* pool) {
+    if (hasUnit()) return true;
+    RhythmQuantizer::Histogram histogram(quantizer_.options());
+    if (pool && pool->size() > 1 && sequences.size() > 1) {
+        // One histogram per worker, merged at the end.
+        const size_t chunks = std::min(pool->size(), sequences.size());
+        std::vector<RhythmQuantizer::Histogram> partial(chunks, histogram);
+        pool->parallelFor(chunks, [&](size_t c) {
+            for (size_t i = c; i < sequences.size(); i += chunks) partial[c].add(sequences[i].data(), sequences[i].size());
+        });
+        for (const auto &p : partial) histogram.merge(p);
+    } else {
+        for (const auto &s : sequences) histogram.add(s.data(), s.size());
     }
-    if (ints.empty()) {
-        unit_ = 0.0;
-        return;
+    if (!quantizer_.detectGrid(histogram)) {
+        if (!sequences.empty()) std::cerr << "RhythmModel::train: failed to compute quantization unit\n";
+        return false;
     }
+    return true;
+}
 
-    long long g = ints[0];
-    for (size_t i = 1; i < ints.size(); ++i) g = llgcd(g, ints[i]);
-    if (g <= 0) {
-        unit_ = 0.0;
-        return;
-    }
+void RhythmModel::train(const std::vector<double>& durations) {
+    trainDurations(durations.data(), durations.size());
+}
 
-    unit_ = static_cast<double>(g) / unitScale_;
-    const double minUnit = 1e-4;
-    if (unit_ < minUnit) unit_ = minUnit;
+void RhythmModel::train(Span<const double> durations) {
+    trainDurations(durations.data(), durations.size());
 }
 
-void RhythmModel::train(const std::vector<double>& durations) {
-    if (durations.empty()) return;
-    if (!hasUnit()) {
-        computeUnitFromDurations(durations);
-        if (!hasUnit()) {
-            std::cerr << "RhythmModel::train: failed to compute quantization unit\n";
-            return;
-        }
-    }
+void RhythmModel::trainDurations(const double* durations, size_t length) {
+    if (length == 0) return;
+    if (!hasUnit() && !detectUnit(std::vector<Span<const double>>{ Span<const double>(durations, length) }, nullptr)) return;
 
     std::vector<int> tokens;
-    tokens.reserve(durations.size());
-    for (double d : durations) {
+    tokens.reserve(length);
+    for (size_t i = 0; i < length; ++i) {
+        const double d = durations[i];
         if (d <= 0.0) continue;
         int tok = durationToToken(d);
         tokens.push_back(tok);
@@ -66,40 +55,96 @@ void RhythmModel::train(const std::vector<double>& durations) {
     markov_.train(tokens);
 }
 
+bool RhythmModel::untrain(const std::vector<double>& durations) {
+    return untrain(Span<const double>(durations));
+}
+
+bool RhythmModel::untrain(Span<const double> durations) {
+    if (durations.empty()) return true;
+    if (!hasUnit()) return false;
+    std::vector<int> tokens;
+    tokens.reserve(durations.size());
+    for (double d : durations) {
+        if (d > 0.0) tokens.push_back(durationToToken(d));
+    }
+    return markov_.untrain(tokens);
+}
+
 void RhythmModel::trainMany(const std::vector<std::vector<double>>& sequences) {
-    bool unitComputed = hasUnit();
-    for (const auto &s : sequences) {
-        if (!unitComputed) {
-            computeUnitFromDurations(s);
-            unitComputed = hasUnit();
+    trainBatch(sequences);
+}
+
+void RhythmModel::trainMany(const std::vector<Span<const double>>& sequences) {
+    trainBatch(sequences);
+}
+
+template <class Seq>
+void RhythmModel::trainBatch(const std::vector<Seq>& sequences) {
+    if (!detectUnit(sequences, nullptr)) return;
+    for (const auto &s : sequences) trainDurations(s.data(), s.size());
+}
+
+void RhythmModel::trainMany(const std::vector<std::vector<double>>& sequences, ThreadPool& pool) {
+    trainBatchParallel(sequences, pool);
+}
+
+void RhythmModel::trainMany(const std::vector<Span<const double>>& sequences, ThreadPool& pool) {
+    trainBatchParallel(sequences, pool);
+}
+
+template <class Seq>
+void RhythmModel::trainBatchParallel(const std::vector<Seq>& sequences, ThreadPool& pool) {
+    if (!detectUnit(sequences, &pool)) return;
+
+    std::vector<std::vector<int>> tokens(sequences.size());
+    pool.parallelFor(tokens.size(), [&](size_t i) {
+        const auto &s = sequences[i];
+        tokens[i].reserve(s.size());
+        for (double d : s) {
+            if (d > 0.0) tokens[i].push_back(durationToToken(d));
         }
-        train(s);
-    }
+    });
+    markov_.trainMany(tokens, pool);
 }
 
 int RhythmModel::durationToToken(double d) const {
-    if (!hasUnit()) return 0;
-    int tok = static_cast<int>(std::llround(d / unit_));
-    if (tok < 0) tok = 0;
-    return tok;
+    return quantizer_.token(d);
 }
 
 double RhythmModel::tokenToDuration(int token) const {
-    if (!hasUnit()) return 0.0;
-    return static_cast<double>(token) * unit_;
+    return quantizer_.duration(token);
+}
+
+double RhythmModel::sampleNext(const std::vector<double>& history, double temperature, Rng& rng) const {
+    return sampleNext(history.data(), history.size(), temperature, rng);
 }
 
-double RhythmModel::sampleNext(const std::vector<double>& history, double temperature) const {
+double RhythmModel::sampleNext(const double* history, size_t length, double temperature, Rng& rng) const {
     if (!hasUnit()) {
         std::cerr << "RhythmModel::sampleNext: unit not initialized. Returning 0.0\n";
         return 0.0;
     }
-    std::vector<int> histTokens;
-    histTokens.reserve(history.size());
-    for (double d : history) {
+    int histTokens[MarkovModel::kMaxOrder];
+    const size_t taken = historyTokens(history, length, histTokens);
+    return tokenToDuration(markov_.sampleNext(histTokens + (order_ - taken), taken, temperature, rng));
+}
+
+NGramTable::Row RhythmModel::lookup(const double* history, size_t length) const {
+    if (!hasUnit()) return NGramTable::Row();
+    int histTokens[MarkovModel::kMaxOrder];
+    const size_t taken = historyTokens(history, length, histTokens);
+    return markov_.lookup(histTokens + (order_ - taken), taken);
+}
+
+size_t RhythmModel::historyTokens(const double* history, size_t length, int* tokens) const {
+    // Only the last order_ positive durations can condition the draw; they
+    // end up right-aligned in tokens[0, order_).
+    size_t taken = 0;
+    for (size_t i = length; i > 0 && taken < static_cast<size_t>(order_); --i) {
+        double d = history[i - 1];
         if (d <= 0.0) continue;
-        histTokens.push_back(durationToToken(d));
+        tokens[order_ - 1 - taken] = durationToToken(d);
+        ++taken;
     }
-    int tok = markov_.sampleNext(histTokens, temperature);
-    return tokenToDuration(tok);
+    return taken;
 }
@@ -0,0 +1,151 @@
+#include "RhythmQuantizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+const uint16_t RhythmQuantizer::kSteps[kTokenCount] = { 1, 2, 3, 4, 6, 8, 12, 16, 24, 32 };
+
+namespace {
+
+const int kTokens = RhythmQuantizer::kTokenCount;
+// Lookup cells per grid step. Neighbouring boundaries are over one step
+// apart, so a cell holds at most one of them.
+const int kCellsPerStep = 4;
+const int kCells = RhythmQuantizer::kTokenCount * 4 * kCellsPerStep;
+
+// Token boundaries in grid steps (the geometric mean of neighbouring steps;
+// the last is a sentinel), and the lowest token of each lookup cell.
+struct Bounds {
+    double at[kTokens];
+    uint8_t cell[kCells];
+    Bounds() {
+        for (int i = 0; i + 1 < kTokens; ++i) {
+            at[i] = std::sqrt(static_cast<double>(RhythmQuantizer::kSteps[i]) * RhythmQuantizer::kSteps[i + 1]);
+        }
+        at[kTokens - 1] = std::numeric_limits<double>::infinity();
+        int t = 0;
+        for (int c = 0; c < kCells; ++c) {
+            while (at[t] <= static_cast<double>(c) / kCellsPerStep) ++t;
+            cell[c] = static_cast<uint8_t>(t);
+        }
+    }
+};
+
+const Bounds kBounds;
+
+}
+
+RhythmQuantizer::Histogram::Histogram(const Options& options)
+    : binSeconds_(options.binSeconds > 0.0 ? options.binSeconds : 0.001),
+      bins_(static_cast<size_t>(std::max(1.0, options.maxSeconds / binSeconds_)) + 1, 0) {}
+
+void RhythmQuantizer::Histogram::add(const double* durations, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        const double d = durations[i];
+        if (!(d > 0.0)) continue;
+        const double bin = std::floor(d / binSeconds_ + 0.5);
+        if (bin >= static_cast<double>(bins_.size())) continue;
+        ++bins_[static_cast<size_t>(bin)];
+        ++total_;
+    }
+}
+
+void RhythmQuantizer::Histogram::merge(const Histogram& other) {
+    const size_t n = std::min(bins_.size(), other.bins_.size());
+    for (size_t i = 0; i < n; ++i) bins_[i] += other.bins_[i];
+    total_ += other.total_;
+}
+
+bool RhythmQuantizer::detectGrid(const Histogram& h) {
+    if (h.total_ == 0) return false;
+    const std::vector<uint32_t> &bins = h.bins_;
+    const size_t n = bins.size();
+    // prefix[i] = durations in bins [0, i).
+    std::vector<uint64_t> prefix(n + 1, 0);
+    for (size_t i = 0; i < n; ++i) prefix[i + 1] = prefix[i] + bins[i];
+    auto mass = [&](double lo, double hi) -> uint64_t {
+        const size_t a = static_cast<size_t>(std::max(0.0, std::ceil(lo)));
+        const size_t b = std::min(n, static_cast<size_t>(std::max(0.0, std::floor(hi) + 1.0)));
+        return a < b ? prefix[b] - prefix[a] : 0;
+    };
+    const double tol = options_.tolerance;
+
+    // The most common duration, counting everything within the tolerance.
+    const size_t lo = std::max<size_t>(1, static_cast<size_t>(std::ceil(options_.minGrid / h.binSeconds_)));
+    const size_t hi = std::min(n - 1, static_cast<size_t>(options_.maxGrid / h.binSeconds_));
+    double mode = static_cast<double>(lo);
+    uint64_t modeMass = 0;
+    for (size_t b = lo; b <= hi; ++b) {
+        const uint64_t m = mass(b * (1.0 - tol), b * (1.0 + tol));
+        if (m > modeMass) {
+            modeMass = m;
+            mode = static_cast<double>(b);
+        }
+    }
+
+    // Durations within the tolerance of a multiple of `step` bins. Windows
+    // widen with the multiple, as timing slack does, up to half a step.
+    auto explained = [&](double step) -> uint64_t {
+        uint64_t sum = 0;
+        for (double c = step; c * (1.0 - tol) < static_cast<double>(n); c += step) {
+            const double w = std::min(tol * c, 0.5 * step - 0.5);
+            sum += mass(c - w, c + w);
+        }
+        return sum;
+    };
+
+    // The grid is the mode or a subdivision of it: the coarsest that
+    // explains nearly as much as the best.
+    static const int kSubdivisions[] = { 1, 2, 3, 4, 6, 8 };
+    double shares[sizeof(kSubdivisions) / sizeof(kSubdivisions[0])] = {};
+    double bestShare = 0.0;
+    for (size_t k = 0; k < sizeof(kSubdivisions) / sizeof(kSubdivisions[0]); ++k) {
+        const double step = mode / kSubdivisions[k];
+        if (k > 0 && step * h.binSeconds_ < options_.minGrid) break;
+        shares[k] = static_cast<double>(explained(step)) / static_cast<double>(h.total_);
+        bestShare = std::max(bestShare, shares[k]);
+    }
+    size_t pick = 0;
+    while (shares[pick] < options_.coverage * bestShare) ++pick;
+    const double step = mode / kSubdivisions[pick];
+
+    // Refine the step to the mean grid implied by the durations it explains,
+    // using only multiples whose windows are not capped: beyond them a
+    // duration may sit nearer the wrong multiple and drag the mean.
+    double weighted = 0.0, count = 0.0;
+    for (double c = step; c * (1.0 - tol) < static_cast<double>(n) && tol * c <= 0.5 * step - 0.5; c += step) {
+        const double w = tol * c;
+        const double multiple = std::round(c / step);
+        const size_t a = static_cast<size_t>(std::max(0.0, std::ceil(c - w)));
+        const size_t b = std::min(n, static_cast<size_t>(std::floor(c + w) + 1.0));
+        for (size_t i = a; i < b; ++i) {
+            weighted += static_cast<double>(bins[i]) * static_cast<double>(i) / multiple;
+            count += bins[i];
+        }
+    }
+    setGrid((count > 0.0 ? weighted / count : step) * h.binSeconds_);
+    coverage_ = shares[pick];
+    return true;
+}
+
+int RhythmQuantizer::token(double seconds) const {
+    if (!hasGrid()) return 0;
+    const double steps = seconds * inverseGrid_;
+    if (!(steps > 0.0)) return 0;
+    if (steps >= static_cast<double>(kCells) / kCellsPerStep) return kTokenCount - 1;
+    const int t = kBounds.cell[static_cast<int>(steps * kCellsPerStep)];
+    return steps >= kBounds.at[t] ? t + 1 : t;
+}
+
+void RhythmQuantizer::setGrid(double grid) {
+    grid_ = grid > 0.0 ? grid : 0.0;
+    inverseGrid_ = grid_ > 0.0 ? 1.0 / grid_ : 0.0;
+    coverage_ = 0.0;
+}
+
+double RhythmQuantizer::duration(int token) const {
+    if (!hasGrid()) return 0.0;
+    token = std::min(std::max(token, 0), kTokenCount - 1);
+    return static_cast<double>(kSteps[token]) * grid_;
+}
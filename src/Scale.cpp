@@ -0,0 +1,143 @@
+#include "Scale.h"
+#include <cctype>
+#include <initializer_list>
+#include <utility>
+
+namespace {
+
+struct NamedScale {
+    const char* name;
+    uint16_t steps;     // bit i set when the note i semitones above the tonic is in the scale
+};
+
+uint16_t steps(std::initializer_list<int> semitones) {
+    uint16_t bits = 0;
+    for (int s : semitones) bits |= uint16_t(1u << s);
+    return bits;
+}
+
+// [0] is the chromatic default Scale() refers to.
+const NamedScale kScales[] = {
+    { "chromatic", 0xFFF },
+    { "major", steps({ 0, 2, 4, 5, 7, 9, 11 }) },
+    { "dorian", steps({ 0, 2, 3, 5, 7, 9, 10 }) },
+    { "phrygian", steps({ 0, 1, 3, 5, 7, 8, 10 }) },
+    { "lydian", steps({ 0, 2, 4, 6, 7, 9, 11 }) },
+    { "mixolydian", steps({ 0, 2, 4, 5, 7, 9, 10 }) },
+    { "minor", steps({ 0, 2, 3, 5, 7, 8, 10 }) },
+    { "locrian", steps({ 0, 1, 3, 5, 6, 8, 10 }) },
+    { "harmonic-minor", steps({ 0, 2, 3, 5, 7, 8, 11 }) },
+    { "melodic-minor", steps({ 0, 2, 3, 5, 7, 9, 11 }) },
+    { "major-pentatonic", steps({ 0, 2, 4, 7, 9 }) },
+    { "minor-pentatonic", steps({ 0, 3, 5, 7, 10 }) },
+    { "blues", steps({ 0, 3, 5, 6, 7, 10 }) },
+};
+const int kScaleCount = static_cast<int>(sizeof(kScales) / sizeof(kScales[0]));
+
+// Other names for the scales above.
+const std::pair<const char*, const char*> kAliases[] = {
+    { "ionian", "major" },
+    { "aeolian", "minor" },
+    { "natural-minor", "minor" },
+    { "pentatonic", "major-pentatonic" },
+};
+
+const char* const kTonicNames[12] = { "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B" };
+
+uint16_t rotate(uint16_t steps, int tonic) {
+    return static_cast<uint16_t>(((steps << tonic) | (steps >> (12 - tonic))) & 0xFFF);
+}
+
+}
+
+bool Scale::parse(const std::string& spec, Scale& out) {
+    if (spec.empty()) return false;
+    static const int kLetters[7] = { 9, 11, 0, 2, 4, 5, 7 };    // A..G
+    const char letter = static_cast<char>(std::toupper(static_cast<unsigned char>(spec[0])));
+    if (letter < 'A' || letter > 'G') return false;
+    int tonic = kLetters[letter - 'A'];
+    size_t i = 1;
+    for (; i < spec.size() && (spec[i] == '#' || spec[i] == 'b'); ++i) tonic += spec[i] == '#' ? 1 : -1;
+
+    std::string name = "major";
+    if (i < spec.size()) {
+        if (spec[i] != ':') return false;
+        name = spec.substr(i + 1);
+        for (char &c : name) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    for (const auto &alias : kAliases) {
+        if (name == alias.first) name = alias.second;
+    }
+    for (int m = 0; m < kScaleCount; ++m) {
+        if (name != kScales[m].name) continue;
+        out.tonic_ = ((tonic % 12) + 12) % 12;
+        out.mode_ = m;
+        out.classes_ = rotate(kScales[m].steps, out.tonic_);
+        return true;
+    }
+    return false;
+}
+
+std::string Scale::names() {
+    std::string out;
+    for (int m = 0; m < kScaleCount; ++m) out += std::string(m ? ", " : "") + kScales[m].name;
+    for (const auto &alias : kAliases) out += std::string(", ") + alias.first;
+    return out;
+}
+
+std::vector<int> Scale::pitchClasses() const {
+    std::vector<int> out;
+    for (int c = 0; c < 12; ++c) {
+        if ((classes_ >> c) & 1u) out.push_back(c);
+    }
+    return out;
+}
+
+std::string Scale::name() const {
+    return std::string(kTonicNames[tonic_]) + ":" + kScales[mode_].name;
+}
+
+int Scale::bestTransposition(Span<const uint8_t> pitches) const {
+    uint64_t histogram[12] = {};
+    for (uint8_t p : pitches) ++histogram[p % 12];
+
+    int best = 0;
+    uint64_t bestFit = 0;
+    // 0, -1, 1, -2, 2, ..., 5, -6: the first of equal fits is the smallest move.
+    for (int k = 0; k < 12; ++k) {
+        const int shift = (k & 1) ? -(k + 1) / 2 : k / 2;
+        uint64_t fit = 0;
+        for (int c = 0; c < 12; ++c) {
+            if ((classes_ >> ((c + shift + 12) % 12)) & 1u) fit += histogram[c];
+        }
+        if (k == 0 || fit > bestFit) {
+            best = shift;
+            bestFit = fit;
+        }
+    }
+    return best;
+}
+
+PitchConstraint::PitchConstraint(const PitchMask& allowed, int minPitch, int maxPitch)
+    : mask_(allowed & PitchMask::range(minPitch, maxPitch)) {
+    const int lo = minPitch < 0 ? 0 : minPitch > 127 ? 127 : minPitch;
+    const int hi = maxPitch < lo ? lo : maxPitch > 127 ? 127 : maxPitch;
+    if (mask_.empty()) {
+        for (int p = 0; p < 128; ++p) nearest_[p] = static_cast<uint8_t>(p < lo ? lo : p > hi ? hi : p);
+        return;
+    }
+    // Two sweeps: the nearest allowed pitch at or below each p, then the
+    // nearest at or above; the closer wins and ties go up.
+    int below[128];
+    int last = -1;
+    for (int p = 0; p < 128; ++p) {
+        if (mask_.test(p)) last = p;
+        below[p] = last;
+    }
+    last = -1;
+    for (int p = 127; p >= 0; --p) {
+        if (mask_.test(p)) last = p;
+        const bool up = last >= 0 && (below[p] < 0 || last - p <= p - below[p]);
+        nearest_[p] = static_cast<uint8_t>(up ? last : below[p]);
+    }
+}
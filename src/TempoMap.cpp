@@ -0,0 +1,143 @@
+#include "TempoMap.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Linear steps a cursor tries before falling back to a binary search.
+const int kCursorSteps = 4;
+
+}
+
+TempoMap::TempoMap(int ppq, uint32_t microsecondsPerQuarter)
+    : ppq_(ppq > 0 ? ppq : 480), ticksPerQuarter_(static_cast<double>(ppq_)) {
+    build({ Change{ 0, microsecondsPerQuarter } });
+}
+
+TempoMap::TempoMap(int ppq, std::vector<Change> changes)
+    : ppq_(ppq > 0 ? ppq : 480), ticksPerQuarter_(static_cast<double>(ppq_)) {
+    build(std::move(changes));
+}
+
+TempoMap TempoMap::smpte(int framesPerSecond, int ticksPerFrame) {
+    TempoMap map;
+    map.smpteFps_ = framesPerSecond;
+    map.ticksPerFrame_ = std::max(1, ticksPerFrame);
+    // "29" is 30 fps drop-frame, i.e. 29.97 frames per real second.
+    const double fps = framesPerSecond == 29 ? 30000.0 / 1001.0 : static_cast<double>(framesPerSecond);
+    // One "quarter" is one second, so the PPQ arithmetic carries over as is.
+    map.ticksPerQuarter_ = fps * map.ticksPerFrame_;
+    map.build({ Change{ 0, 1000000 } });
+    return map;
+}
+
+bool TempoMap::fromDivision(uint16_t division, const std::vector<Change>& changes, TempoMap& out) {
+    if (division & 0x8000) {
+        const int fps = -static_cast<int>(static_cast<int8_t>(division >> 8));
+        const int ticksPerFrame = division & 0xFF;
+        if ((fps != 24 && fps != 25 && fps != 29 && fps != 30) || ticksPerFrame == 0) {
+            out = TempoMap(480, changes);
+            return false;
+        }
+        out = smpte(fps, ticksPerFrame);
+        return true;
+    }
+    out = TempoMap(division == 0 ? 480 : division, changes);
+    return division != 0;
+}
+
+uint16_t TempoMap::division() const {
+    if (!isSmpte()) return static_cast<uint16_t>(ppq_ & 0x7FFF);
+    return static_cast<uint16_t>(((-smpteFps_) & 0xFF) << 8 | (ticksPerFrame_ & 0xFF));
+}
+
+void TempoMap::build(std::vector<Change> changes) {
+    std::stable_sort(changes.begin(), changes.end(), [](const Change &a, const Change &b) { return a.tick < b.tick; });
+
+    segments_.clear();
+    segments_.reserve(changes.size() + 1);
+    uint64_t prevTick = 0;
+    uint32_t currMicro = kDefaultMicrosecondsPerQuarter;
+    for (const auto &c : changes) {
+        if (c.tick > prevTick) {
+            segments_.push_back({ prevTick, currMicro, 0.0 });
+            prevTick = c.tick;
+        }
+        currMicro = c.microsecondsPerQuarter;
+    }
+    segments_.push_back({ prevTick, currMicro, 0.0 });
+
+    for (size_t i = 1; i < segments_.size(); ++i) {
+        const Segment &prev = segments_[i - 1];
+        const uint64_t dt = segments_[i].tick - prev.tick;
+        segments_[i].seconds = prev.seconds + (static_cast<double>(dt) * static_cast<double>(prev.microsecondsPerQuarter)) / (1e6 * ticksPerQuarter_);
+    }
+}
+
+size_t TempoMap::segmentForTick(uint64_t tick) const {
+    size_t lo = 0, hi = segments_.size();
+    while (lo + 1 < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (segments_[mid].tick <= tick) lo = mid;
+        else hi = mid;
+    }
+    return lo;
+}
+
+size_t TempoMap::segmentForSeconds(double seconds) const {
+    size_t lo = 0, hi = segments_.size();
+    while (lo + 1 < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (segments_[mid].seconds <= seconds) lo = mid;
+        else hi = mid;
+    }
+    return lo;
+}
+
+double TempoMap::secondsIn(size_t segment, uint64_t tick) const {
+    const Segment &s = segments_[segment];
+    const uint64_t dt = tick - s.tick;
+    return s.seconds + (static_cast<double>(dt) * static_cast<double>(s.microsecondsPerQuarter)) / (1e6 * ticksPerQuarter_);
+}
+
+uint64_t TempoMap::ticksIn(size_t segment, double seconds) const {
+    const Segment &s = segments_[segment];
+    double v = (seconds - s.seconds) * 1'000'000.0 * ticksPerQuarter_ / static_cast<double>(s.microsecondsPerQuarter);
+    if (v < 0.0) v = 0.0;
+    return s.tick + static_cast<uint64_t>(std::llround(v));
+}
+
+double TempoMap::Cursor::seconds(uint64_t tick) {
+    const auto &segs = map_->segments_;
+    size_t i = tickSegment_;
+    for (int step = 0; step < kCursorSteps; ++step) {
+        if (segs[i].tick > tick) {
+            --i;    // segment 0 starts at tick 0, so this never underflows
+        } else if (i + 1 < segs.size() && segs[i + 1].tick <= tick) {
+            ++i;
+        } else {
+            tickSegment_ = i;
+            return map_->secondsIn(i, tick);
+        }
+    }
+    tickSegment_ = map_->segmentForTick(tick);
+    return map_->secondsIn(tickSegment_, tick);
+}
+
+uint64_t TempoMap::Cursor::ticks(double seconds) {
+    const auto &segs = map_->segments_;
+    size_t i = secondsSegment_;
+    for (int step = 0; step < kCursorSteps; ++step) {
+        if (i > 0 && segs[i].seconds > seconds) {
+            --i;
+        } else if (i + 1 < segs.size() && segs[i + 1].seconds <= seconds) {
+            ++i;
+        } else {
+            secondsSegment_ = i;
+            return map_->ticksIn(i, seconds);
+        }
+    }
+    secondsSegment_ = map_->segmentForSeconds(seconds);
+    return map_->ticksIn(secondsSegment_, seconds);
+}
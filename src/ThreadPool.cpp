@@ -0,0 +1,105 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    queues_.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) queues_.push_back(std::make_unique<Queue>());
+    threads_.reserve(threads - 1);
+    for (size_t i = 1; i < threads; ++i) threads_.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lk(jobMutex_);
+        stop_ = true;
+    }
+    jobCv_.notify_all();
+    for (auto &t : threads_) t.join();
+}
+
+bool ThreadPool::popOrSteal(size_t self, size_t& task) {
+    {
+        Queue &own = *queues_[self];
+        std::lock_guard<std::mutex> lk(own.m);
+        if (!own.tasks.empty()) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t k = 1; k < queues_.size(); ++k) {
+        Queue &victim = *queues_[(self + k) % queues_.size()];
+        std::lock_guard<std::mutex> lk(victim.m);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::runTasks(size_t self, const std::function<void(size_t)>& job) {
+    size_t task;
+    while (popOrSteal(self, task)) {
+        job(task);
+        remaining_.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+void ThreadPool::workerLoop(size_t self) {
+    uint64_t seen = 0;
+    for (;;) {
+        const std::function<void(size_t)>* job = nullptr;
+        {
+            std::unique_lock<std::mutex> lk(jobMutex_);
+            jobCv_.wait(lk, [&]{ return stop_ || jobGeneration_ != seen; });
+            if (stop_) return;
+            seen = jobGeneration_;
+            // A worker that wakes after the job already finished sees nullptr
+            // and must not touch the queues of the next job.
+            job = job_;
+            if (!job) continue;
+            ++busyWorkers_;
+        }
+        runTasks(self, *job);
+        {
+            std::lock_guard<std::mutex> lk(jobMutex_);
+            --busyWorkers_;
+        }
+        doneCv_.notify_all();
+    }
+}
+
+void ThreadPool::parallelFor(size_t n, const std::function<void(size_t)>& fn) {
+    if (n == 0) return;
+    if (queues_.size() == 1 || n == 1) {
+        for (size_t i = 0; i < n; ++i) fn(i);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lk(jobMutex_);
+        job_ = &fn;
+    }
+    remaining_.store(n, std::memory_order_release);
+    // Deal indices round-robin so every worker starts with a share of the
+    // early (typically largest, when callers sort by cost) tasks.
+    for (size_t i = 0; i < n; ++i) {
+        Queue &q = *queues_[i % queues_.size()];
+        std::lock_guard<std::mutex> lk(q.m);
+        q.tasks.push_front(i);
+    }
+    {
+        std::lock_guard<std::mutex> lk(jobMutex_);
+        ++jobGeneration_;
+    }
+    jobCv_.notify_all();
+
+    runTasks(0, fn);
+
+    std::unique_lock<std::mutex> lk(jobMutex_);
+    doneCv_.wait(lk, [&]{ return remaining_.load(std::memory_order_acquire) == 0 && busyWorkers_ == 0; });
+    job_ = nullptr;
+}
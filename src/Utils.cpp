@@ -1,4 +1,5 @@
 #include "Utils.h"
+#include <cstring>
 
 uint16_t Utils::readBE16(std::ifstream& file) {
     unsigned char b1 = file.get();
@@ -23,3 +24,73 @@ uint32_t Utils::readVarLen(std::ifstream& file) {
     } while (c & 0x80);
     return value;
 }
+
+int Utils::readByte(ByteCursor& cur) {
+    if (cur.pos >= cur.end) {
+        cur.ok = false;
+        return -1;
+    }
+    return *cur.pos++;
+}
+
+uint16_t Utils::readBE16(ByteCursor& cur) {
+    if (cur.remaining() < 2) {
+        cur.ok = false;
+        cur.pos = cur.end;
+        return 0;
+    }
+    uint16_t v = static_cast<uint16_t>((cur.pos[0] << 8) | cur.pos[1]);
+    cur.pos += 2;
+    return v;
+}
+
+uint32_t Utils::readBE32(ByteCursor& cur) {
+    if (cur.remaining() < 4) {
+        cur.ok = false;
+        cur.pos = cur.end;
+        return 0;
+    }
+    uint32_t v = (static_cast<uint32_t>(cur.pos[0]) << 24) | (static_cast<uint32_t>(cur.pos[1]) << 16) |
+                 (static_cast<uint32_t>(cur.pos[2]) << 8) | static_cast<uint32_t>(cur.pos[3]);
+    cur.pos += 4;
+    return v;
+}
+
+// SMF variable-length quantities are at most 4 bytes; anything longer is
+// treated as corrupt rather than read on indefinitely.
+uint32_t Utils::readVarLen(ByteCursor& cur) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+        if (cur.pos >= cur.end) {
+            cur.ok = false;
+            return value;
+        }
+        unsigned char c = *cur.pos++;
+        value = (value << 7) | (c & 0x7F);
+        if (!(c & 0x80)) return value;
+    }
+    cur.ok = false;
+    return value;
+}
+
+void Utils::skipBytes(ByteCursor& cur, size_t n) {
+    if (cur.remaining() < n) {
+        cur.ok = false;
+        cur.pos = cur.end;
+        return;
+    }
+    cur.pos += n;
+}
+
+uint64_t Utils::checksum64(const unsigned char* data, size_t size, uint64_t seed) {
+    const uint64_t prime = 0x100000001b3ULL;
+    uint64_t h = seed;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t w;
+        std::memcpy(&w, data + i, 8);
+        h = (h ^ w) * prime;
+    }
+    for (; i < size; ++i) h = (h ^ data[i]) * prime;
+    return h;
+}
@@ -3,25 +3,119 @@
 #include "RhythmModel.h"
 #include "MelodyGenerator.h"
 #include "MidiWriter.h"
+#include "CorpusIngest.h"
+#include "ThreadPool.h"
+#include "ModelFile.h"
+#include "CorpusFile.h"
+#include "BeamSearch.h"
+#include "CompactModel.h"
+#include "ContextTree.h"
+#include "CorpusManifest.h"
+#include "IntervalModel.h"
+#include "JointModel.h"
+#include "Scale.h"
+#include "TempoMap.h"
 
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <chrono>
-#include <set>
 #include <map>
+#include <unordered_set>
 #include <numeric>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+
+// The manifest describes the compiled model and corpus only if it was written
+// after both; an interrupted save leaves it older and forces a full retrain.
+static bool manifestIsCurrent(const std::string& manifestPath, const std::string& modelPath, const std::string& corpusPath) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    if (!fs::exists(manifestPath, ec) || !fs::exists(modelPath, ec)) return false;
+    auto manifestTime = fs::last_write_time(manifestPath, ec);
+    if (ec || fs::last_write_time(modelPath, ec) > manifestTime || ec) return false;
+    if (fs::exists(corpusPath, ec) && fs::last_write_time(corpusPath, ec) > manifestTime) return false;
+    return !ec;
+}
+
+// "--tempo" takes a bpm, or a comma-separated list of tick:bpm changes (a bare
+// bpm counts as tick 0), e.g. "96,1920:120,3840:88".
+static bool parseTempoSpec(const std::string& spec, int ppq, TempoMap& out) {
+    std::vector<TempoMap::Change> changes;
+    size_t pos = 0;
+    while (pos <= spec.size()) {
+        size_t comma = spec.find(',', pos);
+        if (comma == std::string::npos) comma = spec.size();
+        const std::string item = spec.substr(pos, comma - pos);
+        const size_t colon = item.find(':');
+        char *end = nullptr;
+        unsigned long long tick = 0;
+        if (colon != std::string::npos) {
+            tick = std::strtoull(item.c_str(), &end, 10);
+            if (end != item.c_str() + colon) return false;
+        }
+        const std::string bpmText = colon == std::string::npos ? item : item.substr(colon + 1);
+        const double bpm = std::strtod(bpmText.c_str(), &end);
+        if (bpmText.empty() || *end != '\0' || !(bpm >= 4.0 && bpm <= 1000.0)) return false;
+        changes.push_back(TempoMap::Change{ tick, static_cast<uint32_t>(60000000.0 / bpm + 0.5) });
+        pos = comma + 1;
+    }
+    out = TempoMap(ppq, std::move(changes));
+    return true;
+}
+
+static void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n"
+                 "Parses ../data/raw_midis, trains on the result and writes a melody to ../output.\n"
+                 "\n"
+                 "Training:\n"
+                 "  --threads N             worker threads (0 = one per hardware thread)\n"
+                 "  --retrain               ignore the compiled model and train from scratch\n"
+                 "  --export-text           also write per-file melody/duration text\n"
+                 "  --melody MODE           all, skyline, track or voice\n"
+                 "  --transpose             move every training melody into --scale\n"
+                 "\n"
+                 "Generation:\n"
+                 "  --seed N                repeat a melody (otherwise a seed is printed)\n"
+                 "  --scale TONIC[:NAME]    keep pitches in a scale, e.g. D:dorian\n"
+                 "  --constrained           mask out-of-range pitches instead of clamping them\n"
+                 "  --context-order N       draw from a variable-order context tree\n"
+                 "  --memory-budget B[k|m]  prune the melody model to fit B bytes\n"
+                 "  --intervals             draw pitches as steps from the previous one\n"
+                 "  --joint                 draw pitch and duration together\n"
+                 "  --beam W                decode the most likely melody with beam width W\n"
+                 "  --end-pitch P           with --beam: end on pitch P\n"
+                 "  --target-seconds S      with --beam: end exactly S seconds in\n"
+                 "  --tempo BPM[,TICK:BPM]  tempo map of the written MIDI file\n"
+                 "\n"
+                 "Later runs reuse output/model.bin and train only the MIDI files added,\n"
+                 "changed or removed since. Only the counts update incrementally: corpus.bin\n"
+                 "and model.bin are still rewritten whole, so every update's file I/O grows\n"
+                 "with the whole corpus.\n";
+}
 
 int main(int argc, char** argv) {
     namespace fs = std::filesystem;
     using clock = std::chrono::high_resolution_clock;
 
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        }
+    }
+
     const std::string midiFolder = "../data/raw_midis/";
     const std::string melodyFolder = "../data/melodies/";
     const std::string durationFolder = "../data/durations/";
+    const std::string corpusPath = "../data/corpus.bin";
     const std::string outputFolder = "../output/";
     const std::string generatedSeqPath = outputFolder + "generated_seq.txt";
     const std::string generatedMidPath = outputFolder + "generated.mid";
+    const std::string compiledModelPath = outputFolder + "model.bin";
+    const std::string manifestPath = outputFolder + "manifest.txt";
 
     const int markovOrder = 2;
     const int historyMax = 8;
@@ -32,7 +126,6 @@ int main(int argc, char** argv) {
     const double melodyTemp = 1.0;
     const double rhythmTemp = 1.0;
     const int midiPPQ = 480;
-    const uint32_t tempoMicro = 500000;
     const int midiChannel = 0;
     const int midiVelocity = 90;
 
@@ -40,33 +133,197 @@ int main(int argc, char** argv) {
     fs::create_directories(durationFolder);
     fs::create_directories(outputFolder);
 
+    // Worker threads for the parallel stages; 0 = one per hardware thread.
+    size_t workerThreads = 0;
+    // --retrain ignores the compiled model and manifest and trains from scratch.
+    bool retrain = false;
+    // --export-text also writes the per-file melody/duration text alongside corpus.bin;
+    // --melody all|skyline|track|voice picks how each file is reduced to one line.
+    IngestOptions ingestOptions;
+    // --tempo BPM[,TICK:BPM...] sets the tempo map of the generated MIDI file.
+    TempoMap outputTempo(midiPPQ);
+    // --joint draws pitch and duration together from a joint model where it
+    // has seen the history.
+    bool useJoint = false;
+    // --context-order N draws pitches from a variable-order context tree of up
+    // to N notes (pruned below 2 occurrences) instead of the order-2 model.
+    int contextOrder = 0;
+    // --memory-budget BYTES[k|m] prunes the melody model, with 8-bit counts,
+    // to fit BYTES and samples pitches from the result.
+    size_t memoryBudget = 0;
+    // --intervals draws pitches as steps from the previous one, from a model
+    // of intervals that shares counts across keys.
+    bool useIntervals = false;
+    // --constrained masks pitches outside the range before drawing instead of
+    // clamping them afterwards.
+    bool constrained = false;
+    // --beam WIDTH decodes the most likely melody instead of sampling one,
+    // optionally ending on --end-pitch P and/or exactly --target-seconds S in.
+    // --scale TONIC[:NAME] (e.g. D:dorian) keeps generated pitches in that
+    // scale; --transpose also moves every training melody into it.
+    Scale scale;
+    bool transpose = false;
+    int beamWidth = 0;
+    int endPitch = -1;
+    double targetSeconds = 0.0;
+    // --seed N picks the melody; without it a seed is drawn and printed, so
+    // any run can be repeated.
+    bool seeded = false;
+    uint64_t seed = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) workerThreads = static_cast<size_t>(std::max(0, std::atoi(argv[++i])));
+        else if (arg == "--retrain") retrain = true;
+        else if (arg == "--export-text") ingestOptions.exportText = true;
+        else if (arg == "--joint") useJoint = true;
+        else if (arg == "--intervals") useIntervals = true;
+        else if (arg == "--context-order" && i + 1 < argc) {
+            contextOrder = std::atoi(argv[++i]);
+            if (contextOrder < 1 || contextOrder > ContextTree::kMaxOrder) {
+                std::cerr << "--context-order must be 1.." << ContextTree::kMaxOrder << "\n";
+                return 1;
+            }
+        }
+        else if (arg == "--memory-budget" && i + 1 < argc) {
+            char *end = nullptr;
+            const double value = std::strtod(argv[++i], &end);
+            const double multiplier = (*end == 'k' || *end == 'K') ? 1024.0 : (*end == 'm' || *end == 'M') ? 1048576.0 : 1.0;
+            if (!(value > 0.0) || (multiplier == 1.0 && *end != '\0')) {
+                std::cerr << "--memory-budget expects a byte count such as 65536, 64k or 2m\n";
+                return 1;
+            }
+            memoryBudget = static_cast<size_t>(value * multiplier);
+        }
+        else if (arg == "--melody" && i + 1 < argc) {
+            if (!MelodyExtractor::parseMode(argv[++i], ingestOptions.melody)) {
+                std::cerr << "Unknown --melody mode '" << argv[i] << "' (all, skyline, track, voice)\n";
+                return 1;
+            }
+        }
+        else if (arg == "--tempo" && i + 1 < argc) {
+            if (!parseTempoSpec(argv[++i], midiPPQ, outputTempo)) {
+                std::cerr << "Bad --tempo '" << argv[i] << "' (BPM or TICK:BPM, comma-separated; 4..1000 bpm)\n";
+                return 1;
+            }
+        }
+        else if (arg == "--scale" && i + 1 < argc) {
+            if (!Scale::parse(argv[++i], scale)) {
+                std::cerr << "Bad --scale '" << argv[i] << "' (TONIC[:NAME], NAME one of " << Scale::names() << ")\n";
+                return 1;
+            }
+        }
+        else if (arg == "--transpose") transpose = true;
+        else if (arg == "--constrained") constrained = true;
+        else if (arg == "--beam" && i + 1 < argc) beamWidth = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--end-pitch" && i + 1 < argc) endPitch = std::atoi(argv[++i]);
+        else if (arg == "--target-seconds" && i + 1 < argc) targetSeconds = std::max(0.0, std::atof(argv[++i]));
+        else if (arg == "--seed" && i + 1 < argc) {
+            seeded = true;
+            seed = std::strtoull(argv[++i], nullptr, 10);
+        }
+    }
+    if (beamWidth == 0 && (endPitch >= 0 || targetSeconds > 0.0)) {
+        std::cerr << "--end-pitch and --target-seconds need --beam\n";
+        return 1;
+    }
+    if (transpose) {
+        if (scale.chromatic()) std::cerr << "--transpose needs a --scale to transpose into; ignored\n";
+        ingestOptions.transposeTo = scale;
+    }
+    ThreadPool pool(workerThreads);
+
     Parser parser;
 
-    std::cout << "Phase A: Parsing MIDI files and exporting text training files...\n";
+    MarkovModel melodyModel(markovOrder);
+    RhythmModel rhythmModel(markovOrder);
+    CorpusIngest ingest(melodyFolder, durationFolder, ingestOptions);
+    CorpusManifest manifest;
+    CorpusFile previousCorpus;
+    const bool haveMidi = fs::exists(midiFolder);
+
+    // A current manifest means the compiled model already holds every file it
+    // lists; only the difference to the MIDI folder needs parsing and training.
+    bool modelLoaded = false;
+    long long loadUs = 0;
+    if (!retrain && manifestIsCurrent(manifestPath, compiledModelPath, corpusPath)) {
+        auto tl0 = clock::now();
+        modelLoaded = manifest.load(manifestPath) && ModelFile::load(compiledModelPath, melodyModel, rhythmModel) &&
+                      melodyModel.order() == markovOrder && (!haveMidi || previousCorpus.open(corpusPath));
+        loadUs = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - tl0).count();
+        if (modelLoaded && manifest.ingest() != ingest.settings()) {
+            std::cout << "Ingest settings changed (" << manifest.ingest() << " -> " << ingest.settings() << "); retraining from scratch.\n\n";
+            modelLoaded = false;
+        } else if (!modelLoaded) {
+            std::cout << "Compiled model unusable; retraining from scratch.\n\n";
+        }
+        if (!modelLoaded) {
+            melodyModel = MarkovModel(markovOrder);
+            rhythmModel = RhythmModel(markovOrder);
+            manifest = CorpusManifest();
+            previousCorpus.close();
+        }
+    }
+    manifest.setIngest(ingest.settings());
+
+    std::cout << "Phase A: Parsing new and changed MIDI files into the training corpus (" << pool.size() << " threads)...\n";
     auto t0 = clock::now();
 
     size_t midiFiles = 0;
     size_t totalParsedNotes = 0;
     std::map<std::string, size_t> perFileNotes;
+    CorpusManifest::Delta delta;
+    // Manifest paths whose previous sequence is out of date; corpus sequences
+    // are named by the same paths.
+    std::unordered_set<std::string> replaced;
+    IngestResult ingested;
+
+    if (haveMidi) {
+        auto midiPaths = CorpusIngest::listMidiFiles(midiFolder);
+        delta = manifest.diff(midiPaths);
+        std::vector<std::string> toParse;
+        for (const auto &e : delta.added) toParse.push_back(e.path);
+        for (const auto &e : delta.changed) toParse.push_back(e.path);
+        for (const auto &e : delta.changed) replaced.insert(e.path);
+        for (const auto &e : delta.removed) replaced.insert(e.path);
+        std::cout << "  Manifest: " << delta.added.size() << " new, " << delta.changed.size() << " changed, "
+                  << delta.removed.size() << " removed, " << (midiPaths.size() - toParse.size()) << " unchanged\n";
+
+        ingested = ingest.run(toParse, pool);
+        for (const auto &f : ingested.files) {
+            midiFiles++;
+            totalParsedNotes += f.notes;
+            perFileNotes[f.path] = f.notes;
+            std::cout << "  Processed: " << fs::path(f.path).stem().string() << " (" << f.notes << " notes";
+            if (f.transposition != 0) std::cout << ", transposed " << (f.transposition > 0 ? "+" : "") << f.transposition;
+            std::cout << ")\n";
+        }
+        if (ingested.seconds > 0.0 && midiFiles > 0) {
+            std::cout << "  Throughput: " << (midiFiles / ingested.seconds) << " files/s, " << (totalParsedNotes / ingested.seconds) << " notes/s, "
+                      << (ingested.totalBytes / (1024.0 * 1024.0) / ingested.seconds) << " MB/s\n";
+        }
 
-    if (fs::exists(midiFolder)) {
-        for (auto& entry : fs::directory_iterator(midiFolder)) {
-            if (!entry.is_regular_file()) continue;
-            if (entry.path().extension() == ".mid" || entry.path().extension() == ".midi") {
-                std::string stem = entry.path().stem().string();
-                std::string melodyOut   = (fs::path(melodyFolder) / (stem + ".txt")).string();
-                std::string durationOut = (fs::path(durationFolder) / (stem + "_dur.txt")).string();
-
-                auto events = parser.parseMidiFile(entry.path().string());
-                parser.exportMelodyTxt(events, melodyOut);
-                parser.exportDurationTxt(events, durationOut);
-
-                midiFiles++;
-                totalParsedNotes += events.size();
-                perFileNotes[stem] = events.size();
-                std::cout << "  Processed: " << stem << " (" << events.size() << " notes)\n";
+        if (!modelLoaded || !delta.empty()) {
+            // Previous sequences that are still current, plus the new ones. The
+            // corpus is rewritten whole, so this stays O(corpus) per run.
+            std::vector<CorpusFile::Sequence> sequences;
+            if (previousCorpus.isOpen()) {
+                for (size_t i = 0; i < previousCorpus.size(); ++i) {
+                    CorpusFile::Sequence seq;
+                    seq.name = previousCorpus.name(i);
+                    if (replaced.count(seq.name)) continue;
+                    seq.pitches.assign(previousCorpus.pitches(i).begin(), previousCorpus.pitches(i).end());
+                    seq.durations.assign(previousCorpus.durations(i).begin(), previousCorpus.durations(i).end());
+                    sequences.push_back(std::move(seq));
+                }
+            }
+            sequences.insert(sequences.end(), ingested.sequences.begin(), ingested.sequences.end());
+            std::stable_sort(sequences.begin(), sequences.end(),
+                             [](const CorpusFile::Sequence &a, const CorpusFile::Sequence &b) { return a.name < b.name; });
+            if (CorpusFile::write(corpusPath, sequences)) {
+                std::cout << "  Wrote corpus -> " << corpusPath << " (" << fs::file_size(corpusPath) << " bytes)\n";
             }
         }
+        if (ingestOptions.exportText && midiFiles > 0) std::cout << "  Exported text training files to " << melodyFolder << " and " << durationFolder << "\n";
     } else {
         std::cout << "Warning: midiFolder '" << midiFolder << "' does not exist. Skipping conversion step.\n";
     }
@@ -75,99 +332,243 @@ int main(int argc, char** argv) {
     auto durParseMs = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
     std::cout << "Parsing/export stage done. MIDI files processed: " << midiFiles << ", total notes: " << totalParsedNotes << ", time: " << durParseMs << " ms\n\n";
 
-    std::cout << "Phase B: Loading training sequences from text files...\n";
     std::vector<std::vector<int>> melodySeqs;
     std::vector<std::vector<double>> durSeqs;
-
-    if (fs::exists(melodyFolder)) {
-        for (auto &entry : fs::directory_iterator(melodyFolder)) {
-            if (!entry.is_regular_file()) continue;
-            auto p = entry.path();
-            if (p.extension() == ".txt" && p.stem().string().find("_dur") == std::string::npos) {
-                auto seq = parser.parseMelodyTxt(p.string());
-                if (!seq.empty()) {
-                    melodySeqs.push_back(seq);
-                }
-                std::string durPath = (fs::path(durationFolder) / (p.stem().string() + "_dur.txt")).string();
-                if (fs::exists(durPath)) {
-                    auto dseq = parser.parseDurationTxt(durPath);
-                    if (!dseq.empty()) durSeqs.push_back(dseq);
+    CorpusFile corpus;
+    size_t melodySeqCount = 0;
+    size_t durSeqCount = 0;
+    long long durTrainMs = 0;
+    bool modelChanged = false;
+
+    if (modelLoaded) {
+        std::cout << "Phase B/C: Loaded compiled model " << compiledModelPath << " (" << manifest.size() << " files)\n";
+        std::cout << "  Load time (mmap + checksum): " << loadUs << " us\n";
+        if (!delta.empty()) {
+            auto t2 = clock::now();
+            // Changed files come out with their old contents and go back in with the new.
+            size_t untrained = 0;
+            for (size_t i = 0; i < previousCorpus.size(); ++i) {
+                const std::string name = previousCorpus.name(i);
+                if (!replaced.count(name)) continue;
+                bool ok = melodyModel.untrain(previousCorpus.pitches(i));
+                ok = rhythmModel.untrain(previousCorpus.durations(i)) && ok;
+                if (!ok) std::cerr << "  Warning: model did not hold all counts of '" << name << "'\n";
+                ++untrained;
+            }
+            for (const auto &seq : ingested.sequences) {
+                melodyModel.train(Span<const uint8_t>(seq.pitches));
+                rhythmModel.train(Span<const double>(seq.durations));
+            }
+            melodyModel.compact();
+            rhythmModel.compact();
+            durTrainMs = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - t2).count();
+            std::cout << "  Incremental update: removed " << untrained << " sequences, added " << ingested.sequences.size()
+                      << " in " << durTrainMs << " ms (counts only; corpus.bin and model.bin are rewritten whole)\n";
+            modelChanged = true;
+        }
+        std::cout << "\n";
+    } else {
+        auto tb0 = clock::now();
+        if (fs::exists(corpusPath) && corpus.open(corpusPath)) {
+            std::cout << "Phase B: Mapping training corpus " << corpusPath << "...\n";
+            melodySeqCount = corpus.size();
+            durSeqCount = corpus.size();
+        } else {
+            std::cout << "Phase B: Loading training sequences from text files...\n";
+            if (fs::exists(melodyFolder)) {
+                for (auto &entry : fs::directory_iterator(melodyFolder)) {
+                    if (!entry.is_regular_file()) continue;
+                    auto p = entry.path();
+                    if (p.extension() == ".txt" && p.stem().string().find("_dur") == std::string::npos) {
+                        auto seq = parser.parseMelodyTxt(p.string());
+                        if (!seq.empty()) {
+                            melodySeqs.push_back(seq);
+                        }
+                        std::string durPath = (fs::path(durationFolder) / (p.stem().string() + "_dur.txt")).string();
+                        if (fs::exists(durPath)) {
+                            auto dseq = parser.parseDurationTxt(durPath);
+                            if (!dseq.empty()) durSeqs.push_back(dseq);
+                        }
+                    }
                 }
             }
+            melodySeqCount = melodySeqs.size();
+            durSeqCount = durSeqs.size();
         }
-    }
+        auto loadCorpusUs = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - tb0).count();
 
-    std::cout << "  Melody sequences found: " << melodySeqs.size() << "\n";
-    std::cout << "  Duration sequences found: " << durSeqs.size() << "\n\n";
+        std::cout << "  Melody sequences found: " << melodySeqCount << "\n";
+        std::cout << "  Duration sequences found: " << durSeqCount << "\n";
+        std::cout << "  Load time: " << loadCorpusUs << " us\n\n";
 
-    std::cout << "Phase C: Training Markov melody model and rhythm model...\n";
-    auto t2 = clock::now();
+        std::cout << "Phase C: Training Markov melody model and rhythm model (" << pool.size() << " threads)...\n";
+        auto t2 = clock::now();
 
-    MarkovModel melodyModel(markovOrder);
-    melodyModel.trainMany(melodySeqs);
+        if (corpus.isOpen()) {
+            melodyModel.trainMany(corpus.allPitches(), pool);
+        } else {
+            melodyModel.trainMany(melodySeqs, pool);
+        }
 
-    RhythmModel rhythmModel(markovOrder);
-    if (!durSeqs.empty()) {
-        rhythmModel.trainMany(durSeqs);
-    } else {
-        std::cout << "  Warning: no duration sequences available; rhythm model will fallback to defaults.\n";
+        if (corpus.isOpen() && durSeqCount > 0) {
+            rhythmModel.trainMany(corpus.allDurations(), pool);
+        } else if (!durSeqs.empty()) {
+            rhythmModel.trainMany(durSeqs, pool);
+        } else {
+            std::cout << "  Warning: no duration sequences available; rhythm model will fallback to defaults.\n";
+        }
+
+        auto t3 = clock::now();
+        durTrainMs = std::chrono::duration_cast<std::chrono::milliseconds>(t3 - t2).count();
+        std::cout << "Training time: " << durTrainMs << " ms\n";
+        modelChanged = true;
     }
 
-    auto t3 = clock::now();
-    auto durTrainMs = std::chrono::duration_cast<std::chrono::milliseconds>(t3 - t2).count();
-    std::cout << "Training time: " << durTrainMs << " ms\n\n";
+    // Model first, manifest last: the manifest only vouches for a model that is on disk.
+    if (modelChanged) {
+        if (ModelFile::save(compiledModelPath, melodyModel, rhythmModel)) {
+            std::cout << "  Saved compiled model -> " << compiledModelPath << " (" << fs::file_size(compiledModelPath) << " bytes)\n";
+            manifest.apply(delta);
+            if (manifest.save(manifestPath)) std::cout << "  Saved manifest -> " << manifestPath << " (" << manifest.size() << " files)\n";
+        }
+        std::cout << "\n";
+    } else if (!delta.touched.empty()) {
+        manifest.apply(delta);
+        manifest.save(manifestPath);
+    }
 
     std::cout << "Phase D: Model metrics\n";
     std::cout << "  Melody vocabulary size (distinct tokens): " << melodyModel.vocabularySize() << "\n";
 
-    std::set<std::vector<int>> uniqueHistories;
-    for (const auto &seq : melodySeqs) {
-        if (seq.size() < 2) continue;
-        for (size_t i = 1; i < seq.size(); ++i) {
-            for (int k = 1; k <= markovOrder; ++k) {
-                if (i < static_cast<size_t>(k)) break;
-                std::vector<int> h(seq.begin() + (i - k), seq.begin() + i);
-                uniqueHistories.insert(h);
-            }
+    size_t transitionsEntries = melodyModel.transitionCount();
+    uint64_t transitionsTypes = melodyModel.observationCount();
+    std::cout << "  Unique conditioning histories considered: " << melodyModel.historyCount() << "\n";
+    std::cout << "  Transition entries (history -> possible next tokens): " << transitionsEntries << "\n";
+    std::cout << "  Transition observations (sum of counts): " << transitionsTypes << "\n";
+
+    if (rhythmModel.hasUnit()) {
+        std::cout << "  Rhythm quantization unit (seconds): " << rhythmModel.unit() << "\n";
+        if (rhythmModel.quantizer().coverage() > 0.0) {
+            std::cout << "  Rhythm grid fits " << 100.0 * rhythmModel.quantizer().coverage() << "% of training durations\n";
         }
+        std::cout << "  Distinct duration tokens seen: " << rhythmModel.vocabularySize() << " (of " << RhythmQuantizer::kTokenCount << ")\n";
+    } else {
+        std::cout << "  Rhythm model has no unit (no durations trained)\n";
     }
 
-    size_t transitionsEntries = 0;
-    size_t transitionsTypes = 0;
-    for (const auto &h : uniqueHistories) {
-        auto cnts = melodyModel.getCountsForHistory(h);
-        if (!cnts.empty()) {
-            transitionsEntries += cnts.size();
-            transitionsTypes += std::accumulate(cnts.begin(), cnts.end(), size_t(0), [](size_t acc, const std::pair<int,uint32_t>& p){ 
-                return acc + p.second; 
-            });
+    // The joint model takes milliseconds to count, so it is rebuilt from the
+    // corpus on every --joint run instead of being stored in the compiled model.
+    JointModel jointModel(markovOrder);
+    if (useJoint && rhythmModel.hasUnit()) {
+        if (!corpus.isOpen() && fs::exists(corpusPath)) corpus.open(corpusPath);
+        if (corpus.isOpen()) {
+            jointModel.trainMany(corpus.allPitches(), corpus.allDurations(), rhythmModel.quantizer(), pool);
+        } else if (melodySeqs.size() == durSeqs.size()) {
+            jointModel.trainMany(melodySeqs, durSeqs, rhythmModel.quantizer());
         }
+        std::cout << "  Joint model: " << jointModel.vocabularySize() << " (pitch, duration) tokens, "
+                  << jointModel.transitionCount() << " transition entries, " << jointModel.memoryBytes() << " bytes\n";
     }
-    std::cout << "  Unique conditioning histories considered: " << uniqueHistories.size() << "\n";
-    std::cout << "  Transition entries (history -> possible next tokens): " << transitionsEntries << "\n";
-    std::cout << "  Transition observations (sum of counts): " << transitionsTypes << "\n";
 
-    if (rhythmModel.hasUnit()) {
-        std::cout << "  Rhythm quantization unit (seconds): " << rhythmModel.unit() << "\n";
+    // Built from the corpus like the joint model, for the same reason.
+    ContextTree melodyTree(contextOrder > 0 ? contextOrder : 1);
+    if (contextOrder > 0) {
+        if (!corpus.isOpen() && fs::exists(corpusPath)) corpus.open(corpusPath);
+        if (corpus.isOpen()) melodyTree.build(corpus.allPitches());
+        else melodyTree.build(melodySeqs);
+        std::cout << "  Melody context tree (order " << melodyTree.maxOrder() << ", min count " << melodyTree.minCount() << "): "
+                  << melodyTree.nodeCount() << " contexts, " << melodyTree.entryCount() << " transition entries, "
+                  << melodyTree.memoryBytes() << " bytes\n";
+    }
 
-        std::set<int> durTokens;
-        for (const auto &s : durSeqs) {
-            for (double d : s) {
-                if (d <= 0.0) continue;
-                durTokens.insert(rhythmModel.durationToToken(d));
-            }
+    CompactModel melodyCompact;
+    bool useCompact = false;
+    if (memoryBudget > 0) {
+        CompactModel::Options options;
+        options.budgetBytes = memoryBudget;
+        useCompact = melodyCompact.build(melodyModel, options);
+        if (!useCompact) {
+            std::cerr << "Warning: cannot compact the melody model into " << memoryBudget << " bytes; sampling from the full model\n";
+            melodyCompact = CompactModel();
         }
-        std::cout << "  Distinct duration tokens seen: " << durTokens.size() << "\n";
+    }
+    if (useCompact) {
+        std::cout << "  Compacted melody model (budget " << memoryBudget << " bytes, min count " << melodyCompact.minCount()
+                  << ", min history count " << melodyCompact.minHistoryCount() << "): " << melodyCompact.historyCount()
+                  << " histories, " << melodyCompact.entryCount() << " transition entries, " << melodyCompact.memoryBytes()
+                  << " bytes\n";
+    }
+
+    // Built from the corpus like the joint model, for the same reason.
+    IntervalModel melodyIntervals(markovOrder);
+    if (useIntervals) {
+        if (!corpus.isOpen() && fs::exists(corpusPath)) corpus.open(corpusPath);
+        if (corpus.isOpen()) melodyIntervals.trainMany(corpus.allPitches(), pool);
+        else melodyIntervals.trainMany(melodySeqs);
+        std::cout << "  Interval melody model: " << melodyIntervals.vocabularySize() << " steps, " << melodyIntervals.historyCount()
+                  << " histories, " << melodyIntervals.transitionCount() << " transition entries, " << melodyIntervals.memoryBytes()
+                  << " bytes (absolute pitches: " << melodyModel.vocabularySize() << " pitches, " << melodyModel.historyCount()
+                  << " histories, " << transitionsEntries << " transition entries)\n";
+    }
+
+    // Generation runs at fixed temperatures, so draw from alias tables.
+    melodyModel.freeze(melodyTemp);
+    rhythmModel.freeze(rhythmTemp);
+    if (jointModel.trained()) jointModel.freeze(melodyTemp);
+    if (melodyIntervals.trained()) melodyIntervals.freeze(melodyTemp);
+    size_t modelBytes = melodyModel.memoryBytes() + rhythmModel.memoryBytes() + jointModel.memoryBytes() + melodyTree.memoryBytes() +
+                         melodyCompact.memoryBytes() + melodyIntervals.memoryBytes();
+    size_t aliasBytes = melodyModel.frozenMemoryBytes() + rhythmModel.frozenMemoryBytes() + jointModel.frozenMemoryBytes() +
+                        melodyIntervals.frozenMemoryBytes();
+    if (modelLoaded && !modelChanged) {
+        // Loaded tables live in the mapping, not on the heap.
+        modelBytes += static_cast<size_t>(fs::file_size(compiledModelPath));
+        std::cout << "  Model tables (mapped): " << modelBytes;
     } else {
-        std::cout << "  Rhythm model has no unit (no durations trained)\n";
+        std::cout << "  Model tables: " << modelBytes;
     }
+    std::cout << " bytes, alias tables: " << aliasBytes << " bytes (+"
+              << (modelBytes ? 100.0 * aliasBytes / modelBytes : 0.0) << "%)\n";
     std::cout << "\n";
 
     std::cout << "Phase E: Generating melody (length = " << generateLength << ")...\n";
     auto t4 = clock::now();
 
     MelodyGenerator gen(melodyModel, rhythmModel, markovOrder, historyMax);
-    auto generatedNotes = gen.generate(generateLength, startPitch, minPitch, maxPitch, melodyTemp, rhythmTemp);
+    if (jointModel.trained()) gen.setJointModel(&jointModel);
+    if (contextOrder > 0) gen.setMelodyTree(&melodyTree);
+    if (useCompact) gen.setMelodyCompact(&melodyCompact);
+    if (useIntervals) gen.setMelodyIntervals(&melodyIntervals);
+    MelodyRequest request;
+    request.length = generateLength;
+    request.startPitch = startPitch;
+    request.minPitch = minPitch;
+    request.maxPitch = maxPitch;
+    request.melodyTemp = melodyTemp;
+    request.rhythmTemp = rhythmTemp;
+    request.enforceScale = !scale.chromatic();
+    request.allowedPitchClasses = scale.pitchClasses();
+    request.constrained = constrained;
+    request.endPitch = endPitch;
+    request.targetDuration = targetSeconds;
+    std::vector<NoteEvent> generatedNotes;
+    if (beamWidth > 0) {
+        // Beam search reads the separate melody and rhythm models only.
+        BeamSearch search(melodyModel, rhythmModel, markovOrder, historyMax);
+        if (search.search(request, beamWidth, generatedNotes)) {
+            std::cout << "  Beam width " << beamWidth << ", log-likelihood " << search.logLikelihood() << " ("
+                      << search.logLikelihood() / static_cast<double>(generatedNotes.size()) << " per note)\n";
+        } else {
+            std::cerr << "  Beam search found no melody meeting the constraints\n";
+        }
+    } else {
+        if (!seeded) {
+            std::random_device rd;
+            seed = (static_cast<uint64_t>(rd()) << 32) ^ rd() ^ static_cast<uint64_t>(clock::now().time_since_epoch().count());
+        }
+        std::cout << "  Seed: " << seed << (seeded ? "" : " (pass --seed to repeat this melody)") << "\n";
+        generatedNotes = std::move(gen.generateBatch({ request }, seed, pool).front());
+    }
 
     auto t5 = clock::now();
     auto durGenMs = std::chrono::duration_cast<std::chrono::milliseconds>(t5 - t4).count();
@@ -190,7 +591,7 @@ int main(int argc, char** argv) {
     std::cout << "Phase F: Writing MIDI file: " << generatedMidPath << " ...\n";
     auto t6 = clock::now();
     MidiWriter writer;
-    bool ok = writer.write(generatedMidPath, generatedNotes, midiPPQ, tempoMicro, midiChannel, midiVelocity);
+    bool ok = writer.write(generatedMidPath, generatedNotes, outputTempo, midiChannel, midiVelocity);
     auto t7 = clock::now();
     auto durWriteMs = std::chrono::duration_cast<std::chrono::milliseconds>(t7 - t6).count();
 
@@ -210,8 +611,12 @@ int main(int argc, char** argv) {
     if (midiFiles > 0) {
         std::cout << "Avg notes / MIDI: " << (totalParsedNotes / static_cast<double>(midiFiles)) << "\n";
     }
-    std::cout << "Melody sequences used for training: " << melodySeqs.size() << "\n";
-    std::cout << "Duration sequences used for training: " << durSeqs.size() << "\n";
+    if (modelLoaded) {
+        std::cout << "Models loaded from: " << compiledModelPath << "\n";
+    } else {
+        std::cout << "Melody sequences used for training: " << melodySeqCount << "\n";
+        std::cout << "Duration sequences used for training: " << durSeqCount << "\n";
+    }
     std::cout << "Melody vocab size: " << melodyModel.vocabularySize() << "\n";
     std::cout << "Transition entries: " << transitionsEntries << "\n";
     std::cout << "Transition observations: " << transitionsTypes << "\n";
@@ -0,0 +1,101 @@
+#include "CorpusFile.h"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// A corpus file whose header or index points outside the file must be
+// refused by open(), with or without the checksum. Exits non-zero on any
+// mismatch.
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char* what) {
+    if (ok) return;
+    std::cerr << "FAIL: " << what << "\n";
+    ++failures;
+}
+
+// Header field offsets: magic, version, byteOrder, fileSize, checksum,
+// sequenceCount, totalNotes, namesOffset, pitchesOffset, durationsOffset,
+// reserved.
+const size_t kPitchesOffset = 56;
+const size_t kReserved = 72;
+const size_t kFirstIndexEntry = 80;
+
+std::vector<char> readAll(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void writeAll(const std::string& path, const std::vector<char>& bytes) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+void patch64(std::vector<char>& bytes, size_t at, uint64_t value) {
+    std::memcpy(bytes.data() + at, &value, sizeof(value));
+}
+
+}
+
+int main() {
+    namespace fs = std::filesystem;
+    const fs::path dir = fs::temp_directory_path() / "musicgen-corpus-file-test";
+    fs::create_directories(dir);
+    const std::string path = (dir / "corpus.bin").string();
+
+    std::vector<CorpusFile::Sequence> sequences(2);
+    sequences[0] = CorpusFile::Sequence{ "a", { 60, 62, 64 }, { 0.5, 0.5, 1.0 } };
+    sequences[1] = CorpusFile::Sequence{ "b", { 67, 65 }, { 0.25, 0.75 } };
+    check(CorpusFile::write(path, sequences), "write() succeeds");
+    const std::vector<char> good = readAll(path);
+    {
+        CorpusFile corpus;
+        check(corpus.open(path) && corpus.size() == 2 && corpus.totalNotes() == 5 && corpus.pitches(1)[0] == 67,
+              "a written corpus opens and reads back");
+    }
+
+    // Offsets and counts that would wrap an addition-based bounds check.
+    struct Case {
+        const char* what;
+        size_t at;
+        uint64_t value;
+    };
+    const Case cases[] = {
+        { "a pitches offset near 2^64 is refused", kPitchesOffset, UINT64_MAX - 1 },
+        { "a sequence starting near 2^64 is refused", kFirstIndexEntry, UINT64_MAX - 1 },
+    };
+    for (const auto &c : cases) {
+        std::vector<char> bad = good;
+        patch64(bad, c.at, c.value);
+        writeAll(path, bad);
+        CorpusFile verified, unverified;
+        check(!verified.open(path, true) && !unverified.open(path, false), c.what);
+    }
+
+    // The checksum covers the header: a changed field that every bound
+    // still accepts is caught.
+    {
+        std::vector<char> bad = good;
+        patch64(bad, kReserved, 1);
+        writeAll(path, bad);
+        CorpusFile corpus;
+        check(!corpus.open(path, true), "a changed header field fails the checksum");
+    }
+
+    fs::remove_all(dir);
+    if (failures) {
+        std::cerr << failures << " corpus file check(s) failed\n";
+        return 1;
+    }
+    std::cout << "All corpus file checks passed\n";
+    return 0;
+}
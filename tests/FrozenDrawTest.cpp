@@ -0,0 +1,65 @@
+#include "AliasTable.h"
+#include "MarkovModel.h"
+#include "Rng.h"
+
+#include <iostream>
+#include <limits>
+#include <vector>
+
+// Freezing at a low temperature must concentrate the alias tables on the
+// heaviest successor, as the scanning draw does, not let overflowing
+// weights scramble them. Exits non-zero on any mismatch.
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char* what) {
+    if (ok) return;
+    std::cerr << "FAIL: " << what << "\n";
+    ++failures;
+}
+
+}
+
+int main() {
+    // 1 is followed by 2 5000 times, by 3 3000 times and by 4 10 times.
+    std::vector<std::vector<int>> melodies;
+    for (int i = 0; i < 5000; ++i) melodies.push_back({ 1, 2 });
+    for (int i = 0; i < 3000; ++i) melodies.push_back({ 1, 3 });
+    for (int i = 0; i < 10; ++i) melodies.push_back({ 1, 4 });
+    MarkovModel model(1);
+    model.trainMany(melodies);
+
+    const int history = 1;
+    const double temperature = 0.01;
+    const int draws = 10000;
+    Rng rng(5);
+    int scanned = 0;
+    for (int d = 0; d < draws; ++d) scanned += model.sampleNext(&history, 1, temperature, rng) == 2;
+    check(scanned == draws, "scanning draws at T=0.01 always pick the most frequent successor");
+
+    model.freeze(temperature);
+    int frozen = 0;
+    for (int d = 0; d < draws; ++d) frozen += model.sampleNext(&history, 1, temperature, rng) == 2;
+    check(frozen == draws, "frozen draws at T=0.01 always pick the most frequent successor");
+
+    // Weights that sum to infinity give a table that always draws the first
+    // largest one.
+    const double inf = std::numeric_limits<double>::infinity();
+    std::vector<double> weights = { 1.0, inf, 3.0, inf };
+    std::vector<uint32_t> threshold(weights.size()), alias(weights.size()), small, large;
+    AliasTable::build(weights.data(), static_cast<uint32_t>(weights.size()), threshold.data(), alias.data(), small, large);
+    bool degenerate = true;
+    for (int d = 0; d < draws; ++d) {
+        degenerate = degenerate && AliasTable::draw(threshold.data(), alias.data(), static_cast<uint32_t>(weights.size()), rng()) == 1;
+    }
+    check(degenerate, "an alias table over infinite weights always draws the first of them");
+
+    if (failures) {
+        std::cerr << failures << " frozen draw check(s) failed\n";
+        return 1;
+    }
+    std::cout << "All frozen draw checks passed\n";
+    return 0;
+}